@@ -5,29 +5,127 @@ Provides REST API endpoints to interact with the C shared memory KV store
 through Python ctypes wrapper.
 """
 
+import asyncio
+import base64
+import json
+import math
 import os
 import sys
 from contextlib import asynccontextmanager
 from pathlib import Path
-from typing import Optional
+from typing import Optional, Union
 
 from fastapi import FastAPI, HTTPException, Request
 from fastapi.middleware.cors import CORSMiddleware
-from fastapi.responses import JSONResponse
+from fastapi.responses import JSONResponse, StreamingResponse
 from fastapi.exceptions import RequestValidationError
-from pydantic import BaseModel, ValidationError
+from pydantic import BaseModel, StrictFloat, StrictInt, ValidationError
 
-from kv_store_wrapper import KVStoreWrapper
+from kv_store_wrapper import (
+    KVStoreWrapper,
+    SHM_NAME,
+    KV_FLAG_COMPRESS_VALUES,
+    KV_FLAG_DEDUP_VALUES,
+    KV_FLAG_PREFIX_KEYS,
+)
 
 
 # Path to shared library (relative to this file)
 BUILD_DIR = Path(__file__).parent / "build"
 LIB_PATH = BUILD_DIR / "libshared_memory_kv.so"
 
+# Shared memory object to serve; set KV_STORE_NAME=/gitflow_kv_replica to
+# serve a replica kept up to date by build/replicator
+STORE_NAME = os.environ.get("KV_STORE_NAME", SHM_NAME)
+
 
 # Global wrapper instance
 kv_store: Optional[KVStoreWrapper] = None
 
+# Whether this server created the shared memory object (and so unlinks it
+# on shutdown once no other process is attached)
+created_store = False
+
+# Background compaction: slots examined per step and pause between steps.
+# Each step holds the store lock only for its own slots, so compaction
+# never pauses other processes for a full table pass.
+COMPACT_STEP_SLOTS = 256
+COMPACT_INTERVAL_SECONDS = 0.5
+
+# Change notifications: a subscription to every key whose notification
+# descriptor is watched by the event loop; each /events client has a queue
+# holding the newest version not yet sent (older ones are dropped)
+change_subscription: Optional[int] = None
+change_fd: Optional[int] = None
+change_events = 0
+event_queues: set[asyncio.Queue] = set()
+EVENTS_KEEPALIVE_SECONDS = 15
+
+
+def on_store_change():
+    """
+    Event loop reader callback: the notification descriptor is readable.
+    
+    Drains and re-arms it, then hands the new version to every /events
+    client. A burst of writes produces a single callback.
+    """
+    global change_events
+    if kv_store is None:
+        return
+    events = kv_store.notify_read(change_subscription, change_fd, change_events)
+    if events is None:
+        return
+    change_events = events
+    
+    version = kv_store.get_version()
+    if version is None:
+        return
+    for queue in event_queues:
+        if queue.full():
+            queue.get_nowait()  # Client is behind: only the newest matters
+        queue.put_nowait(version)
+
+
+def start_change_notifications():
+    """Subscribe to every key and watch the notification descriptor."""
+    global change_subscription, change_fd
+    subscription, error = kv_store.subscribe([""], prefix=True)
+    if subscription is None:
+        print(f"Change notifications unavailable: {error}", file=sys.stderr)
+        return
+    fd = kv_store.notify_fd(subscription)
+    if fd is None:
+        print("Change notifications unavailable: no descriptor", file=sys.stderr)
+        kv_store.unsubscribe(subscription)
+        return
+    change_subscription, change_fd = subscription, fd
+    asyncio.get_running_loop().add_reader(fd, on_store_change)
+
+
+def stop_change_notifications():
+    """Stop watching the descriptor, unsubscribe and close it."""
+    global change_subscription, change_fd
+    if change_fd is None:
+        return
+    asyncio.get_running_loop().remove_reader(change_fd)
+    kv_store.unsubscribe(change_subscription)
+    os.close(change_fd)
+    change_subscription, change_fd = None, None
+
+
+async def compaction_loop():
+    """
+    Purge tombstones in small steps while the server is running.
+    
+    Also refreshes this process's heartbeat in the store registry; each
+    step reaps the registry entries of processes that died attached.
+    """
+    while True:
+        await asyncio.sleep(COMPACT_INTERVAL_SECONDS)
+        if kv_store is not None:
+            kv_store.heartbeat()
+            kv_store.compact_step(COMPACT_STEP_SLOTS)
+
 
 @asynccontextmanager
 async def lifespan(app: FastAPI):
@@ -36,7 +134,7 @@ async def lifespan(app: FastAPI):
     
     Handles initialization and cleanup of shared memory store.
     """
-    global kv_store
+    global kv_store, created_store
     
     # Startup: Initialize shared memory store
     try:
@@ -46,16 +144,18 @@ async def lifespan(app: FastAPI):
                 f"Run 'make libso' to build it."
             )
         
-        kv_store = KVStoreWrapper(str(LIB_PATH))
+        kv_store = KVStoreWrapper(str(LIB_PATH), STORE_NAME)
         
         # Try to open existing store first, create if doesn't exist
-        print(f"Attempting to open shared memory store at '{LIB_PATH}'...")
+        print(f"Attempting to open shared memory store '{STORE_NAME}' at '{LIB_PATH}'...")
         if not kv_store.open():
             print("Shared memory not found or invalid, creating new store...")
-            if not kv_store.create():
+            if not kv_store.create(KV_FLAG_DEDUP_VALUES | KV_FLAG_PREFIX_KEYS |
+                                   KV_FLAG_COMPRESS_VALUES):
                 print("FAILED to create shared memory store.", file=sys.stderr)
                 raise RuntimeError("Failed to create shared memory store")
             else:
+                created_store = True
                 print("Created new shared memory store successfully")
         else:
             print("Opened existing shared memory store successfully")
@@ -70,14 +170,23 @@ async def lifespan(app: FastAPI):
         print(f"ERROR: Failed to initialize KV store: {e}", file=sys.stderr)
         sys.exit(1)
     
+    compaction_task = asyncio.create_task(compaction_loop())
+    start_change_notifications()
+    
     yield
     
     # Shutdown: Cleanup
+    compaction_task.cancel()
+    stop_change_notifications()
     if kv_store:
         print("Cleaning up KV store...")
+        # Only the creator unlinks, and only if no other process (producer,
+        # consumer) is still attached; crashed processes don't count
+        if created_store:
+            unlinked, error = kv_store.unlink_safe()
+            if not unlinked:
+                print(f"Shared memory kept: {error}")
         kv_store.destroy()
-        # Note: We don't unlink here - only the creator process should unlink
-        # Unlinking is typically done manually or by a separate cleanup script
 
 
 # Create FastAPI app with lifespan
@@ -136,7 +245,8 @@ async def http_exception_handler(request: Request, exc: HTTPException):
 class SetRequest(BaseModel):
     """Request model for POST /set"""
     key: str
-    value: str
+    # JSON integers are stored as int64, other numbers as double
+    value: Union[StrictInt, StrictFloat, str]
 
 
 class SetResponse(BaseModel):
@@ -148,15 +258,226 @@ class SetResponse(BaseModel):
 class GetResponse(BaseModel):
     """Response model for GET /get/{key}"""
     key: str
+    # Bytes values are returned base64-encoded, hashes as field -> value
+    value: Union[StrictInt, StrictFloat, str, dict[str, str]]
+    # "string", "int64", "double", "bytes" or "hash"
+    type: str = "string"
+
+
+class HistoryResponse(BaseModel):
+    """Response model for GET /history/{key}"""
+    key: str
+    # Retained versions, newest first: value, version, timestamp
+    versions: list[dict]
+
+
+class SampleRequest(BaseModel):
+    """Request model for POST /series/{key}"""
+    value: float
+    # Milliseconds since the epoch (0 = now)
+    timestamp: int = 0
+
+
+class SeriesResponse(BaseModel):
+    """Response model for GET /series/{key}"""
+    key: str
+    # Samples oldest first: timestamp (ms), value
+    samples: list[dict]
+
+
+class SeriesListResponse(BaseModel):
+    """Response model for GET /series"""
+    # key, count, appended, first_timestamp, last_timestamp, last_value
+    series: list[dict]
+
+
+class RollupRequest(BaseModel):
+    """Request model for PUT /rollups/{key}"""
+    # Windows to maintain: "1s", "10s", "1m" (empty = disable)
+    windows: list[str] = ["1s", "10s", "1m"]
+
+
+class RollupResponse(BaseModel):
+    """Response model for GET /rollups/{key}"""
+    key: str
+    # Window name -> {"current", "previous"} buckets with start (ms),
+    # count, min, max, avg, last
+    windows: dict
+
+
+class QueuePushRequest(BaseModel):
+    """Request model for POST /queues/{name}/push"""
+    value: str
+
+
+class QueuePopResponse(BaseModel):
+    """Response model for POST /queues/{name}/pop"""
+    name: str
+    # None if the queue stayed empty; non-UTF-8 items are base64-encoded
+    value: Optional[str] = None
+    # "string" or "bytes"
+    type: str = "string"
+
+
+class QueueListResponse(BaseModel):
+    """Response model for GET /queues"""
+    # name, length, capacity, waiters, pushed, popped, rejected
+    queues: list[dict]
+
+
+class ZsetScoreRequest(BaseModel):
+    """Request model for PUT /zsets/{name}/{member}"""
+    score: float
+
+
+class ZsetMemberResponse(BaseModel):
+    """Response model for GET /zsets/{name}/{member}"""
+    name: str
+    member: str
+    score: float
+    # 0 = lowest score
+    rank: int
+    # 0 = highest score
+    reverse_rank: int
+
+
+class ZsetRangeResponse(BaseModel):
+    """Response model for GET /zsets/{name}"""
+    name: str
+    # Members in rank order: member, score
+    members: list[dict]
+
+
+class ZsetListResponse(BaseModel):
+    """Response model for GET /zsets"""
+    # name, count, capacity, min, max (lowest/highest member and score)
+    zsets: list[dict]
+
+
+class HashFieldRequest(BaseModel):
+    """Request model for PUT /hash/{key}/{field}"""
+    value: str
+
+
+class HashFieldResponse(BaseModel):
+    """Response model for GET /hash/{key}/{field}"""
+    key: str
+    field: str
     value: str
 
 
+class HashResponse(BaseModel):
+    """Response model for GET /hash/{key}"""
+    key: str
+    # Field name -> value
+    fields: dict[str, str]
+
+
+class TransactionWrite(BaseModel):
+    """Single write of a transaction (value None deletes the key)"""
+    key: str
+    value: Optional[str] = None
+
+
+class TransactionRequest(BaseModel):
+    """Request model for POST /transaction"""
+    writes: list[TransactionWrite]
+    # Expected current values (None = key must not exist)
+    expect: dict[str, Optional[str]] = {}
+
+
 class StatusResponse(BaseModel):
     """Response model for GET /status"""
     version: int
     entry_count: int
     max_entries: int
     entries: list[dict]
+    # Key -> rollup windows (see GET /rollups/{key})
+    rollups: dict = {}
+
+
+class OccupancyResponse(BaseModel):
+    """Response model for GET /stats/occupancy"""
+    capacity: int
+    entry_count: int
+    tombstone_count: int
+    load_factor: float
+    avg_probe_length: float
+    max_probe_length: int
+    probe_histogram: list[int]
+    region_size: int
+    region_occupied: list[int]
+    region_tombstones: list[int]
+    compaction: dict
+    bloom: dict
+
+
+class MemoryStatsResponse(BaseModel):
+    """Response model for GET /stats/memory"""
+    dedup_values: bool
+    prefix_keys: bool
+    single_writer: bool
+    writer_pid: int
+    arena_size: int
+    arena_top: int
+    allocated_bytes: int
+    free_bytes: int
+    blob_count: int
+    shared_blob_count: int
+    dedup_hits: int
+    bytes_saved: int
+    compression: dict
+    mvcc: dict
+    combining: dict
+    subscriptions: dict
+
+
+class ProcessesResponse(BaseModel):
+    """Response model for GET /processes"""
+    # Attached processes: pid, start_time, heartbeat, epoch, threads, alive
+    processes: list[dict]
+    # Registry entries of dead processes freed by this request
+    reaped: int
+
+
+class SearchResponse(BaseModel):
+    """Response model for GET /search"""
+    query: str
+    results: list[dict]
+
+
+class ReplicationResponse(BaseModel):
+    """Response model for GET /replication"""
+    role: str
+    log_position: int
+    connected: bool
+    pid: int
+    source: str
+    applied_position: int
+    primary_position: int
+    lag_changes: int
+    lag_ms: int
+    last_contact: float
+    applied_changes: int
+    full_syncs: int
+    bytes_received: int
+
+
+class VersionResponse(BaseModel):
+    """Response model for GET /version"""
+    version: int
+    entry_count: int
+    generation: int
+
+
+class ChangesResponse(BaseModel):
+    """Response model for GET /changes"""
+    version: int
+    entry_count: int
+    max_entries: int
+    generation: int
+    full: bool
+    changes: list[dict]
 
 
 @app.get("/")
@@ -167,8 +488,38 @@ async def root():
         "version": "1.0.0",
         "endpoints": {
             "GET /get/{key}": "Get value by key",
+            "GET /history/{key}": "Get the retained versions of a key",
+            "GET /series": "List time series",
+            "GET /series/{key}?start=&end=&limit=": "Get time series samples in a range",
+            "POST /series/{key}": "Append a sample to a time series",
+            "GET /rollups/{key}": "Get min/max/avg/last of a key over 1s/10s/1m",
+            "PUT /rollups/{key}": "Enable, change or disable the rollups of a key",
+            "GET /hash/{key}": "Get all fields of a hash entry",
+            "GET /hash/{key}/{field}": "Get a field of a hash entry",
+            "PUT /hash/{key}/{field}": "Set a field of a hash entry",
+            "DELETE /hash/{key}/{field}": "Delete a field of a hash entry",
+            "GET /queues": "List work queues",
+            "PUT /queues/{name}": "Create a work queue",
+            "DELETE /queues/{name}": "Delete a work queue with its items",
+            "POST /queues/{name}/push": "Push an item to a queue",
+            "POST /queues/{name}/pop?timeout_ms=0": "Pop an item, waiting up to timeout_ms",
+            "GET /zsets": "List sorted sets",
+            "GET /zsets/{name}?start=&limit=&reverse=&min_score=&max_score=": "Get members by rank or score range",
+            "DELETE /zsets/{name}": "Delete a sorted set",
+            "GET /zsets/{name}/{member}": "Get a member's score and rank",
+            "PUT /zsets/{name}/{member}": "Add a member or change its score",
+            "DELETE /zsets/{name}/{member}": "Remove a member from a sorted set",
             "POST /set": "Set key-value pair",
-            "GET /status": "Get store status and all entries"
+            "GET /status": "Get store status and all entries",
+            "GET /search?q={query}": "Search keys by prefix/substring/fuzzy",
+            "GET /version": "Get store version only (cheap polling check)",
+            "GET /stats/occupancy": "Get load factor, probe lengths and occupancy heatmap",
+            "POST /transaction": "Apply several writes atomically (optional expected values)",
+            "GET /stats/memory": "Get arena usage and deduplication statistics",
+            "GET /processes": "List processes attached to the store (reaps dead ones)",
+            "GET /replication": "Get role, log position and replica lag",
+            "GET /changes?since={version}&generation={generation}": "Get slots changed after a version",
+            "GET /events": "Server-sent events stream of store versions"
         }
     }
 
@@ -197,16 +548,109 @@ async def get_value(key: str):
             raise HTTPException(status_code=404, detail=error)
         raise HTTPException(status_code=500, detail=error)
     
+    if isinstance(value, bytes):
+        return GetResponse(key=key, value=base64.b64encode(value).decode(),
+                           type="bytes")
+    if isinstance(value, int):
+        return GetResponse(key=key, value=value, type="int64")
+    if isinstance(value, float):
+        return GetResponse(key=key, value=value, type="double")
+    if isinstance(value, dict):
+        return GetResponse(key=key, value=value, type="hash")
     return GetResponse(key=key, value=value)
 
 
-@app.post("/set", response_model=SetResponse)
-async def set_value(request: SetRequest):
+@app.get("/history/{key}", response_model=HistoryResponse)
+async def get_history(key: str):
     """
-    Set key-value pair in the store.
+    Get the versions of a key kept in its version chain.
     
     Args:
-        request: JSON body with key and value
+        key: Key to look up
+        
+    Returns:
+        JSON with key and its versions, newest first
+        
+    Raises:
+        HTTPException: If key not found or error occurs
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    versions, error = kv_store.history(key)
+    
+    if error:
+        if "not found" in error.lower():
+            raise HTTPException(status_code=404, detail=error)
+        raise HTTPException(status_code=500, detail=error)
+    
+    return HistoryResponse(key=key, versions=versions)
+
+
+@app.get("/series", response_model=SeriesListResponse)
+async def list_series():
+    """
+    List the time series with their newest sample.
+    
+    Returns:
+        JSON with one summary per series
+        
+    Raises:
+        HTTPException: If store not initialized or error occurs
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    series = kv_store.ts_list()
+    if series is None:
+        raise HTTPException(status_code=500, detail="Failed to list series")
+    
+    return SeriesListResponse(series=series)
+
+
+@app.get("/series/{key}", response_model=SeriesResponse)
+async def get_series(key: str, start: int = 0, end: int = 0, limit: int = 256):
+    """
+    Get the samples of a time series within a time range.
+    
+    Args:
+        key: Series name
+        start: First timestamp in ms (inclusive, 0 = no limit)
+        end: Last timestamp in ms (inclusive, 0 = no limit)
+        limit: Maximum number of samples (the newest are returned)
+        
+    Returns:
+        JSON with key and samples, oldest first
+        
+    Raises:
+        HTTPException: If series not found or error occurs
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    if start < 0 or end < 0 or limit < 0:
+        raise HTTPException(status_code=400, detail="start, end and limit must be >= 0")
+    
+    samples, error = kv_store.ts_range(key, start, end, limit)
+    
+    if error:
+        if "not found" in error.lower():
+            raise HTTPException(status_code=404, detail=error)
+        if "too long" in error.lower():
+            raise HTTPException(status_code=413, detail=error)
+        raise HTTPException(status_code=500, detail=error)
+    
+    return SeriesResponse(key=key, samples=samples)
+
+
+@app.post("/series/{key}", response_model=SetResponse)
+async def append_sample(key: str, request: SampleRequest):
+    """
+    Append a sample to a time series (created on first append).
+    
+    Args:
+        key: Series name
+        request: JSON body with value and optional timestamp (ms)
         
     Returns:
         JSON with success status and message
@@ -217,64 +661,922 @@ async def set_value(request: SetRequest):
     if kv_store is None:
         raise HTTPException(status_code=503, detail="Store not initialized")
     
-    success, error = kv_store.set(request.key, request.value)
+    success, error = kv_store.ts_append(key, request.value, request.timestamp)
     
     if not success:
         status_code = 400
         if "too long" in error.lower():
             status_code = 413  # Payload Too Large
-        elif "full" in error.lower() or "ENOSPC" in error:
+        elif "too many" in error.lower():
             status_code = 507  # Insufficient Storage
+        elif "EPERM" in error:
+            status_code = 403  # Store created in single-writer mode
         raise HTTPException(status_code=status_code, detail=error)
     
     return SetResponse(
         success=True,
-        message=f"Key '{request.key}' set successfully"
+        message=f"Sample appended to '{key}'"
     )
 
 
-@app.get("/status", response_model=StatusResponse)
-async def get_status():
+@app.get("/rollups/{key}", response_model=RollupResponse)
+async def get_rollup(key: str):
     """
-    Get store status including version, entry count, and all entries.
+    Get the rollups (min/max/avg/last per window) of a key.
     
+    Args:
+        key: Key name
+        
     Returns:
-        JSON with store status and all key-value pairs
+        JSON with the current and the last completed bucket of each window
         
     Raises:
-        HTTPException: If store not initialized or error occurs
+        HTTPException: If the key has no rollups or error occurs
     """
     if kv_store is None:
         raise HTTPException(status_code=503, detail="Store not initialized")
     
-    try:
-        status = kv_store.get_status()
+    rollup, error = kv_store.rollup_get(key)
+    
+    if error:
+        if "no rollups" in error.lower():
+            raise HTTPException(status_code=404, detail=error)
+        if "too long" in error.lower():
+            raise HTTPException(status_code=413, detail=error)
+        raise HTTPException(status_code=500, detail=error)
+    
+    return RollupResponse(**rollup)
+
+
+@app.put("/rollups/{key}", response_model=SetResponse)
+async def configure_rollup(key: str, request: RollupRequest):
+    """
+    Enable, change or disable the rollups of a key.
+    
+    Args:
+        key: Key name (need not exist yet)
+        request: JSON body with the windows to maintain (empty = disable)
         
-        if status is None:
-            raise HTTPException(status_code=500, detail="Failed to get status")
+    Returns:
+        JSON with success status and message
         
-        # Validate and create response model
-        # This may raise ValidationError if data structure is invalid
-        return StatusResponse(**status)
-    except Exception as e:
-        # Re-raise HTTPException as-is (it will include CORS headers via middleware)
-        if isinstance(e, HTTPException):
-            raise
-        # For unexpected errors, wrap in HTTPException
-        raise HTTPException(
-            status_code=500,
-            detail=f"Internal server error: {str(e)}"
-        )
+    Raises:
+        HTTPException: If operation fails
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    success, error = kv_store.rollup_enable(key, request.windows)
+    
+    if not success:
+        status_code = 400
+        if "no rollups" in error.lower():
+            status_code = 404
+        elif "too long" in error.lower():
+            status_code = 413  # Payload Too Large
+        elif "too many" in error.lower():
+            status_code = 507  # Insufficient Storage
+        elif "EPERM" in error:
+            status_code = 403  # Store created in single-writer mode
+        raise HTTPException(status_code=status_code, detail=error)
+    
+    windows = ", ".join(request.windows)
+    return SetResponse(
+        success=True,
+        message=f"Rollups of '{key}': {windows}" if windows
+        else f"Rollups of '{key}' disabled"
+    )
 
 
-if __name__ == "__main__":
-    import uvicorn
+def hash_error_status(error: str) -> int:
+    """HTTP status of a failed hash operation."""
+    if "not found" in error.lower():
+        return 404
+    if "not a hash" in error.lower():
+        return 409  # Conflict: the key holds another type
+    if "too long" in error.lower():
+        return 413  # Payload Too Large
+    if "full" in error.lower():
+        return 507  # Insufficient Storage
+    if "EPERM" in error:
+        return 403  # Store created in single-writer mode
+    return 500
+
+
+@app.get("/hash/{key}", response_model=HashResponse)
+async def get_hash(key: str):
+    """
+    Get all fields of a hash entry with one lookup.
     
-    # Run server
-    uvicorn.run(
-        "api_server:app",
-        host="0.0.0.0",
-        port=8000,
-        reload=False  # Disable reload in production
-    )
+    Args:
+        key: Key name
+        
+    Returns:
+        JSON with key and its fields
+        
+    Raises:
+        HTTPException: If key not found, not a hash or error occurs
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    fields, error = kv_store.hgetall(key)
+    
+    if error:
+        raise HTTPException(status_code=hash_error_status(error), detail=error)
+    
+    return HashResponse(key=key, fields=fields)
 
+
+@app.get("/hash/{key}/{field}", response_model=HashFieldResponse)
+async def get_hash_field(key: str, field: str):
+    """
+    Get a field of a hash entry.
+    
+    Args:
+        key: Key name
+        field: Field name
+        
+    Returns:
+        JSON with key, field and value
+        
+    Raises:
+        HTTPException: If key or field not found, not a hash or error occurs
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    value, error = kv_store.hget(key, field)
+    
+    if error:
+        raise HTTPException(status_code=hash_error_status(error), detail=error)
+    
+    return HashFieldResponse(key=key, field=field, value=value)
+
+
+@app.put("/hash/{key}/{field}", response_model=SetResponse)
+async def set_hash_field(key: str, field: str, request: HashFieldRequest):
+    """
+    Set a field of a hash entry (the entry is created if needed).
+    
+    Args:
+        key: Key name
+        field: Field name
+        request: JSON body with the value
+        
+    Returns:
+        JSON with success status and message
+        
+    Raises:
+        HTTPException: If operation fails
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    success, error = kv_store.hset(key, field, request.value)
+    
+    if not success:
+        status_code = hash_error_status(error)
+        raise HTTPException(status_code=400 if status_code == 500
+                            else status_code, detail=error)
+    
+    return SetResponse(
+        success=True,
+        message=f"Field '{field}' of '{key}' set successfully"
+    )
+
+
+@app.delete("/hash/{key}/{field}", response_model=SetResponse)
+async def delete_hash_field(key: str, field: str):
+    """
+    Delete a field of a hash entry (the last field deletes the key).
+    
+    Args:
+        key: Key name
+        field: Field name
+        
+    Returns:
+        JSON with success status and message
+        
+    Raises:
+        HTTPException: If key or field not found or operation fails
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    success, error = kv_store.hdel(key, field)
+    
+    if not success:
+        raise HTTPException(status_code=hash_error_status(error), detail=error)
+    
+    return SetResponse(
+        success=True,
+        message=f"Field '{field}' of '{key}' deleted"
+    )
+
+
+# Longest blocking pop served over HTTP (each waits in a worker thread)
+MAX_POP_TIMEOUT_MS = 30000
+
+
+def queue_error_status(error: str) -> int:
+    """HTTP status of a failed queue operation."""
+    if "not found" in error.lower():
+        return 404
+    if "too long" in error.lower() or "empty" in error.lower():
+        return 400
+    if "full" in error.lower():
+        return 429  # Too Many Requests: consumers are behind
+    if "too many" in error.lower():
+        return 507  # Insufficient Storage
+    if "EPERM" in error:
+        return 403  # Store created in single-writer mode
+    return 500
+
+
+@app.get("/queues", response_model=QueueListResponse)
+async def list_queues():
+    """
+    List the work queues with their lengths and counters.
+    
+    Returns:
+        JSON with one entry per queue
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    queues = kv_store.queue_list()
+    if queues is None:
+        raise HTTPException(status_code=500, detail="Failed to list queues")
+    
+    return QueueListResponse(queues=queues)
+
+
+@app.put("/queues/{name}", response_model=SetResponse)
+async def create_queue(name: str):
+    """
+    Create a work queue (succeeds if it already exists).
+    
+    Args:
+        name: Queue name
+        
+    Returns:
+        JSON with success status and message
+        
+    Raises:
+        HTTPException: If operation fails
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    success, error = kv_store.queue_create(name)
+    
+    if not success:
+        raise HTTPException(status_code=queue_error_status(error), detail=error)
+    
+    return SetResponse(success=True, message=f"Queue '{name}' created")
+
+
+@app.delete("/queues/{name}", response_model=SetResponse)
+async def delete_queue(name: str):
+    """
+    Delete a work queue with the items it holds.
+    
+    Args:
+        name: Queue name
+        
+    Returns:
+        JSON with success status and message
+        
+    Raises:
+        HTTPException: If queue not found or operation fails
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    success, error = kv_store.queue_delete(name)
+    
+    if not success:
+        raise HTTPException(status_code=queue_error_status(error), detail=error)
+    
+    return SetResponse(success=True, message=f"Queue '{name}' deleted")
+
+
+@app.post("/queues/{name}/push", response_model=SetResponse)
+async def push_queue_item(name: str, request: QueuePushRequest):
+    """
+    Push an item to the tail of a queue.
+    
+    Args:
+        name: Queue name
+        request: JSON body with the item
+        
+    Returns:
+        JSON with success status and message
+        
+    Raises:
+        HTTPException: If queue not found, full or item too long
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    success, error = kv_store.queue_push(name, request.value)
+    
+    if not success:
+        raise HTTPException(status_code=queue_error_status(error), detail=error)
+    
+    return SetResponse(success=True, message=f"Item pushed to '{name}'")
+
+
+@app.post("/queues/{name}/pop", response_model=QueuePopResponse)
+async def pop_queue_item(name: str, timeout_ms: int = 0):
+    """
+    Pop the item at the head of a queue.
+    
+    Args:
+        name: Queue name
+        timeout_ms: Maximum wait for an item (at most MAX_POP_TIMEOUT_MS)
+        
+    Returns:
+        JSON with the item, or value null if the queue stayed empty
+        
+    Raises:
+        HTTPException: If queue not found or error occurs
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    # The C call sleeps on a futex: wait in a worker thread, not the loop
+    timeout_ms = max(0, min(timeout_ms, MAX_POP_TIMEOUT_MS))
+    if timeout_ms > 0:
+        item, error = await asyncio.to_thread(kv_store.queue_pop, name,
+                                              timeout_ms)
+    else:
+        item, error = kv_store.queue_pop(name, 0)
+    
+    if error:
+        raise HTTPException(status_code=queue_error_status(error), detail=error)
+    if item is None:
+        return QueuePopResponse(name=name)
+    
+    try:
+        return QueuePopResponse(name=name, value=item.decode('utf-8'))
+    except UnicodeDecodeError:
+        return QueuePopResponse(name=name, value=base64.b64encode(item).decode(),
+                                type="bytes")
+
+
+def zset_error_status(error: str) -> int:
+    """HTTP status of a failed sorted set operation."""
+    if "not found" in error.lower():
+        return 404
+    if "too long" in error.lower():
+        return 413
+    if "empty" in error.lower() or "must be" in error.lower():
+        return 400
+    if "ENOSPC" in error:
+        return 507  # Insufficient Storage
+    if "EPERM" in error:
+        return 403  # Store created in single-writer mode
+    return 500
+
+
+@app.get("/zsets", response_model=ZsetListResponse)
+async def list_zsets():
+    """
+    List the sorted sets with their sizes and lowest/highest members.
+    
+    Returns:
+        JSON with one entry per sorted set
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    zsets = kv_store.zset_list()
+    if zsets is None:
+        raise HTTPException(status_code=500, detail="Failed to list sorted sets")
+    
+    return ZsetListResponse(zsets=zsets)
+
+
+@app.get("/zsets/{name}", response_model=ZsetRangeResponse)
+async def get_zset_range(name: str, start: int = 0, limit: int = 10,
+                         reverse: bool = False,
+                         min_score: Optional[float] = None,
+                         max_score: Optional[float] = None):
+    """
+    Get members of a sorted set by rank, or by score when a score bound is
+    given.
+    
+    Top-K is reverse=true&limit=K.
+    
+    Args:
+        name: Set name
+        start: First rank (rank queries)
+        limit: Maximum number of members
+        reverse: Count ranks from the highest score (rank queries)
+        min_score: Lowest score (inclusive, default no limit)
+        max_score: Highest score (inclusive, default no limit)
+        
+    Returns:
+        JSON with name and members in rank order (by score: lowest first)
+        
+    Raises:
+        HTTPException: If sorted set not found or error occurs
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    if start < 0 or limit < 0:
+        raise HTTPException(status_code=400, detail="start and limit must be >= 0")
+    
+    if min_score is not None or max_score is not None:
+        members, error = kv_store.zrange_by_score(
+            name,
+            -math.inf if min_score is None else min_score,
+            math.inf if max_score is None else max_score,
+            limit
+        )
+    else:
+        members, error = kv_store.zrange(name, start, limit, reverse)
+    
+    if error:
+        raise HTTPException(status_code=zset_error_status(error), detail=error)
+    
+    return ZsetRangeResponse(name=name, members=members)
+
+
+@app.delete("/zsets/{name}", response_model=SetResponse)
+async def delete_zset(name: str):
+    """
+    Delete a sorted set with all its members.
+    
+    Args:
+        name: Set name
+        
+    Returns:
+        JSON with success status and message
+        
+    Raises:
+        HTTPException: If sorted set not found or operation fails
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    success, error = kv_store.zset_delete(name)
+    
+    if not success:
+        raise HTTPException(status_code=zset_error_status(error), detail=error)
+    
+    return SetResponse(success=True, message=f"Sorted set '{name}' deleted")
+
+
+@app.get("/zsets/{name}/{member}", response_model=ZsetMemberResponse)
+async def get_zset_member(name: str, member: str):
+    """
+    Get the score and ranks of a sorted set member.
+    
+    Args:
+        name: Set name
+        member: Member
+        
+    Returns:
+        JSON with score, rank (lowest first) and reverse_rank (highest first)
+        
+    Raises:
+        HTTPException: If sorted set or member not found
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    result, error = kv_store.zscore(name, member)
+    
+    if error:
+        raise HTTPException(status_code=zset_error_status(error), detail=error)
+    
+    return ZsetMemberResponse(name=name, **result)
+
+
+@app.put("/zsets/{name}/{member}", response_model=SetResponse)
+async def set_zset_member(name: str, member: str, request: ZsetScoreRequest):
+    """
+    Add a member to a sorted set or change its score (the set is created on
+    first add).
+    
+    Args:
+        name: Set name
+        member: Member
+        request: JSON body with the score
+        
+    Returns:
+        JSON with success status and message
+        
+    Raises:
+        HTTPException: If a name is too long or the store is full
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    success, error = kv_store.zadd(name, member, request.score)
+    
+    if not success:
+        raise HTTPException(status_code=zset_error_status(error), detail=error)
+    
+    return SetResponse(success=True,
+                       message=f"'{member}' scored {request.score} in '{name}'")
+
+
+@app.delete("/zsets/{name}/{member}", response_model=SetResponse)
+async def delete_zset_member(name: str, member: str):
+    """
+    Remove a member from a sorted set.
+    
+    Args:
+        name: Set name
+        member: Member
+        
+    Returns:
+        JSON with success status and message
+        
+    Raises:
+        HTTPException: If sorted set or member not found
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    success, error = kv_store.zrem(name, member)
+    
+    if not success:
+        raise HTTPException(status_code=zset_error_status(error), detail=error)
+    
+    return SetResponse(success=True, message=f"'{member}' removed from '{name}'")
+
+
+@app.post("/set", response_model=SetResponse)
+async def set_value(request: SetRequest):
+    """
+    Set key-value pair in the store.
+    
+    Args:
+        request: JSON body with key and value
+        
+    Returns:
+        JSON with success status and message
+        
+    Raises:
+        HTTPException: If operation fails
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    success, error = kv_store.set(request.key, request.value)
+    
+    if not success:
+        status_code = 400
+        if "too long" in error.lower():
+            status_code = 413  # Payload Too Large
+        elif "full" in error.lower() or "ENOSPC" in error:
+            status_code = 507  # Insufficient Storage
+        elif "EPERM" in error:
+            status_code = 403  # Store created in single-writer mode
+        raise HTTPException(status_code=status_code, detail=error)
+    
+    return SetResponse(
+        success=True,
+        message=f"Key '{request.key}' set successfully"
+    )
+
+
+@app.post("/transaction", response_model=SetResponse)
+async def commit_transaction(request: TransactionRequest):
+    """
+    Apply several writes atomically.
+    
+    All writes become visible together (readers never see part of them).
+    If expect is given, the writes are applied only if every listed key
+    still has the expected value at commit time.
+    
+    Args:
+        request: JSON body with writes and optional expectations
+        
+    Returns:
+        JSON with success status and message
+        
+    Raises:
+        HTTPException: 409 on conflict, 413 if a key/value is too long,
+        507 if the store is full, 403 if another process is the single
+        writer
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    writes = [(write.key, write.value) for write in request.writes]
+    success, error = kv_store.transaction(writes, request.expect)
+    
+    if not success:
+        status_code = 400
+        if error.startswith("Conflict"):
+            status_code = 409  # Conflict
+        elif "too long" in error.lower():
+            status_code = 413  # Payload Too Large
+        elif "full" in error.lower() or "ENOSPC" in error:
+            status_code = 507  # Insufficient Storage
+        elif "EPERM" in error:
+            status_code = 403  # Store created in single-writer mode
+        raise HTTPException(status_code=status_code, detail=error)
+    
+    return SetResponse(
+        success=True,
+        message=f"Transaction with {len(writes)} write(s) committed"
+    )
+
+
+@app.get("/status", response_model=StatusResponse)
+async def get_status():
+    """
+    Get store status including version, entry count, and all entries.
+    
+    Returns:
+        JSON with store status and all key-value pairs
+        
+    Raises:
+        HTTPException: If store not initialized or error occurs
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    try:
+        status = kv_store.get_status()
+        
+        if status is None:
+            raise HTTPException(status_code=500, detail="Failed to get status")
+        
+        # Validate and create response model
+        # This may raise ValidationError if data structure is invalid
+        return StatusResponse(**status)
+    except Exception as e:
+        # Re-raise HTTPException as-is (it will include CORS headers via middleware)
+        if isinstance(e, HTTPException):
+            raise
+        # For unexpected errors, wrap in HTTPException
+        raise HTTPException(
+            status_code=500,
+            detail=f"Internal server error: {str(e)}"
+        )
+
+
+# Upper bound for /search limit (results are copied out of shared memory)
+SEARCH_MAX_LIMIT = 100
+
+
+@app.get("/search", response_model=SearchResponse)
+async def search_keys(q: str = "", limit: int = 10, fuzzy: bool = True):
+    """
+    Search keys for typeahead.
+    
+    Prefix matches come first (sorted key index in shared memory), then
+    case-insensitive substring and subsequence matches when fuzzy is true.
+    
+    Args:
+        q: Query string (empty returns the first keys in sorted order)
+        limit: Maximum number of results (1..SEARCH_MAX_LIMIT)
+        fuzzy: Include substring/subsequence matches
+        
+    Returns:
+        JSON with the query and matching entries
+        
+    Raises:
+        HTTPException: If parameters are invalid or store not initialized
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    if limit < 1 or limit > SEARCH_MAX_LIMIT:
+        raise HTTPException(
+            status_code=400,
+            detail=f"limit must be between 1 and {SEARCH_MAX_LIMIT}"
+        )
+    
+    results, error = kv_store.search(q, limit, fuzzy)
+    
+    if error:
+        if "too long" in error.lower():
+            raise HTTPException(status_code=413, detail=error)
+        raise HTTPException(status_code=500, detail=error)
+    
+    return SearchResponse(query=q, results=results)
+
+
+@app.get("/stats/occupancy", response_model=OccupancyResponse)
+async def get_occupancy():
+    """
+    Get hash table occupancy and probe-length statistics.
+    
+    Returns:
+        JSON with load factor, tombstone count, probe-length histogram
+        (probe_histogram[i] = entries found after i + 1 probes, last bucket
+        includes longer probes) and per-region occupancy for a heatmap
+        
+    Raises:
+        HTTPException: If store not initialized or error occurs
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    stats = kv_store.get_occupancy()
+    if stats is None:
+        raise HTTPException(status_code=500, detail="Failed to get occupancy stats")
+    
+    return OccupancyResponse(**stats)
+
+
+@app.get("/stats/memory", response_model=MemoryStatsResponse)
+async def get_memory_stats():
+    """
+    Get arena usage and deduplication statistics.
+    
+    Returns:
+        JSON with arena high-water mark, live/free bytes, blob counts and
+        how many bytes value deduplication and key prefix sharing saved
+        
+    Raises:
+        HTTPException: If store not initialized or error occurs
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    stats = kv_store.get_memory_stats()
+    if stats is None:
+        raise HTTPException(status_code=500, detail="Failed to get memory stats")
+    
+    return MemoryStatsResponse(**stats)
+
+
+@app.get("/processes", response_model=ProcessesResponse)
+async def get_processes():
+    """
+    List the processes attached to the shared memory store.
+    
+    Entries left behind by processes that exited without detaching are
+    reaped first, so every listed process is alive.
+    
+    Returns:
+        JSON with attached processes and the number of entries reaped
+        
+    Raises:
+        HTTPException: If store not initialized or error occurs
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    reaped = kv_store.reap()
+    processes = kv_store.get_processes()
+    if reaped < 0 or processes is None:
+        raise HTTPException(status_code=500, detail="Failed to list processes")
+    
+    return ProcessesResponse(processes=processes, reaped=reaped)
+
+
+@app.get("/replication", response_model=ReplicationResponse)
+async def get_replication():
+    """
+    Get the replication state of the served store.
+    
+    A primary reports its change log position; a replica (KV_STORE_NAME
+    set to the store of a running replicator) also reports its source,
+    how far it has applied the primary's log and its lag.
+    
+    Returns:
+        JSON with role, log positions, lag in changes and milliseconds,
+        and stream counters
+        
+    Raises:
+        HTTPException: If store not initialized or error occurs
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    status = kv_store.replication_status()
+    if status is None:
+        raise HTTPException(status_code=500, detail="Failed to get replication state")
+    
+    return ReplicationResponse(**status)
+
+
+@app.get("/version", response_model=VersionResponse)
+async def get_version():
+    """
+    Get the store version, entry count and generation without any entries.
+    
+    Pollers call this first and only fetch /changes when the version or the
+    generation (changed when the store is recreated) moved.
+    
+    Returns:
+        JSON with version, entry_count and generation
+        
+    Raises:
+        HTTPException: If store not initialized or error occurs
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    version = kv_store.get_version()
+    if version is None:
+        raise HTTPException(status_code=500, detail="Failed to get version")
+    
+    return VersionResponse(**version)
+
+
+@app.get("/changes", response_model=ChangesResponse)
+async def get_changes(since: int = 0, generation: Optional[int] = None):
+    """
+    Get slots changed after the given store version.
+    
+    Lets pollers apply incremental updates instead of re-fetching every
+    entry. Deleted slots are returned with "entry": null. If generation is
+    not the store's (it was recreated), every slot is returned with
+    "full": true.
+    
+    Args:
+        since: Store version the client already has (0 = everything)
+        generation: Store generation that version belongs to
+        
+    Returns:
+        JSON with store version info and the changed slots
+        
+    Raises:
+        HTTPException: If store not initialized or error occurs
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    if since < 0:
+        raise HTTPException(status_code=400, detail="since must be >= 0")
+    
+    changes = kv_store.get_changes(since, generation)
+    if changes is None:
+        raise HTTPException(status_code=500, detail="Failed to get changes")
+    
+    return ChangesResponse(**changes)
+
+
+@app.get("/events")
+async def stream_events(request: Request):
+    """
+    Stream store version changes as server-sent events.
+    
+    Sends the current version first, then one "version" event per batch of
+    changes, pushed by the store's notification descriptor instead of being
+    polled. Idle streams get a comment line every EVENTS_KEEPALIVE_SECONDS.
+    
+    Returns:
+        text/event-stream of {"version", "entry_count"} events
+        
+    Raises:
+        HTTPException: If store not initialized or notifications unavailable
+    """
+    if kv_store is None:
+        raise HTTPException(status_code=503, detail="Store not initialized")
+    
+    if change_fd is None:
+        raise HTTPException(status_code=503, detail="Change notifications unavailable")
+    
+    queue: asyncio.Queue = asyncio.Queue(maxsize=1)
+    event_queues.add(queue)
+    
+    async def stream():
+        try:
+            version = kv_store.get_version()
+            if version is not None:
+                yield f"event: version\ndata: {json.dumps(version)}\n\n"
+            while True:
+                try:
+                    version = await asyncio.wait_for(
+                        queue.get(), EVENTS_KEEPALIVE_SECONDS
+                    )
+                except asyncio.TimeoutError:
+                    if await request.is_disconnected():
+                        break
+                    yield ": keepalive\n\n"
+                    continue
+                yield f"event: version\ndata: {json.dumps(version)}\n\n"
+        finally:
+            event_queues.discard(queue)
+    
+    return StreamingResponse(
+        stream(),
+        media_type="text/event-stream",
+        headers={"Cache-Control": "no-cache"}
+    )
+
+
+if __name__ == "__main__":
+    import uvicorn
+    
+    # Run server
+    uvicorn.run(
+        "api_server:app",
+        host="0.0.0.0",
+        port=8000,
+        reload=False  # Disable reload in production
+    )
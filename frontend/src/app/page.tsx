@@ -5,6 +5,7 @@ import { Database, Cpu, Activity, AlertTriangle, RefreshCw } from "lucide-react"
 import { Card, CardContent } from "@/components/ui/card";
 import { Button } from "@/components/ui/button";
 import { MemoryGrid } from "@/components/MemoryGrid";
+import { OccupancyHeatmap } from "@/components/OccupancyHeatmap";
 import { SetValueDialog } from "@/components/SetValueDialog";
 import { SearchKey } from "@/components/SearchKey";
 import { ThemeToggle } from "@/components/ThemeToggle";
@@ -268,12 +269,22 @@ export default function Dashboard() {
               transition={{ delay: 0.5 }}
             >
               <MemoryGrid
-                entries={status.entries}
+                slots={status.slots}
+                changedSlots={status.changedSlots}
                 maxEntries={status.max_entries}
                 version={status.version}
                 entryCount={status.entry_count}
               />
             </motion.div>
+
+            {/* Hash table occupancy */}
+            <motion.div
+              initial={{ opacity: 0, y: 20 }}
+              animate={{ opacity: 1, y: 0 }}
+              transition={{ delay: 0.6 }}
+            >
+              <OccupancyHeatmap version={status.version} />
+            </motion.div>
           </>
         )}
       </main>
@@ -282,7 +293,7 @@ export default function Dashboard() {
       <footer className="border-t border-border/30 mt-auto">
         <div className="container mx-auto px-4 py-4">
           <p className="text-xs text-muted-foreground text-center font-mono">
-            POSIX Shared Memory KV Store • Polling every 2s
+            POSIX Shared Memory KV Store • Adaptive polling from 2s
           </p>
         </div>
       </footer>
@@ -1,92 +1,85 @@
 "use client";
 
-import { motion, AnimatePresence } from "framer-motion";
+import { memo, useEffect, useRef, useState } from "react";
 import { Database, Clock, Hash } from "lucide-react";
 import { Card, CardContent, CardHeader, CardTitle } from "@/components/ui/card";
 import { KVEntry } from "@/lib/api";
 
 interface MemoryGridProps {
-  entries: KVEntry[];
+  slots: Map<number, KVEntry>;
+  changedSlots: Set<number>;
   maxEntries: number;
   version: number;
   entryCount: number;
 }
 
+// Fixed cell geometry so visible rows can be computed from scroll position
+const CELL_MIN_WIDTH = 180; // px
+const ROW_HEIGHT = 124; // px, cell height + gap
+const GAP = 12; // px
+const VIEWPORT_HEIGHT = 560; // px, max height of the scroll area
+const OVERSCAN_ROWS = 2; // rows rendered above/below the viewport
+
+const formatTimestamp = (timestamp: number) => {
+  if (!timestamp) return "—";
+  return new Date(timestamp * 1000).toLocaleTimeString();
+};
+
 /**
  * Memory cell component representing a single slot in shared memory
+ *
+ * Memoized on the entry object: delta updates replace only the entries of
+ * changed slots, so unchanged cells are not re-rendered on every poll.
  */
-function MemoryCell({ 
-  entry, 
-  index, 
-  isOccupied 
-}: { 
-  entry?: KVEntry; 
-  index: number; 
-  isOccupied: boolean;
+const MemoryCell = memo(function MemoryCell({
+  entry,
+  index,
+  isChanged,
+}: {
+  entry?: KVEntry;
+  index: number;
+  isChanged: boolean;
 }) {
-  const formatTimestamp = (timestamp: number) => {
-    if (!timestamp) return "—";
-    return new Date(timestamp * 1000).toLocaleTimeString();
-  };
+  const isOccupied = !!entry;
+  const digits = Math.max(2, String(index).length);
 
   return (
-    <motion.div
-      layout
-      initial={{ opacity: 0, scale: 0.8 }}
-      animate={{ 
-        opacity: 1, 
-        scale: 1,
-        transition: { 
-          type: "spring",
-          stiffness: 300,
-          damping: 25,
-          delay: index * 0.05 
-        }
-      }}
-      exit={{ opacity: 0, scale: 0.8 }}
+    <div
       className={`
-        relative p-4 rounded-lg border transition-all duration-300
-        ${isOccupied 
-          ? "bg-primary/10 border-primary/50 cyber-glow animate-pulse-glow" 
+        relative p-4 rounded-lg border transition-colors duration-300 h-full
+        ${isOccupied
+          ? "bg-primary/10 border-primary/50 cyber-glow"
           : "bg-muted/30 border-border/50 opacity-50"
         }
+        ${isChanged ? "animate-pulse-glow" : ""}
       `}
     >
       {/* Cell index indicator */}
       <div className="absolute top-1 right-2 text-xs font-mono text-muted-foreground/50">
-        [{index.toString().padStart(2, "0")}]
+        [{index.toString().padStart(digits, "0")}]
       </div>
 
       {isOccupied && entry ? (
-        <AnimatePresence mode="wait">
-          <motion.div
-            key={entry.key}
-            initial={{ opacity: 0, y: 10 }}
-            animate={{ opacity: 1, y: 0 }}
-            exit={{ opacity: 0, y: -10 }}
-            transition={{ duration: 0.2 }}
-            className="space-y-2"
-          >
-            {/* Key */}
-            <div className="flex items-center gap-2">
-              <Hash className="h-3 w-3 text-primary" />
-              <span className="font-mono text-sm text-primary font-semibold truncate">
-                {entry.key}
-              </span>
-            </div>
-            
-            {/* Value */}
-            <div className="font-mono text-xs text-foreground/80 truncate pl-5">
-              {entry.value}
-            </div>
-            
-            {/* Timestamp */}
-            <div className="flex items-center gap-1 text-xs text-muted-foreground pl-5">
-              <Clock className="h-3 w-3" />
-              <span>{formatTimestamp(entry.timestamp)}</span>
-            </div>
-          </motion.div>
-        </AnimatePresence>
+        <div className="space-y-2">
+          {/* Key */}
+          <div className="flex items-center gap-2">
+            <Hash className="h-3 w-3 text-primary" />
+            <span className="font-mono text-sm text-primary font-semibold truncate">
+              {entry.key}
+            </span>
+          </div>
+
+          {/* Value */}
+          <div className="font-mono text-xs text-foreground/80 truncate pl-5">
+            {entry.value}
+          </div>
+
+          {/* Timestamp */}
+          <div className="flex items-center gap-1 text-xs text-muted-foreground pl-5">
+            <Clock className="h-3 w-3" />
+            <span>{formatTimestamp(entry.timestamp)}</span>
+          </div>
+        </div>
       ) : (
         <div className="h-16 flex items-center justify-center">
           <span className="text-xs font-mono text-muted-foreground/30">
@@ -94,29 +87,81 @@ function MemoryCell({
           </span>
         </div>
       )}
-
-      {/* Data flow animation for occupied cells */}
-      {isOccupied && (
-        <div className="absolute inset-0 rounded-lg animate-data-flow opacity-30 pointer-events-none" />
-      )}
-    </motion.div>
+    </div>
   );
-}
+});
 
 /**
  * Live Monitor component showing shared memory state as a grid
+ *
+ * The grid is windowed: only the rows inside the scroll viewport (plus a
+ * small overscan) are mounted, so the cost of a render depends on the
+ * viewport size rather than on the number of slots in the store.
  */
-export function MemoryGrid({ 
-  entries, 
-  maxEntries, 
-  version, 
-  entryCount 
+export function MemoryGrid({
+  slots,
+  changedSlots,
+  maxEntries,
+  version,
+  entryCount
 }: MemoryGridProps) {
-  // Create array of all slots (filled + empty)
-  const slots = Array.from({ length: maxEntries }, (_, index) => {
-    const entry = entries[index];
-    return { entry, index, isOccupied: !!entry };
-  });
+  const scrollRef = useRef<HTMLDivElement>(null);
+  const [scrollTop, setScrollTop] = useState(0);
+  const [width, setWidth] = useState(0);
+
+  // Track container width to derive the column count
+  useEffect(() => {
+    const element = scrollRef.current;
+    if (!element) return;
+
+    const observer = new ResizeObserver(([entry]) => {
+      setWidth(entry.contentRect.width);
+    });
+    observer.observe(element);
+    return () => observer.disconnect();
+  }, []);
+
+  const columns = Math.max(1, Math.floor((width + GAP) / (CELL_MIN_WIDTH + GAP)));
+  const rowCount = Math.ceil(maxEntries / columns);
+  const totalHeight = rowCount * ROW_HEIGHT;
+  const viewportHeight = Math.min(VIEWPORT_HEIGHT, totalHeight);
+
+  const firstRow = Math.max(0, Math.floor(scrollTop / ROW_HEIGHT) - OVERSCAN_ROWS);
+  const lastRow = Math.min(
+    rowCount - 1,
+    Math.ceil((scrollTop + viewportHeight) / ROW_HEIGHT) + OVERSCAN_ROWS
+  );
+
+  const rows: JSX.Element[] = [];
+  for (let row = firstRow; row <= lastRow && width > 0; row++) {
+    const cells: JSX.Element[] = [];
+    for (let column = 0; column < columns; column++) {
+      const index = row * columns + column;
+      if (index >= maxEntries) break;
+      cells.push(
+        <MemoryCell
+          key={index}
+          entry={slots.get(index)}
+          index={index}
+          isChanged={changedSlots.has(index)}
+        />
+      );
+    }
+    rows.push(
+      <div
+        key={row}
+        className="absolute left-0 right-0 grid"
+        style={{
+          top: row * ROW_HEIGHT,
+          height: ROW_HEIGHT - GAP,
+          gap: GAP,
+          gridTemplateColumns: `repeat(${columns}, minmax(0, 1fr))`,
+        }}
+      >
+        {cells}
+      </div>
+    );
+  }
 
   return (
     <Card className="border-border/50 bg-card/50 backdrop-blur">
@@ -126,7 +171,7 @@ export function MemoryGrid({
             <Database className="h-5 w-5 text-primary" />
             <span>Live Memory Monitor</span>
           </CardTitle>
-          
+
           {/* Status indicators */}
           <div className="flex items-center gap-4 text-sm">
             <div className="flex items-center gap-2">
@@ -142,20 +187,20 @@ export function MemoryGrid({
           </div>
         </div>
       </CardHeader>
-      
+
       <CardContent>
-        {/* Memory grid */}
-        <div className="grid grid-cols-2 md:grid-cols-5 gap-3">
-          {slots.map(({ entry, index, isOccupied }) => (
-            <MemoryCell
-              key={index}
-              entry={entry}
-              index={index}
-              isOccupied={isOccupied}
-            />
-          ))}
+        {/* Memory grid (windowed) */}
+        <div
+          ref={scrollRef}
+          onScroll={(e) => setScrollTop(e.currentTarget.scrollTop)}
+          className="relative overflow-y-auto"
+          style={{ height: viewportHeight }}
+        >
+          <div className="relative" style={{ height: totalHeight }}>
+            {rows}
+          </div>
         </div>
-        
+
         {/* Legend */}
         <div className="flex items-center gap-6 mt-4 pt-4 border-t border-border/30 text-xs text-muted-foreground">
           <div className="flex items-center gap-2">
@@ -173,5 +218,3 @@ export function MemoryGrid({
 }
 
 export default MemoryGrid;
-
-
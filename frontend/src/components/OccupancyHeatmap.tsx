@@ -0,0 +1,150 @@
+"use client";
+
+import { Gauge } from "lucide-react";
+import { Card, CardContent, CardHeader, CardTitle } from "@/components/ui/card";
+import { useOccupancyStats } from "@/lib/hooks";
+
+interface OccupancyHeatmapProps {
+  /** Store version; stats are refetched when it changes */
+  version: number;
+}
+
+/**
+ * Region cell of the heatmap
+ *
+ * Opacity follows the occupied fraction of the region; regions holding
+ * tombstones get a destructive-colored border.
+ */
+function RegionCell({
+  index,
+  regionSize,
+  capacity,
+  occupied,
+  tombstones,
+}: {
+  index: number;
+  regionSize: number;
+  capacity: number;
+  occupied: number;
+  tombstones: number;
+}) {
+  const first = index * regionSize;
+  const size = Math.min(regionSize, capacity - first);
+  const fill = size > 0 ? occupied / size : 0;
+
+  return (
+    <div
+      title={`slots ${first}-${first + size - 1}: ${occupied} occupied, ${tombstones} tombstones`}
+      className={`h-6 rounded-sm border ${tombstones > 0 ? "border-destructive/70" : "border-border/30"}`}
+      style={{ backgroundColor: `hsl(var(--primary) / ${0.05 + fill * 0.85})` }}
+    />
+  );
+}
+
+/**
+ * Hash table health panel: load factor, tombstones, probe-length
+ * histogram and a per-region occupancy heatmap
+ */
+export function OccupancyHeatmap({ version }: OccupancyHeatmapProps) {
+  const { stats, error } = useOccupancyStats(version);
+
+  if (error && !stats) {
+    return null;
+  }
+
+  const maxBucket = stats ? Math.max(1, ...stats.probe_histogram) : 1;
+
+  return (
+    <Card className="border-border/50 bg-card/50 backdrop-blur">
+      <CardHeader className="pb-4">
+        <div className="flex items-center justify-between">
+          <CardTitle className="flex items-center gap-2 text-lg">
+            <Gauge className="h-5 w-5 text-primary" />
+            <span>Hash Table Occupancy</span>
+          </CardTitle>
+
+          {stats && (
+            <div className="flex items-center gap-4 text-sm font-mono text-muted-foreground">
+              <span>
+                load <span className="text-primary">{(stats.load_factor * 100).toFixed(1)}%</span>
+              </span>
+              <span>
+                tombstones <span className="text-primary">{stats.tombstone_count}</span>
+              </span>
+              <span>
+                probe avg <span className="text-primary">{stats.avg_probe_length.toFixed(2)}</span>
+                {" / "}max <span className="text-primary">{stats.max_probe_length}</span>
+              </span>
+            </div>
+          )}
+        </div>
+      </CardHeader>
+
+      <CardContent className="space-y-6">
+        {!stats ? (
+          <div className="h-24 bg-muted/30 rounded animate-pulse" />
+        ) : (
+          <>
+            {/* Region heatmap */}
+            <div>
+              <p className="text-xs text-muted-foreground uppercase tracking-wider mb-2">
+                Occupancy by region ({stats.region_size} slot{stats.region_size === 1 ? "" : "s"} each)
+              </p>
+              <div
+                className="grid gap-1"
+                style={{ gridTemplateColumns: `repeat(${Math.min(16, stats.region_occupied.length)}, minmax(0, 1fr))` }}
+              >
+                {stats.region_occupied.map((occupied, index) => (
+                  <RegionCell
+                    key={index}
+                    index={index}
+                    regionSize={stats.region_size}
+                    capacity={stats.capacity}
+                    occupied={occupied}
+                    tombstones={stats.region_tombstones[index]}
+                  />
+                ))}
+              </div>
+            </div>
+
+            {/* Compaction progress */}
+            <p className="text-xs font-mono text-muted-foreground">
+              compaction: pass {stats.compaction.passes}, cursor {stats.compaction.cursor}
+              {" · "}moved {stats.compaction.moved}, purged {stats.compaction.purged}
+            </p>
+
+            {/* Bloom filter effectiveness */}
+            <p className="text-xs font-mono text-muted-foreground">
+              bloom filter: {stats.bloom.rejects} misses skipped the lock
+              {" · "}{stats.bloom.false_positives} false positives
+              {" · "}{(stats.bloom.fill * 100).toFixed(1)}% counters set
+            </p>
+
+            {/* Probe-length histogram */}
+            <div>
+              <p className="text-xs text-muted-foreground uppercase tracking-wider mb-2">
+                Probe length distribution
+              </p>
+              <div className="flex items-end gap-1 h-24">
+                {stats.probe_histogram.map((count, index) => (
+                  <div key={index} className="flex-1 flex flex-col items-center justify-end h-full">
+                    <div
+                      title={`${count} entries`}
+                      className="w-full rounded-t bg-primary/60"
+                      style={{ height: `${(count / maxBucket) * 100}%` }}
+                    />
+                    <span className="text-[10px] font-mono text-muted-foreground mt-1">
+                      {index + 1}{index === stats.probe_histogram.length - 1 ? "+" : ""}
+                    </span>
+                  </div>
+                ))}
+              </div>
+            </div>
+          </>
+        )}
+      </CardContent>
+    </Card>
+  );
+}
+
+export default OccupancyHeatmap;
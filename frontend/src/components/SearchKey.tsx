@@ -6,33 +6,46 @@ import { Search, Loader2, X, Copy, Check, AlertCircle } from "lucide-react";
 import { Card, CardContent, CardHeader, CardTitle } from "@/components/ui/card";
 import { Input } from "@/components/ui/input";
 import { Button } from "@/components/ui/button";
-import { useSearchKey } from "@/lib/hooks";
+import { useSearchKey, useKeySuggestions } from "@/lib/hooks";
 
 /**
  * Search component for looking up values by key
+ *
+ * Typing shows server-side suggestions (prefix first, then fuzzy matches);
+ * picking one or submitting performs the exact lookup.
  */
 export function SearchKey() {
   const [searchInput, setSearchInput] = useState("");
   const [copied, setCopied] = useState(false);
+  const [showSuggestions, setShowSuggestions] = useState(false);
   
   const { search, result, isSearching, error, clear } = useSearchKey();
+  const { suggestions } = useKeySuggestions(showSuggestions ? searchInput : "");
 
   const handleSearch = useCallback(async (e: React.FormEvent) => {
     e.preventDefault();
     if (!searchInput.trim()) return;
+    setShowSuggestions(false);
     await search(searchInput.trim());
   }, [searchInput, search]);
 
+  const handleSelect = useCallback(async (key: string) => {
+    setSearchInput(key);
+    setShowSuggestions(false);
+    await search(key);
+  }, [search]);
+
   const handleClear = useCallback(() => {
     setSearchInput("");
+    setShowSuggestions(false);
     clear();
   }, [clear]);
 
   const handleCopy = useCallback(async () => {
-    if (!result?.value) return;
+    if (result?.value === undefined || result.value === "") return;
     
     try {
-      await navigator.clipboard.writeText(result.value);
+      await navigator.clipboard.writeText(String(result.value));
       setCopied(true);
       setTimeout(() => setCopied(false), 2000);
     } catch (err) {
@@ -56,7 +69,11 @@ export function SearchKey() {
             <Input
               placeholder="Enter key to search..."
               value={searchInput}
-              onChange={(e) => setSearchInput(e.target.value)}
+              onChange={(e) => {
+                setSearchInput(e.target.value);
+                setShowSuggestions(true);
+              }}
+              onBlur={() => setShowSuggestions(false)}
               className="font-mono pr-8 bg-background/50 border-border/50 focus:border-primary/50 focus:ring-primary/20"
               disabled={isSearching}
             />
@@ -69,6 +86,30 @@ export function SearchKey() {
                 <X className="h-4 w-4" />
               </button>
             )}
+
+            {/* Typeahead suggestions */}
+            {showSuggestions && suggestions.length > 0 && (
+              <ul className="absolute z-10 left-0 right-0 mt-1 max-h-64 overflow-y-auto rounded-md border border-border/50 bg-card shadow-lg">
+                {suggestions.map((suggestion) => (
+                  <li key={suggestion.slot}>
+                    <button
+                      type="button"
+                      // Prevent input blur before the click is handled
+                      onMouseDown={(e) => e.preventDefault()}
+                      onClick={() => handleSelect(suggestion.key)}
+                      className="flex w-full items-center justify-between gap-4 px-3 py-2 text-left hover:bg-primary/10"
+                    >
+                      <span className="font-mono text-sm text-primary truncate">
+                        {suggestion.key}
+                      </span>
+                      <span className="font-mono text-xs text-muted-foreground truncate max-w-[40%]">
+                        {suggestion.value}
+                      </span>
+                    </button>
+                  </li>
+                ))}
+              </ul>
+            )}
           </div>
           <Button 
             type="submit" 
@@ -121,15 +121,15 @@ export function SetValueDialog({ onSuccess }: SetValueDialogProps) {
               </Label>
               <Input
                 id="value"
-                placeholder="Enter value (max 255 chars)"
+                placeholder="Enter value (max 4095 chars)"
                 value={value}
                 onChange={(e) => setValue(e.target.value)}
-                maxLength={255}
+                maxLength={4095}
                 disabled={isSubmitting}
                 className="font-mono bg-background/50 border-border/50 focus:border-primary/50 focus:ring-primary/20"
               />
               <p className="text-xs text-muted-foreground text-right">
-                {value.length}/255
+                {value.length}/4095
               </p>
             </div>
             
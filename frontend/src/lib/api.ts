@@ -9,9 +9,15 @@
 const API_BASE_URL = process.env.NEXT_PUBLIC_API_URL || "http://localhost:8000";
 
 // Types matching FastAPI response models
+
+/** Stored value type: numbers arrive as JSON numbers, bytes as base64 */
+export type ValueType = "string" | "int64" | "double" | "bytes";
+
 export interface KVEntry {
+  slot: number;
   key: string;
-  value: string;
+  value: string | number;
+  type?: ValueType;
   timestamp: number;
 }
 
@@ -22,9 +28,75 @@ export interface StoreStatus {
   entries: KVEntry[];
 }
 
+export interface StoreVersion {
+  version: number;
+  entry_count: number;
+  /** Changes when the store is recreated (its version starts over) */
+  generation: number;
+}
+
+export interface SlotChange {
+  slot: number;
+  /** null when the slot was cleared */
+  entry: KVEntry | null;
+}
+
+export interface StoreChanges {
+  version: number;
+  entry_count: number;
+  max_entries: number;
+  generation: number;
+  /** true when the server sent every slot and local state must be reset */
+  full: boolean;
+  changes: SlotChange[];
+}
+
 export interface GetResponse {
+  key: string;
+  value: string | number;
+  type?: ValueType;
+}
+
+export interface OccupancyStats {
+  capacity: number;
+  entry_count: number;
+  tombstone_count: number;
+  load_factor: number;
+  avg_probe_length: number;
+  max_probe_length: number;
+  /** probe_histogram[i] = entries found after i + 1 probes (last bucket includes longer) */
+  probe_histogram: number[];
+  region_size: number;
+  region_occupied: number[];
+  region_tombstones: number[];
+  /** Background tombstone compaction progress */
+  compaction: {
+    cursor: number;
+    passes: number;
+    moved: number;
+    purged: number;
+  };
+  /** Bloom filter in front of lookups */
+  bloom: {
+    /** Gets answered as misses without locking */
+    rejects: number;
+    /** Gets that passed the filter but missed */
+    false_positives: number;
+    /** Fraction of non-zero filter counters */
+    fill: number;
+  };
+}
+
+export interface SearchMatch {
   key: string;
   value: string;
+  slot: number;
+  match: "prefix" | "substring" | "fuzzy";
+}
+
+export interface SearchResponse {
+  query: string;
+  results: SearchMatch[];
 }
 
 export interface SetResponse {
@@ -105,6 +177,39 @@ export const kvStoreApi = {
     return apiFetch<StoreStatus>("/status");
   },
 
+  /**
+   * Get store version only
+   * Cheap check used by polling before fetching changes
+   */
+  async getVersion(): Promise<StoreVersion> {
+    return apiFetch<StoreVersion>("/version");
+  },
+
+  /**
+   * Open the server-sent events stream of store versions
+   * Each "version" event carries a StoreVersion; pushed on every change
+   */
+  openVersionEvents(): EventSource {
+    return new EventSource(`${API_BASE_URL}/events`);
+  },
+
+  /**
+   * Get hash table occupancy and probe-length statistics
+   */
+  async getOccupancy(): Promise<OccupancyStats> {
+    return apiFetch<OccupancyStats>("/stats/occupancy");
+  },
+
+  /**
+   * Get only the slots changed after a store version
+   * Used by Live Monitor polling after the initial status fetch; when
+   * generation is not the store's, every slot comes back with full set
+   */
+  async getChanges(since: number, generation?: number): Promise<StoreChanges> {
+    const query = generation === undefined ? "" : `&generation=${generation}`;
+    return apiFetch<StoreChanges>(`/changes?since=${since}${query}`);
+  },
+
   /**
    * Get value by key
    */
@@ -112,10 +217,19 @@ export const kvStoreApi = {
     return apiFetch<GetResponse>(`/get/${encodeURIComponent(key)}`);
   },
 
+  /**
+   * Search keys by prefix (then substring/fuzzy)
+   * Used for SearchKey typeahead
+   */
+  async searchKeys(query: string, limit = 10, signal?: AbortSignal): Promise<SearchResponse> {
+    const params = new URLSearchParams({ q: query, limit: String(limit) });
+    return apiFetch<SearchResponse>(`/search?${params}`, { signal });
+  },
+
   /**
    * Set key-value pair
    */
-  async setValue(key: string, value: string): Promise<SetResponse> {
+  async setValue(key: string, value: string | number): Promise<SetResponse> {
     return apiFetch<SetResponse>("/set", {
       method: "POST",
       body: JSON.stringify({ key, value }),
@@ -1,105 +1,70 @@
 "use client";
 
-import { useState, useEffect, useCallback, useRef } from "react";
-import { kvStoreApi, StoreStatus, KVStoreApiError } from "./api";
+import { useState, useEffect, useCallback, useSyncExternalStore } from "react";
+import { kvStoreApi, KVStoreApiError, OccupancyStats, SearchMatch } from "./api";
+import { storePoller, StoreSnapshot } from "./storePoller";
+
+export type { StoreSnapshot } from "./storePoller";
 
 interface UseStoreStatusOptions {
-  /** Polling interval in milliseconds (default: 2000) */
+  /** Base polling interval in milliseconds (default: 2000) */
   pollingInterval?: number;
   /** Whether polling is enabled (default: true) */
   enabled?: boolean;
 }
 
 interface UseStoreStatusResult {
-  /** Current store status */
-  status: StoreStatus | null;
+  /** Current store snapshot */
+  status: StoreSnapshot | null;
   /** Loading state (true during initial fetch) */
   isLoading: boolean;
   /** Error object if fetch failed */
   error: KVStoreApiError | null;
   /** Manually trigger a refresh */
   refresh: () => Promise<void>;
-  /** Whether currently fetching (including polling) */
+  /** Whether currently fetching entries */
   isFetching: boolean;
 }
 
 /**
  * Hook for polling KV Store status
  * 
- * Fetches store status at regular intervals for Live Monitor.
- * Automatically handles cleanup on unmount.
+ * All components using this hook share one poller (see storePoller.ts):
+ * it checks /version first, applies /changes deltas only when the version
+ * moved, backs off while the store is idle and pauses in hidden tabs.
+ * Automatically unregisters on unmount.
  */
 export function useStoreStatus(
   options: UseStoreStatusOptions = {}
 ): UseStoreStatusResult {
   const { pollingInterval = 2000, enabled = true } = options;
-  
-  const [status, setStatus] = useState<StoreStatus | null>(null);
-  const [isLoading, setIsLoading] = useState(true);
-  const [isFetching, setIsFetching] = useState(false);
-  const [error, setError] = useState<KVStoreApiError | null>(null);
-  
-  // Track previous version to detect changes
-  const previousVersionRef = useRef<number | null>(null);
 
-  const fetchStatus = useCallback(async () => {
-    setIsFetching(true);
-    
-    try {
-      const newStatus = await kvStoreApi.getStatus();
-      
-      // Track version changes for animations
-      if (previousVersionRef.current !== null && 
-          newStatus.version !== previousVersionRef.current) {
-        // Version changed - new data available
-        console.log(`[KV Store] Version changed: ${previousVersionRef.current} -> ${newStatus.version}`);
-      }
-      
-      previousVersionRef.current = newStatus.version;
-      setStatus(newStatus);
-      setError(null);
-    } catch (err) {
-      setError(err instanceof KVStoreApiError ? err : new KVStoreApiError(
-        "Unknown error",
-        0,
-        String(err)
-      ));
-    } finally {
-      setIsLoading(false);
-      setIsFetching(false);
-    }
-  }, []);
+  const state = useSyncExternalStore(
+    storePoller.subscribe,
+    storePoller.getState,
+    storePoller.getState
+  );
 
-  // Initial fetch and polling setup
+  // Register with the shared poller while enabled
   useEffect(() => {
     if (!enabled) return;
-    
-    // Initial fetch
-    fetchStatus();
-    
-    // Set up polling interval
-    const intervalId = setInterval(fetchStatus, pollingInterval);
-    
-    // Cleanup on unmount or when dependencies change
-    return () => {
-      clearInterval(intervalId);
-    };
-  }, [enabled, pollingInterval, fetchStatus]);
+    return storePoller.register(pollingInterval);
+  }, [enabled, pollingInterval]);
 
   return {
-    status,
-    isLoading,
-    error,
-    refresh: fetchStatus,
-    isFetching,
+    status: state.status,
+    isLoading: state.isLoading,
+    error: state.error,
+    refresh: storePoller.refresh,
+    isFetching: state.isFetching,
   };
 }
 
 interface UseSearchKeyResult {
   /** Search for a key and return its value */
-  search: (key: string) => Promise<string | null>;
+  search: (key: string) => Promise<string | number | null>;
   /** Current search result */
-  result: { key: string; value: string } | null;
+  result: { key: string; value: string | number } | null;
   /** Whether search is in progress */
   isSearching: boolean;
   /** Search error */
@@ -112,11 +77,11 @@ interface UseSearchKeyResult {
  * Hook for searching by key
  */
 export function useSearchKey(): UseSearchKeyResult {
-  const [result, setResult] = useState<{ key: string; value: string } | null>(null);
+  const [result, setResult] = useState<{ key: string; value: string | number } | null>(null);
   const [isSearching, setIsSearching] = useState(false);
   const [error, setError] = useState<KVStoreApiError | null>(null);
 
-  const search = useCallback(async (key: string): Promise<string | null> => {
+  const search = useCallback(async (key: string): Promise<string | number | null> => {
     if (!key.trim()) {
       setResult(null);
       setError(null);
@@ -158,6 +123,98 @@ export function useSearchKey(): UseSearchKeyResult {
   };
 }
 
+/**
+ * Hook for hash table occupancy statistics
+ *
+ * Refetches only when the store version changes (pass the version from
+ * useStoreStatus), so it rides on the shared poller instead of polling.
+ */
+export function useOccupancyStats(version: number | undefined): {
+  stats: OccupancyStats | null;
+  error: KVStoreApiError | null;
+} {
+  const [stats, setStats] = useState<OccupancyStats | null>(null);
+  const [error, setError] = useState<KVStoreApiError | null>(null);
+
+  useEffect(() => {
+    if (version === undefined) return;
+
+    let cancelled = false;
+    kvStoreApi.getOccupancy()
+      .then((response) => {
+        if (cancelled) return;
+        setStats(response);
+        setError(null);
+      })
+      .catch((err) => {
+        if (cancelled) return;
+        setError(err instanceof KVStoreApiError ? err : new KVStoreApiError(
+          "Failed to load occupancy",
+          0,
+          String(err)
+        ));
+      });
+
+    return () => {
+      cancelled = true;
+    };
+  }, [version]);
+
+  return { stats, error };
+}
+
+interface UseKeySuggestionsOptions {
+  /** Maximum number of suggestions (default: 8) */
+  limit?: number;
+  /** Debounce delay in milliseconds (default: 150) */
+  debounceMs?: number;
+}
+
+/**
+ * Hook for key typeahead suggestions
+ *
+ * Debounces the query and calls /search; an in-flight request is aborted
+ * when the query changes, so only the latest results are shown.
+ */
+export function useKeySuggestions(
+  query: string,
+  options: UseKeySuggestionsOptions = {}
+): { suggestions: SearchMatch[]; isLoading: boolean } {
+  const { limit = 8, debounceMs = 150 } = options;
+  const [suggestions, setSuggestions] = useState<SearchMatch[]>([]);
+  const [isLoading, setIsLoading] = useState(false);
+
+  useEffect(() => {
+    const trimmed = query.trim();
+    if (!trimmed) {
+      setSuggestions([]);
+      setIsLoading(false);
+      return;
+    }
+
+    const controller = new AbortController();
+    const timeoutId = setTimeout(async () => {
+      setIsLoading(true);
+      try {
+        const response = await kvStoreApi.searchKeys(trimmed, limit, controller.signal);
+        setSuggestions(response.results);
+      } catch {
+        // Suggestions are best-effort; aborted or failed requests show none
+        if (!controller.signal.aborted) setSuggestions([]);
+      } finally {
+        if (!controller.signal.aborted) setIsLoading(false);
+      }
+    }, debounceMs);
+
+    return () => {
+      clearTimeout(timeoutId);
+      controller.abort();
+    };
+  }, [query, limit, debounceMs]);
+
+  return { suggestions, isLoading };
+}
+
 interface UseSetValueResult {
   /** Set a key-value pair */
   setValue: (key: string, value: string) => Promise<boolean>;
@@ -0,0 +1,278 @@
+/**
+ * Shared, adaptive poller for KV Store status
+ *
+ * One poller instance serves every component that uses useStoreStatus, so a
+ * dashboard with several widgets still issues a single request per tick.
+ *
+ * Each tick first asks /version (three integers). Entries are fetched from
+ * /changes only when the version or the store generation moved; a new
+ * generation (store recreated) makes the server send every slot. While nothing changes, the delay
+ * between ticks grows up to MAX_IDLE_INTERVAL; any change resets it to the
+ * base interval. Polling stops while the tab is hidden and resumes with an
+ * immediate tick when it becomes visible again.
+ *
+ * While the /events stream is connected, the server pushes every version
+ * change and the poller ticks immediately on each; the backoff then only
+ * paces the fallback checks.
+ */
+
+import { kvStoreApi, KVEntry, StoreChanges, StoreVersion, KVStoreApiError } from "./api";
+
+/**
+ * Client-side copy of the store, kept up to date with delta updates
+ */
+export interface StoreSnapshot {
+  version: number;
+  entry_count: number;
+  max_entries: number;
+  /** Occupied slots by slot index (mutated in place, read it on version change) */
+  slots: Map<number, KVEntry>;
+  /** Slot indexes touched by the last update */
+  changedSlots: Set<number>;
+}
+
+export interface PollerState {
+  /** Current store snapshot */
+  status: StoreSnapshot | null;
+  /** Loading state (true until the first fetch completes) */
+  isLoading: boolean;
+  /** Whether entries are currently being fetched */
+  isFetching: boolean;
+  /** Error object if the last poll failed */
+  error: KVStoreApiError | null;
+}
+
+// Idle backoff: delay grows by BACKOFF_FACTOR per unchanged poll
+const BACKOFF_FACTOR = 1.5;
+const MAX_IDLE_INTERVAL = 30000; // ms
+const DEFAULT_INTERVAL = 2000; // ms
+
+/**
+ * Apply a /changes response to the slot map
+ *
+ * Returns the set of slot indexes that were touched.
+ */
+function applyChanges(slots: Map<number, KVEntry>, changes: StoreChanges): Set<number> {
+  if (changes.full) {
+    slots.clear();
+  }
+
+  const changed = new Set<number>();
+  for (const { slot, entry } of changes.changes) {
+    if (entry) {
+      slots.set(slot, entry);
+    } else {
+      slots.delete(slot);
+    }
+    changed.add(slot);
+  }
+  return changed;
+}
+
+function toApiError(err: unknown): KVStoreApiError {
+  return err instanceof KVStoreApiError ? err : new KVStoreApiError(
+    "Unknown error",
+    0,
+    String(err)
+  );
+}
+
+class StorePoller {
+  private state: PollerState = {
+    status: null,
+    isLoading: true,
+    isFetching: false,
+    error: null,
+  };
+
+  private listeners = new Set<() => void>();
+  // Requested polling interval per registered consumer
+  private consumers = new Map<symbol, number>();
+
+  private slots = new Map<number, KVEntry>();
+  private version: number | null = null;
+  private generation: number | undefined = undefined;
+
+  private delay = DEFAULT_INTERVAL;
+  private timer: ReturnType<typeof setTimeout> | null = null;
+  private inFlight: Promise<void> | null = null;
+  private events: EventSource | null = null;
+
+  /** Current state (stable reference between changes) */
+  getState = (): PollerState => this.state;
+
+  /** Subscribe to state changes (useSyncExternalStore contract) */
+  subscribe = (listener: () => void): (() => void) => {
+    this.listeners.add(listener);
+    return () => {
+      this.listeners.delete(listener);
+    };
+  };
+
+  /**
+   * Register a consumer that wants polling at the given interval
+   *
+   * The poller runs at the smallest requested interval while at least one
+   * consumer is registered. Returns the unregister function.
+   */
+  register(interval: number): () => void {
+    const id = Symbol("store-poller-consumer");
+    const wasIdle = this.consumers.size === 0;
+    this.consumers.set(id, interval);
+
+    if (wasIdle && typeof document !== "undefined") {
+      document.addEventListener("visibilitychange", this.handleVisibility);
+      this.openEvents();
+    }
+    this.delay = this.baseInterval();
+    if (wasIdle) {
+      this.schedule(0);
+    }
+
+    return () => {
+      this.consumers.delete(id);
+      if (this.consumers.size === 0) {
+        this.stop();
+        this.closeEvents();
+        if (typeof document !== "undefined") {
+          document.removeEventListener("visibilitychange", this.handleVisibility);
+        }
+      }
+    };
+  }
+
+  /** Poll immediately and reset the idle backoff */
+  refresh = async (): Promise<void> => {
+    this.delay = this.baseInterval();
+    await this.poll(true);
+  };
+
+  private baseInterval(): number {
+    if (this.consumers.size === 0) return DEFAULT_INTERVAL;
+    return Math.min(...Array.from(this.consumers.values()));
+  }
+
+  private setState(patch: Partial<PollerState>) {
+    this.state = { ...this.state, ...patch };
+    this.listeners.forEach((listener) => listener());
+  }
+
+  private isHidden(): boolean {
+    return typeof document !== "undefined" && document.hidden;
+  }
+
+  private openEvents() {
+    if (typeof EventSource === "undefined" || this.events) return;
+    this.events = kvStoreApi.openVersionEvents();
+    this.events.addEventListener("version", this.handleVersionEvent);
+  }
+
+  private closeEvents() {
+    this.events?.close();
+    this.events = null;
+  }
+
+  /** Pushed version: tick now if it is not the one already shown */
+  private handleVersionEvent = (event: MessageEvent) => {
+    const { version, generation } = JSON.parse(event.data) as StoreVersion;
+    const moved = version !== this.version || generation !== this.generation;
+    if (moved && !this.isHidden()) {
+      this.delay = this.baseInterval();
+      this.schedule(0);
+    }
+  };
+
+  private handleVisibility = () => {
+    if (this.isHidden()) {
+      this.stop();
+    } else {
+      this.delay = this.baseInterval();
+      this.schedule(0);
+    }
+  };
+
+  private stop() {
+    if (this.timer !== null) {
+      clearTimeout(this.timer);
+      this.timer = null;
+    }
+  }
+
+  private schedule(delay: number) {
+    this.stop();
+    if (this.consumers.size === 0 || this.isHidden()) return;
+    this.timer = setTimeout(this.tick, delay);
+  }
+
+  private tick = async () => {
+    this.timer = null;
+    await this.poll(false);
+    this.schedule(this.delay);
+  };
+
+  private poll(force: boolean): Promise<void> {
+    // Concurrent callers (manual refresh during a tick) share one request
+    if (!this.inFlight) {
+      this.inFlight = this.fetchOnce(force).finally(() => {
+        this.inFlight = null;
+      });
+    }
+    return this.inFlight;
+  }
+
+  private async fetchOnce(force: boolean): Promise<void> {
+    try {
+      // Cheap version check first; skip entries when nothing moved
+      if (this.version !== null && !force) {
+        const { version, generation } = await kvStoreApi.getVersion();
+        if (version === this.version && generation === this.generation) {
+          this.delay = Math.min(this.delay * BACKOFF_FACTOR, MAX_IDLE_INTERVAL);
+          if (this.state.error) this.setState({ error: null });
+          return;
+        }
+      }
+
+      this.setState({ isFetching: true });
+
+      // Version 0 means "everything" on the first poll
+      const since = this.version ?? 0;
+      const changes = await kvStoreApi.getChanges(since, this.generation);
+
+      if (this.version !== null && changes.version !== this.version) {
+        console.log(`[KV Store] Version changed: ${this.version} -> ${changes.version}`);
+      }
+
+      const isFirstFetch = this.version === null;
+      const changedSlots = applyChanges(this.slots, changes);
+      this.version = changes.version;
+      this.generation = changes.generation;
+
+      if (isFirstFetch || changes.full || changedSlots.size > 0) {
+        this.delay = this.baseInterval();
+        this.setState({
+          status: {
+            version: changes.version,
+            entry_count: changes.entry_count,
+            max_entries: changes.max_entries,
+            slots: this.slots,
+            changedSlots,
+          },
+          isLoading: false,
+          isFetching: false,
+          error: null,
+        });
+      } else {
+        this.setState({ isLoading: false, isFetching: false, error: null });
+      }
+    } catch (err) {
+      // Back off on errors too, so a down server isn't hammered
+      this.delay = Math.min(this.delay * BACKOFF_FACTOR, MAX_IDLE_INTERVAL);
+      this.setState({ isLoading: false, isFetching: false, error: toApiError(err) });
+    }
+  }
+}
+
+/** Process-wide poller shared by all useStoreStatus consumers */
+export const storePoller = new StorePoller();
+
+export default storePoller;
@@ -6,26 +6,346 @@ functions, allowing Python code to interact with the shared memory store.
 """
 
 import ctypes
+import errno
+import math
 import os
 import sys
 from ctypes import Structure, c_char, c_int, c_uint, c_long, POINTER
-from typing import Optional, Tuple
+from typing import Dict, List, Optional, Tuple, Union
 
 
 # Constants from shared_memory_kv.h
 MAX_ENTRIES = 10
 KEY_SIZE = 64
-VALUE_SIZE = 256
+VALUE_SIZE = 4096
 SHM_NAME = "/gitflow_kv_store"
 
+# Key search flags and match kinds
+KV_SEARCH_PREFIX = 0x1
+KV_SEARCH_FUZZY = 0x2
+MATCH_KINDS = {1: "prefix", 2: "substring", 3: "fuzzy"}
+
+# Storage flags (shared_memory_kv_create_ex)
+KV_FLAG_DEDUP_VALUES = 0x1
+KV_FLAG_PREFIX_KEYS = 0x2
+KV_FLAG_COMPRESS_VALUES = 0x4
+KV_FLAG_SINGLE_WRITER = 0x8
+
+# Value compression
+KV_COMPRESS_DICT_SIZE = 1024
+
+# Occupancy statistics layout
+KV_PROBE_HISTOGRAM_BUCKETS = 16
+KV_OCCUPANCY_REGIONS = 64
+KV_BLOOM_COUNTERS = 1024
+
+# Transactions
+KV_TXN_MAX_OPS = 16
+
+# Versions kept per entry (shared_memory_kv_history)
+KV_MVCC_VERSIONS = 4
+
+# Registry entries (attached threads) per store
+KV_REGISTRY_SIZE = 128
+
+# Key subscriptions
+KV_SUBSCRIPTIONS = 64
+KV_SUBSCRIPTION_KEYS = 8
+KV_SUBSCRIBE_PREFIX = 0x1
+
+# Time series
+KV_SERIES_MAX = 16
+KV_SERIES_SAMPLES = 256
+
+# Rollups (window i is selected by flag 1 << i)
+KV_ROLLUP_MAX = 16
+KV_ROLLUP_WINDOWS = 3
+KV_ROLLUP_1S = 0x1
+KV_ROLLUP_10S = 0x2
+KV_ROLLUP_1M = 0x4
+KV_ROLLUP_ALL = KV_ROLLUP_1S | KV_ROLLUP_10S | KV_ROLLUP_1M
+ROLLUP_WINDOW_NAMES = ("1s", "10s", "1m")  # By window index
+
+# Queues (bounded MPMC rings in the segment)
+KV_QUEUE_MAX = 8
+KV_QUEUE_CAPACITY = 256
+KV_QUEUE_ITEM_SIZE = 256
+
+# Sorted sets (skiplists in the segment)
+KV_ZSET_MAX = 8
+KV_ZSET_CAPACITY = 256
+KV_ZSET_MEMBER_SIZE = 64
+
+# Replication (change log tailed by build/replicator)
+KV_ROLE_PRIMARY = 0
+KV_ROLE_REPLICA = 1
+ROLE_NAMES = ("primary", "replica")  # By role code
+KV_REPLICATION_SOURCE_SIZE = 108
+
+# Value types (numbers are stored natively, not as text)
+KV_TYPE_STRING = 0
+KV_TYPE_INT64 = 1
+KV_TYPE_DOUBLE = 2
+KV_TYPE_BYTES = 3
+KV_TYPE_HASH = 4
+VALUE_TYPE_NAMES = ("string", "int64", "double", "bytes", "hash")  # By code
+KV_HASH_FIELD_SIZE = 64  # Max field name length + 1
+INT64_MIN = -(1 << 63)
+INT64_MAX = (1 << 63) - 1
+
+# Python value of a typed entry: str, int (int64), float (double), bytes or
+# dict (hash fields, as returned by get)
+Value = Union[str, int, float, bytes, Dict[str, str]]
+
 
 # C structure definitions using ctypes
 class KVPair(Structure):
     """C structure: kv_pair_t"""
+    _fields_ = [
+        # Offsets of key/value blobs in the store arena
+        ("key_prefix_ref", c_uint),
+        ("key_suffix_ref", c_uint),
+        ("value_ref", c_uint),
+        ("timestamp", c_long),  # time_t is typically long
+        ("slot_version", c_uint),
+        ("hash", c_uint),
+        ("state", c_uint),
+        ("head", c_uint),  # Newest version record
+        ("seq", c_uint),  # Slot sequence counter
+    ]
+
+
+class KVSearchResult(Structure):
+    """C structure: kv_search_result_t"""
     _fields_ = [
         ("key", c_char * KEY_SIZE),
         ("value", c_char * VALUE_SIZE),
-        ("timestamp", c_long),  # time_t is typically long
+        ("slot", c_uint),
+        ("match", c_int),
+    ]
+
+
+class KVOccupancyStats(Structure):
+    """C structure: kv_occupancy_stats_t"""
+    _fields_ = [
+        ("capacity", c_uint),
+        ("entry_count", c_uint),
+        ("tombstone_count", c_uint),
+        ("load_factor", ctypes.c_double),
+        ("avg_probe_length", ctypes.c_double),
+        ("max_probe_length", c_uint),
+        ("probe_histogram", c_uint * KV_PROBE_HISTOGRAM_BUCKETS),
+        ("region_count", c_uint),
+        ("region_size", c_uint),
+        ("region_occupied", c_uint * KV_OCCUPANCY_REGIONS),
+        ("region_tombstones", c_uint * KV_OCCUPANCY_REGIONS),
+        ("compact_cursor", c_uint),
+        ("compact_passes", c_uint),
+        ("compact_moved", ctypes.c_ulonglong),
+        ("compact_purged", ctypes.c_ulonglong),
+        ("bloom_rejects", ctypes.c_ulonglong),
+        ("bloom_false_positives", ctypes.c_ulonglong),
+        ("bloom_counters_set", c_uint),
+    ]
+
+
+class KVMemoryStats(Structure):
+    """C structure: kv_memory_stats_t"""
+    _fields_ = [
+        ("flags", c_uint),
+        ("arena_size", c_uint),
+        ("arena_top", c_uint),
+        ("allocated_bytes", c_uint),
+        ("free_bytes", c_uint),
+        ("blob_count", c_uint),
+        ("shared_blob_count", c_uint),
+        ("dedup_hits", ctypes.c_ulonglong),
+        ("bytes_saved", ctypes.c_ulonglong),
+        ("compress_dict_length", c_uint),
+        ("compressed_values", c_uint),
+        ("compressed_bytes", ctypes.c_ulonglong),
+        ("uncompressed_bytes", ctypes.c_ulonglong),
+        ("epoch", ctypes.c_ulonglong),
+        ("registry_entries", c_uint),
+        ("attached_processes", c_uint),
+        ("active_readers", c_uint),
+        ("reaped_entries", ctypes.c_ulonglong),
+        ("version_records", c_uint),
+        ("retired_pending", c_uint),
+        ("reclaimed", ctypes.c_ulonglong),
+        ("retire_overflows", ctypes.c_ulonglong),
+        ("writer_pid", c_int),
+        ("combined_writes", ctypes.c_ulonglong),
+        ("combine_batches", ctypes.c_ulonglong),
+        ("subscriptions", c_uint),
+        ("notifications", ctypes.c_ulonglong),
+    ]
+
+
+class KVEntry(Structure):
+    """C structure: kv_entry_t"""
+    _fields_ = [
+        ("key", c_char * KEY_SIZE),
+        ("value", c_char * VALUE_SIZE),
+        ("slot", c_uint),
+        ("slot_version", c_uint),
+        ("timestamp", c_long),
+        ("type", c_uint),
+        ("int64", ctypes.c_longlong),
+        ("number", ctypes.c_double),
+    ]
+
+
+class KVValue(Structure):
+    """C structure: kv_value_t"""
+    _fields_ = [
+        ("type", c_uint),
+        ("length", c_uint),
+        ("int64", ctypes.c_longlong),
+        ("number", ctypes.c_double),
+        ("data", c_char * VALUE_SIZE),
+    ]
+
+
+class KVVersionInfo(Structure):
+    """C structure: kv_version_info_t"""
+    _fields_ = [
+        ("value", c_char * VALUE_SIZE),
+        ("version", c_uint),
+        ("timestamp", c_long),
+    ]
+
+
+class KVProcessInfo(Structure):
+    """C structure: kv_process_info_t"""
+    _fields_ = [
+        ("pid", c_int),
+        ("start_time", ctypes.c_ulonglong),
+        ("heartbeat", c_long),
+        ("epoch", ctypes.c_ulonglong),
+        ("threads", c_uint),
+        ("alive", c_int),
+    ]
+
+
+class KVSample(Structure):
+    """C structure: kv_sample_t"""
+    _fields_ = [
+        ("timestamp", ctypes.c_longlong),  # Milliseconds since the epoch
+        ("value", ctypes.c_double),
+    ]
+
+
+class KVSeriesInfo(Structure):
+    """C structure: kv_series_info_t"""
+    _fields_ = [
+        ("key", c_char * KEY_SIZE),
+        ("count", c_uint),
+        ("appended", ctypes.c_ulonglong),
+        ("first", KVSample),
+        ("last", KVSample),
+    ]
+
+
+class KVRollupBucket(Structure):
+    """C structure: kv_rollup_bucket_t"""
+    _fields_ = [
+        ("start", ctypes.c_longlong),  # Milliseconds since the epoch
+        ("count", c_uint),
+        ("min", ctypes.c_double),
+        ("max", ctypes.c_double),
+        ("sum", ctypes.c_double),
+        ("last", ctypes.c_double),
+    ]
+
+
+class KVRollupInfo(Structure):
+    """C structure: kv_rollup_info_t"""
+    _fields_ = [
+        ("key", c_char * KEY_SIZE),
+        ("windows", c_uint),
+        ("current", KVRollupBucket * KV_ROLLUP_WINDOWS),
+        ("previous", KVRollupBucket * KV_ROLLUP_WINDOWS),
+    ]
+
+
+class KVQueueInfo(Structure):
+    """C structure: kv_queue_info_t"""
+    _fields_ = [
+        ("name", c_char * KEY_SIZE),
+        ("length", c_uint),
+        ("waiters", c_uint),
+        ("pushed", ctypes.c_ulonglong),
+        ("popped", ctypes.c_ulonglong),
+        ("rejected", ctypes.c_ulonglong),
+    ]
+
+
+class KVZsetItem(Structure):
+    """C structure: kv_zset_item_t"""
+    _fields_ = [
+        ("member", c_char * KV_ZSET_MEMBER_SIZE),
+        ("score", ctypes.c_double),
+    ]
+
+
+class KVZsetInfo(Structure):
+    """C structure: kv_zset_info_t"""
+    _fields_ = [
+        ("name", c_char * KEY_SIZE),
+        ("count", c_uint),
+        ("min", KVZsetItem),
+        ("max", KVZsetItem),
+    ]
+
+
+class KVReplicationStatus(Structure):
+    """C structure: kv_replication_status_t"""
+    _fields_ = [
+        ("role", c_uint),
+        ("connected", c_int),
+        ("pid", c_int),
+        ("source", c_char * KV_REPLICATION_SOURCE_SIZE),
+        ("applied_position", ctypes.c_ulonglong),
+        ("primary_position", ctypes.c_ulonglong),
+        ("lag_ms", ctypes.c_longlong),
+        ("last_contact", ctypes.c_longlong),
+        ("applied_changes", ctypes.c_ulonglong),
+        ("full_syncs", ctypes.c_ulonglong),
+        ("bytes_received", ctypes.c_ulonglong),
+    ]
+
+
+class KVTxnRead(Structure):
+    """C structure: kv_txn_read_t"""
+    _fields_ = [
+        ("key", c_char * KEY_SIZE),
+        ("found", c_int),
+        ("slot", c_uint),
+        ("slot_version", c_uint),
+    ]
+
+
+class KVTxnWrite(Structure):
+    """C structure: kv_txn_write_t"""
+    _fields_ = [
+        ("key", c_char * KEY_SIZE),
+        ("value", c_char * VALUE_SIZE),
+        ("is_delete", c_int),
+        ("type", c_uint),
+        ("length", c_uint),
+    ]
+
+
+class KVTxn(Structure):
+    """C structure: shared_memory_kv_txn_t"""
+    _fields_ = [
+        ("store", ctypes.c_void_p),
+        ("active", c_int),
+        ("read_count", c_uint),
+        ("write_count", c_uint),
+        ("reads", KVTxnRead * KV_TXN_MAX_OPS),
+        ("writes", KVTxnWrite * KV_TXN_MAX_OPS),
     ]
 
 
@@ -40,6 +360,7 @@ class SharedMemoryKVStore(Structure):
         ("sem", ctypes.c_byte * 32),  # Size for sem_t (platform-dependent)
         ("version", c_uint),
         ("entry_count", c_uint),
+        ("generation", ctypes.c_ulonglong),
     ]
 
 
@@ -51,23 +372,27 @@ class KVStoreWrapper:
     interface to C functions.
     """
     
-    def __init__(self, lib_path: str):
+    def __init__(self, lib_path: str, name: str = SHM_NAME):
         """
         Initialize wrapper and load C library.
         
         Args:
             lib_path: Path to libshared_memory_kv.so
+            name: Shared memory object of the store ("/name"), e.g. a
+                replica kept by build/replicator
         """
         if not os.path.exists(lib_path):
             raise FileNotFoundError(f"Library not found: {lib_path}")
         
         # Load shared library
-        self.lib = ctypes.CDLL(lib_path)
+        # use_errno: C functions report failures through errno
+        self.lib = ctypes.CDLL(lib_path, use_errno=True)
         
         # Define function signatures
         self._setup_functions()
         
         # Store state
+        self.name = name
         self.store_ptr = None
         self.fd = ctypes.c_int(-1)
         
@@ -95,10 +420,33 @@ class KVStoreWrapper:
         self.lib.shared_memory_kv_create.argtypes = [POINTER(c_int)]
         self.lib.shared_memory_kv_create.restype = POINTER(SharedMemoryKVStore)
         
+        # shared_memory_kv_create_ex
+        self.lib.shared_memory_kv_create_ex.argtypes = [POINTER(c_int), c_uint]
+        self.lib.shared_memory_kv_create_ex.restype = POINTER(SharedMemoryKVStore)
+        
         # shared_memory_kv_open
         self.lib.shared_memory_kv_open.argtypes = [POINTER(c_int)]
         self.lib.shared_memory_kv_open.restype = POINTER(SharedMemoryKVStore)
         
+        # shared_memory_kv_create_named
+        self.lib.shared_memory_kv_create_named.argtypes = [
+            ctypes.c_char_p,
+            POINTER(c_int),
+            c_uint
+        ]
+        self.lib.shared_memory_kv_create_named.restype = POINTER(SharedMemoryKVStore)
+        
+        # shared_memory_kv_open_named
+        self.lib.shared_memory_kv_open_named.argtypes = [
+            ctypes.c_char_p,
+            POINTER(c_int)
+        ]
+        self.lib.shared_memory_kv_open_named.restype = POINTER(SharedMemoryKVStore)
+        
+        # shared_memory_kv_unlink_named
+        self.lib.shared_memory_kv_unlink_named.argtypes = [ctypes.c_char_p]
+        self.lib.shared_memory_kv_unlink_named.restype = c_int
+        
         # shared_memory_kv_destroy
         self.lib.shared_memory_kv_destroy.argtypes = [c_int, POINTER(SharedMemoryKVStore)]
         self.lib.shared_memory_kv_destroy.restype = None
@@ -107,6 +455,10 @@ class KVStoreWrapper:
         self.lib.shared_memory_kv_unlink.argtypes = []
         self.lib.shared_memory_kv_unlink.restype = c_int
         
+        # shared_memory_kv_unlink_safe
+        self.lib.shared_memory_kv_unlink_safe.argtypes = [POINTER(SharedMemoryKVStore)]
+        self.lib.shared_memory_kv_unlink_safe.restype = c_int
+        
         # shared_memory_kv_set
         self.lib.shared_memory_kv_set.argtypes = [
             POINTER(SharedMemoryKVStore),
@@ -123,171 +475,2086 @@ class KVStoreWrapper:
         ]
         self.lib.shared_memory_kv_get.restype = c_int
         
+        # shared_memory_kv_set_int64
+        self.lib.shared_memory_kv_set_int64.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            ctypes.c_longlong
+        ]
+        self.lib.shared_memory_kv_set_int64.restype = c_int
+        
+        # shared_memory_kv_set_double
+        self.lib.shared_memory_kv_set_double.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            ctypes.c_double
+        ]
+        self.lib.shared_memory_kv_set_double.restype = c_int
+        
+        # shared_memory_kv_set_bytes
+        self.lib.shared_memory_kv_set_bytes.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            ctypes.c_char_p,
+            ctypes.c_size_t
+        ]
+        self.lib.shared_memory_kv_set_bytes.restype = c_int
+        
+        # shared_memory_kv_get_value
+        self.lib.shared_memory_kv_get_value.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            POINTER(KVValue)
+        ]
+        self.lib.shared_memory_kv_get_value.restype = c_int
+        
+        # shared_memory_kv_hset
+        self.lib.shared_memory_kv_hset.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            ctypes.c_char_p,
+            ctypes.c_char_p
+        ]
+        self.lib.shared_memory_kv_hset.restype = c_int
+        
+        # shared_memory_kv_hget
+        self.lib.shared_memory_kv_hget.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            ctypes.c_char_p,
+            ctypes.c_char_p
+        ]
+        self.lib.shared_memory_kv_hget.restype = c_int
+        
+        # shared_memory_kv_hdel
+        self.lib.shared_memory_kv_hdel.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            ctypes.c_char_p
+        ]
+        self.lib.shared_memory_kv_hdel.restype = c_int
+        
+        # shared_memory_kv_hgetall
+        self.lib.shared_memory_kv_hgetall.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            POINTER(KVValue)
+        ]
+        self.lib.shared_memory_kv_hgetall.restype = c_int
+        
         # shared_memory_kv_delete
         self.lib.shared_memory_kv_delete.argtypes = [
             POINTER(SharedMemoryKVStore),
             ctypes.c_char_p
         ]
         self.lib.shared_memory_kv_delete.restype = c_int
-    
-    def create(self) -> bool:
-        """
-        Create new shared memory store.
         
-        Returns:
-            True on success, False on error
-        """
-        fd_ptr = ctypes.pointer(self.fd)
-        self.store_ptr = self.lib.shared_memory_kv_create(fd_ptr)
+        # shared_memory_kv_search
+        self.lib.shared_memory_kv_search.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            c_int,
+            POINTER(KVSearchResult),
+            ctypes.c_size_t
+        ]
+        self.lib.shared_memory_kv_search.restype = c_int
         
-        # Check for NULL pointer
-        if not self._check_store():
-            return False
+        # shared_memory_kv_occupancy_stats
+        self.lib.shared_memory_kv_occupancy_stats.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            POINTER(KVOccupancyStats)
+        ]
+        self.lib.shared_memory_kv_occupancy_stats.restype = c_int
         
-        return True
-    
-    def open(self) -> bool:
-        """
-        Open existing shared memory store.
+        # shared_memory_kv_compact_step
+        self.lib.shared_memory_kv_compact_step.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            c_uint
+        ]
+        self.lib.shared_memory_kv_compact_step.restype = c_int
         
-        Returns:
-            True on success, False on error
-        """
-        fd_ptr = ctypes.pointer(self.fd)
-        self.store_ptr = self.lib.shared_memory_kv_open(fd_ptr)
+        # shared_memory_kv_read_slot
+        self.lib.shared_memory_kv_read_slot.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            c_uint,
+            ctypes.c_char_p,
+            ctypes.c_char_p,
+            POINTER(c_long)
+        ]
+        self.lib.shared_memory_kv_read_slot.restype = c_int
         
-        # Check for NULL pointer
-        if not self._check_store():
-            return False
+        # shared_memory_kv_set_dictionary
+        self.lib.shared_memory_kv_set_dictionary.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            ctypes.c_size_t
+        ]
+        self.lib.shared_memory_kv_set_dictionary.restype = c_int
         
-        return True
-    
-    def set(self, key: str, value: str) -> Tuple[bool, Optional[str]]:
-        """
-        Set key-value pair in store.
+        # shared_memory_kv_snapshot_table
+        self.lib.shared_memory_kv_snapshot_table.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            POINTER(KVEntry),
+            POINTER(c_uint)
+        ]
+        self.lib.shared_memory_kv_snapshot_table.restype = c_int
         
-        Args:
-            key: Key string
-            value: Value string
-            
-        Returns:
-            Tuple of (success: bool, error_message: Optional[str])
-        """
-        if not self._check_store():
-            return False, "Store not initialized"
+        # shared_memory_kv_txn_begin
+        self.lib.shared_memory_kv_txn_begin.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            POINTER(KVTxn)
+        ]
+        self.lib.shared_memory_kv_txn_begin.restype = c_int
         
-        # Convert strings to bytes
-        key_bytes = key.encode('utf-8')
-        value_bytes = value.encode('utf-8')
+        # shared_memory_kv_txn_get
+        self.lib.shared_memory_kv_txn_get.argtypes = [
+            POINTER(KVTxn),
+            ctypes.c_char_p,
+            ctypes.c_char_p
+        ]
+        self.lib.shared_memory_kv_txn_get.restype = c_int
         
-        # Check lengths
-        if len(key_bytes) >= KEY_SIZE:
-            return False, f"Key too long (max {KEY_SIZE-1} bytes)"
-        if len(value_bytes) >= VALUE_SIZE:
-            return False, f"Value too long (max {VALUE_SIZE-1} bytes)"
+        # shared_memory_kv_txn_set
+        self.lib.shared_memory_kv_txn_set.argtypes = [
+            POINTER(KVTxn),
+            ctypes.c_char_p,
+            ctypes.c_char_p
+        ]
+        self.lib.shared_memory_kv_txn_set.restype = c_int
         
-        result = self.lib.shared_memory_kv_set(
-            self.store_ptr,
-            key_bytes,
-            value_bytes
-        )
+        # shared_memory_kv_txn_delete
+        self.lib.shared_memory_kv_txn_delete.argtypes = [
+            POINTER(KVTxn),
+            ctypes.c_char_p
+        ]
+        self.lib.shared_memory_kv_txn_delete.restype = c_int
         
-        if result == -1:
-            # Get errno from C library
-            errno_val = ctypes.get_errno()
-            return False, f"Error setting key: errno={errno_val}"
+        # shared_memory_kv_txn_commit
+        self.lib.shared_memory_kv_txn_commit.argtypes = [POINTER(KVTxn)]
+        self.lib.shared_memory_kv_txn_commit.restype = c_int
         
-        return True, None
-    
-    def get(self, key: str) -> Tuple[Optional[str], Optional[str]]:
-        """
-        Get value by key from store.
+        # shared_memory_kv_txn_abort
+        self.lib.shared_memory_kv_txn_abort.argtypes = [POINTER(KVTxn)]
+        self.lib.shared_memory_kv_txn_abort.restype = None
         
-        Args:
-            key: Key string
-            
-        Returns:
-            Tuple of (value: Optional[str], error_message: Optional[str])
-        """
-        if not self._check_store():
-            return None, "Store not initialized"
+        # shared_memory_kv_memory_stats
+        self.lib.shared_memory_kv_memory_stats.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            POINTER(KVMemoryStats)
+        ]
+        self.lib.shared_memory_kv_memory_stats.restype = c_int
         
-        key_bytes = key.encode('utf-8')
+        # shared_memory_kv_history
+        self.lib.shared_memory_kv_history.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            POINTER(KVVersionInfo),
+            ctypes.c_size_t
+        ]
+        self.lib.shared_memory_kv_history.restype = c_int
         
-        if len(key_bytes) >= KEY_SIZE:
-            return None, f"Key too long (max {KEY_SIZE-1} bytes)"
+        # shared_memory_kv_heartbeat
+        self.lib.shared_memory_kv_heartbeat.argtypes = [POINTER(SharedMemoryKVStore)]
+        self.lib.shared_memory_kv_heartbeat.restype = c_int
         
-        # Allocate buffer for value
-        value_buffer = ctypes.create_string_buffer(VALUE_SIZE)
+        # shared_memory_kv_reap
+        self.lib.shared_memory_kv_reap.argtypes = [POINTER(SharedMemoryKVStore)]
+        self.lib.shared_memory_kv_reap.restype = c_int
         
-        result = self.lib.shared_memory_kv_get(
-            self.store_ptr,
-            key_bytes,
-            value_buffer
-        )
+        # shared_memory_kv_processes
+        self.lib.shared_memory_kv_processes.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            POINTER(KVProcessInfo),
+            ctypes.c_size_t
+        ]
+        self.lib.shared_memory_kv_processes.restype = c_int
         
-        if result == -1:
-            errno_val = ctypes.get_errno()
-            if errno_val == 2:  # ENOENT - key not found
-                return None, "Key not found"
-            return None, f"Error getting key: errno={errno_val}"
+        # shared_memory_kv_subscribe
+        self.lib.shared_memory_kv_subscribe.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            POINTER(ctypes.c_char_p),
+            ctypes.c_size_t,
+            c_uint
+        ]
+        self.lib.shared_memory_kv_subscribe.restype = c_int
         
-        # Convert bytes to string
-        value_str = value_buffer.value.decode('utf-8')
-        return value_str, None
-    
-    def get_status(self) -> Optional[dict]:
-        """
-        Get store status (version, entry_count, all entries).
+        # shared_memory_kv_wait
+        self.lib.shared_memory_kv_wait.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            c_int,
+            POINTER(c_uint),
+            c_int
+        ]
+        self.lib.shared_memory_kv_wait.restype = c_int
+        
+        # shared_memory_kv_unsubscribe
+        self.lib.shared_memory_kv_unsubscribe.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            c_int
+        ]
+        self.lib.shared_memory_kv_unsubscribe.restype = c_int
+        
+        # shared_memory_kv_notify_fd
+        self.lib.shared_memory_kv_notify_fd.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            c_int
+        ]
+        self.lib.shared_memory_kv_notify_fd.restype = c_int
+        
+        # shared_memory_kv_notify_read
+        self.lib.shared_memory_kv_notify_read.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            c_int,
+            c_int,
+            POINTER(c_uint)
+        ]
+        self.lib.shared_memory_kv_notify_read.restype = c_int
+        
+        # shared_memory_kv_ts_append
+        self.lib.shared_memory_kv_ts_append.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            ctypes.c_longlong,
+            ctypes.c_double
+        ]
+        self.lib.shared_memory_kv_ts_append.restype = c_int
+        
+        # shared_memory_kv_ts_range
+        self.lib.shared_memory_kv_ts_range.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            ctypes.c_longlong,
+            ctypes.c_longlong,
+            POINTER(KVSample),
+            ctypes.c_size_t
+        ]
+        self.lib.shared_memory_kv_ts_range.restype = c_int
+        
+        # shared_memory_kv_ts_list
+        self.lib.shared_memory_kv_ts_list.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            POINTER(KVSeriesInfo),
+            ctypes.c_size_t
+        ]
+        self.lib.shared_memory_kv_ts_list.restype = c_int
+        
+        # shared_memory_kv_ts_delete
+        self.lib.shared_memory_kv_ts_delete.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p
+        ]
+        self.lib.shared_memory_kv_ts_delete.restype = c_int
+        
+        # shared_memory_kv_rollup_enable
+        self.lib.shared_memory_kv_rollup_enable.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            c_uint
+        ]
+        self.lib.shared_memory_kv_rollup_enable.restype = c_int
+        
+        # shared_memory_kv_rollup_get
+        self.lib.shared_memory_kv_rollup_get.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            POINTER(KVRollupInfo)
+        ]
+        self.lib.shared_memory_kv_rollup_get.restype = c_int
+        
+        # shared_memory_kv_rollup_list
+        self.lib.shared_memory_kv_rollup_list.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            POINTER(KVRollupInfo),
+            ctypes.c_size_t
+        ]
+        self.lib.shared_memory_kv_rollup_list.restype = c_int
+        
+        # shared_memory_kv_queue_create
+        self.lib.shared_memory_kv_queue_create.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p
+        ]
+        self.lib.shared_memory_kv_queue_create.restype = c_int
+        
+        # shared_memory_kv_queue_push
+        self.lib.shared_memory_kv_queue_push.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            ctypes.c_char_p,
+            ctypes.c_size_t
+        ]
+        self.lib.shared_memory_kv_queue_push.restype = c_int
+        
+        # shared_memory_kv_queue_pop
+        self.lib.shared_memory_kv_queue_pop.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            ctypes.c_char_p,
+            ctypes.c_size_t,
+            c_int
+        ]
+        self.lib.shared_memory_kv_queue_pop.restype = c_int
+        
+        # shared_memory_kv_queue_list
+        self.lib.shared_memory_kv_queue_list.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            POINTER(KVQueueInfo),
+            ctypes.c_size_t
+        ]
+        self.lib.shared_memory_kv_queue_list.restype = c_int
+        
+        # shared_memory_kv_queue_delete
+        self.lib.shared_memory_kv_queue_delete.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p
+        ]
+        self.lib.shared_memory_kv_queue_delete.restype = c_int
+        
+        # shared_memory_kv_zadd
+        self.lib.shared_memory_kv_zadd.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            ctypes.c_char_p,
+            ctypes.c_double
+        ]
+        self.lib.shared_memory_kv_zadd.restype = c_int
+        
+        # shared_memory_kv_zrem
+        self.lib.shared_memory_kv_zrem.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            ctypes.c_char_p
+        ]
+        self.lib.shared_memory_kv_zrem.restype = c_int
+        
+        # shared_memory_kv_zscore
+        self.lib.shared_memory_kv_zscore.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            ctypes.c_char_p,
+            POINTER(ctypes.c_double)
+        ]
+        self.lib.shared_memory_kv_zscore.restype = c_int
+        
+        # shared_memory_kv_zrank
+        self.lib.shared_memory_kv_zrank.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            ctypes.c_char_p,
+            c_int
+        ]
+        self.lib.shared_memory_kv_zrank.restype = c_int
+        
+        # shared_memory_kv_zrange
+        self.lib.shared_memory_kv_zrange.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            c_uint,
+            c_int,
+            POINTER(KVZsetItem),
+            ctypes.c_size_t
+        ]
+        self.lib.shared_memory_kv_zrange.restype = c_int
+        
+        # shared_memory_kv_zrange_by_score
+        self.lib.shared_memory_kv_zrange_by_score.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p,
+            ctypes.c_double,
+            ctypes.c_double,
+            POINTER(KVZsetItem),
+            ctypes.c_size_t
+        ]
+        self.lib.shared_memory_kv_zrange_by_score.restype = c_int
+        
+        # shared_memory_kv_zset_list
+        self.lib.shared_memory_kv_zset_list.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            POINTER(KVZsetInfo),
+            ctypes.c_size_t
+        ]
+        self.lib.shared_memory_kv_zset_list.restype = c_int
+        
+        # shared_memory_kv_zset_delete
+        self.lib.shared_memory_kv_zset_delete.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            ctypes.c_char_p
+        ]
+        self.lib.shared_memory_kv_zset_delete.restype = c_int
+        
+        # shared_memory_kv_changelog_position
+        self.lib.shared_memory_kv_changelog_position.argtypes = [
+            POINTER(SharedMemoryKVStore)
+        ]
+        self.lib.shared_memory_kv_changelog_position.restype = ctypes.c_ulonglong
+        
+        # shared_memory_kv_replication_status
+        self.lib.shared_memory_kv_replication_status.argtypes = [
+            POINTER(SharedMemoryKVStore),
+            POINTER(KVReplicationStatus)
+        ]
+        self.lib.shared_memory_kv_replication_status.restype = c_int
+    
+    def create(self, flags: int = 0) -> bool:
+        """
+        Create new shared memory store.
+        
+        Args:
+            flags: Storage options (KV_FLAG_* bitmask, 0 = plain storage)
+        
+        Returns:
+            True on success, False on error
+        """
+        fd_ptr = ctypes.pointer(self.fd)
+        self.store_ptr = self.lib.shared_memory_kv_create_named(
+            self.name.encode('utf-8'), fd_ptr, flags
+        )
+        
+        # Check for NULL pointer
+        if not self._check_store():
+            return False
+        
+        return True
+    
+    def open(self) -> bool:
+        """
+        Open existing shared memory store.
+        
+        Returns:
+            True on success, False on error
+        """
+        fd_ptr = ctypes.pointer(self.fd)
+        self.store_ptr = self.lib.shared_memory_kv_open_named(
+            self.name.encode('utf-8'), fd_ptr
+        )
+        
+        # Check for NULL pointer
+        if not self._check_store():
+            return False
+        
+        return True
+    
+    def set(self, key: str, value: Value) -> Tuple[bool, Optional[str]]:
+        """
+        Set key-value pair in store.
+        
+        The value keeps its Python type: int is stored as a native int64,
+        float as a native double, bytes as opaque bytes, str as text.
+        
+        Args:
+            key: Key string
+            value: Value (str, int, float or bytes)
+            
+        Returns:
+            Tuple of (success: bool, error_message: Optional[str])
+        """
+        if not self._check_store():
+            return False, "Store not initialized"
+        
+        # Convert strings to bytes
+        key_bytes = key.encode('utf-8')
+        
+        # Check lengths
+        if len(key_bytes) >= KEY_SIZE:
+            return False, f"Key too long (max {KEY_SIZE-1} bytes)"
+        
+        if isinstance(value, int):
+            if not INT64_MIN <= value <= INT64_MAX:
+                return False, "Integer out of int64 range"
+            result = self.lib.shared_memory_kv_set_int64(
+                self.store_ptr, key_bytes, value
+            )
+        elif isinstance(value, float):
+            result = self.lib.shared_memory_kv_set_double(
+                self.store_ptr, key_bytes, value
+            )
+        else:
+            is_bytes = isinstance(value, bytes)
+            value_bytes = value if is_bytes else value.encode('utf-8')
+            if len(value_bytes) >= VALUE_SIZE:
+                return False, f"Value too long (max {VALUE_SIZE-1} bytes)"
+            if is_bytes:
+                result = self.lib.shared_memory_kv_set_bytes(
+                    self.store_ptr, key_bytes, value_bytes, len(value_bytes)
+                )
+            else:
+                result = self.lib.shared_memory_kv_set(
+                    self.store_ptr, key_bytes, value_bytes
+                )
+        
+        if result == -1:
+            # Get errno from C library
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOSPC:
+                return False, "Store full (ENOSPC)"
+            if errno_val == errno.EPERM:
+                return False, "Read-only: another process or thread is the single writer (EPERM)"
+            if errno_val == errno.EAGAIN:
+                return False, "Retire list full, a reader is still on old versions (EAGAIN)"
+            return False, f"Error setting key: errno={errno_val}"
+        
+        return True, None
+    
+    def get(self, key: str) -> Tuple[Optional[Value], Optional[str]]:
+        """
+        Get value by key from store.
+        
+        Numbers written natively come back as int/float without parsing;
+        bytes values as bytes; text as str.
+        
+        Args:
+            key: Key string
+            
+        Returns:
+            Tuple of (value: Optional[Value], error_message: Optional[str])
+        """
+        if not self._check_store():
+            return None, "Store not initialized"
+        
+        key_bytes = key.encode('utf-8')
+        
+        if len(key_bytes) >= KEY_SIZE:
+            return None, f"Key too long (max {KEY_SIZE-1} bytes)"
+        
+        # Allocate the typed value
+        value = KVValue()
+        
+        result = self.lib.shared_memory_kv_get_value(
+            self.store_ptr,
+            key_bytes,
+            ctypes.byref(value)
+        )
+        
+        if result == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOENT:  # key not found
+                return None, "Key not found"
+            return None, f"Error getting key: errno={errno_val}"
+        
+        if value.type == KV_TYPE_INT64:
+            return value.int64, None
+        if value.type == KV_TYPE_DOUBLE:
+            return value.number, None
+        data = ctypes.string_at(ctypes.addressof(value) + KVValue.data.offset,
+                                value.length)
+        if value.type == KV_TYPE_BYTES:
+            return data, None
+        if value.type == KV_TYPE_HASH:
+            return self._hash_fields(data), None
+        return data.decode('utf-8'), None
+    
+    @staticmethod
+    def _hash_fields(data: bytes) -> Dict[str, str]:
+        """Decode an encoded field map ("field\\0value\\0" per field)."""
+        parts = data.split(b'\0')[:-1]
+        return {
+            parts[i].decode('utf-8'): parts[i + 1].decode('utf-8')
+            for i in range(0, len(parts) - 1, 2)
+        }
+    
+    def _hash_args(self, key: str,
+                   field: str) -> Tuple[Optional[bytes], Optional[bytes],
+                                        Optional[str]]:
+        """Encode and check key and field of a hash call."""
+        key_bytes = key.encode('utf-8')
+        field_bytes = field.encode('utf-8')
+        if len(key_bytes) >= KEY_SIZE:
+            return None, None, f"Key too long (max {KEY_SIZE-1} bytes)"
+        if len(field_bytes) >= KV_HASH_FIELD_SIZE:
+            return None, None, \
+                f"Field too long (max {KV_HASH_FIELD_SIZE-1} bytes)"
+        return key_bytes, field_bytes, None
+    
+    def hset(self, key: str, field: str,
+             value: str) -> Tuple[bool, Optional[str]]:
+        """
+        Set a field of a hash entry (created if the key does not exist).
+        
+        Args:
+            key: Key string
+            field: Field name
+            value: Field value
+            
+        Returns:
+            Tuple of (success: bool, error_message: Optional[str])
+        """
+        if not self._check_store():
+            return False, "Store not initialized"
+        
+        key_bytes, field_bytes, error = self._hash_args(key, field)
+        if error:
+            return False, error
+        
+        result = self.lib.shared_memory_kv_hset(
+            self.store_ptr, key_bytes, field_bytes, value.encode('utf-8')
+        )
+        
+        if result == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.EINVAL:
+                return False, "Key holds a value that is not a hash"
+            if errno_val == errno.ENAMETOOLONG:
+                return False, f"Hash too long (max {VALUE_SIZE-1} bytes)"
+            if errno_val == errno.ENOSPC:
+                return False, "Store full (ENOSPC)"
+            if errno_val == errno.EPERM:
+                return False, "Read-only: another process or thread is the single writer (EPERM)"
+            return False, f"Error setting field: errno={errno_val}"
+        
+        return True, None
+    
+    def hget(self, key: str,
+             field: str) -> Tuple[Optional[str], Optional[str]]:
+        """
+        Get a field of a hash entry.
+        
+        Args:
+            key: Key string
+            field: Field name
+            
+        Returns:
+            Tuple of (value: Optional[str], error_message: Optional[str])
+        """
+        if not self._check_store():
+            return None, "Store not initialized"
+        
+        key_bytes, field_bytes, error = self._hash_args(key, field)
+        if error:
+            return None, error
+        
+        value_buffer = ctypes.create_string_buffer(VALUE_SIZE)
+        result = self.lib.shared_memory_kv_hget(
+            self.store_ptr, key_bytes, field_bytes, value_buffer
+        )
+        
+        if result == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOENT:
+                return None, "Key or field not found"
+            if errno_val == errno.EINVAL:
+                return None, "Key holds a value that is not a hash"
+            return None, f"Error getting field: errno={errno_val}"
+        
+        return value_buffer.value.decode('utf-8'), None
+    
+    def hdel(self, key: str, field: str) -> Tuple[bool, Optional[str]]:
+        """
+        Delete a field of a hash entry (the last field deletes the key).
+        
+        Args:
+            key: Key string
+            field: Field name
+            
+        Returns:
+            Tuple of (success: bool, error_message: Optional[str])
+        """
+        if not self._check_store():
+            return False, "Store not initialized"
+        
+        key_bytes, field_bytes, error = self._hash_args(key, field)
+        if error:
+            return False, error
+        
+        result = self.lib.shared_memory_kv_hdel(
+            self.store_ptr, key_bytes, field_bytes
+        )
+        
+        if result == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOENT:
+                return False, "Key or field not found"
+            if errno_val == errno.EINVAL:
+                return False, "Key holds a value that is not a hash"
+            if errno_val == errno.EPERM:
+                return False, "Read-only: another process or thread is the single writer (EPERM)"
+            return False, f"Error deleting field: errno={errno_val}"
+        
+        return True, None
+    
+    def hgetall(self, key: str) -> Tuple[Optional[Dict[str, str]],
+                                         Optional[str]]:
+        """
+        Get all fields of a hash entry with one lookup.
+        
+        Args:
+            key: Key string
+            
+        Returns:
+            Tuple of (fields: Optional[dict], error_message: Optional[str])
+        """
+        if not self._check_store():
+            return None, "Store not initialized"
+        
+        key_bytes = key.encode('utf-8')
+        if len(key_bytes) >= KEY_SIZE:
+            return None, f"Key too long (max {KEY_SIZE-1} bytes)"
+        
+        value = KVValue()
+        count = self.lib.shared_memory_kv_hgetall(
+            self.store_ptr, key_bytes, ctypes.byref(value)
+        )
+        
+        if count == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOENT:
+                return None, "Key not found"
+            if errno_val == errno.EINVAL:
+                return None, "Key holds a value that is not a hash"
+            return None, f"Error getting hash: errno={errno_val}"
+        
+        data = ctypes.string_at(ctypes.addressof(value) + KVValue.data.offset,
+                                value.length)
+        return self._hash_fields(data), None
+    
+    def history(self, key: str) -> Tuple[Optional[List[dict]], Optional[str]]:
+        """
+        Get the retained versions of a key, newest first.
+        
+        Args:
+            key: Key string
+            
+        Returns:
+            Tuple of (versions: Optional[list], error_message: Optional[str])
+        """
+        if not self._check_store():
+            return None, "Store not initialized"
+        
+        key_bytes = key.encode('utf-8')
+        
+        if len(key_bytes) >= KEY_SIZE:
+            return None, f"Key too long (max {KEY_SIZE-1} bytes)"
+        
+        versions = (KVVersionInfo * KV_MVCC_VERSIONS)()
+        count = self.lib.shared_memory_kv_history(
+            self.store_ptr,
+            key_bytes,
+            versions,
+            KV_MVCC_VERSIONS
+        )
+        
+        if count == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOENT:
+                return None, "Key not found"
+            return None, f"Error reading history: errno={errno_val}"
+        
+        return [
+            {
+                "value": versions[i].value.decode('utf-8'),
+                "version": versions[i].version,
+                "timestamp": versions[i].timestamp
+            }
+            for i in range(count)
+        ], None
+    
+    def transaction(self, writes: List[Tuple[str, Optional[str]]],
+                    expect: Optional[Dict[str, Optional[str]]] = None
+                    ) -> Tuple[bool, Optional[str]]:
+        """
+        Apply several writes atomically, optionally conditioned on values.
+        
+        Keys in expect are read inside the transaction and compared with the
+        expected value (None = key must not exist). Commit fails if any of
+        them changed in the meantime, so expect gives compare-and-set over
+        several keys.
+        
+        Args:
+            writes: List of (key, value) pairs; value None deletes the key
+            expect: Optional mapping of key -> expected value or None
+            
+        Returns:
+            Tuple of (success, error_message). Conflicts start with
+            "Conflict"
+        """
+        if not self._check_store():
+            return False, "Store not initialized"
+        
+        expect = expect or {}
+        if len(writes) > KV_TXN_MAX_OPS or len(expect) > KV_TXN_MAX_OPS:
+            return False, f"Too many operations (max {KV_TXN_MAX_OPS} keys)"
+        
+        txn = KVTxn()
+        self.lib.shared_memory_kv_txn_begin(self.store_ptr, ctypes.byref(txn))
+        
+        # Reads: check expectations and record versions for validation
+        value_buffer = ctypes.create_string_buffer(VALUE_SIZE)
+        for key, expected in expect.items():
+            key_bytes = key.encode('utf-8')
+            if len(key_bytes) >= KEY_SIZE:
+                self.lib.shared_memory_kv_txn_abort(ctypes.byref(txn))
+                return False, f"Key too long (max {KEY_SIZE-1} bytes)"
+            result = self.lib.shared_memory_kv_txn_get(
+                ctypes.byref(txn), key_bytes, value_buffer
+            )
+            current = value_buffer.value.decode('utf-8') if result == 0 else None
+            if result == -1 and ctypes.get_errno() != errno.ENOENT:
+                self.lib.shared_memory_kv_txn_abort(ctypes.byref(txn))
+                return False, f"Error reading key: errno={ctypes.get_errno()}"
+            if current != expected:
+                self.lib.shared_memory_kv_txn_abort(ctypes.byref(txn))
+                return False, f"Conflict: '{key}' does not have the expected value"
+        
+        # Writes: buffered in txn until commit
+        for key, value in writes:
+            key_bytes = key.encode('utf-8')
+            if value is None:
+                result = self.lib.shared_memory_kv_txn_delete(ctypes.byref(txn), key_bytes)
+            else:
+                result = self.lib.shared_memory_kv_txn_set(
+                    ctypes.byref(txn), key_bytes, value.encode('utf-8')
+                )
+            if result == -1:
+                errno_val = ctypes.get_errno()
+                self.lib.shared_memory_kv_txn_abort(ctypes.byref(txn))
+                if errno_val == errno.ENAMETOOLONG:
+                    return False, f"Key or value too long for '{key}'"
+                return False, f"Error buffering write: errno={errno_val}"
+        
+        result = self.lib.shared_memory_kv_txn_commit(ctypes.byref(txn))
+        if result == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.EAGAIN:
+                return False, "Conflict: a read key changed before commit"
+            if errno_val == errno.ENOSPC:
+                return False, "Store full (ENOSPC)"
+            if errno_val == errno.EPERM:
+                return False, "Read-only: another process or thread is the single writer (EPERM)"
+            return False, f"Error committing transaction: errno={errno_val}"
+        
+        return True, None
+    
+    def search(self, query: str, limit: int = 10,
+               fuzzy: bool = True) -> Tuple[Optional[list], Optional[str]]:
+        """
+        Search keys by prefix (and optionally substring/subsequence).
+        
+        Prefix matches come from the sorted key index in shared memory;
+        fuzzy matches fill the remaining slots up to limit.
+        
+        Args:
+            query: Query string
+            limit: Maximum number of results
+            fuzzy: Also return substring and subsequence matches
+            
+        Returns:
+            Tuple of (results: Optional[list], error_message: Optional[str])
+        """
+        if not self._check_store():
+            return None, "Store not initialized"
+        
+        query_bytes = query.encode('utf-8')
+        if len(query_bytes) >= KEY_SIZE:
+            return None, f"Query too long (max {KEY_SIZE-1} bytes)"
+        
+        flags = KV_SEARCH_PREFIX | (KV_SEARCH_FUZZY if fuzzy else 0)
+        results = (KVSearchResult * limit)()
+        
+        count = self.lib.shared_memory_kv_search(
+            self.store_ptr,
+            query_bytes,
+            flags,
+            results,
+            limit
+        )
+        
+        if count == -1:
+            errno_val = ctypes.get_errno()
+            return None, f"Error searching keys: errno={errno_val}"
+        
+        return [
+            {
+                "key": results[i].key.decode('utf-8'),
+                "value": results[i].value.decode('utf-8'),
+                "slot": results[i].slot,
+                "match": MATCH_KINDS.get(results[i].match, "unknown"),
+            }
+            for i in range(count)
+        ], None
+    
+    def get_occupancy(self) -> Optional[dict]:
+        """
+        Get hash table occupancy and probe-length statistics.
+        
+        Returns:
+            Dictionary with load factor, tombstones, probe-length histogram
+            and per-region occupancy, or None on error
+        """
+        if not self._check_store():
+            return None
+        
+        stats = KVOccupancyStats()
+        if self.lib.shared_memory_kv_occupancy_stats(
+                self.store_ptr, ctypes.byref(stats)) == -1:
+            return None
+        
+        regions = stats.region_count
+        return {
+            "capacity": stats.capacity,
+            "entry_count": stats.entry_count,
+            "tombstone_count": stats.tombstone_count,
+            "load_factor": stats.load_factor,
+            "avg_probe_length": stats.avg_probe_length,
+            "max_probe_length": stats.max_probe_length,
+            "probe_histogram": list(stats.probe_histogram),
+            "region_size": stats.region_size,
+            "region_occupied": list(stats.region_occupied[:regions]),
+            "region_tombstones": list(stats.region_tombstones[:regions]),
+            "compaction": {
+                "cursor": stats.compact_cursor,
+                "passes": stats.compact_passes,
+                "moved": stats.compact_moved,
+                "purged": stats.compact_purged,
+            },
+            "bloom": {
+                "rejects": stats.bloom_rejects,
+                "false_positives": stats.bloom_false_positives,
+                "fill": stats.bloom_counters_set / KV_BLOOM_COUNTERS,
+            },
+        }
+    
+    def compact_step(self, max_slots: int) -> int:
+        """
+        Run one bounded step of tombstone compaction.
+        
+        Args:
+            max_slots: Maximum number of slots to examine
+            
+        Returns:
+            Number of slots changed, or -1 on error
+        """
+        if not self._check_store():
+            return -1
+        
+        return self.lib.shared_memory_kv_compact_step(self.store_ptr, max_slots)
+    
+    def get_memory_stats(self) -> Optional[dict]:
+        """
+        Get arena usage and value/key deduplication statistics.
+        
+        Returns:
+            Dictionary with memory statistics, or None on error
+        """
+        if not self._check_store():
+            return None
+        
+        stats = KVMemoryStats()
+        result = self.lib.shared_memory_kv_memory_stats(self.store_ptr, ctypes.byref(stats))
+        if result != 0:
+            return None
+        
+        return {
+            "dedup_values": bool(stats.flags & KV_FLAG_DEDUP_VALUES),
+            "prefix_keys": bool(stats.flags & KV_FLAG_PREFIX_KEYS),
+            "single_writer": bool(stats.flags & KV_FLAG_SINGLE_WRITER),
+            "writer_pid": stats.writer_pid,
+            "arena_size": stats.arena_size,
+            "arena_top": stats.arena_top,
+            "allocated_bytes": stats.allocated_bytes,
+            "free_bytes": stats.free_bytes,
+            "blob_count": stats.blob_count,
+            "shared_blob_count": stats.shared_blob_count,
+            "dedup_hits": stats.dedup_hits,
+            "bytes_saved": stats.bytes_saved,
+            "compression": {
+                "enabled": bool(stats.flags & KV_FLAG_COMPRESS_VALUES),
+                "dictionary_size": stats.compress_dict_length,
+                "values": stats.compressed_values,
+                "stored_bytes": stats.compressed_bytes,
+                "original_bytes": stats.uncompressed_bytes,
+                "ratio": (stats.uncompressed_bytes / stats.compressed_bytes
+                          if stats.compressed_bytes else 1.0)
+            },
+            "mvcc": {
+                "epoch": stats.epoch,
+                "registry_entries": stats.registry_entries,
+                "attached_processes": stats.attached_processes,
+                "active_readers": stats.active_readers,
+                "reaped_entries": stats.reaped_entries,
+                "version_records": stats.version_records,
+                "retired_pending": stats.retired_pending,
+                "reclaimed": stats.reclaimed,
+                "retire_overflows": stats.retire_overflows
+            },
+            "combining": {
+                "combined_writes": stats.combined_writes,
+                "batches": stats.combine_batches,
+                "avg_batch": (stats.combined_writes / stats.combine_batches
+                              if stats.combine_batches else 0.0)
+            },
+            "subscriptions": {
+                "active": stats.subscriptions,
+                "notifications": stats.notifications
+            }
+        }
+    
+    def set_dictionary(self, dictionary: bytes) -> Tuple[bool, Optional[str]]:
+        """
+        Set the preset dictionary used to compress values.
+        
+        Only possible while no compressed values are stored.
+        
+        Args:
+            dictionary: Sample bytes of typical values (max 1024 bytes)
+            
+        Returns:
+            Tuple (success, error_message)
+        """
+        if not self._check_store():
+            return False, "Store not initialized"
+        
+        if len(dictionary) > KV_COMPRESS_DICT_SIZE:
+            return False, f"Dictionary too large (max {KV_COMPRESS_DICT_SIZE} bytes)"
+        
+        result = self.lib.shared_memory_kv_set_dictionary(
+            self.store_ptr, dictionary, len(dictionary)
+        )
+        if result != 0:
+            return False, "Compressed values exist, dictionary cannot change"
+        
+        return True, None
+    
+    @staticmethod
+    def _entry_value(entry: KVEntry) -> Union[str, int, float]:
+        """
+        Native value of a snapshot entry (numbers without parsing).
+        
+        Bytes values and hashes are given as their text view (bytes up to
+        the first '\\0', undecodable bytes replaced; hashes as
+        "field=value" lines), so entries stay JSON-friendly.
+        """
+        if entry.type == KV_TYPE_INT64:
+            return entry.int64
+        if entry.type == KV_TYPE_DOUBLE:
+            return entry.number
+        return entry.value.decode('utf-8', errors='replace')
+    
+    def _snapshot(self) -> Optional[Tuple[int, list]]:
+        """
+        Copy all entries as of a single store version.
+        
+        Uses the lock-free snapshot read, so the listing never mixes
+        entries from before and after a concurrent write.
+        
+        Returns:
+            Tuple (version, entries), or None on error
+        """
+        entries = (KVEntry * MAX_ENTRIES)()
+        version = c_uint(0)
+        count = self.lib.shared_memory_kv_snapshot_table(
+            self.store_ptr, entries, ctypes.byref(version)
+        )
+        if count < 0:
+            return None
+        
+        return version.value, [
+            {
+                "slot": entry.slot,
+                "key": entry.key.decode('utf-8'),
+                "value": self._entry_value(entry),
+                "type": VALUE_TYPE_NAMES[entry.type]
+                if entry.type < len(VALUE_TYPE_NAMES) else "string",
+                "timestamp": entry.timestamp,
+                "slot_version": entry.slot_version
+            }
+            for entry in entries[:count]
+        ]
+    
+    def get_status(self) -> Optional[dict]:
+        """
+        Get store status (version, entry_count, all entries).
+        
+        Returns:
+            Dictionary with status info, or None on error
+        """
+        if not self._check_store():
+            return None
+        
+        snapshot = self._snapshot()
+        if snapshot is None:
+            return None
+        version, entries = snapshot
+        
+        for entry in entries:
+            del entry["slot_version"]
+        
+        rollups = self.rollup_list() or []
+        
+        return {
+            "version": version,
+            "entry_count": len(entries),
+            "max_entries": MAX_ENTRIES,
+            "entries": entries,
+            "rollups": {rollup["key"]: rollup["windows"] for rollup in rollups}
+        }
+    
+    def get_version(self) -> Optional[dict]:
+        """
+        Get only the store version, entry count and generation.
+        
+        Cheap check for pollers: reads three integers instead of walking the
+        whole table, so clients can skip fetching entries when nothing moved.
+        The generation (creation time in microseconds) changes when the
+        store is recreated, even if the new version equals the old one.
+        
+        Returns:
+            Dictionary with version, entry_count and generation, or None on
+            error
+        """
+        if not self._check_store():
+            return None
+        
+        try:
+            store = self.store_ptr.contents
+        except (ValueError, AttributeError, TypeError) as e:
+            print(f"Error accessing store pointer contents: {e}", file=sys.stderr)
+            self.store_ptr = None
+            return None
+        
+        return {
+            "version": store.version,
+            "entry_count": store.entry_count,
+            "generation": store.generation
+        }
+    
+    def get_changes(self, since_version: int,
+                    generation: Optional[int] = None) -> Optional[dict]:
+        """
+        Get only the slots changed after a given store version.
+        
+        Every slot records the store version of its last write or delete,
+        so a client that already has the table as of since_version only
+        needs the slots whose slot_version is newer. Deleted slots are
+        reported with entry set to None.
+        
+        If the store was recreated since (generation differs from the
+        store's, or since_version is ahead of the store), all slots are
+        returned and "full" is set so the client discards its local copy.
+        
+        Args:
+            since_version: Store version the client already has
+            generation: Store generation that version belongs to (None =
+                not known, only since_version is checked)
+            
+        Returns:
+            Dictionary with version info and changed slots, or None on error
+        """
+        if not self._check_store():
+            return None
+        
+        try:
+            store = self.store_ptr.contents
+        except (ValueError, AttributeError, TypeError) as e:
+            print(f"Error accessing store pointer contents: {e}", file=sys.stderr)
+            self.store_ptr = None
+            return None
+        
+        snapshot = self._snapshot()
+        if snapshot is None:
+            return None
+        version, entries = snapshot
+        
+        full = since_version > version or (
+            generation is not None and generation != store.generation
+        )
+        if full:
+            since_version = 0
+        
+        # Occupied slots come from the snapshot; a slot changed after it
+        # (slot_version > version) is left for the next poll
+        occupied = {entry["slot"]: entry for entry in entries}
+        changes = []
+        for i in range(MAX_ENTRIES):
+            entry = occupied.get(i)
+            if entry is not None:
+                slot_version = entry.pop("slot_version")
+            else:
+                slot_version = store.kv_table[i].slot_version
+                if slot_version > version:
+                    continue
+            if slot_version > since_version:
+                changes.append({"slot": i, "entry": entry})
+        
+        return {
+            "version": version,
+            "entry_count": len(entries),
+            "max_entries": MAX_ENTRIES,
+            "generation": store.generation,
+            "full": full,
+            "changes": changes
+        }
+    
+    def destroy(self):
+        """Clean up resources (munmap, close fd)."""
+        if self._check_store():
+            self.lib.shared_memory_kv_destroy(self.fd, self.store_ptr)
+            self.store_ptr = None
+            self.fd.value = -1
+    
+    def unlink(self) -> bool:
+        """
+        Unlink shared memory object (only creator should call this).
+        
+        Returns:
+            True on success, False on error
+        """
+        result = self.lib.shared_memory_kv_unlink_named(self.name.encode('utf-8'))
+        return result == 0
+    
+    def unlink_safe(self) -> Tuple[bool, Optional[str]]:
+        """
+        Unlink shared memory object unless other processes are attached.
+        
+        Returns:
+            Tuple (success, error_message)
+        """
+        if not self._check_store():
+            return False, "Store not initialized"
+        
+        result = self.lib.shared_memory_kv_unlink_safe(self.store_ptr)
+        if result == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.EBUSY:
+                return False, "Other processes are attached"
+            return False, f"Error unlinking: errno={errno_val}"
+        return True, None
+    
+    def heartbeat(self) -> bool:
+        """
+        Record that this process is alive (refreshes its registry entry).
+        
+        Returns:
+            True on success, False on error
+        """
+        if not self._check_store():
+            return False
+        return self.lib.shared_memory_kv_heartbeat(self.store_ptr) == 0
+    
+    def reap(self) -> int:
+        """
+        Free registry entries of processes that exited without detaching.
+        
+        Returns:
+            Number of entries freed (-1 on error)
+        """
+        if not self._check_store():
+            return -1
+        return self.lib.shared_memory_kv_reap(self.store_ptr)
+    
+    def get_processes(self) -> Optional[List[dict]]:
+        """
+        List the processes attached to the store.
+        
+        Returns:
+            List of process dicts or None on error
+        """
+        if not self._check_store():
+            return None
+        
+        processes = (KVProcessInfo * KV_REGISTRY_SIZE)()
+        count = self.lib.shared_memory_kv_processes(
+            self.store_ptr,
+            processes,
+            KV_REGISTRY_SIZE
+        )
+        if count == -1:
+            return None
+        
+        return [
+            {
+                "pid": processes[i].pid,
+                "start_time": processes[i].start_time,
+                "heartbeat": processes[i].heartbeat,
+                "epoch": processes[i].epoch,
+                "threads": processes[i].threads,
+                "alive": bool(processes[i].alive)
+            }
+            for i in range(count)
+        ]
+    
+    def subscribe(self, patterns: List[str],
+                  prefix: bool = False) -> Tuple[Optional[int], Optional[str]]:
+        """
+        Subscribe to changes of specific keys (or key prefixes).
+        
+        Args:
+            patterns: Keys to watch (1..KV_SUBSCRIPTION_KEYS)
+            prefix: Treat patterns as key prefixes
+            
+        Returns:
+            Tuple of (subscription id, error message)
+        """
+        if not self._check_store():
+            return None, "Store not initialized"
+        
+        encoded = (ctypes.c_char_p * len(patterns))(
+            *[pattern.encode('utf-8') for pattern in patterns]
+        )
+        result = self.lib.shared_memory_kv_subscribe(
+            self.store_ptr,
+            encoded,
+            len(patterns),
+            KV_SUBSCRIBE_PREFIX if prefix else 0
+        )
+        if result == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOSPC:
+                return None, "Subscription table is full"
+            if errno_val == errno.ENAMETOOLONG:
+                return None, "Pattern too long"
+            return None, f"Error subscribing: errno={errno_val}"
+        return result, None
+    
+    def wait(self, subscription: int, events: int = 0,
+             timeout_ms: int = -1) -> Optional[int]:
+        """
+        Wait for changes of the keys of a subscription.
+        
+        Blocks without holding the GIL until the event counter differs from
+        events (0 right after subscribing) or the timeout expires.
+        
+        Args:
+            subscription: Id returned by subscribe()
+            events: Event counter last seen
+            timeout_ms: Maximum wait in milliseconds (-1 = no limit)
+            
+        Returns:
+            New event counter, or None on timeout or error
+        """
+        if not self._check_store():
+            return None
+        
+        counter = c_uint(events)
+        result = self.lib.shared_memory_kv_wait(
+            self.store_ptr,
+            subscription,
+            ctypes.byref(counter),
+            timeout_ms
+        )
+        if result == -1:
+            return None
+        return counter.value
+    
+    def unsubscribe(self, subscription: int) -> bool:
+        """
+        Cancel a subscription of this process.
+        
+        Returns:
+            True on success, False on error
+        """
+        if not self._check_store():
+            return False
+        return self.lib.shared_memory_kv_unsubscribe(
+            self.store_ptr, subscription
+        ) == 0
+    
+    def notify_fd(self, subscription: int) -> Optional[int]:
+        """
+        Get a pollable file descriptor for the events of a subscription.
+        
+        The descriptor becomes readable when events arrive (register it
+        with select/poll or asyncio's loop.add_reader), then call
+        notify_read(). The caller closes it after unsubscribing.
+        
+        Args:
+            subscription: Id returned by subscribe()
+            
+        Returns:
+            File descriptor, or None on error
+        """
+        if not self._check_store():
+            return None
+        
+        fd = self.lib.shared_memory_kv_notify_fd(self.store_ptr, subscription)
+        if fd == -1:
+            return None
+        return fd
+    
+    def notify_read(self, subscription: int, fd: int,
+                    events: int = 0) -> Optional[int]:
+        """
+        Drain the notification descriptor and re-arm it.
+        
+        Args:
+            subscription: Id returned by subscribe()
+            fd: Descriptor returned by notify_fd()
+            events: Event counter last seen
+            
+        Returns:
+            New event counter, or None if nothing changed (or on error)
+        """
+        if not self._check_store():
+            return None
+        
+        counter = c_uint(events)
+        result = self.lib.shared_memory_kv_notify_read(
+            self.store_ptr,
+            subscription,
+            fd,
+            ctypes.byref(counter)
+        )
+        if result == -1:
+            return None
+        return counter.value
+    
+    def ts_append(self, key: str, value: float,
+                  timestamp: int = 0) -> Tuple[bool, Optional[str]]:
+        """
+        Append a sample to a time series (created on first append).
+        
+        Args:
+            key: Series name
+            value: Sample value
+            timestamp: Milliseconds since the epoch (0 = now); must not be
+                older than the newest sample
+            
+        Returns:
+            Tuple of (success: bool, error_message: Optional[str])
+        """
+        if not self._check_store():
+            return False, "Store not initialized"
+        
+        key_bytes = key.encode('utf-8')
+        if len(key_bytes) >= KEY_SIZE:
+            return False, f"Key too long (max {KEY_SIZE-1} bytes)"
+        
+        result = self.lib.shared_memory_kv_ts_append(
+            self.store_ptr, key_bytes, timestamp, value
+        )
+        if result == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.EINVAL:
+                return False, "Timestamp older than the newest sample"
+            if errno_val == errno.ENOSPC:
+                return False, f"Too many series (max {KV_SERIES_MAX})"
+            if errno_val == errno.EPERM:
+                return False, "Read-only: another process or thread is the single writer (EPERM)"
+            return False, f"Error appending sample: errno={errno_val}"
+        return True, None
+    
+    def ts_range(self, key: str, start: int = 0, end: int = 0,
+                 limit: int = KV_SERIES_SAMPLES) -> Tuple[Optional[List[dict]], Optional[str]]:
+        """
+        Read the samples of a time series, oldest first.
+        
+        Args:
+            key: Series name
+            start: First timestamp in ms (inclusive, 0 = no limit)
+            end: Last timestamp in ms (inclusive, 0 = no limit)
+            limit: Maximum number of samples (the newest are kept)
+            
+        Returns:
+            Tuple of (samples: Optional[list], error_message: Optional[str])
+        """
+        if not self._check_store():
+            return None, "Store not initialized"
+        
+        key_bytes = key.encode('utf-8')
+        if len(key_bytes) >= KEY_SIZE:
+            return None, f"Key too long (max {KEY_SIZE-1} bytes)"
+        
+        limit = max(0, min(limit, KV_SERIES_SAMPLES))
+        samples = (KVSample * KV_SERIES_SAMPLES)()
+        count = self.lib.shared_memory_kv_ts_range(
+            self.store_ptr, key_bytes, start, end, samples, limit
+        )
+        if count == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOENT:
+                return None, "Series not found"
+            return None, f"Error reading series: errno={errno_val}"
+        
+        return [
+            {"timestamp": samples[i].timestamp, "value": samples[i].value}
+            for i in range(count)
+        ], None
+    
+    def ts_list(self) -> Optional[List[dict]]:
+        """
+        List the time series.
         
         Returns:
-            Dictionary with status info, or None on error
+            List of series dicts or None on error
         """
         if not self._check_store():
             return None
         
-        try:
-            store = self.store_ptr.contents
-        except (ValueError, AttributeError, TypeError) as e:
-            # Handle NULL pointer access or invalid pointer
-            print(f"Error accessing store pointer contents: {e}", file=sys.stderr)
-            self.store_ptr = None
+        series = (KVSeriesInfo * KV_SERIES_MAX)()
+        count = self.lib.shared_memory_kv_ts_list(
+            self.store_ptr, series, KV_SERIES_MAX
+        )
+        if count == -1:
             return None
         
-        entries = []
-        for i in range(MAX_ENTRIES):
-            pair = store.kv_table[i]
-            # Check if entry is not empty
-            if pair.key:
-                key_str = pair.key.decode('utf-8')
-                value_str = pair.value.decode('utf-8')
-                entries.append({
-                    "key": key_str,
-                    "value": value_str,
-                    "timestamp": pair.timestamp
-                })
+        return [
+            {
+                "key": series[i].key.decode('utf-8'),
+                "count": series[i].count,
+                "appended": series[i].appended,
+                "first_timestamp": series[i].first.timestamp,
+                "last_timestamp": series[i].last.timestamp,
+                "last_value": series[i].last.value
+            }
+            for i in range(count)
+        ]
+    
+    def ts_delete(self, key: str) -> Tuple[bool, Optional[str]]:
+        """
+        Delete a time series with all its samples.
+        
+        Returns:
+            Tuple of (success: bool, error_message: Optional[str])
+        """
+        if not self._check_store():
+            return False, "Store not initialized"
+        
+        key_bytes = key.encode('utf-8')
+        if len(key_bytes) >= KEY_SIZE:
+            return False, f"Key too long (max {KEY_SIZE-1} bytes)"
         
+        result = self.lib.shared_memory_kv_ts_delete(self.store_ptr, key_bytes)
+        if result == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOENT:
+                return False, "Series not found"
+            if errno_val == errno.EPERM:
+                return False, "Read-only: another process or thread is the single writer (EPERM)"
+            return False, f"Error deleting series: errno={errno_val}"
+        return True, None
+    
+    @staticmethod
+    def _rollup_bucket(bucket: KVRollupBucket) -> dict:
+        """Convert a rollup bucket to a dict (aggregates None while empty)"""
+        empty = bucket.count == 0
         return {
-            "version": store.version,
-            "entry_count": store.entry_count,
-            "max_entries": MAX_ENTRIES,
-            "entries": entries
+            "start": bucket.start,
+            "count": bucket.count,
+            "min": None if empty else bucket.min,
+            "max": None if empty else bucket.max,
+            "avg": None if empty else bucket.sum / bucket.count,
+            "last": None if empty else bucket.last
         }
     
-    def destroy(self):
-        """Clean up resources (munmap, close fd)."""
-        if self._check_store():
-            self.lib.shared_memory_kv_destroy(self.fd, self.store_ptr)
-            self.store_ptr = None
-            self.fd.value = -1
+    def _rollup_dict(self, info: KVRollupInfo) -> dict:
+        """Convert a rollup entry to {"key", "windows": {name: buckets}}"""
+        return {
+            "key": info.key.decode('utf-8'),
+            "windows": {
+                name: {
+                    "current": self._rollup_bucket(info.current[i]),
+                    "previous": self._rollup_bucket(info.previous[i])
+                }
+                for i, name in enumerate(ROLLUP_WINDOW_NAMES)
+                if info.windows & (1 << i)
+            }
+        }
     
-    def unlink(self) -> bool:
+    def rollup_enable(self, key: str,
+                      windows: List[str]) -> Tuple[bool, Optional[str]]:
         """
-        Unlink shared memory object (only creator should call this).
+        Enable, change or disable the rollups of a key.
+        
+        Numeric values written to the key are aggregated (min/max/avg/last)
+        per window from then on.
         
+        Args:
+            key: Key name (need not exist yet)
+            windows: Window names from ROLLUP_WINDOW_NAMES (empty = disable)
+            
         Returns:
-            True on success, False on error
+            Tuple of (success: bool, error_message: Optional[str])
         """
-        result = self.lib.shared_memory_kv_unlink()
-        return result == 0
-
+        if not self._check_store():
+            return False, "Store not initialized"
+        
+        key_bytes = key.encode('utf-8')
+        if len(key_bytes) >= KEY_SIZE:
+            return False, f"Key too long (max {KEY_SIZE-1} bytes)"
+        
+        flags = 0
+        for name in windows:
+            if name not in ROLLUP_WINDOW_NAMES:
+                return False, f"Unknown window '{name}' (expected one of {', '.join(ROLLUP_WINDOW_NAMES)})"
+            flags |= 1 << ROLLUP_WINDOW_NAMES.index(name)
+        
+        result = self.lib.shared_memory_kv_rollup_enable(
+            self.store_ptr, key_bytes, flags
+        )
+        if result == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOENT:
+                return False, "Key has no rollups"
+            if errno_val == errno.ENOSPC:
+                return False, f"Too many keys with rollups (max {KV_ROLLUP_MAX})"
+            if errno_val == errno.EPERM:
+                return False, "Read-only: another process or thread is the single writer (EPERM)"
+            return False, f"Error configuring rollups: errno={errno_val}"
+        return True, None
+    
+    def rollup_get(self, key: str) -> Tuple[Optional[dict], Optional[str]]:
+        """
+        Get the rollups of a key.
+        
+        Returns:
+            Tuple of (rollup dict or None, error_message: Optional[str])
+        """
+        if not self._check_store():
+            return None, "Store not initialized"
+        
+        key_bytes = key.encode('utf-8')
+        if len(key_bytes) >= KEY_SIZE:
+            return None, f"Key too long (max {KEY_SIZE-1} bytes)"
+        
+        info = KVRollupInfo()
+        result = self.lib.shared_memory_kv_rollup_get(
+            self.store_ptr, key_bytes, ctypes.byref(info)
+        )
+        if result == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOENT:
+                return None, "Key has no rollups"
+            return None, f"Error reading rollups: errno={errno_val}"
+        return self._rollup_dict(info), None
+    
+    def rollup_list(self) -> Optional[List[dict]]:
+        """
+        List the rollups of all keys that have them.
+        
+        Returns:
+            List of rollup dicts or None on error
+        """
+        if not self._check_store():
+            return None
+        
+        rollups = (KVRollupInfo * KV_ROLLUP_MAX)()
+        count = self.lib.shared_memory_kv_rollup_list(
+            self.store_ptr, rollups, KV_ROLLUP_MAX
+        )
+        if count == -1:
+            return None
+        
+        return [self._rollup_dict(rollups[i]) for i in range(count)]
+    
+    def queue_create(self, name: str) -> Tuple[bool, Optional[str]]:
+        """
+        Create a queue (succeeds if it already exists).
+        
+        Returns:
+            Tuple of (success: bool, error_message: Optional[str])
+        """
+        if not self._check_store():
+            return False, "Store not initialized"
+        
+        name_bytes = name.encode('utf-8')
+        if not name_bytes:
+            return False, "Queue name must not be empty"
+        if len(name_bytes) >= KEY_SIZE:
+            return False, f"Name too long (max {KEY_SIZE-1} bytes)"
+        
+        result = self.lib.shared_memory_kv_queue_create(self.store_ptr,
+                                                        name_bytes)
+        if result == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOSPC:
+                return False, f"Too many queues (max {KV_QUEUE_MAX})"
+            if errno_val == errno.EPERM:
+                return False, "Read-only: another process or thread is the single writer (EPERM)"
+            return False, f"Error creating queue: errno={errno_val}"
+        return True, None
+    
+    def queue_push(self, name: str,
+                   item: Union[str, bytes]) -> Tuple[bool, Optional[str]]:
+        """
+        Push an item to the tail of a queue (never blocks).
+        
+        Args:
+            name: Queue name
+            item: Item (str is stored UTF-8 encoded)
+            
+        Returns:
+            Tuple of (success: bool, error_message: Optional[str])
+        """
+        if not self._check_store():
+            return False, "Store not initialized"
+        
+        name_bytes = name.encode('utf-8')
+        data = item if isinstance(item, bytes) else item.encode('utf-8')
+        if len(name_bytes) >= KEY_SIZE:
+            return False, f"Name too long (max {KEY_SIZE-1} bytes)"
+        if len(data) > KV_QUEUE_ITEM_SIZE:
+            return False, f"Item too long (max {KV_QUEUE_ITEM_SIZE} bytes)"
+        
+        result = self.lib.shared_memory_kv_queue_push(
+            self.store_ptr, name_bytes, data, len(data)
+        )
+        if result == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOENT:
+                return False, "Queue not found"
+            if errno_val == errno.EAGAIN:
+                return False, "Queue is full (EAGAIN)"
+            return False, f"Error pushing item: errno={errno_val}"
+        return True, None
+    
+    def queue_pop(self, name: str,
+                  timeout_ms: int = 0) -> Tuple[Optional[bytes], Optional[str]]:
+        """
+        Pop the item at the head of a queue.
+        
+        The wait sleeps on a futex in C (the GIL is released meanwhile).
+        
+        Args:
+            name: Queue name
+            timeout_ms: Maximum wait (0 = don't wait, -1 = no limit)
+            
+        Returns:
+            Tuple of (item: Optional[bytes], error_message: Optional[str]);
+            (None, None) if the queue stayed empty
+        """
+        if not self._check_store():
+            return None, "Store not initialized"
+        
+        name_bytes = name.encode('utf-8')
+        if len(name_bytes) >= KEY_SIZE:
+            return None, f"Name too long (max {KEY_SIZE-1} bytes)"
+        
+        buffer = ctypes.create_string_buffer(KV_QUEUE_ITEM_SIZE)
+        length = self.lib.shared_memory_kv_queue_pop(
+            self.store_ptr, name_bytes, buffer, KV_QUEUE_ITEM_SIZE, timeout_ms
+        )
+        if length == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val in (errno.EAGAIN, errno.ETIMEDOUT):
+                return None, None
+            if errno_val == errno.ENOENT:
+                return None, "Queue not found"
+            return None, f"Error popping item: errno={errno_val}"
+        return buffer.raw[:length], None
+    
+    def queue_list(self) -> Optional[List[dict]]:
+        """
+        List the queues.
+        
+        Returns:
+            List of queue dicts or None on error
+        """
+        if not self._check_store():
+            return None
+        
+        queues = (KVQueueInfo * KV_QUEUE_MAX)()
+        count = self.lib.shared_memory_kv_queue_list(
+            self.store_ptr, queues, KV_QUEUE_MAX
+        )
+        if count == -1:
+            return None
+        
+        return [
+            {
+                "name": queues[i].name.decode('utf-8'),
+                "length": queues[i].length,
+                "capacity": KV_QUEUE_CAPACITY,
+                "waiters": queues[i].waiters,
+                "pushed": queues[i].pushed,
+                "popped": queues[i].popped,
+                "rejected": queues[i].rejected
+            }
+            for i in range(count)
+        ]
+    
+    def queue_delete(self, name: str) -> Tuple[bool, Optional[str]]:
+        """
+        Delete a queue with its items (blocked consumers get an error).
+        
+        Returns:
+            Tuple of (success: bool, error_message: Optional[str])
+        """
+        if not self._check_store():
+            return False, "Store not initialized"
+        
+        name_bytes = name.encode('utf-8')
+        if len(name_bytes) >= KEY_SIZE:
+            return False, f"Name too long (max {KEY_SIZE-1} bytes)"
+        
+        result = self.lib.shared_memory_kv_queue_delete(self.store_ptr,
+                                                        name_bytes)
+        if result == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOENT:
+                return False, "Queue not found"
+            if errno_val == errno.EPERM:
+                return False, "Read-only: another process or thread is the single writer (EPERM)"
+            return False, f"Error deleting queue: errno={errno_val}"
+        return True, None
+    
+    @staticmethod
+    def _zset_args(name: str,
+                   member: Optional[str] = None) -> Tuple[Optional[tuple],
+                                                          Optional[str]]:
+        """Encode set name and member, checking their lengths"""
+        name_bytes = name.encode('utf-8')
+        if len(name_bytes) >= KEY_SIZE:
+            return None, f"Name too long (max {KEY_SIZE-1} bytes)"
+        if member is None:
+            return (name_bytes,), None
+        member_bytes = member.encode('utf-8')
+        if len(member_bytes) >= KV_ZSET_MEMBER_SIZE:
+            return None, f"Member too long (max {KV_ZSET_MEMBER_SIZE-1} bytes)"
+        return (name_bytes, member_bytes), None
+    
+    @staticmethod
+    def _zset_items(items, count: int) -> List[dict]:
+        """Convert sorted set items to dicts"""
+        return [
+            {
+                "member": items[i].member.decode('utf-8', errors='replace'),
+                "score": items[i].score
+            }
+            for i in range(count)
+        ]
+    
+    def zadd(self, name: str, member: str,
+             score: float) -> Tuple[bool, Optional[str]]:
+        """
+        Add a member to a sorted set or change its score (the set is
+        created on first add).
+        
+        Returns:
+            Tuple of (success: bool, error_message: Optional[str])
+        """
+        if not self._check_store():
+            return False, "Store not initialized"
+        
+        args, error = self._zset_args(name, member)
+        if error:
+            return False, error
+        if not args[0] or not args[1]:
+            return False, "Set name and member must not be empty"
+        if math.isnan(score):
+            return False, "Score must be a number"
+        
+        result = self.lib.shared_memory_kv_zadd(self.store_ptr, *args, score)
+        if result == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOSPC:
+                return False, (f"Store full: max {KV_ZSET_MAX} sets of "
+                               f"{KV_ZSET_CAPACITY} members (ENOSPC)")
+            if errno_val == errno.EPERM:
+                return False, "Read-only: another process or thread is the single writer (EPERM)"
+            return False, f"Error adding member: errno={errno_val}"
+        return True, None
+    
+    def zrem(self, name: str, member: str) -> Tuple[bool, Optional[str]]:
+        """
+        Remove a member from a sorted set.
+        
+        Returns:
+            Tuple of (success: bool, error_message: Optional[str])
+        """
+        if not self._check_store():
+            return False, "Store not initialized"
+        
+        args, error = self._zset_args(name, member)
+        if error:
+            return False, error
+        
+        result = self.lib.shared_memory_kv_zrem(self.store_ptr, *args)
+        if result == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOENT:
+                return False, "Member not found"
+            if errno_val == errno.EPERM:
+                return False, "Read-only: another process or thread is the single writer (EPERM)"
+            return False, f"Error removing member: errno={errno_val}"
+        return True, None
+    
+    def zscore(self, name: str,
+               member: str) -> Tuple[Optional[dict], Optional[str]]:
+        """
+        Get the score and ranks of a member (lock-free).
+        
+        Returns:
+            Tuple of (member: Optional[dict], error_message: Optional[str]);
+            the dict holds score, rank (lowest score first) and
+            reverse_rank (highest score first)
+        """
+        if not self._check_store():
+            return None, "Store not initialized"
+        
+        args, error = self._zset_args(name, member)
+        if error:
+            return None, error
+        
+        score = ctypes.c_double()
+        if self.lib.shared_memory_kv_zscore(self.store_ptr, *args,
+                                            ctypes.byref(score)) == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOENT:
+                return None, "Member not found"
+            return None, f"Error reading member: errno={errno_val}"
+        
+        # Ranks are read separately: a concurrent change between the calls
+        # can make them disagree with the score, or drop the member
+        rank = self.lib.shared_memory_kv_zrank(self.store_ptr, *args, 0)
+        reverse_rank = self.lib.shared_memory_kv_zrank(self.store_ptr, *args, 1)
+        if rank == -1 or reverse_rank == -1:
+            return None, "Member not found"
+        return {
+            "member": member,
+            "score": score.value,
+            "rank": rank,
+            "reverse_rank": reverse_rank
+        }, None
+    
+    def zrange(self, name: str, start: int = 0, limit: int = 10,
+               reverse: bool = False) -> Tuple[Optional[List[dict]],
+                                               Optional[str]]:
+        """
+        Read members by rank (lock-free, O(log n + k)).
+        
+        Args:
+            name: Set name
+            start: First rank
+            limit: Maximum number of members
+            reverse: Count ranks from the highest score (top-K)
+            
+        Returns:
+            Tuple of (members: Optional[list], error_message: Optional[str])
+        """
+        if not self._check_store():
+            return None, "Store not initialized"
+        
+        args, error = self._zset_args(name)
+        if error:
+            return None, error
+        
+        limit = max(0, min(limit, KV_ZSET_CAPACITY))
+        items = (KVZsetItem * KV_ZSET_CAPACITY)()
+        count = self.lib.shared_memory_kv_zrange(
+            self.store_ptr, *args, max(0, start), 1 if reverse else 0,
+            items, limit
+        )
+        if count == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOENT:
+                return None, "Sorted set not found"
+            return None, f"Error reading sorted set: errno={errno_val}"
+        return self._zset_items(items, count), None
+    
+    def zrange_by_score(self, name: str, min_score: float, max_score: float,
+                        limit: int = KV_ZSET_CAPACITY) -> Tuple[Optional[List[dict]],
+                                                                Optional[str]]:
+        """
+        Read the members with min_score <= score <= max_score, lowest first
+        (lock-free, O(log n + k)).
+        
+        Returns:
+            Tuple of (members: Optional[list], error_message: Optional[str])
+        """
+        if not self._check_store():
+            return None, "Store not initialized"
+        
+        args, error = self._zset_args(name)
+        if error:
+            return None, error
+        if math.isnan(min_score) or math.isnan(max_score):
+            return None, "Score bounds must be numbers"
+        
+        limit = max(0, min(limit, KV_ZSET_CAPACITY))
+        items = (KVZsetItem * KV_ZSET_CAPACITY)()
+        count = self.lib.shared_memory_kv_zrange_by_score(
+            self.store_ptr, *args, min_score, max_score, items, limit
+        )
+        if count == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOENT:
+                return None, "Sorted set not found"
+            return None, f"Error reading sorted set: errno={errno_val}"
+        return self._zset_items(items, count), None
+    
+    def zset_list(self) -> Optional[List[dict]]:
+        """
+        List the sorted sets.
+        
+        Returns:
+            List of sorted set dicts or None on error
+        """
+        if not self._check_store():
+            return None
+        
+        zsets = (KVZsetInfo * KV_ZSET_MAX)()
+        count = self.lib.shared_memory_kv_zset_list(
+            self.store_ptr, zsets, KV_ZSET_MAX
+        )
+        if count == -1:
+            return None
+        
+        result = []
+        for i in range(count):
+            empty = zsets[i].count == 0
+            bounds = self._zset_items((zsets[i].min, zsets[i].max), 2)
+            result.append({
+                "name": zsets[i].name.decode('utf-8'),
+                "count": zsets[i].count,
+                "capacity": KV_ZSET_CAPACITY,
+                "min": None if empty else bounds[0],
+                "max": None if empty else bounds[1]
+            })
+        return result
+    
+    def zset_delete(self, name: str) -> Tuple[bool, Optional[str]]:
+        """
+        Delete a sorted set with all its members.
+        
+        Returns:
+            Tuple of (success: bool, error_message: Optional[str])
+        """
+        if not self._check_store():
+            return False, "Store not initialized"
+        
+        args, error = self._zset_args(name)
+        if error:
+            return False, error
+        
+        result = self.lib.shared_memory_kv_zset_delete(self.store_ptr, *args)
+        if result == -1:
+            errno_val = ctypes.get_errno()
+            if errno_val == errno.ENOENT:
+                return False, "Sorted set not found"
+            if errno_val == errno.EPERM:
+                return False, "Read-only: another process or thread is the single writer (EPERM)"
+            return False, f"Error deleting sorted set: errno={errno_val}"
+        return True, None
+    
+    def replication_status(self) -> Optional[dict]:
+        """
+        Get the replication state of the store.
+        
+        A replica store is kept up to date by build/replicator, which
+        reports its progress here; any other store is a primary.
+        
+        Returns:
+            Replication dict or None on error
+        """
+        if not self._check_store():
+            return None
+        
+        status = KVReplicationStatus()
+        if self.lib.shared_memory_kv_replication_status(
+            self.store_ptr, ctypes.byref(status)
+        ) == -1:
+            return None
+        
+        return {
+            "role": ROLE_NAMES[status.role] if status.role < len(ROLE_NAMES) else "unknown",
+            "log_position": self.lib.shared_memory_kv_changelog_position(self.store_ptr),
+            "connected": bool(status.connected),
+            "pid": status.pid,
+            "source": status.source.decode('utf-8', errors='replace'),
+            "applied_position": status.applied_position,
+            "primary_position": status.primary_position,
+            "lag_changes": max(0, status.primary_position - status.applied_position),
+            "lag_ms": status.lag_ms,
+            "last_contact": status.last_contact / 1000.0,
+            "applied_changes": status.applied_changes,
+            "full_syncs": status.full_syncs,
+            "bytes_received": status.bytes_received
+        }
@@ -1,5 +1,7 @@
 #include "shared_memory_kv.h"
 
+#include <poll.h> // poll, struct pollfd
+
 // Global variables for cleanup
 static shared_memory_kv_store_t *g_store = NULL;
 static int g_shm_fd = -1;
@@ -28,22 +30,13 @@ void cleanup(void) {
 }
 
 /**
- * Read and display a single key-value pair
+ * Display a single key-value pair read from a snapshot
  */
-int read_and_display(const char *key) {
-  char value[VALUE_SIZE];
-
-  if (shared_memory_kv_get(g_store, key, value) == 0) {
-    printf("Consumer: Got '%s' = '%s'\n", key, value);
-    return 0;
+void display_item(const kv_snapshot_item_t *item) {
+  if (item->found) {
+    printf("Consumer: Got '%s' = '%s'\n", item->key, item->value);
   } else {
-    if (errno == ENOENT) {
-      printf("Consumer: Key '%s' not found\n", key);
-    } else {
-      fprintf(stderr, "Consumer: Failed to get '%s'\n", key);
-      perror("  Error");
-    }
-    return -1;
+    printf("Consumer: Key '%s' not found\n", item->key);
   }
 }
 
@@ -83,6 +76,29 @@ int main(void) {
   };
   size_t num_keys = sizeof(keys_to_read) / sizeof(keys_to_read[0]);
 
+  // Snapshot request: one item per key (static, values are VALUE_SIZE each)
+  static kv_snapshot_item_t items[sizeof(keys_to_read) /
+                                  sizeof(keys_to_read[0])];
+  for (size_t i = 0; i < num_keys; i++) {
+    strncpy(items[i].key, keys_to_read[i], KEY_SIZE - 1);
+  }
+
+  // Subscribe to the keys read, so the loop sleeps until one of them
+  // changes instead of waking every second (polling if the table is full).
+  // The loop waits on a pollable descriptor, as an event loop would
+  int subscription = shared_memory_kv_subscribe(g_store, keys_to_read,
+                                                num_keys, 0);
+  int notify_fd = -1;
+  if (subscription == -1) {
+    perror("Consumer: Subscribe failed, polling instead");
+  } else {
+    notify_fd = shared_memory_kv_notify_fd(g_store, subscription);
+    if (notify_fd == -1) {
+      perror("Consumer: Notification descriptor failed, polling instead");
+    }
+  }
+  unsigned int events = 0;
+
   printf("Consumer: Reading key-value pairs...\n");
   printf("Consumer: Press Ctrl+C to exit\n\n");
 
@@ -91,20 +107,46 @@ int main(void) {
   while (g_running) {
     // Check if data has changed (version tracking)
     if (g_store->version != last_version) {
+      // Read all keys as of a single version, so a producer update in the
+      // middle of the loop cannot mix old and new values
+      unsigned int snapshot_version;
+      if (shared_memory_kv_snapshot_get(g_store, items, num_keys,
+                                        &snapshot_version) == -1) {
+        perror("Consumer: Snapshot read failed");
+        sleep(1);
+        continue;
+      }
+
       printf("\n--- Store updated (version %u -> %u) ---\n", last_version,
-             g_store->version);
-      last_version = g_store->version;
+             snapshot_version);
+      last_version = snapshot_version;
 
-      // Read all keys
       for (size_t i = 0; i < num_keys; i++) {
-        read_and_display(keys_to_read[i]);
+        display_item(&items[i]);
       }
 
       printf("\nConsumer: Waiting for updates... (version: %u, entries: %u)\n",
              g_store->version, g_store->entry_count);
     }
 
-    sleep(1); // Sleep for 1 second before checking again
+    shared_memory_kv_heartbeat(g_store); // Still attached and alive
+
+    // Wait up to 1 second for a change of the keys (heartbeat interval)
+    if (notify_fd == -1) {
+      sleep(1);
+      continue;
+    }
+    struct pollfd pending = {.fd = notify_fd, .events = POLLIN};
+    if (poll(&pending, 1, 1000) > 0) {
+      shared_memory_kv_notify_read(g_store, subscription, notify_fd, &events);
+    }
+  }
+
+  if (subscription != -1) {
+    shared_memory_kv_unsubscribe(g_store, subscription);
+  }
+  if (notify_fd != -1) {
+    close(notify_fd);
   }
 
   printf("Consumer: Exiting...\n");
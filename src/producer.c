@@ -1,5 +1,43 @@
 #include "shared_memory_kv.h"
 
+#include <sys/statvfs.h> // statvfs
+
+// Slots examined per compaction step in the idle loop
+#define COMPACT_STEP_SLOTS 64
+
+// Collector mode (--collect): sampling interval bounds and default, in ms
+#define COLLECT_MIN_INTERVAL_MS 10
+#define COLLECT_MAX_INTERVAL_MS 60000
+#define COLLECT_DEFAULT_INTERVAL_MS 1000
+
+// Seconds between progress lines in collector mode
+#define COLLECT_REPORT_SECONDS 10
+
+// Size of the buffer one /proc file is read into (parsed in place)
+#define PROC_BUFFER_SIZE 16384
+
+// Number of metrics published per collector sample
+#define METRIC_COUNT 8
+
+/**
+ * One sample of the collected system metrics
+ */
+typedef struct {
+  double cpu_usage;          // Percent of CPU time busy since last sample
+  double memory_usage;       // Percent of MemTotal not available
+  double disk_usage;         // Percent of the root filesystem used
+  double load_avg;           // 1-minute load average
+  double uptime;             // Seconds since boot
+  double process_count;      // Processes and threads (from loadavg)
+  unsigned long long network_rx; // Bytes received, all interfaces but lo
+  unsigned long long network_tx; // Bytes sent, all interfaces but lo
+} metrics_t;
+
+// Keys of the collected metrics, in the order publish_metrics() writes them
+static const char *const g_metric_keys[METRIC_COUNT] = {
+    "cpu_usage", "memory_usage", "disk_usage", "load_avg",
+    "uptime",    "process_count", "network_rx", "network_tx"};
+
 // Global variables for cleanup
 static shared_memory_kv_store_t *g_store = NULL;
 static int g_shm_fd = -1;
@@ -20,20 +58,416 @@ void signal_handler(int sig) {
  * Cleanup function to release shared memory resources
  */
 void cleanup(void) {
-  if (g_store != NULL) {
-    shared_memory_kv_destroy(g_shm_fd, g_store);
-    g_store = NULL;
+  if (g_store == NULL) {
+    return;
   }
 
-  // Unlink shared memory object (only producer should do this)
-  if (shared_memory_kv_unlink() == -1) {
-    perror("Failed to unlink shared memory");
-  } else {
+  // Unlink shared memory object (only producer should do this), unless a
+  // consumer is still attached: it keeps the store and the next producer
+  // run starts over anyway. Processes that crashed attached are reaped
+  // first and don't block the unlink
+  if (shared_memory_kv_unlink_safe(g_store) == 0) {
     printf("Shared memory object unlinked\n");
+  } else if (errno == EBUSY) {
+    kv_process_info_t processes[KV_REGISTRY_SIZE];
+    int count = shared_memory_kv_processes(g_store, processes,
+                                           KV_REGISTRY_SIZE);
+    printf("Shared memory object kept, still attached:");
+    for (int i = 0; i < count; i++) {
+      if (processes[i].pid != (int)getpid()) {
+        printf(" %d", processes[i].pid);
+      }
+    }
+    printf("\n");
+  } else {
+    perror("Failed to unlink shared memory");
+  }
+
+  shared_memory_kv_destroy(g_shm_fd, g_store);
+  g_store = NULL;
+}
+
+/* ========================================================================
+ * METRICS COLLECTOR
+ * ======================================================================== */
+
+/**
+ * Read a whole /proc file into a caller buffer
+ *
+ * /proc files report a size of 0, so the file is read until EOF (or until
+ * the buffer is full) instead of by its size. The buffer is NUL-terminated.
+ * No memory is allocated: open/read/close only, no stdio.
+ *
+ * @param path Path of the file
+ * @param buffer Destination buffer
+ * @param size Buffer size in bytes (including the terminator)
+ * @return Bytes read on success, -1 on error (errno set)
+ */
+static ssize_t read_proc_file(const char *path, char *buffer, size_t size) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return -1;
+  }
+
+  size_t length = 0;
+  while (length < size - 1) {
+    ssize_t n = read(fd, buffer + length, size - 1 - length);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    if (n == -1) {
+      int saved_errno = errno;
+      close(fd);
+      errno = saved_errno;
+      return -1;
+    }
+    if (n == 0) {
+      break;
+    }
+    length += (size_t)n;
+  }
+
+  close(fd);
+  buffer[length] = '\0';
+  return (ssize_t)length;
+}
+
+/**
+ * Parse the value of a "Name:   value kB" line of /proc/meminfo
+ *
+ * @return The value, or 0 if the field is missing
+ */
+static unsigned long long meminfo_field(const char *buffer, const char *name) {
+  const char *line = strstr(buffer, name);
+  if (line == NULL) {
+    return 0;
+  }
+  return strtoull(line + strlen(name), NULL, 10);
+}
+
+/**
+ * Sample CPU usage from the aggregate "cpu" line of /proc/stat
+ *
+ * The line holds cumulative jiffies (user nice system idle iowait irq
+ * softirq steal); usage is the busy share of the delta since the previous
+ * call, so the first call reports usage since boot.
+ */
+static void collect_cpu(char *buffer, metrics_t *metrics) {
+  static unsigned long long prev_total, prev_idle;
+
+  if (read_proc_file("/proc/stat", buffer, PROC_BUFFER_SIZE) == -1 ||
+      strncmp(buffer, "cpu ", 4) != 0) {
+    return;
+  }
+
+  // Step 1: Sum the first eight counters; idle time includes iowait
+  unsigned long long total = 0, idle = 0;
+  char *cursor = buffer + 4;
+  for (int i = 0; i < 8; i++) {
+    unsigned long long value = strtoull(cursor, &cursor, 10);
+    total += value;
+    if (i == 3 || i == 4) {
+      idle += value;
+    }
+  }
+
+  // Step 2: Busy share of the elapsed jiffies (none elapsed: keep the
+  // previous reading, common at intervals below one jiffy)
+  if (total > prev_total) {
+    unsigned long long elapsed = total - prev_total;
+    unsigned long long idled = idle - prev_idle;
+    metrics->cpu_usage =
+        100.0 * (double)(elapsed - (idled < elapsed ? idled : elapsed)) /
+        (double)elapsed;
+  }
+  prev_total = total;
+  prev_idle = idle;
+}
+
+/**
+ * Sample memory usage from /proc/meminfo (MemAvailable over MemTotal)
+ */
+static void collect_memory(char *buffer, metrics_t *metrics) {
+  if (read_proc_file("/proc/meminfo", buffer, PROC_BUFFER_SIZE) == -1) {
+    return;
+  }
+
+  unsigned long long total = meminfo_field(buffer, "MemTotal:");
+  unsigned long long available = meminfo_field(buffer, "MemAvailable:");
+  if (total > 0 && available <= total) {
+    metrics->memory_usage =
+        100.0 * (double)(total - available) / (double)total;
   }
 }
 
-int main(void) {
+/**
+ * Sample network byte counters from /proc/net/dev
+ *
+ * After two header lines every line is "iface: rx_bytes rx_packets ...
+ * (8 receive fields) tx_bytes ...". Counters of all interfaces except the
+ * loopback are summed.
+ */
+static void collect_network(char *buffer, metrics_t *metrics) {
+  if (read_proc_file("/proc/net/dev", buffer, PROC_BUFFER_SIZE) == -1) {
+    return;
+  }
+
+  // Step 1: Skip the two header lines
+  char *line = buffer;
+  for (int i = 0; i < 2 && line != NULL; i++) {
+    line = strchr(line, '\n');
+    line = line != NULL ? line + 1 : NULL;
+  }
+
+  // Step 2: Sum receive (field 1) and transmit (field 9) bytes
+  unsigned long long rx = 0, tx = 0;
+  while (line != NULL && *line != '\0') {
+    char *colon = strchr(line, ':');
+    char *end = strchr(line, '\n');
+    if (colon == NULL || (end != NULL && colon > end)) {
+      break;
+    }
+
+    char *name = line;
+    while (*name == ' ') {
+      name++;
+    }
+    if (!(colon - name == 2 && strncmp(name, "lo", 2) == 0)) {
+      char *cursor = colon + 1;
+      rx += strtoull(cursor, &cursor, 10);
+      for (int i = 0; i < 7; i++) {
+        strtoull(cursor, &cursor, 10);
+      }
+      tx += strtoull(cursor, &cursor, 10);
+    }
+    line = end != NULL ? end + 1 : NULL;
+  }
+
+  metrics->network_rx = rx;
+  metrics->network_tx = tx;
+}
+
+/**
+ * Sample load average and process count from /proc/loadavg
+ *
+ * Format: "0.37 0.44 0.58 2/71 14967" (1/5/15-minute load, running/total
+ * scheduling entities, last pid).
+ */
+static void collect_loadavg(char *buffer, metrics_t *metrics) {
+  if (read_proc_file("/proc/loadavg", buffer, PROC_BUFFER_SIZE) == -1) {
+    return;
+  }
+
+  metrics->load_avg = strtod(buffer, NULL);
+  char *slash = strchr(buffer, '/');
+  if (slash != NULL) {
+    metrics->process_count = (double)strtoul(slash + 1, NULL, 10);
+  }
+}
+
+/**
+ * Sample uptime (/proc/uptime) and root filesystem usage (statvfs)
+ */
+static void collect_system(char *buffer, metrics_t *metrics) {
+  if (read_proc_file("/proc/uptime", buffer, PROC_BUFFER_SIZE) != -1) {
+    metrics->uptime = (double)(unsigned long long)strtod(buffer, NULL);
+  }
+
+  struct statvfs fs;
+  if (statvfs("/", &fs) == 0 && fs.f_blocks > 0) {
+    metrics->disk_usage = 100.0 * (double)(fs.f_blocks - fs.f_bfree) /
+                          (double)(fs.f_blocks - fs.f_bfree + fs.f_bavail);
+  }
+}
+
+/**
+ * Take one sample of all metrics
+ *
+ * A metric whose source can't be read keeps its previous value. All parsing
+ * happens in one static buffer: no allocation per sample.
+ */
+static void collect_metrics(metrics_t *metrics) {
+  static char buffer[PROC_BUFFER_SIZE];
+
+  collect_cpu(buffer, metrics);
+  collect_memory(buffer, metrics);
+  collect_network(buffer, metrics);
+  collect_loadavg(buffer, metrics);
+  collect_system(buffer, metrics);
+}
+
+/**
+ * Publish one sample: all keys in one transaction, then the time series
+ *
+ * The transaction makes the sample atomic for readers (they never see
+ * cpu_usage of one sample next to memory_usage of another) and costs one
+ * lock acquisition and one version bump instead of eight. Values are
+ * stored as native int64/double, so readers of the numbers skip parsing.
+ * Each metric is also appended to its time series with the same timestamp.
+ *
+ * @return 0 on success, -1 on error (errno set by the failing call)
+ */
+static int publish_metrics(const metrics_t *metrics) {
+  static shared_memory_kv_txn_t txn; // Large (buffered values): static
+  double samples[METRIC_COUNT] = {
+      metrics->cpu_usage,          metrics->memory_usage,
+      metrics->disk_usage,         metrics->load_avg,
+      metrics->uptime,             metrics->process_count,
+      (double)metrics->network_rx, (double)metrics->network_tx};
+
+  // Step 1: Write all keys in one transaction, as native numbers:
+  // percentages and load average as doubles, the rest as integers
+  if (shared_memory_kv_txn_begin(g_store, &txn) == -1) {
+    return -1;
+  }
+  for (int i = 0; i < METRIC_COUNT; i++) {
+    int result;
+    if (i < 4) {
+      // Rounded to two decimals (values are non-negative) so text
+      // readers get short values
+      double rounded = (double)(long long)(samples[i] * 100 + 0.5) / 100;
+      result =
+          shared_memory_kv_txn_set_double(&txn, g_metric_keys[i], rounded);
+    } else if (i < 6) {
+      result = shared_memory_kv_txn_set_int64(&txn, g_metric_keys[i],
+                                              (long long)samples[i]);
+    } else {
+      unsigned long long counter =
+          i == 6 ? metrics->network_rx : metrics->network_tx;
+      result = shared_memory_kv_txn_set_int64(&txn, g_metric_keys[i],
+                                              (long long)counter);
+    }
+    if (result == -1) {
+      int saved_errno = errno;
+      shared_memory_kv_txn_abort(&txn);
+      errno = saved_errno;
+      return -1;
+    }
+  }
+  if (shared_memory_kv_txn_commit(&txn) == -1) {
+    return -1;
+  }
+
+  // Step 2: Append to the time series (a wall clock step backwards makes
+  // the append fail with EINVAL; the sample is then only in the store)
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  long long timestamp =
+      (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+  for (int i = 0; i < METRIC_COUNT; i++) {
+    shared_memory_kv_ts_append(g_store, g_metric_keys[i], timestamp,
+                               samples[i]);
+  }
+  return 0;
+}
+
+/**
+ * Collector loop: sample and publish every interval until SIGINT
+ *
+ * Ticks are scheduled on absolute CLOCK_MONOTONIC deadlines, so the time
+ * spent collecting doesn't accumulate as drift. A producer that falls more
+ * than one interval behind skips the missed ticks instead of bursting.
+ * Heartbeat and incremental compaction run once per second. Rollups of all
+ * metrics are enabled first.
+ *
+ * @param interval_ms Sampling interval in milliseconds
+ */
+static void run_collector(long interval_ms) {
+  metrics_t metrics;
+  memset(&metrics, 0, sizeof(metrics));
+  unsigned long long published = 0, failed = 0, reported = 0;
+  time_t last_maintenance = 0, last_report = time(NULL);
+
+  // Rollups of every metric: dashboards read 1s/10s/1m aggregates instead
+  // of walking the raw samples
+  for (int i = 0; i < METRIC_COUNT; i++) {
+    if (shared_memory_kv_rollup_enable(g_store, g_metric_keys[i],
+                                       KV_ROLLUP_ALL) == -1) {
+      perror("Producer: Failed to enable rollups");
+    }
+  }
+
+  struct timespec next;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+
+  while (g_running) {
+    // Step 1: Sample and publish
+    collect_metrics(&metrics);
+    if (publish_metrics(&metrics) == 0) {
+      published++;
+    } else if (failed++ == 0) {
+      perror("Producer: Failed to publish metrics");
+    }
+
+    // Step 2: Once per second: heartbeat, compaction, progress report
+    time_t now = time(NULL);
+    if (now != last_maintenance) {
+      last_maintenance = now;
+      shared_memory_kv_heartbeat(g_store);
+      shared_memory_kv_compact_step(g_store, COMPACT_STEP_SLOTS);
+    }
+    if (now - last_report >= COLLECT_REPORT_SECONDS) {
+      printf("Producer: %llu samples (%.1f/s), %llu failed; cpu %.1f%%, "
+             "mem %.1f%%, load %.2f\n",
+             published,
+             (double)(published - reported) / (double)(now - last_report),
+             failed, metrics.cpu_usage, metrics.memory_usage,
+             metrics.load_avg);
+      reported = published;
+      last_report = now;
+    }
+
+    // Step 3: Sleep until the next tick
+    next.tv_nsec += (interval_ms % 1000) * 1000000;
+    next.tv_sec += interval_ms / 1000 + next.tv_nsec / 1000000000;
+    next.tv_nsec %= 1000000000;
+
+    struct timespec current;
+    clock_gettime(CLOCK_MONOTONIC, &current);
+    long long behind_ms = (current.tv_sec - next.tv_sec) * 1000LL +
+                          (current.tv_nsec - next.tv_nsec) / 1000000;
+    if (behind_ms > interval_ms) {
+      next = current; // Far behind (suspend, stall): skip missed ticks
+    }
+    // EINTR (SIGINT) ends the sleep early; the loop condition then exits
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+  }
+
+  printf("Producer: %llu samples published, %llu failed\n", published,
+         failed);
+}
+
+int main(int argc, char *argv[]) {
+  // --single-writer: this process stays the only writer, so its sets skip
+  // the semaphore (other clients can then only read)
+  // --collect: sample real metrics from /proc instead of writing the demo
+  // values once; --interval MS sets the sampling rate (implies --collect)
+  unsigned int single_writer = 0;
+  long interval_ms = 0; // 0: demo mode
+  for (int i = 1; i < argc; i++) {
+    char *end = NULL;
+    if (strcmp(argv[i], "--single-writer") == 0) {
+      single_writer = KV_FLAG_SINGLE_WRITER;
+    } else if (strcmp(argv[i], "--collect") == 0) {
+      if (interval_ms == 0) {
+        interval_ms = COLLECT_DEFAULT_INTERVAL_MS;
+      }
+    } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc &&
+               (interval_ms = strtol(argv[++i], &end, 10)) >=
+                   COLLECT_MIN_INTERVAL_MS &&
+               interval_ms <= COLLECT_MAX_INTERVAL_MS && *end == '\0') {
+      continue;
+    } else {
+      fprintf(stderr,
+              "Usage: %s [--single-writer] [--collect] [--interval MS]\n"
+              "  --interval MS  sampling interval in collector mode "
+              "(%d..%d ms, default %d)\n",
+              argv[0], COLLECT_MIN_INTERVAL_MS, COLLECT_MAX_INTERVAL_MS,
+              COLLECT_DEFAULT_INTERVAL_MS);
+      return EXIT_FAILURE;
+    }
+  }
+
   // Clean up any existing shared memory object from previous runs
   // This allows producer to restart without errors if previous run didn't cleanup properly
   shared_memory_kv_unlink(); // Ignore errors (object might not exist)
@@ -53,13 +487,30 @@ int main(void) {
   printf("Producer: Creating shared memory KV store...\n");
 
   // Step 1: Create shared memory object
-  g_store = shared_memory_kv_create(&g_shm_fd);
+  // Metric keys share "system." / "cpu." prefixes and values repeat often,
+  // so both prefix sharing and value deduplication pay off here; large
+  // values written by other clients (JSON documents) are compressed
+  g_store = shared_memory_kv_create_ex(
+      &g_shm_fd, KV_FLAG_DEDUP_VALUES | KV_FLAG_PREFIX_KEYS |
+                     KV_FLAG_COMPRESS_VALUES | single_writer);
   if (g_store == NULL) {
     fprintf(stderr, "Failed to create shared memory object\n");
     return EXIT_FAILURE;
   }
 
-  printf("Producer: Shared memory created successfully\n");
+  printf("Producer: Shared memory created successfully%s\n",
+         single_writer ? " (single-writer mode)" : "");
+
+  // Collector mode: publish real samples until SIGINT
+  if (interval_ms > 0) {
+    printf("Producer: Collecting metrics from /proc every %ld ms\n",
+           interval_ms);
+    printf("Producer: Press Ctrl+C to exit\n\n");
+    run_collector(interval_ms);
+    printf("Producer: Exiting...\n");
+    return EXIT_SUCCESS;
+  }
+
   printf("Producer: Writing key-value pairs...\n\n");
 
   // Step 2: Write system metrics to the store
@@ -71,8 +522,6 @@ int main(void) {
       {"cpu_usage", "45.2"},
       {"memory_usage", "67.8"},
       {"disk_usage", "23.5"},
-      {"network_rx", "1024"},
-      {"network_tx", "2048"},
       {"uptime", "86400"},
       {"process_count", "127"},
       {"load_avg", "1.25"},
@@ -80,11 +529,15 @@ int main(void) {
 
   size_t num_pairs = sizeof(test_data) / sizeof(test_data[0]);
 
+  // Each value also becomes a sample of the metric's time series, so the
+  // history survives the next set
   for (size_t i = 0; i < num_pairs; i++) {
     if (shared_memory_kv_set(g_store, test_data[i].key, test_data[i].value) ==
         0) {
       printf("Producer: Set '%s' = '%s'\n", test_data[i].key,
              test_data[i].value);
+      shared_memory_kv_ts_append(g_store, test_data[i].key, 0,
+                                 strtod(test_data[i].value, NULL));
     } else {
       fprintf(stderr, "Producer: Failed to set '%s' = '%s'\n",
               test_data[i].key, test_data[i].value);
@@ -92,14 +545,34 @@ int main(void) {
     }
   }
 
+  // Step 3: Write counters that are sampled together in one transaction
+  // Consumers never observe network_rx from one sample and network_tx from
+  // another. The transaction is large (buffered values), so it is static
+  static shared_memory_kv_txn_t txn;
+  if (shared_memory_kv_txn_begin(g_store, &txn) == 0 &&
+      shared_memory_kv_txn_set(&txn, "network_rx", "1024") == 0 &&
+      shared_memory_kv_txn_set(&txn, "network_tx", "2048") == 0 &&
+      shared_memory_kv_txn_commit(&txn) == 0) {
+    printf("Producer: Set 'network_rx' = '1024', 'network_tx' = '2048' "
+           "(one transaction)\n");
+  } else {
+    perror("Producer: Failed to commit network counters");
+    shared_memory_kv_txn_abort(&txn);
+  }
+
   printf("\nProducer: All pairs written. Store version: %u, Entry count: %u\n",
          g_store->version, g_store->entry_count);
   printf("Producer: Waiting for consumer to read data...\n");
   printf("Producer: Press Ctrl+C to exit\n\n");
 
-  // Step 3: Keep running until SIGINT is received
+  // Step 4: Keep running until SIGINT is received
   // This allows consumer to read the data
+  // Idle time is used for incremental compaction: each step examines a few
+  // slots under the lock, so readers are never paused for a full pass.
+  // The heartbeat marks this process alive in the store registry
   while (g_running) {
+    shared_memory_kv_heartbeat(g_store);
+    shared_memory_kv_compact_step(g_store, COMPACT_STEP_SLOTS);
     sleep(1); // Sleep for 1 second
   }
 
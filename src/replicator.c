@@ -0,0 +1,765 @@
+#include "shared_memory_kv.h"
+
+#include <netdb.h>       // getaddrinfo, freeaddrinfo
+#include <netinet/in.h>  // IPPROTO_TCP
+#include <netinet/tcp.h> // TCP_NODELAY
+#include <poll.h>        // poll, struct pollfd
+
+// Name of the replica store unless --store is given
+#define REPLICA_SHM_NAME "/gitflow_kv_replica"
+
+// Stream framing: every message starts with a repl_header_t carrying this
+// magic. Both ends must share the byte order (same build on both hosts)
+#define REPL_MAGIC 0x4B565231 // "KVR1"
+
+// Message types (repl_header_t.type)
+#define MSG_SNAPSHOT_BEGIN 1 // A full copy of the table follows
+#define MSG_ENTRY 2          // Entry of the full copy: key and value
+#define MSG_SNAPSHOT_END 3   // End of the copy; position: log position the
+                             // copy is current to
+#define MSG_SET 4            // Logged set: key and value at send time
+#define MSG_DELETE 5         // Logged delete (or set of a key gone since)
+#define MSG_HEARTBEAT 6      // Nothing new; head: primary log head
+
+// Logged changes read per batch, and stream buffer size
+#define CHANGE_BATCH 64
+#define STREAM_BUFFER_SIZE 65536
+
+// Primary: idle wait for changes before sending a heartbeat (ms)
+#define HEARTBEAT_INTERVAL_MS 1000
+// Replica: silence after which the connection counts as dead (ms)
+#define STREAM_TIMEOUT_MS 5000
+// Replica: pause between connection attempts (seconds)
+#define RECONNECT_SECONDS 1
+// Pending connections of the primary's listening socket
+#define LISTEN_BACKLOG 8
+
+/**
+ * Header of a stream message, followed by key_length key bytes and
+ * value_length value bytes
+ */
+typedef struct {
+  unsigned int magic;          // REPL_MAGIC
+  unsigned int type;           // MSG_*
+  unsigned long long position; // Log position of the change (SET, DELETE)
+                               // or of the copy (SNAPSHOT_END)
+  unsigned long long head;     // Primary log head when sent
+  long long timestamp;         // Change time (SET, DELETE), send time
+                               // (HEARTBEAT); ms since the Unix epoch
+  unsigned int value_type;     // KV_TYPE_* (ENTRY, SET)
+  unsigned int key_length;     // Key bytes, < KEY_SIZE
+  unsigned int value_length;   // Value bytes, < VALUE_SIZE
+  unsigned int reserved;
+} repl_header_t;
+
+// Global variables for cleanup
+static shared_memory_kv_store_t *g_store = NULL;
+static int g_shm_fd = -1;
+static int g_is_replica = 0;
+static const char *g_store_name = NULL;
+static volatile int g_running = 1; // Flag to control main loop
+
+// Outgoing stream buffer (primary side)
+static char g_out[STREAM_BUFFER_SIZE];
+static size_t g_out_length = 0;
+
+/**
+ * Signal handler for SIGINT (Ctrl+C)
+ *
+ * Sets the running flag to 0 to exit the main loop gracefully
+ */
+void signal_handler(int sig) {
+  (void)sig; // Suppress unused parameter warning
+  g_running = 0;
+}
+
+/**
+ * Cleanup function to release shared memory resources
+ *
+ * The replica store belongs to this process: it is unlinked unless a tool
+ * is still attached to it.
+ */
+void cleanup(void) {
+  if (g_store == NULL) {
+    return;
+  }
+  if (g_is_replica) {
+    kv_replication_status_t status;
+    shared_memory_kv_replication_status(g_store, &status);
+    status.connected = 0;
+    status.pid = 0;
+    shared_memory_kv_replication_report(g_store, &status);
+    if (shared_memory_kv_unlink_safe(g_store) == 0) {
+      printf("Replica: Store %s unlinked\n", g_store_name);
+    }
+  }
+  shared_memory_kv_destroy(g_shm_fd, g_store);
+  g_store = NULL;
+}
+
+/**
+ * Current time in milliseconds since the Unix epoch
+ */
+static long long now_ms(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// ============================================================================
+// SOCKETS
+// ============================================================================
+
+/**
+ * Splits an address into a unix socket path or a TCP host and port
+ *
+ * Anything containing "/" is a socket path; otherwise "host:port" or just
+ * "port" (all interfaces when serving, localhost when connecting).
+ *
+ * @return 1 for a unix socket, 0 for TCP (host_out may be empty), -1 if
+ *         invalid
+ */
+static int parse_address(const char *address, char *host_out,
+                         size_t host_size, const char **port_out) {
+  if (strchr(address, '/') != NULL) {
+    return strlen(address) < sizeof(((struct sockaddr_un *)0)->sun_path)
+               ? 1
+               : -1;
+  }
+  const char *colon = strrchr(address, ':');
+  const char *port = colon != NULL ? colon + 1 : address;
+  size_t host_length = colon != NULL ? (size_t)(colon - address) : 0;
+  if (*port == '\0' || host_length >= host_size) {
+    return -1;
+  }
+  memcpy(host_out, address, host_length);
+  host_out[host_length] = '\0';
+  *port_out = port;
+  return 0;
+}
+
+/**
+ * Opens a listening socket (primary) or connects to one (replica)
+ *
+ * @return Socket descriptor, or -1 on error
+ */
+static int open_socket(const char *address, int listening) {
+  char host[256];
+  const char *port = NULL;
+  int kind = parse_address(address, host, sizeof(host), &port);
+  if (kind == -1) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 1: Unix socket (a stale socket file of a previous run is replaced)
+  if (kind == 1) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, address, strlen(address) + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+      return -1;
+    }
+    if (listening) {
+      unlink(address);
+      if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+          listen(fd, LISTEN_BACKLOG) == -1) {
+        close(fd);
+        return -1;
+      }
+    } else if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  // Step 2: TCP, trying each address the name resolves to
+  struct addrinfo hints;
+  struct addrinfo *addresses = NULL;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = listening ? AI_PASSIVE : 0;
+  if (getaddrinfo(host[0] != '\0' ? host : NULL, port, &hints, &addresses) !=
+      0) {
+    errno = EINVAL;
+    return -1;
+  }
+  int fd = -1;
+  for (struct addrinfo *ai = addresses; ai != NULL && fd == -1;
+       ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd == -1) {
+      continue;
+    }
+    int one = 1;
+    if (listening) {
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+      if (bind(fd, ai->ai_addr, ai->ai_addrlen) == -1 ||
+          listen(fd, LISTEN_BACKLOG) == -1) {
+        close(fd);
+        fd = -1;
+      }
+    } else if (connect(fd, ai->ai_addr, ai->ai_addrlen) == -1) {
+      close(fd);
+      fd = -1;
+    } else {
+      // Changes are small messages: don't hold them back for coalescing
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+  }
+  freeaddrinfo(addresses);
+  return fd;
+}
+
+// ============================================================================
+// PRIMARY: full copy, then change log tailing
+// ============================================================================
+
+/**
+ * Sends the buffered messages
+ *
+ * @return 0 on success, -1 if the replica is gone
+ */
+static int flush_stream(int fd) {
+  size_t sent = 0;
+  while (sent < g_out_length) {
+    ssize_t n = send(fd, g_out + sent, g_out_length - sent, MSG_NOSIGNAL);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return -1;
+    }
+    sent += (size_t)n;
+  }
+  g_out_length = 0;
+  return 0;
+}
+
+/**
+ * Appends a message to the stream buffer, flushing it when full
+ *
+ * @param value Value to send (ENTRY, SET), or NULL
+ * @return 0 on success, -1 if the replica is gone
+ */
+static int send_message(int fd, unsigned int type,
+                        unsigned long long position, long long timestamp,
+                        const char *key, const kv_value_t *value) {
+  repl_header_t header;
+  memset(&header, 0, sizeof(header));
+  header.magic = REPL_MAGIC;
+  header.type = type;
+  header.position = position;
+  header.head = shared_memory_kv_changelog_position(g_store);
+  header.timestamp = timestamp;
+
+  // Numbers travel natively, text without its '\0'
+  const void *data = NULL;
+  if (key != NULL) {
+    header.key_length = (unsigned int)strnlen(key, KEY_SIZE - 1);
+  }
+  if (value != NULL) {
+    header.value_type = value->type;
+    switch (value->type) {
+    case KV_TYPE_INT64:
+      data = &value->int64;
+      header.value_length = sizeof(value->int64);
+      break;
+    case KV_TYPE_DOUBLE:
+      data = &value->number;
+      header.value_length = sizeof(value->number);
+      break;
+    case KV_TYPE_STRING:
+      data = value->data;
+      header.value_length = (unsigned int)strnlen(value->data, VALUE_SIZE);
+      break;
+    default:
+      data = value->data;
+      header.value_length = value->length;
+      break;
+    }
+  }
+
+  size_t length = sizeof(header) + header.key_length + header.value_length;
+  if (g_out_length + length > sizeof(g_out) && flush_stream(fd) == -1) {
+    return -1;
+  }
+  memcpy(g_out + g_out_length, &header, sizeof(header));
+  memcpy(g_out + g_out_length + sizeof(header), key, header.key_length);
+  if (header.value_length > 0) {
+    memcpy(g_out + g_out_length + sizeof(header) + header.key_length, data,
+           header.value_length);
+  }
+  g_out_length += length;
+  return 0;
+}
+
+/**
+ * Sends a full copy of the table
+ *
+ * The log head is read before the copy: replaying the log from there
+ * resends every change the copy may have missed.
+ *
+ * @param position_out Pointer to return the log position to tail from
+ * @return 0 on success, -1 if the replica is gone
+ */
+static int send_full_copy(int fd, unsigned long long *position_out) {
+  static kv_entry_t entries[MAX_ENTRIES];
+  static kv_value_t value;
+
+  unsigned long long position = shared_memory_kv_changelog_position(g_store);
+  int count = shared_memory_kv_snapshot_table(g_store, entries, NULL);
+  if (count == -1) {
+    perror("Primary: Table copy failed");
+    return -1;
+  }
+  if (send_message(fd, MSG_SNAPSHOT_BEGIN, 0, 0, NULL, NULL) == -1) {
+    return -1;
+  }
+  for (int i = 0; i < count; i++) {
+    // Values are read natively; a key deleted since is covered by the log
+    if (shared_memory_kv_get_value(g_store, entries[i].key, &value) == 0 &&
+        send_message(fd, MSG_ENTRY, 0, 0, entries[i].key, &value) == -1) {
+      return -1;
+    }
+  }
+  if (send_message(fd, MSG_SNAPSHOT_END, position, 0, NULL, NULL) == -1 ||
+      flush_stream(fd) == -1) {
+    return -1;
+  }
+  *position_out = position;
+  return 0;
+}
+
+/**
+ * Streams the store to one replica until it disconnects
+ */
+static void serve_replica(int fd) {
+  static kv_change_t changes[CHANGE_BATCH];
+  static kv_value_t value;
+  unsigned long long position;
+
+  // Step 1: Full copy
+  if (send_full_copy(fd, &position) == -1) {
+    return;
+  }
+  printf("Primary: Replica %d synced at log position %llu\n", (int)getpid(),
+         position);
+
+  while (g_running) {
+    // Step 2: Forward logged changes with the keys' current values, each
+    // key once per batch
+    int count = shared_memory_kv_changelog_read(g_store, &position, changes,
+                                                CHANGE_BATCH);
+    if (count == -1 && errno == ERANGE) {
+      printf("Primary: Replica %d fell behind the change log, copying the "
+             "table again\n",
+             (int)getpid());
+      if (send_full_copy(fd, &position) == -1) {
+        return;
+      }
+      continue;
+    }
+    if (count == -1) {
+      perror("Primary: Change log read failed");
+      return;
+    }
+    for (int i = 0; i < count; i++) {
+      const kv_change_t *change = &changes[i];
+      // A key logged again later in the batch is sent once, with the
+      // position of its last record: the replica's position still moves
+      // past every record of the batch
+      int repeated = 0;
+      for (int j = i + 1; j < count && !repeated; j++) {
+        repeated = strncmp(changes[j].key, change->key, KEY_SIZE) == 0;
+      }
+      if (repeated) {
+        continue;
+      }
+      int found = change->op == KV_CHANGE_SET &&
+                  shared_memory_kv_get_value(g_store, change->key, &value) ==
+                      0;
+      if (send_message(fd, found ? MSG_SET : MSG_DELETE, change->position,
+                       change->timestamp, change->key,
+                       found ? &value : NULL) == -1) {
+        return;
+      }
+    }
+    if (count == CHANGE_BATCH) {
+      continue; // More may be waiting: send them before flushing
+    }
+    if (flush_stream(fd) == -1) {
+      return;
+    }
+
+    // Step 3: Sleep until the next change; heartbeat when none comes
+    shared_memory_kv_heartbeat(g_store);
+    if (shared_memory_kv_changelog_wait(g_store, position,
+                                        HEARTBEAT_INTERVAL_MS) == -1 &&
+        errno != EINTR) {
+      if (send_message(fd, MSG_HEARTBEAT, position, now_ms(), NULL, NULL) ==
+              -1 ||
+          flush_stream(fd) == -1) {
+        return;
+      }
+    }
+  }
+}
+
+/**
+ * Accepts replicas and serves each from a child process
+ */
+static int run_primary(const char *address) {
+  // Step 1: The store must exist (a producer or the API server created it)
+  g_store = shared_memory_kv_open_named(g_store_name, &g_shm_fd);
+  if (g_store == NULL) {
+    fprintf(stderr, "Primary: Store %s not found, start the producer first\n",
+            g_store_name);
+    return EXIT_FAILURE;
+  }
+  shared_memory_kv_destroy(g_shm_fd, g_store); // Children attach themselves
+  g_store = NULL;
+  g_shm_fd = -1;
+
+  // Step 2: Listen; exited children are reaped automatically
+  int listen_fd = open_socket(address, 1);
+  if (listen_fd == -1) {
+    perror("Primary: Failed to listen");
+    return EXIT_FAILURE;
+  }
+  signal(SIGCHLD, SIG_IGN);
+  printf("Primary: Serving %s on %s\n", g_store_name, address);
+  printf("Primary: Press Ctrl+C to exit\n\n");
+
+  while (g_running) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd == -1) {
+      if (errno != EINTR) {
+        perror("Primary: accept failed");
+      }
+      continue;
+    }
+
+    // Step 3: One child per replica, with its own attachment to the store
+    fflush(stdout); // Don't let the child repeat buffered output
+    pid_t child = fork();
+    if (child == 0) {
+      close(listen_fd);
+      g_store = shared_memory_kv_open_named(g_store_name, &g_shm_fd);
+      if (g_store != NULL) {
+        serve_replica(fd);
+        printf("Primary: Replica %d disconnected\n", (int)getpid());
+      }
+      close(fd);
+      exit(EXIT_SUCCESS); // cleanup() detaches from the store
+    }
+    if (child == -1) {
+      perror("Primary: fork failed");
+    }
+    close(fd);
+  }
+
+  close(listen_fd);
+  if (strchr(address, '/') != NULL) {
+    unlink(address);
+  }
+  return EXIT_SUCCESS;
+}
+
+// ============================================================================
+// REPLICA: apply the stream to a store of its own
+// ============================================================================
+
+// Keys received in the current full copy (stale keys are deleted at its end)
+static char g_copy_keys[MAX_ENTRIES][KEY_SIZE];
+static unsigned int g_copy_count = 0;
+
+/**
+ * Deletes the keys of the replica that the full copy did not contain
+ */
+static void drop_stale_keys(void) {
+  static kv_entry_t entries[MAX_ENTRIES];
+  int count = shared_memory_kv_snapshot_table(g_store, entries, NULL);
+  for (int i = 0; i < count; i++) {
+    int kept = 0;
+    for (unsigned int j = 0; j < g_copy_count && !kept; j++) {
+      kept = strcmp(entries[i].key, g_copy_keys[j]) == 0;
+    }
+    if (!kept) {
+      shared_memory_kv_delete(g_store, entries[i].key);
+    }
+  }
+}
+
+/**
+ * Makes room for an entry of a full copy when the replica is full
+ *
+ * Deletes one key the copy has not sent yet: it is either stale or comes
+ * later in the copy.
+ *
+ * @return 0 if a key was deleted, -1 if there is none to delete
+ */
+static int evict_stale_key(void) {
+  static kv_entry_t entries[MAX_ENTRIES];
+  int count = shared_memory_kv_snapshot_table(g_store, entries, NULL);
+  for (int i = 0; i < count; i++) {
+    int copied = 0;
+    for (unsigned int j = 0; j < g_copy_count && !copied; j++) {
+      copied = strcmp(entries[i].key, g_copy_keys[j]) == 0;
+    }
+    if (!copied) {
+      return shared_memory_kv_delete(g_store, entries[i].key);
+    }
+  }
+  return -1;
+}
+
+/**
+ * Applies one message to the replica store and its replication state
+ *
+ * @return 0 on success, -1 if the message is invalid
+ */
+static int apply_message(const repl_header_t *header, const char *payload,
+                         kv_replication_status_t *status) {
+  static kv_value_t value;
+  char key[KEY_SIZE];
+
+  memcpy(key, payload, header->key_length);
+  key[header->key_length] = '\0';
+  status->primary_position = header->head;
+
+  // Step 1: Decode the value (numbers travel natively)
+  if (header->type == MSG_ENTRY || header->type == MSG_SET) {
+    const char *data = payload + header->key_length;
+    memset(&value, 0, offsetof(kv_value_t, data));
+    value.type = header->value_type;
+    value.length = header->value_length;
+    if (value.type == KV_TYPE_INT64 &&
+        header->value_length == sizeof(value.int64)) {
+      memcpy(&value.int64, data, sizeof(value.int64));
+    } else if (value.type == KV_TYPE_DOUBLE &&
+               header->value_length == sizeof(value.number)) {
+      memcpy(&value.number, data, sizeof(value.number));
+    } else {
+      memcpy(value.data, data, header->value_length);
+      value.data[header->value_length] = '\0';
+    }
+    int result = shared_memory_kv_set_value(g_store, key, &value);
+    if (result == -1 && errno == ENOSPC && header->type == MSG_ENTRY &&
+        evict_stale_key() == 0) {
+      result = shared_memory_kv_set_value(g_store, key, &value);
+    }
+    if (result == -1) {
+      perror("Replica: Set failed");
+    }
+  }
+
+  // Step 2: Track the copy and the log position
+  switch (header->type) {
+  case MSG_SNAPSHOT_BEGIN:
+    g_copy_count = 0;
+    break;
+  case MSG_ENTRY:
+    if (g_copy_count < MAX_ENTRIES) {
+      memcpy(g_copy_keys[g_copy_count++], key, KEY_SIZE);
+    }
+    break;
+  case MSG_SNAPSHOT_END:
+    drop_stale_keys();
+    status->applied_position = header->position;
+    status->full_syncs++;
+    printf("Replica: Full copy of %u keys received (log position %llu)\n",
+           g_copy_count, header->position);
+    break;
+  case MSG_DELETE:
+    if (shared_memory_kv_delete(g_store, key) == -1 && errno != ENOENT) {
+      perror("Replica: Delete failed");
+    }
+    /* fall through */
+  case MSG_SET:
+    status->applied_position = header->position + 1;
+    status->applied_changes++;
+    status->lag_ms = now_ms() - header->timestamp;
+    if (status->lag_ms < 0) {
+      status->lag_ms = 0; // Clocks of two hosts disagree
+    }
+    break;
+  case MSG_HEARTBEAT:
+    break;
+  default:
+    return -1;
+  }
+
+  // Step 3: Nothing left to apply: no lag
+  if (status->applied_position >= status->primary_position) {
+    status->lag_ms = 0;
+  }
+  return 0;
+}
+
+/**
+ * Receives and applies the stream of one connection until it breaks
+ */
+static void follow_primary(int fd, kv_replication_status_t *status) {
+  static char in[STREAM_BUFFER_SIZE];
+  size_t in_length = 0;
+
+  while (g_running) {
+    // Step 1: Wait for data (the primary sends a heartbeat every second)
+    struct pollfd pending = {.fd = fd, .events = POLLIN};
+    int ready = poll(&pending, 1, STREAM_TIMEOUT_MS);
+    if (ready == -1 && errno == EINTR) {
+      continue;
+    }
+    if (ready <= 0) {
+      fprintf(stderr, "Replica: Primary silent for %d ms\n",
+              STREAM_TIMEOUT_MS);
+      return;
+    }
+    ssize_t n = recv(fd, in + in_length, sizeof(in) - in_length, 0);
+    if (n <= 0) {
+      return;
+    }
+    in_length += (size_t)n;
+    status->bytes_received += (unsigned long long)n;
+    status->last_contact = now_ms();
+
+    // Step 2: Apply every complete message, keep the partial one
+    size_t offset = 0;
+    while (in_length - offset >= sizeof(repl_header_t)) {
+      repl_header_t header;
+      memcpy(&header, in + offset, sizeof(header));
+      if (header.magic != REPL_MAGIC || header.key_length >= KEY_SIZE ||
+          header.value_length >= VALUE_SIZE) {
+        fprintf(stderr, "Replica: Invalid stream (different build?)\n");
+        return;
+      }
+      size_t length =
+          sizeof(header) + header.key_length + header.value_length;
+      if (in_length - offset < length) {
+        break;
+      }
+      if (apply_message(&header, in + offset + sizeof(header), status) ==
+          -1) {
+        fprintf(stderr, "Replica: Unknown message type %u\n", header.type);
+        return;
+      }
+      offset += length;
+    }
+    memmove(in, in + offset, in_length - offset);
+    in_length -= offset;
+
+    // Step 3: Publish the new state once per received batch
+    shared_memory_kv_replication_report(g_store, status);
+    shared_memory_kv_heartbeat(g_store);
+  }
+}
+
+/**
+ * Keeps a replica store up to date, reconnecting whenever the stream breaks
+ */
+static int run_replica(const char *address) {
+  // Step 1: Create the replica store; this process is its only writer, so
+  // tools attached to it can read but not write
+  shared_memory_kv_unlink_named(g_store_name); // Leftover of a previous run
+  g_store = shared_memory_kv_create_named(
+      g_store_name, &g_shm_fd,
+      KV_FLAG_DEDUP_VALUES | KV_FLAG_PREFIX_KEYS | KV_FLAG_COMPRESS_VALUES |
+          KV_FLAG_SINGLE_WRITER);
+  if (g_store == NULL) {
+    fprintf(stderr, "Replica: Failed to create store %s\n", g_store_name);
+    return EXIT_FAILURE;
+  }
+  g_is_replica = 1;
+
+  kv_replication_status_t status;
+  memset(&status, 0, sizeof(status));
+  status.role = KV_ROLE_REPLICA;
+  status.pid = (int)getpid();
+  strncpy(status.source, address, KV_REPLICATION_SOURCE_SIZE - 1);
+  shared_memory_kv_replication_report(g_store, &status);
+  printf("Replica: Store %s following %s\n", g_store_name, address);
+  printf("Replica: Press Ctrl+C to exit\n\n");
+
+  while (g_running) {
+    // Step 2: Connect (every full copy starts from scratch)
+    int fd = open_socket(address, 0);
+    if (fd == -1) {
+      sleep(RECONNECT_SECONDS);
+      continue;
+    }
+    status.connected = 1;
+    shared_memory_kv_replication_report(g_store, &status);
+    printf("Replica: Connected to %s\n", address);
+
+    // Step 3: Apply the stream until it breaks
+    follow_primary(fd, &status);
+    close(fd);
+    status.connected = 0;
+    shared_memory_kv_replication_report(g_store, &status);
+    if (g_running) {
+      printf("Replica: Disconnected, applied up to log position %llu; "
+             "reconnecting\n",
+             status.applied_position);
+      sleep(RECONNECT_SECONDS);
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+  // --serve ADDRESS: stream the store to replicas connecting to ADDRESS
+  // --replica ADDRESS: keep a replica store up to date from ADDRESS
+  // --store NAME: store to serve (default SHM_NAME) or to create as the
+  // replica (default REPLICA_SHM_NAME)
+  const char *serve = NULL;
+  const char *replica = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+      serve = argv[++i];
+    } else if (strcmp(argv[i], "--replica") == 0 && i + 1 < argc) {
+      replica = argv[++i];
+    } else if (strcmp(argv[i], "--store") == 0 && i + 1 < argc) {
+      g_store_name = argv[++i];
+    } else {
+      serve = replica = NULL;
+      break;
+    }
+  }
+  if ((serve == NULL) == (replica == NULL)) {
+    fprintf(stderr,
+            "Usage: %s --serve ADDRESS [--store NAME]\n"
+            "       %s --replica ADDRESS [--store NAME]\n"
+            "  ADDRESS  unix socket path (contains '/'), or [host:]port\n"
+            "  --store  store to serve (default %s) or replica store to "
+            "create (default %s)\n",
+            argv[0], argv[0], SHM_NAME, REPLICA_SHM_NAME);
+    return EXIT_FAILURE;
+  }
+  if (g_store_name == NULL) {
+    g_store_name = serve != NULL ? SHM_NAME : REPLICA_SHM_NAME;
+  }
+
+  // Register signal handler for graceful shutdown (not restarting accept,
+  // poll and the change log wait, so the loops see the flag)
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = signal_handler;
+  if (sigaction(SIGINT, &action, NULL) == -1 ||
+      sigaction(SIGTERM, &action, NULL) == -1) {
+    perror("Failed to register signal handler");
+    return EXIT_FAILURE;
+  }
+
+  // Register cleanup function to be called on exit
+  if (atexit(cleanup) != 0) {
+    perror("Failed to register cleanup function");
+    return EXIT_FAILURE;
+  }
+
+  return serve != NULL ? run_primary(serve) : run_replica(replica);
+}
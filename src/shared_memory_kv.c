@@ -1,446 +1,8020 @@
 #include "shared_memory_kv.h"
 
+// ============================================================================
+// ARENA (internal helpers, caller must hold the semaphore)
+// ============================================================================
+
 /**
- * Creates a new shared memory object for the KV store
+ * Header in front of every arena block
  *
- * This function creates a new shared memory object, allocates memory,
- * initializes the semaphore, and initializes the data structures.
+ * Offsets handed out by the allocator point just past this header.
+ */
+typedef struct {
+  unsigned int size_class; // Index into arena_free (block size is
+                           // KV_ARENA_MIN_BLOCK << size_class)
+  unsigned int next_free;  // Next free block of the same class (free only)
+} kv_block_header_t;
+
+// Blob flags (kv_blob_t.flags)
+#define KV_BLOB_INTERNED 0x1   // Linked into blob_buckets, may be shared
+#define KV_BLOB_COMPRESSED 0x2 // Payload is LZ-compressed (see kv_lz_*)
+#define KV_BLOB_TYPE_SHIFT 8   // Value type (KV_TYPE_*) in bits 8-15
+#define KV_BLOB_TYPE(flags) (((flags) >> KV_BLOB_TYPE_SHIFT) & 0xFF)
+
+/**
+ * Reference counted byte string in the arena
  *
- * @param shared_memory_file_descriptor_out Pointer to return the shared memory
- * file descriptor (output parameter) (required for later closing/deletion)
- * @return Pointer to shared_memory_kv_store_t structure in shared memory, or
- * NULL on error
+ * Used for values and key parts. Interned blobs are also linked into
+ * blob_buckets so identical content can be found and shared. The header
+ * records whether the payload is compressed, so readers decode it
+ * transparently.
+ */
+typedef struct {
+  unsigned int refcount;   // Number of slots referencing this blob
+  unsigned int hash;       // FNV-1a of the payload
+  unsigned int length;     // Payload length in bytes (no '\0' stored)
+  unsigned int next;       // Next blob in the same bucket (interned only)
+  unsigned int flags;      // KV_BLOB_INTERNED, KV_BLOB_COMPRESSED, value
+                           // type (KV_BLOB_TYPE)
+  unsigned int raw_length; // Length after decompression (= length if raw)
+  unsigned char data[];    // Payload
+} kv_blob_t;
+
+/**
+ * FNV-1a hash of a byte string
+ */
+static unsigned int kv_hash_bytes(const void *data, size_t length) {
+  const unsigned char *bytes = data;
+  unsigned int hash = 2166136261u; // FNV offset basis
+  for (size_t i = 0; i < length; i++) {
+    hash ^= bytes[i];
+    hash *= 16777619u; // FNV prime
+  }
+  return hash;
+}
+
+/**
+ * Block size of a size class
+ */
+static unsigned int kv_class_size(unsigned int size_class) {
+  return (unsigned int)KV_ARENA_MIN_BLOCK << size_class;
+}
+
+/**
+ * Allocates bytes from the arena
  *
- * @note shared_memory_kv_destroy() must be called after use for cleanup
- * @note If the object already exists, the function returns NULL (use
- * shared_memory_kv_open())
+ * Takes a block from the free list of the matching size class, or carves a
+ * new one at arena_top. Blocks are never split or merged: with power-of-two
+ * classes, freed blocks are reused by allocations of the same class.
+ *
+ * @return Offset of the usable memory, or 0 if the arena is full
  */
-shared_memory_kv_store_t *
-shared_memory_kv_create(int *shared_memory_file_descriptor_out) {
-  // Step 1: Create the shared memory object
-  // O_CREAT - create if it doesn't exist
-  // O_EXCL - return error if already exists (overwrite protection)
-  // O_RDWR - read and write mode
-  // S_IRUSR | S_IWUSR - permissions: read and write for the owner
-  int shared_memory_file_descriptor =
-      shm_open(SHM_NAME, O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+static unsigned int kv_arena_alloc(shared_memory_kv_store_t *store,
+                                   size_t bytes) {
+  size_t needed = bytes + sizeof(kv_block_header_t);
+  unsigned int size_class = 0;
+  while (size_class < KV_ARENA_CLASSES &&
+         kv_class_size(size_class) < needed) {
+    size_class++;
+  }
+  if (size_class == KV_ARENA_CLASSES) {
+    return 0; // Larger than the largest block
+  }
 
-  if (shared_memory_file_descriptor == -1) {
-    perror("shm_open failed");
-    return NULL;
+  unsigned int block_size = kv_class_size(size_class);
+  unsigned int block = store->arena_free[size_class];
+
+  if (block != 0) {
+    // Reuse a freed block of the same class
+    kv_block_header_t *header = (kv_block_header_t *)&store->arena[block];
+    store->arena_free[size_class] = header->next_free;
+    store->arena_free_bytes -= block_size;
+  } else {
+    // Carve a new block (offset 0 stays unused so 0 can mean "none")
+    block = store->arena_top == 0 ? 8 : store->arena_top;
+    if ((size_t)block + block_size > ARENA_SIZE) {
+      return 0;
+    }
+    store->arena_top = block + block_size;
   }
 
-  // Save the descriptor to return it
-  if (shared_memory_file_descriptor_out != NULL) {
-    *shared_memory_file_descriptor_out = shared_memory_file_descriptor;
+  kv_block_header_t *header = (kv_block_header_t *)&store->arena[block];
+  header->size_class = size_class;
+  header->next_free = 0;
+  store->arena_allocated_bytes += block_size;
+
+  return block + (unsigned int)sizeof(kv_block_header_t);
+}
+
+/**
+ * Returns memory from kv_arena_alloc() to its size class free list
+ */
+static void kv_arena_free(shared_memory_kv_store_t *store,
+                          unsigned int offset) {
+  if (offset == 0) {
+    return;
   }
 
-  // Step 2: Set the shared memory object size
-  // ftruncate sets the size of the file/object
-  // Important: shm_open creates an object with size 0, so size must be
-  // explicitly set. Size should be equal to sizeof(shared_memory_kv_store_t)
-  if (ftruncate(shared_memory_file_descriptor,
-                sizeof(shared_memory_kv_store_t)) == -1) {
-    perror("ftruncate failed");
-    // If ftruncate fails, close the descriptor and return an error
-    close(shared_memory_file_descriptor);
-    // Also need to unlink the object as it was created but is incomplete
-    shm_unlink(SHM_NAME);
+  unsigned int block = offset - (unsigned int)sizeof(kv_block_header_t);
+  kv_block_header_t *header = (kv_block_header_t *)&store->arena[block];
+  unsigned int block_size = kv_class_size(header->size_class);
+
+  header->next_free = store->arena_free[header->size_class];
+  store->arena_free[header->size_class] = block;
+  store->arena_allocated_bytes -= block_size;
+  store->arena_free_bytes += block_size;
+}
+
+/**
+ * Resolves a blob offset
+ */
+static kv_blob_t *kv_blob(const shared_memory_kv_store_t *store,
+                          unsigned int offset) {
+  return offset == 0 ? NULL : (kv_blob_t *)&store->arena[offset];
+}
+
+/**
+ * Returns the payload of a blob after checking it lies inside the arena
+ *
+ * Snapshot readers (see shared_memory_kv_snapshot_get) follow offsets
+ * without the semaphore, so a concurrent writer may have reused the block;
+ * each header field is read once and checked, and garbage yields NULL
+ * instead of a read outside the segment. The reader then retries.
+ *
+ * @param length_out Payload length
+ * @param flags_out Optional blob flags
+ * @return Payload, or NULL for offset 0 or an invalid blob
+ */
+static const unsigned char *
+kv_blob_payload(const shared_memory_kv_store_t *store, unsigned int offset,
+                size_t *length_out, unsigned int *flags_out) {
+  if (offset < sizeof(kv_block_header_t) ||
+      offset > ARENA_SIZE - sizeof(kv_blob_t)) {
     return NULL;
   }
 
-  // Step 3: Map shared memory into the process address space
-  // mmap creates a virtual mapping of the shared memory object into process
-  // memory. After mmap, we can work with shared memory via a pointer like a
-  // regular structure.
-  //
-  // Parameters:
-  // - NULL: the kernel will choose the mapping address
-  // - sizeof(shared_memory_kv_store_t): mapping size (must match ftruncate
-  //   size)
-  // - PROT_READ | PROT_WRITE: allow read and write
-  // - MAP_SHARED: changes are visible to other processes (important for IPC!)
-  // - shared_memory_file_descriptor: descriptor from shm_open
-  // - 0: offset from the start of the object (map from the beginning)
-  shared_memory_kv_store_t *store =
-      mmap(NULL, // address (NULL = kernel will choose)
-           sizeof(shared_memory_kv_store_t), // size
-           PROT_READ | PROT_WRITE,           // access rights
-           MAP_SHARED,                       // flags (shared between processes)
-           shared_memory_file_descriptor,    // file descriptor
-           0                                 // offset
-      );
+  const kv_blob_t *blob = kv_blob(store, offset);
+  size_t length = blob->length;
+  if (length > ARENA_SIZE - offset - sizeof(kv_blob_t)) {
+    return NULL;
+  }
 
-  // Error check: mmap returns MAP_FAILED (usually (void*)-1) on error
-  if (store == MAP_FAILED) {
-    perror("mmap failed");
+  *length_out = length;
+  if (flags_out != NULL) {
+    *flags_out = blob->flags;
+  }
+  return blob->data;
+}
 
-    close(shared_memory_file_descriptor);
-    shm_unlink(SHM_NAME);
-    return NULL;
+/**
+ * Stores bytes as a blob
+ *
+ * With KV_BLOB_INTERNED set, an existing blob with the same content (and
+ * encoding) is looked up in blob_buckets and shared (its refcount is
+ * incremented); otherwise a new blob is allocated (and linked into the
+ * index when interned).
+ *
+ * @param flags KV_BLOB_INTERNED and/or KV_BLOB_COMPRESSED
+ * @param raw_length Payload length after decompression
+ * @return Blob offset, or 0 if the arena is full
+ */
+static unsigned int kv_blob_create(shared_memory_kv_store_t *store,
+                                   const void *data, size_t length,
+                                   unsigned int flags, size_t raw_length) {
+  unsigned int hash = kv_hash_bytes(data, length);
+  unsigned int bucket = hash % KV_BLOB_BUCKETS;
+  int intern = (flags & KV_BLOB_INTERNED) != 0;
+
+  // Step 1: Reuse identical content if interning
+  if (intern) {
+    for (unsigned int offset = store->blob_buckets[bucket]; offset != 0;) {
+      kv_blob_t *blob = kv_blob(store, offset);
+      if (blob->hash == hash && blob->length == length &&
+          blob->flags == flags &&
+          memcmp(blob->data, data, length) == 0) {
+        blob->refcount++;
+        store->dedup_hits++;
+        store->bytes_saved += length;
+        return offset;
+      }
+      offset = blob->next;
+    }
   }
 
-  // Step 4: Initialize structure fields
-  // After mmap, memory may contain garbage, so all fields must be explicitly
-  // initialized.
-  //
-  // memset clears memory: sets all bytes to 0.
-  // This ensures that:
-  // - All strings in kv_table will start with '\0' (empty)
-  // - All timestamps will be 0
-  // - version and entry_count will be 0
-  memset(store, 0, sizeof(shared_memory_kv_store_t));
+  // Step 2: Allocate a new blob
+  unsigned int offset = kv_arena_alloc(store, sizeof(kv_blob_t) + length);
+  if (offset == 0) {
+    return 0;
+  }
 
-  // Explicit field initialization for clarity (though memset already cleared
-  // them). This makes the code more readable and explicitly shows initial
-  // values.
-  store->version = 0;     // Initial data version
-  store->entry_count = 0; // Initial entry count (table is empty)
+  kv_blob_t *blob = kv_blob(store, offset);
+  blob->refcount = 1;
+  blob->hash = hash;
+  blob->length = (unsigned int)length;
+  blob->next = 0;
+  blob->flags = flags;
+  blob->raw_length = (unsigned int)raw_length;
+  memcpy(blob->data, data, length);
+  store->blob_count++;
 
-  // Step 5: Initialize the semaphore for synchronization
-  // sem_init initializes the semaphore for inter-process synchronization.
-  // Important: do this AFTER memset so the semaphore is initialized in clean
-  // memory.
-  //
-  // Parameters:
-  // - &store->sem: pointer to the semaphore in the structure (in shared memory)
-  // - 1 (pshared): "shared" flag - semaphore will be accessible between
-  // processes
-  //   (0 = current process only, 1 = between processes via shared memory)
-  // - 1 (value): initial semaphore value (1 = semaphore is free, can be taken)
-  //   Used as a mutex: 1 = unlocked, 0 = locked
-  if (sem_init(&store->sem, 1, 1) == -1) {
-    perror("sem_init failed");
-    munmap(store, sizeof(shared_memory_kv_store_t));
-    close(shared_memory_file_descriptor);
-    shm_unlink(SHM_NAME);
-    return NULL;
+  if (flags & KV_BLOB_COMPRESSED) {
+    store->compressed_values++;
+    store->compressed_bytes += length;
+    store->uncompressed_bytes += raw_length;
   }
 
-  return store; // Return pointer to the structure in shared memory
+  // Step 3: Make it findable for later interning
+  if (intern) {
+    blob->next = store->blob_buckets[bucket];
+    store->blob_buckets[bucket] = offset;
+  }
+
+  return offset;
 }
 
 /**
- * Opens an existing shared memory object for the KV store
+ * Drops one reference to a blob, freeing it when the last one is gone
+ */
+static void kv_blob_release(shared_memory_kv_store_t *store,
+                            unsigned int offset) {
+  kv_blob_t *blob = kv_blob(store, offset);
+  if (blob == NULL) {
+    return;
+  }
+
+  if (blob->refcount > 1) {
+    blob->refcount--;
+    store->bytes_saved -= blob->length;
+    return;
+  }
+
+  // Unlink from its bucket before freeing
+  if (blob->flags & KV_BLOB_INTERNED) {
+    unsigned int *link = &store->blob_buckets[blob->hash % KV_BLOB_BUCKETS];
+    while (*link != 0 && *link != offset) {
+      link = &kv_blob(store, *link)->next;
+    }
+    if (*link == offset) {
+      *link = blob->next;
+    }
+  }
+
+  if (blob->flags & KV_BLOB_COMPRESSED) {
+    store->compressed_values--;
+    store->compressed_bytes -= blob->length;
+    store->uncompressed_bytes -= blob->raw_length;
+  }
+
+  store->blob_count--;
+  kv_arena_free(store, offset);
+}
+
+// ============================================================================
+// VALUE COMPRESSION (internal helpers)
+// ============================================================================
+//
+// LZ77 with an LZ4-style sequence format. Each sequence is:
+//   token      high nibble: literal count, low nibble: match length - 4
+//              (15 in a nibble means "more length bytes follow", each adding
+//              up to 255; a byte below 255 ends the length)
+//   literals   copied verbatim
+//   offset     2 bytes little-endian, distance back to the match
+// The last sequence has only a token and literals. Matches may reach back
+// into the preset dictionary, which is treated as if it preceded the value.
+
+#define KV_LZ_MIN_MATCH 4
+#define KV_LZ_HASH_BITS 12
+#define KV_LZ_MAX_OFFSET 0xFFFF
+#define KV_LZ_WINDOW_SIZE (KV_COMPRESS_DICT_SIZE + VALUE_SIZE)
+
+/**
+ * Hash of the next KV_LZ_MIN_MATCH bytes (multiplicative, Knuth)
+ */
+static unsigned int kv_lz_hash(const unsigned char *bytes) {
+  unsigned int sequence = (unsigned int)bytes[0] |
+                          (unsigned int)bytes[1] << 8 |
+                          (unsigned int)bytes[2] << 16 |
+                          (unsigned int)bytes[3] << 24;
+  return (sequence * 2654435761u) >> (32 - KV_LZ_HASH_BITS);
+}
+
+/**
+ * Writes an extended length (the part that did not fit in the token)
  *
- * @param shared_memory_file_descriptor_out Pointer to return the shared memory
- * file descriptor
- * @return Pointer to shared_memory_kv_store_t structure in shared memory, or
- * NULL on error
+ * @return 0 on success, -1 if the output buffer is too small
  */
-shared_memory_kv_store_t *
-shared_memory_kv_open(int *shared_memory_file_descriptor_out) {
-  // Step 1: Open existing shared memory object
-  // O_RDWR - read and write mode
-  int shared_memory_file_descriptor = shm_open(SHM_NAME, O_RDWR, 0);
+static int kv_lz_put_length(unsigned char *out, size_t capacity,
+                            size_t *pos, size_t length) {
+  while (length >= 255) {
+    if (*pos >= capacity) {
+      return -1;
+    }
+    out[(*pos)++] = 255;
+    length -= 255;
+  }
+  if (*pos >= capacity) {
+    return -1;
+  }
+  out[(*pos)++] = (unsigned char)length;
+  return 0;
+}
 
-  if (shared_memory_file_descriptor == -1) {
-    perror("shm_open failed");
-    return NULL;
+/**
+ * Writes one sequence (match_length 0 = final literals-only sequence)
+ *
+ * @return 0 on success, -1 if the output buffer is too small
+ */
+static int kv_lz_put_sequence(unsigned char *out, size_t capacity,
+                              size_t *pos, const unsigned char *literals,
+                              size_t literal_count, size_t offset,
+                              size_t match_length) {
+  size_t match_code = match_length ? match_length - KV_LZ_MIN_MATCH : 0;
+
+  // Token
+  if (*pos >= capacity) {
+    return -1;
+  }
+  out[(*pos)++] =
+      (unsigned char)((literal_count < 15 ? literal_count : 15) << 4 |
+                      (match_code < 15 ? match_code : 15));
+  if (literal_count >= 15 &&
+      kv_lz_put_length(out, capacity, pos, literal_count - 15) == -1) {
+    return -1;
   }
 
-  // Save descriptor if requested
-  if (shared_memory_file_descriptor_out != NULL) {
-    *shared_memory_file_descriptor_out = shared_memory_file_descriptor;
+  // Literals
+  if (*pos + literal_count > capacity) {
+    return -1;
   }
+  memcpy(out + *pos, literals, literal_count);
+  *pos += literal_count;
 
-  // Step 2: Map shared memory into process address space
-  shared_memory_kv_store_t *store =
-      mmap(NULL, sizeof(shared_memory_kv_store_t), PROT_READ | PROT_WRITE,
-           MAP_SHARED, shared_memory_file_descriptor, 0);
-  if (store == MAP_FAILED) {
-    perror("mmap failed");
-    close(shared_memory_file_descriptor);
-    return NULL;
+  if (match_length == 0) {
+    return 0;
+  }
+
+  // Offset and the rest of the match length
+  if (*pos + 2 > capacity) {
+    return -1;
+  }
+  out[(*pos)++] = (unsigned char)(offset & 0xFF);
+  out[(*pos)++] = (unsigned char)(offset >> 8);
+  if (match_code >= 15 &&
+      kv_lz_put_length(out, capacity, pos, match_code - 15) == -1) {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Compresses window[start..end) (window[0..start) is the dictionary)
+ *
+ * Greedy parse with a single-entry hash table of recent positions.
+ *
+ * @return Compressed size, or 0 if it would not fit in capacity bytes
+ */
+static size_t kv_lz_compress(const unsigned char *window, size_t start,
+                             size_t end, unsigned char *out,
+                             size_t capacity) {
+  // Per thread rather than on the stack (16 KB): writers run this on the
+  // stacks of callers and combining threads
+  static _Thread_local unsigned int table[1 << KV_LZ_HASH_BITS];
+  for (size_t i = 0; i < (1 << KV_LZ_HASH_BITS); i++) {
+    table[i] = UINT_MAX; // No position yet
+  }
+
+  // Step 1: Index the dictionary so the first bytes can match it
+  for (size_t pos = 0; pos + KV_LZ_MIN_MATCH <= start; pos++) {
+    table[kv_lz_hash(window + pos)] = (unsigned int)pos;
+  }
+
+  // Step 2: Emit a sequence at every match found in the input
+  size_t out_pos = 0;
+  size_t anchor = start; // First byte not yet emitted
+  size_t pos = start;
+
+  while (pos + KV_LZ_MIN_MATCH <= end) {
+    unsigned int hash = kv_lz_hash(window + pos);
+    unsigned int candidate = table[hash];
+    table[hash] = (unsigned int)pos;
+
+    if (candidate == UINT_MAX || pos - candidate > KV_LZ_MAX_OFFSET ||
+        memcmp(window + candidate, window + pos, KV_LZ_MIN_MATCH) != 0) {
+      pos++;
+      continue;
+    }
+
+    // Extend the match (it may overlap the bytes being encoded)
+    size_t length = KV_LZ_MIN_MATCH;
+    while (pos + length < end &&
+           window[candidate + length] == window[pos + length]) {
+      length++;
+    }
+
+    if (kv_lz_put_sequence(out, capacity, &out_pos, window + anchor,
+                           pos - anchor, pos - candidate, length) == -1) {
+      return 0;
+    }
+    pos += length;
+    anchor = pos;
+  }
+
+  // Step 3: Remaining bytes go into the final literals-only sequence
+  if (kv_lz_put_sequence(out, capacity, &out_pos, window + anchor,
+                         end - anchor, 0, 0) == -1) {
+    return 0;
+  }
+  return out_pos;
+}
+
+/**
+ * Reads an extended length
+ *
+ * @return 0 on success, -1 on truncated input
+ */
+static int kv_lz_get_length(const unsigned char *in, size_t in_length,
+                            size_t *pos, size_t *length) {
+  unsigned char byte;
+  do {
+    if (*pos >= in_length) {
+      return -1;
+    }
+    byte = in[(*pos)++];
+    *length += byte;
+  } while (byte == 255);
+  return 0;
+}
+
+/**
+ * Decompresses into window[start..capacity) (window[0..start) holds the
+ * dictionary)
+ *
+ * Every length and offset is checked, so corrupt input cannot write or
+ * read outside the window.
+ *
+ * @return Decompressed size, or -1 on corrupt input
+ */
+static long kv_lz_decompress(const unsigned char *in, size_t in_length,
+                             unsigned char *window, size_t start,
+                             size_t capacity) {
+  size_t in_pos = 0;
+  size_t out_pos = start;
+
+  while (in_pos < in_length) {
+    unsigned char token = in[in_pos++];
+
+    // Literals
+    size_t literal_count = token >> 4;
+    if (literal_count == 15 &&
+        kv_lz_get_length(in, in_length, &in_pos, &literal_count) == -1) {
+      return -1;
+    }
+    if (literal_count > in_length - in_pos ||
+        literal_count > capacity - out_pos) {
+      return -1;
+    }
+    memcpy(window + out_pos, in + in_pos, literal_count);
+    in_pos += literal_count;
+    out_pos += literal_count;
+
+    if (in_pos == in_length) {
+      break; // Final sequence
+    }
+
+    // Match
+    if (in_length - in_pos < 2) {
+      return -1;
+    }
+    size_t offset = (size_t)in[in_pos] | (size_t)in[in_pos + 1] << 8;
+    in_pos += 2;
+    size_t length = token & 0x0F;
+    if (length == 15 &&
+        kv_lz_get_length(in, in_length, &in_pos, &length) == -1) {
+      return -1;
+    }
+    length += KV_LZ_MIN_MATCH;
+    if (offset == 0 || offset > out_pos || length > capacity - out_pos) {
+      return -1;
+    }
+
+    // Byte by byte: overlapping matches repeat the pattern
+    for (size_t i = 0; i < length; i++, out_pos++) {
+      window[out_pos] = window[out_pos - offset];
+    }
+  }
+
+  return (long)(out_pos - start);
+}
+
+// ============================================================================
+// KEYS AND VALUES IN THE ARENA (internal helpers, caller must hold the
+// semaphore)
+// ============================================================================
+
+/**
+ * Length of the key prefix to intern (0 = store the key as one blob)
+ */
+static size_t kv_key_prefix_length(const shared_memory_kv_store_t *store,
+                                   const char *key, size_t key_len) {
+  if (!(store->flags & KV_FLAG_PREFIX_KEYS)) {
+    return 0;
+  }
+
+  // Split after the last delimiter, keeping a non-empty suffix
+  for (size_t i = key_len; i > 1; i--) {
+    if (strchr(KV_KEY_DELIMITERS, key[i - 2]) != NULL) {
+      return i - 1 >= KV_MIN_PREFIX_LENGTH ? i - 1 : 0;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Stores a key in a slot as an interned prefix blob plus a suffix blob
+ *
+ * @return 0 on success, -1 if the arena is full (slot left unchanged)
+ */
+static int kv_key_store(shared_memory_kv_store_t *store, kv_pair_t *pair,
+                        const char *key, size_t key_len) {
+  size_t prefix_len = kv_key_prefix_length(store, key, key_len);
+  unsigned int prefix_ref = 0;
+
+  if (prefix_len > 0) {
+    prefix_ref =
+        kv_blob_create(store, key, prefix_len, KV_BLOB_INTERNED, prefix_len);
+    if (prefix_ref == 0) {
+      return -1;
+    }
+  }
+
+  size_t suffix_len = key_len - prefix_len;
+  unsigned int suffix_ref =
+      kv_blob_create(store, key + prefix_len, suffix_len, 0, suffix_len);
+  if (suffix_ref == 0) {
+    kv_blob_release(store, prefix_ref);
+    return -1;
+  }
+
+  pair->key_prefix_ref = prefix_ref;
+  pair->key_suffix_ref = suffix_ref;
+  return 0;
+}
+
+/**
+ * Compares the key of a slot with a string (strcmp semantics)
+ *
+ * Walks the prefix and suffix blobs without assembling the key.
+ */
+static int kv_key_compare(const shared_memory_kv_store_t *store,
+                          const kv_pair_t *pair, const char *key) {
+  const unsigned int refs[2] = {pair->key_prefix_ref, pair->key_suffix_ref};
+  size_t pos = 0;
+
+  for (int part = 0; part < 2; part++) {
+    size_t length;
+    const unsigned char *data =
+        kv_blob_payload(store, refs[part], &length, NULL);
+    if (data == NULL) {
+      continue;
+    }
+    for (size_t i = 0; i < length; i++, pos++) {
+      unsigned char slot_char = data[i];
+      unsigned char key_char = (unsigned char)key[pos];
+      if (slot_char != key_char) {
+        // Also covers the end of key ('\0' sorts first)
+        return slot_char < key_char ? -1 : 1;
+      }
+    }
+  }
+
+  return key[pos] == '\0' ? 0 : -1;
+}
+
+/**
+ * Copies the key of a slot into a KEY_SIZE buffer ('\0'-terminated)
+ */
+static void kv_key_copy(const shared_memory_kv_store_t *store,
+                        const kv_pair_t *pair, char *key_out) {
+  const unsigned int refs[2] = {pair->key_prefix_ref, pair->key_suffix_ref};
+  size_t pos = 0;
+
+  for (int part = 0; part < 2; part++) {
+    size_t length;
+    const unsigned char *data =
+        kv_blob_payload(store, refs[part], &length, NULL);
+    if (data == NULL) {
+      continue;
+    }
+    if (pos + length > KEY_SIZE - 1) {
+      length = KEY_SIZE - 1 - pos;
+    }
+    memcpy(key_out + pos, data, length);
+    pos += length;
+  }
+  key_out[pos] = '\0';
+}
+
+/**
+ * Stores a value as a blob, compressed and/or deduplicated per store flags
+ *
+ * Compression is attempted for values of at least KV_COMPRESS_THRESHOLD
+ * bytes and kept only if the result is smaller than the value. The type is
+ * kept in the blob flags; numbers are their 8 native bytes (never long
+ * enough to compress), so equal numbers of one type share a blob too.
+ *
+ * @param type KV_TYPE_* of the value
+ * @return Blob offset, or 0 if the arena is full
+ */
+static unsigned int kv_value_store(shared_memory_kv_store_t *store,
+                                   const void *value, size_t value_len,
+                                   unsigned int type) {
+  unsigned int flags =
+      ((store->flags & KV_FLAG_DEDUP_VALUES) ? KV_BLOB_INTERNED : 0) |
+      type << KV_BLOB_TYPE_SHIFT;
+
+  if ((store->flags & KV_FLAG_COMPRESS_VALUES) &&
+      value_len >= KV_COMPRESS_THRESHOLD) {
+    // Per thread, off the stack (see kv_lz_compress)
+    static _Thread_local unsigned char window[KV_LZ_WINDOW_SIZE];
+    static _Thread_local unsigned char compressed[VALUE_SIZE];
+    size_t dict_len = store->compress_dict_length;
+
+    memcpy(window, store->compress_dict, dict_len);
+    memcpy(window + dict_len, value, value_len);
+    size_t compressed_len = kv_lz_compress(window, dict_len,
+                                           dict_len + value_len, compressed,
+                                           value_len - 1);
+    if (compressed_len > 0) {
+      return kv_blob_create(store, compressed, compressed_len,
+                            flags | KV_BLOB_COMPRESSED, value_len);
+    }
+  }
+
+  return kv_blob_create(store, value, value_len, flags, value_len);
+}
+
+/**
+ * Copies the raw bytes of a slot's value into a VALUE_SIZE buffer
+ * ('\0'-terminated)
+ *
+ * Compressed values are decoded against the store dictionary.
+ *
+ * @param type_out Value type (KV_TYPE_*)
+ * @return Value length in bytes
+ */
+static size_t kv_value_decode(const shared_memory_kv_store_t *store,
+                              const kv_pair_t *pair, char *value_out,
+                              unsigned int *type_out) {
+  size_t stored_length;
+  unsigned int flags = 0;
+  const unsigned char *data =
+      kv_blob_payload(store, pair->value_ref, &stored_length, &flags);
+  size_t length = 0;
+
+  if (data != NULL && (flags & KV_BLOB_COMPRESSED)) {
+    static _Thread_local unsigned char window[KV_LZ_WINDOW_SIZE];
+    size_t dict_len = store->compress_dict_length;
+    if (dict_len > KV_COMPRESS_DICT_SIZE) {
+      dict_len = KV_COMPRESS_DICT_SIZE; // Torn read (snapshot readers)
+    }
+
+    memcpy(window, store->compress_dict, dict_len);
+    long decoded = kv_lz_decompress(data, stored_length, window, dict_len,
+                                    dict_len + VALUE_SIZE - 1);
+    if (decoded > 0) {
+      length = (size_t)decoded;
+      memcpy(value_out, window + dict_len, length);
+    }
+  } else if (data != NULL) {
+    length = stored_length < VALUE_SIZE - 1 ? stored_length : VALUE_SIZE - 1;
+    memcpy(value_out, data, length);
+  }
+  value_out[length] = '\0';
+  *type_out = data != NULL ? KV_BLOB_TYPE(flags) : KV_TYPE_STRING;
+  return length;
+}
+
+/**
+ * Formats a number or hash stored natively as text, in place
+ *
+ * Integers are printed exactly; doubles with the fewest digits that read
+ * back as the same double ("45.2", not "45.200000000000003"). Hashes become
+ * "field=value" lines (same length as the encoded map). Values of other
+ * types, and numbers of the wrong length (torn snapshot reads), are left
+ * alone.
+ *
+ * @param value VALUE_SIZE buffer holding length raw bytes of the value
+ */
+static void kv_value_format(char *value, size_t length, unsigned int type) {
+  if (type == KV_TYPE_HASH && length > 0) {
+    // "field\0value\0..." -> "field=value\n...", without the last newline
+    unsigned int separators = 0;
+    for (size_t i = 0; i < length; i++) {
+      if (value[i] == '\0') {
+        value[i] = (separators++ & 1) ? '\n' : '=';
+      }
+    }
+    value[length - 1] = '\0';
+  } else if (type == KV_TYPE_INT64 && length == sizeof(long long)) {
+    long long number;
+    memcpy(&number, value, sizeof(number));
+    snprintf(value, VALUE_SIZE, "%lld", number);
+  } else if (type == KV_TYPE_DOUBLE && length == sizeof(double)) {
+    double number;
+    memcpy(&number, value, sizeof(number));
+    snprintf(value, VALUE_SIZE, "%.15g", number);
+    if (strtod(value, NULL) != number) {
+      snprintf(value, VALUE_SIZE, "%.17g", number);
+    }
+  }
+}
+
+/**
+ * Copies the value of a slot into a VALUE_SIZE buffer as text
+ * ('\0'-terminated)
+ *
+ * Numbers are formatted (see kv_value_format); bytes are copied as they
+ * are, so text readers see them up to their first '\0'.
+ */
+static void kv_value_copy(const shared_memory_kv_store_t *store,
+                          const kv_pair_t *pair, char *value_out) {
+  unsigned int type;
+  size_t length = kv_value_decode(store, pair, value_out, &type);
+  kv_value_format(value_out, length, type);
+}
+
+/**
+ * Extracts a number stored natively (integers also as double); both
+ * outputs are 0 for other types
+ */
+static void kv_value_number(const char *value, size_t length,
+                            unsigned int type, long long *int64_out,
+                            double *number_out) {
+  *int64_out = 0;
+  *number_out = 0.0;
+  if (type == KV_TYPE_INT64 && length == sizeof(long long)) {
+    memcpy(int64_out, value, sizeof(long long));
+    *number_out = (double)*int64_out;
+  } else if (type == KV_TYPE_DOUBLE && length == sizeof(double)) {
+    memcpy(number_out, value, sizeof(double));
+  }
+}
+
+/**
+ * Copies the value of a slot with its type, numbers natively
+ */
+static void kv_value_read(const shared_memory_kv_store_t *store,
+                          const kv_pair_t *pair, kv_value_t *value_out) {
+  size_t length = kv_value_decode(store, pair, value_out->data,
+                                  &value_out->type);
+  value_out->length = (unsigned int)length;
+  kv_value_number(value_out->data, length, value_out->type,
+                  &value_out->int64, &value_out->number);
+  if (value_out->type == KV_TYPE_INT64 || value_out->type == KV_TYPE_DOUBLE) {
+    value_out->length = 0;
+    value_out->data[0] = '\0';
+  }
+}
+
+// ============================================================================
+// BLOOM FILTER (updates need the semaphore, lookups do not)
+// ============================================================================
+
+/**
+ * Counter index of the i-th bloom hash of a key
+ *
+ * Double hashing (Kirsch-Mitzenmacher): h1 + i * h2, with h2 derived from
+ * the key hash by a second mixing round and forced odd so every step
+ * reaches all counters of the power-of-two table.
+ */
+static unsigned int kv_bloom_index(unsigned int hash, unsigned int i) {
+  unsigned int second = (hash ^ (hash >> 16)) * 0x45d9f3bu;
+  second = (second ^ (second >> 16)) | 1u;
+  return (hash + i * second) & (KV_BLOOM_COUNTERS - 1);
+}
+
+/**
+ * Adds a key (by hash) to the bloom filter
+ */
+static void kv_bloom_add(shared_memory_kv_store_t *store, unsigned int hash) {
+  for (unsigned int i = 0; i < KV_BLOOM_HASHES; i++) {
+    _Atomic unsigned char *counter = &store->bloom[kv_bloom_index(hash, i)];
+    unsigned char count = atomic_load_explicit(counter, memory_order_relaxed);
+    if (count < 255) {
+      atomic_store_explicit(counter, count + 1, memory_order_release);
+    }
+  }
+}
+
+/**
+ * Removes a key (by hash) from the bloom filter
+ *
+ * Saturated counters are left alone: their true count is unknown.
+ */
+static void kv_bloom_remove(shared_memory_kv_store_t *store,
+                            unsigned int hash) {
+  for (unsigned int i = 0; i < KV_BLOOM_HASHES; i++) {
+    _Atomic unsigned char *counter = &store->bloom[kv_bloom_index(hash, i)];
+    unsigned char count = atomic_load_explicit(counter, memory_order_relaxed);
+    if (count > 0 && count < 255) {
+      atomic_store_explicit(counter, count - 1, memory_order_release);
+    }
+  }
+}
+
+/**
+ * Checks whether a key (by hash) may be in the store
+ *
+ * Safe without the semaphore: a concurrent insert that has not yet bumped
+ * all counters is simply ordered after this lookup.
+ *
+ * @return 0 if the key is definitely absent, 1 if it may be present
+ */
+static int kv_bloom_may_contain(shared_memory_kv_store_t *store,
+                                unsigned int hash) {
+  for (unsigned int i = 0; i < KV_BLOOM_HASHES; i++) {
+    if (atomic_load_explicit(&store->bloom[kv_bloom_index(hash, i)],
+                             memory_order_acquire) == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// ============================================================================
+// SEQUENCE LOCK (lets snapshot readers run without the semaphore)
+// ============================================================================
+
+/**
+ * Marks the start of a modification (caller holds the semaphore)
+ *
+ * The sequence becomes odd; snapshot readers that see an odd value, or a
+ * different value after copying, discard their copy and retry.
+ */
+static void kv_seq_write_begin(shared_memory_kv_store_t *store) {
+  unsigned int seq = atomic_load_explicit(&store->seq, memory_order_relaxed);
+  atomic_store_explicit(&store->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+/**
+ * Marks the end of a modification (sequence even again)
+ */
+static void kv_seq_write_end(shared_memory_kv_store_t *store) {
+  unsigned int seq = atomic_load_explicit(&store->seq, memory_order_relaxed);
+  atomic_store_explicit(&store->seq, seq + 1, memory_order_release);
+}
+
+/**
+ * Marks the start of a change of one slot (by the writer)
+ *
+ * The slot's own counter becomes odd, so readers of that single slot (see
+ * shared_memory_kv_read_slot) are not disturbed by writes to other slots.
+ */
+static void kv_slot_write_begin(kv_pair_t *pair) {
+  unsigned int seq = atomic_load_explicit(&pair->seq, memory_order_relaxed);
+  atomic_store_explicit(&pair->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+/**
+ * Marks the end of a change of one slot (counter even again)
+ */
+static void kv_slot_write_end(kv_pair_t *pair) {
+  unsigned int seq = atomic_load_explicit(&pair->seq, memory_order_relaxed);
+  atomic_store_explicit(&pair->seq, seq + 1, memory_order_release);
+}
+
+/**
+ * Starts an optimistic read: waits for an even sequence and returns it
+ *
+ * @return Sequence value, or 1 (odd) if a writer stayed active for the
+ *         whole spin
+ */
+static unsigned int kv_seq_read_begin(const shared_memory_kv_store_t *store) {
+  for (unsigned int spin = 0; spin < KV_SNAPSHOT_SPINS; spin++) {
+    unsigned int seq =
+        atomic_load_explicit(&store->seq, memory_order_acquire);
+    if ((seq & 1) == 0) {
+      return seq;
+    }
+  }
+  return 1;
+}
+
+/**
+ * Checks that no modification started since kv_seq_read_begin()
+ *
+ * @return 1 if the data read in between is consistent
+ */
+static int kv_seq_read_valid(const shared_memory_kv_store_t *store,
+                             unsigned int seq) {
+  atomic_thread_fence(memory_order_acquire);
+  return atomic_load_explicit(&store->seq, memory_order_relaxed) == seq;
+}
+
+// ============================================================================
+// PROCESS REGISTRY (entries are claimed and reaped lock-free)
+// ============================================================================
+
+// Registry entries cached per thread, one per store it used recently (a
+// thread using a sharded store uses one per shard); a thread is identified
+// within its process by the address of its own copy of kv_thread_marker
+static _Thread_local char kv_thread_marker;
+static _Thread_local struct {
+  const shared_memory_kv_store_t *store;
+  int index;
+} kv_registry_cache[KV_SHARD_MAX];
+static _Thread_local unsigned int kv_registry_cache_next; // Replaced next
+static _Thread_local int kv_thread_id;                    // 0 = not read yet
+static _Thread_local int kv_thread_pid;                   // Process it was
+                                                          // read in
+
+// Stores this process has mapped: a thread exit handler only touches
+// registry entries of mappings that still exist
+static pthread_mutex_t kv_mapped_lock = PTHREAD_MUTEX_INITIALIZER;
+static shared_memory_kv_store_t *kv_mapped[KV_MAPPED_MAX];
+
+// Key whose destructor frees the exiting thread's registry entries
+static pthread_once_t kv_thread_exit_once = PTHREAD_ONCE_INIT;
+static pthread_key_t kv_thread_exit_key;
+
+/**
+ * Kernel thread id of the calling thread (read once per thread, and again
+ * in a child after fork(): the child inherits the cached value)
+ */
+static int kv_self_tid(void) {
+  int pid = (int)getpid();
+  if (kv_thread_id == 0 || kv_thread_pid != pid) {
+    kv_thread_id = (int)syscall(SYS_gettid);
+    kv_thread_pid = pid;
+  }
+  return kv_thread_id;
+}
+
+/**
+ * Checks whether a thread of a live process still runs
+ *
+ * @return 0 only if /proc/<pid>/task/<tid> is known to be gone
+ */
+static int kv_thread_alive(int pid, int tid) {
+  if (tid <= 0) {
+    return 1;
+  }
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/task/%d", pid, tid);
+  int saved_errno = errno;
+  int alive = access(path, F_OK) == 0 || errno != ENOENT;
+  errno = saved_errno;
+  return alive;
+}
+
+/**
+ * Reads the start time and state of a process from /proc/<pid>/stat
+ *
+ * @param state_out Optional: process state letter ('Z' = zombie)
+ * @return Start time in clock ticks after boot, or 0 if unavailable
+ */
+static unsigned long long kv_process_start_time(int pid, char *state_out) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return 0;
+  }
+
+  char buffer[1024];
+  size_t length = fread(buffer, 1, sizeof(buffer) - 1, file);
+  fclose(file);
+  buffer[length] = '\0';
+
+  // The command name (field 2) is parenthesized and may contain spaces:
+  // count fields from the last ')'. State is field 3, start time field 22
+  char *cursor = strrchr(buffer, ')');
+  if (cursor == NULL) {
+    return 0;
+  }
+  int field = 2;
+  for (cursor++; *cursor != '\0'; cursor++) {
+    if (*cursor != ' ') {
+      continue;
+    }
+    field++;
+    if (field == 3 && state_out != NULL) {
+      *state_out = cursor[1];
+    } else if (field == 22) {
+      return strtoull(cursor + 1, NULL, 10);
+    }
+  }
+  return 0;
+}
+
+/**
+ * Start time of the calling process (read once per process)
+ */
+static unsigned long long kv_self_start_time(void) {
+  static int cached_pid;
+  static unsigned long long cached_start_time;
+
+  int pid = (int)getpid();
+  if (cached_pid != pid) { // First call, or first call after a fork
+    cached_start_time = kv_process_start_time(pid, NULL);
+    cached_pid = pid;
+  }
+  return cached_start_time;
+}
+
+/**
+ * Checks whether the process that claimed a registry entry still runs
+ *
+ * A pid that no longer exists, belongs to a zombie, or was reused by a
+ * process with a different start time counts as gone.
+ */
+static int kv_process_alive(int pid, unsigned long long start_time) {
+  int saved_errno = errno;
+  int alive = kill(pid, 0) == 0 || errno != ESRCH;
+  errno = saved_errno;
+  if (!alive) {
+    return 0;
+  }
+
+  char state = '?';
+  unsigned long long current = kv_process_start_time(pid, &state);
+  if (state == 'Z' || state == 'X') {
+    return 0;
+  }
+  return start_time == 0 || current == 0 || current == start_time;
+}
+
+/**
+ * Frees a registry entry (its epoch no longer pins anything)
+ */
+static void kv_registry_free(kv_registry_entry_t *entry) {
+  atomic_store_explicit(&entry->epoch, 0, memory_order_relaxed);
+  atomic_store_explicit(&entry->heartbeat, 0, memory_order_relaxed);
+  atomic_store_explicit(&entry->start_time, 0, memory_order_relaxed);
+  atomic_store_explicit(&entry->thread, 0, memory_order_relaxed);
+  atomic_store_explicit(&entry->pid, 0, memory_order_release);
+}
+
+/**
+ * Frees a process table entry
+ */
+static void kv_process_free(kv_process_entry_t *process) {
+  atomic_store_explicit(&process->attachments, 0, memory_order_relaxed);
+  atomic_store_explicit(&process->start_time, 0, memory_order_relaxed);
+  atomic_store_explicit(&process->pid, 0, memory_order_release);
+}
+
+/**
+ * Frees the entries of threads and processes that are gone
+ *
+ * Needs no lock: an entry is first switched from the dead pid to -1 with a
+ * compare-and-swap, so of two reapers only one frees it, and no thread can
+ * claim it (claims start from 0) until it is completely cleared.
+ *
+ * @return Number of registry entries freed
+ */
+static unsigned int kv_registry_reap(shared_memory_kv_store_t *store) {
+  int self = (int)getpid();
+  unsigned int reaped = 0;
+
+  atomic_store_explicit(&store->last_reap, (long long)time(NULL),
+                        memory_order_relaxed);
+
+  // Step 1: Thread entries of dead processes, and of exited threads of
+  // live ones (a thread that exits normally frees its own entries)
+  for (unsigned int i = 0; i < KV_REGISTRY_SIZE; i++) {
+    kv_registry_entry_t *entry = &store->registry[i];
+    int pid = atomic_load_explicit(&entry->pid, memory_order_acquire);
+    if (pid <= 0) {
+      continue;
+    }
+    int alive = pid == self ||
+                kv_process_alive(pid, atomic_load_explicit(
+                                          &entry->start_time,
+                                          memory_order_relaxed));
+    if (alive &&
+        kv_thread_alive(pid, atomic_load_explicit(&entry->tid,
+                                                  memory_order_relaxed))) {
+      continue;
+    }
+    if (!atomic_compare_exchange_strong(&entry->pid, &pid, -1)) {
+      continue; // Another reaper got there first
+    }
+    kv_registry_free(entry);
+    reaped++;
+  }
+
+  // Step 2: Attachment counts of dead processes
+  for (unsigned int i = 0; i < KV_PROCESS_MAX; i++) {
+    kv_process_entry_t *process = &store->processes[i];
+    int pid = atomic_load_explicit(&process->pid, memory_order_acquire);
+    if (pid <= 0 || pid == self ||
+        kv_process_alive(pid, atomic_load_explicit(&process->start_time,
+                                                   memory_order_relaxed))) {
+      continue;
+    }
+    if (atomic_compare_exchange_strong(&process->pid, &pid, -1)) {
+      kv_process_free(process);
+    }
+  }
+
+  atomic_fetch_add_explicit(&store->reaped, reaped, memory_order_relaxed);
+  return reaped;
+}
+
+/**
+ * Frees the registry entries of an exiting thread (pthread key destructor)
+ *
+ * Only entries in the thread's cache are freed here, and only in stores
+ * the process still has mapped; reaping finds any others once the thread
+ * is gone. An entry still announcing an epoch is left to reaping as well.
+ */
+static void kv_thread_exit(void *value) {
+  (void)value;
+  int pid = (int)getpid();
+  uintptr_t thread = (uintptr_t)&kv_thread_marker;
+
+  pthread_mutex_lock(&kv_mapped_lock);
+  for (unsigned int i = 0; i < KV_SHARD_MAX; i++) {
+    shared_memory_kv_store_t *store =
+        (shared_memory_kv_store_t *)kv_registry_cache[i].store;
+    unsigned int mapped = 0;
+    while (store != NULL && mapped < KV_MAPPED_MAX &&
+           kv_mapped[mapped] != store) {
+      mapped++;
+    }
+    if (store == NULL || mapped == KV_MAPPED_MAX) {
+      continue;
+    }
+
+    kv_registry_entry_t *entry = &store->registry[kv_registry_cache[i].index];
+    int owner = pid;
+    if (atomic_load_explicit(&entry->thread, memory_order_relaxed) ==
+            thread &&
+        atomic_load_explicit(&entry->epoch, memory_order_relaxed) == 0 &&
+        atomic_compare_exchange_strong(&entry->pid, &owner, -1)) {
+      kv_registry_free(entry);
+    }
+    kv_registry_cache[i].store = NULL;
+  }
+  pthread_mutex_unlock(&kv_mapped_lock);
+}
+
+/**
+ * Creates the thread exit key (once per process)
+ */
+static void kv_thread_exit_init(void) {
+  pthread_key_create(&kv_thread_exit_key, kv_thread_exit);
+}
+
+/**
+ * Returns the registry entry of the calling thread, claiming one
+ *
+ * @return Registry entry, or NULL if the registry is full
+ */
+static kv_registry_entry_t *kv_registry_entry(shared_memory_kv_store_t *store) {
+  int pid = (int)getpid();
+  uintptr_t thread = (uintptr_t)&kv_thread_marker;
+  int tid = kv_self_tid();
+  unsigned long long start_time = kv_self_start_time();
+
+  // Step 1: Cached entry, if it is still ours (fork, destroy or reaping
+  // may have invalidated it)
+  unsigned int cached = 0;
+  while (cached < KV_SHARD_MAX && kv_registry_cache[cached].store != store) {
+    cached++;
+  }
+  if (cached < KV_SHARD_MAX) {
+    kv_registry_entry_t *entry =
+        &store->registry[kv_registry_cache[cached].index];
+    if (atomic_load_explicit(&entry->pid, memory_order_relaxed) == pid &&
+        atomic_load_explicit(&entry->thread, memory_order_relaxed) ==
+            thread) {
+      return entry;
+    }
+  }
+
+  // Step 2: An entry this thread claimed through another mapping, or a
+  // free one (claimed by compare-and-swap against other processes). The
+  // start time keeps a process from adopting the stale entry of an earlier
+  // one that had the same pid
+  int index = -1;
+  for (int i = 0; i < KV_REGISTRY_SIZE && index == -1; i++) {
+    kv_registry_entry_t *entry = &store->registry[i];
+    if (atomic_load_explicit(&entry->pid, memory_order_relaxed) == pid &&
+        atomic_load_explicit(&entry->thread, memory_order_relaxed) ==
+            thread &&
+        atomic_load_explicit(&entry->tid, memory_order_relaxed) == tid &&
+        atomic_load_explicit(&entry->start_time, memory_order_relaxed) ==
+            start_time) {
+      index = i;
+    }
+  }
+  for (int i = 0; i < KV_REGISTRY_SIZE && index == -1; i++) {
+    kv_registry_entry_t *entry = &store->registry[i];
+    int expected = 0;
+    if (atomic_compare_exchange_strong(&entry->pid, &expected, pid)) {
+      atomic_store_explicit(&entry->epoch, 0, memory_order_relaxed);
+      atomic_store_explicit(&entry->start_time, start_time,
+                            memory_order_relaxed);
+      atomic_store_explicit(&entry->heartbeat, (long long)time(NULL),
+                            memory_order_relaxed);
+      atomic_store_explicit(&entry->tid, tid, memory_order_relaxed);
+      atomic_store_explicit(&entry->thread, thread, memory_order_release);
+      index = i;
+    }
+  }
+  if (index == -1) {
+    return NULL;
+  }
+
+  // Step 3: Have the entry freed when this thread exits
+  pthread_once(&kv_thread_exit_once, kv_thread_exit_init);
+  pthread_setspecific(kv_thread_exit_key, &kv_thread_marker);
+
+  if (cached == KV_SHARD_MAX) {
+    cached = kv_registry_cache_next;
+    kv_registry_cache_next = (cached + 1) % KV_SHARD_MAX;
+  }
+  kv_registry_cache[cached].store = store;
+  kv_registry_cache[cached].index = index;
+  return &store->registry[index];
+}
+
+/**
+ * Returns the entry the calling thread announces its reads in
+ *
+ * Its registry entry or, when the registry is full, one of the shared
+ * reader entries: an idle one if there is one, so that busy entries can
+ * drain and let reclamation advance.
+ *
+ * @return Registry entry or shared reader entry, never NULL
+ */
+static kv_registry_entry_t *kv_reader_entry(shared_memory_kv_store_t *store) {
+  kv_registry_entry_t *entry = kv_registry_entry(store);
+  if (entry != NULL) {
+    return entry;
+  }
+
+  unsigned int first = (unsigned int)kv_self_tid() % KV_SHARED_READERS;
+  for (unsigned int i = 0; i < KV_SHARED_READERS; i++) {
+    entry = &store->shared_readers[(first + i) % KV_SHARED_READERS];
+    if (atomic_load_explicit(&entry->epoch, memory_order_relaxed) == 0) {
+      return entry;
+    }
+  }
+  return &store->shared_readers[first];
+}
+
+/**
+ * Counts one more attachment of the calling process
+ *
+ * @return 0 on success, -1 if the process table is full
+ */
+static int kv_process_attach(shared_memory_kv_store_t *store) {
+  int pid = (int)getpid();
+  unsigned long long start_time = kv_self_start_time();
+
+  // Step 1: Our entry, unless it is being freed (count 0)
+  for (unsigned int i = 0; i < KV_PROCESS_MAX; i++) {
+    kv_process_entry_t *process = &store->processes[i];
+    if (atomic_load_explicit(&process->pid, memory_order_acquire) != pid ||
+        atomic_load_explicit(&process->start_time, memory_order_relaxed) !=
+            start_time) {
+      continue;
+    }
+    unsigned int count =
+        atomic_load_explicit(&process->attachments, memory_order_relaxed);
+    while (count > 0 && !atomic_compare_exchange_weak(&process->attachments,
+                                                      &count, count + 1)) {
+    }
+    if (count > 0) {
+      return 0;
+    }
+  }
+
+  // Step 2: A free entry
+  for (unsigned int i = 0; i < KV_PROCESS_MAX; i++) {
+    kv_process_entry_t *process = &store->processes[i];
+    int expected = 0;
+    if (atomic_compare_exchange_strong(&process->pid, &expected, pid)) {
+      atomic_store_explicit(&process->start_time, start_time,
+                            memory_order_relaxed);
+      atomic_store_explicit(&process->attachments, 1, memory_order_release);
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Counts one attachment of the calling process less
+ */
+static void kv_process_detach(shared_memory_kv_store_t *store) {
+  int pid = (int)getpid();
+  for (unsigned int i = 0; i < KV_PROCESS_MAX; i++) {
+    kv_process_entry_t *process = &store->processes[i];
+    if (atomic_load_explicit(&process->pid, memory_order_acquire) != pid) {
+      continue;
+    }
+    unsigned int count =
+        atomic_load_explicit(&process->attachments, memory_order_relaxed);
+    while (count > 0 && !atomic_compare_exchange_weak(&process->attachments,
+                                                      &count, count - 1)) {
+    }
+    if (count == 1) {
+      kv_process_free(process); // Attach no longer counts on it (0)
+    }
+    if (count > 0) {
+      return;
+    }
+  }
+}
+
+/**
+ * Registers the calling process when it creates or opens the store
+ *
+ * Full tables are reaped once before giving up. Without a registry entry
+ * the store stays usable (reads then use an overflow path), but the
+ * process must be counted for shared_memory_kv_unlink_safe().
+ *
+ * @return 0 on success, -1 if KV_PROCESS_MAX processes are attached
+ *         (errno set to EAGAIN)
+ */
+static int kv_registry_attach(shared_memory_kv_store_t *store) {
+  if (kv_process_attach(store) == -1) {
+    kv_registry_reap(store);
+    if (kv_process_attach(store) == -1) {
+      errno = EAGAIN;
+      return -1;
+    }
+  }
+
+  // Remember the mapping for the thread exit handler
+  pthread_mutex_lock(&kv_mapped_lock);
+  for (unsigned int i = 0; i < KV_MAPPED_MAX; i++) {
+    if (kv_mapped[i] == NULL) {
+      kv_mapped[i] = store;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&kv_mapped_lock);
+
+  if (kv_registry_entry(store) == NULL) {
+    kv_registry_reap(store);
+    kv_registry_entry(store);
+  }
+  return 0;
+}
+
+/**
+ * Undoes kv_registry_attach() before the store is unmapped
+ */
+static void kv_registry_detach(shared_memory_kv_store_t *store) {
+  pthread_mutex_lock(&kv_mapped_lock);
+  for (unsigned int i = 0; i < KV_MAPPED_MAX; i++) {
+    if (kv_mapped[i] == store) {
+      kv_mapped[i] = NULL;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&kv_mapped_lock);
+  kv_process_detach(store);
+}
+
+// ============================================================================
+// VERSION CHAINS AND EPOCH RECLAMATION
+// ============================================================================
+
+/**
+ * One version of an entry, immutable once published
+ *
+ * Owns one reference to its value blob; the key blobs are borrowed from the
+ * slot (they are retired together with the chain when the key is deleted).
+ * prev is the only field written after publication: it is cleared when the
+ * chain is trimmed to KV_MVCC_VERSIONS.
+ */
+typedef struct {
+  unsigned int key_prefix_ref; // Key blobs of the slot
+  unsigned int key_suffix_ref;
+  unsigned int value_ref;      // Value blob (owned)
+  unsigned int store_version;  // Store version that wrote this version
+  _Atomic unsigned int prev;   // Next older version (0 = end of chain)
+  time_t timestamp;            // Write time
+} kv_version_t;
+
+// Kinds of retired objects (kv_retired_t.kind)
+#define KV_RETIRED_VERSION 1 // Version record (and its value reference)
+#define KV_RETIRED_BLOB 2    // Key blob reference
+
+/**
+ * Resolves a version record offset
+ */
+static kv_version_t *kv_version(const shared_memory_kv_store_t *store,
+                                unsigned int offset) {
+  return offset == 0 ? NULL : (kv_version_t *)&store->arena[offset];
+}
+
+/**
+ * Describes a version as a slot, for the key and value helpers
+ */
+static kv_pair_t kv_version_view(const kv_version_t *version) {
+  kv_pair_t view = {0};
+  view.key_prefix_ref = version->key_prefix_ref;
+  view.key_suffix_ref = version->key_suffix_ref;
+  view.value_ref = version->value_ref;
+  view.timestamp = version->timestamp;
+  return view;
+}
+
+/**
+ * Frees a retired object (no reader can reach it any more)
+ */
+static void kv_reclaim_item(shared_memory_kv_store_t *store,
+                            const kv_retired_t *item) {
+  if (item->kind == KV_RETIRED_VERSION) {
+    kv_blob_release(store, kv_version(store, item->offset)->value_ref);
+    kv_arena_free(store, item->offset);
+    store->version_records--;
+  } else {
+    kv_blob_release(store, item->offset);
+  }
+  store->reclaimed++;
+}
+
+/**
+ * Advances the global epoch if possible and frees what no reader can see
+ *
+ * The epoch moves on once every active reader has announced the current
+ * one. An object retired in epoch E was unlinked before the epoch moved
+ * past E, so readers that announced a later epoch cannot have found it;
+ * it is freed when every active reader is past E.
+ */
+static void kv_reclaim(shared_memory_kv_store_t *store) {
+  if (store->retired_count == 0) {
+    return;
+  }
+
+  // Step 1: Order the unlinking stores before reading the registry
+  atomic_thread_fence(memory_order_seq_cst);
+
+  // Step 2: Find the oldest announced epoch
+  unsigned long long epoch =
+      atomic_load_explicit(&store->epoch, memory_order_relaxed);
+  unsigned long long oldest = 0;
+  for (unsigned int i = 0; i < KV_REGISTRY_SIZE + KV_SHARED_READERS; i++) {
+    const kv_registry_entry_t *entry =
+        i < KV_REGISTRY_SIZE ? &store->registry[i]
+                             : &store->shared_readers[i - KV_REGISTRY_SIZE];
+    unsigned long long announced =
+        atomic_load_explicit(&entry->epoch, memory_order_seq_cst);
+    if (i >= KV_REGISTRY_SIZE) {
+      announced &= KV_SHARED_EPOCH_MASK; // Without the reader count
+    }
+    if (announced != 0 && (oldest == 0 || announced < oldest)) {
+      oldest = announced;
+    }
+  }
+
+  // Step 3: Advance when all readers caught up (or none is reading)
+  if (oldest == 0 || oldest == epoch) {
+    epoch++;
+    atomic_store_explicit(&store->epoch, epoch, memory_order_seq_cst);
+  }
+  if (oldest == 0) {
+    oldest = epoch;
+  }
+
+  // Step 4: Free everything retired before the oldest announced epoch
+  unsigned int kept = 0;
+  for (unsigned int i = 0; i < store->retired_count; i++) {
+    if (store->retired[i].epoch < oldest) {
+      kv_reclaim_item(store, &store->retired[i]);
+    } else {
+      store->retired[kept++] = store->retired[i];
+    }
+  }
+  store->retired_count = kept;
+}
+
+/**
+ * Makes room for retiring objects without waiting for readers
+ *
+ * A write only frees what readers already moved past: a reader that is
+ * slow (or preempted mid-read) makes it fail instead of stalling the other
+ * writers and the lock-free readers spinning on the seqlock.
+ *
+ * @param needed Number of objects the caller is about to retire
+ * @return 0 if they fit, -1 if not (errno set to EAGAIN)
+ */
+static int kv_retire_room(shared_memory_kv_store_t *store,
+                          unsigned int needed) {
+  if (store->retired_count + needed > KV_RETIRED_MAX) {
+    kv_reclaim(store);
+  }
+  // The oldest reader may have died mid-read
+  if (store->retired_count + needed > KV_RETIRED_MAX &&
+      kv_registry_reap(store) > 0) {
+    kv_reclaim(store);
+  }
+  if (store->retired_count + needed > KV_RETIRED_MAX) {
+    errno = EAGAIN;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Queues an unlinked object for freeing once readers moved past it
+ *
+ * Callers check kv_retire_room() first; an object that still does not fit
+ * is leaked rather than freed under a reader that may still use it.
+ */
+static void kv_retire(shared_memory_kv_store_t *store, unsigned int kind,
+                      unsigned int offset) {
+  if (offset == 0) {
+    return;
+  }
+  if (store->retired_count == KV_RETIRED_MAX) {
+    store->retire_overflows++;
+    return;
+  }
+
+  kv_retired_t *item = &store->retired[store->retired_count++];
+  item->offset = offset;
+  item->kind = kind;
+  item->epoch = atomic_load_explicit(&store->epoch, memory_order_relaxed);
+}
+
+/**
+ * Counts the version records of a chain
+ */
+static unsigned int kv_version_count(shared_memory_kv_store_t *store,
+                                     unsigned int offset) {
+  unsigned int count = 0;
+  for (kv_version_t *version = kv_version(store, offset); version != NULL;
+       version = kv_version(store, atomic_load_explicit(
+                                       &version->prev, memory_order_relaxed))) {
+    count++;
+  }
+  return count;
+}
+
+/**
+ * Retires a version record and all older ones
+ */
+static void kv_version_retire_chain(shared_memory_kv_store_t *store,
+                                    unsigned int offset) {
+  while (offset != 0) {
+    unsigned int prev = atomic_load_explicit(&kv_version(store, offset)->prev,
+                                             memory_order_relaxed);
+    kv_retire(store, KV_RETIRED_VERSION, offset);
+    offset = prev;
+  }
+}
+
+/**
+ * Cuts a chain after its KV_MVCC_VERSIONS newest versions, unless the
+ * retire list has no room for the cut-off ones
+ */
+static void kv_version_trim(shared_memory_kv_store_t *store,
+                            unsigned int head) {
+  kv_version_t *last = kv_version(store, head);
+  for (unsigned int depth = 1; depth < KV_MVCC_VERSIONS && last != NULL;
+       depth++) {
+    last = kv_version(store, atomic_load_explicit(&last->prev,
+                                                  memory_order_relaxed));
+  }
+  if (last == NULL) {
+    return;
+  }
+
+  // With the retire list full the chain stays longer for now; a later
+  // write to the key trims it
+  unsigned int tail = atomic_load_explicit(&last->prev, memory_order_relaxed);
+  if (kv_retire_room(store, kv_version_count(store, tail)) == -1) {
+    return;
+  }
+  atomic_store_explicit(&last->prev, 0, memory_order_release);
+  kv_version_retire_chain(store, tail);
+}
+
+/**
+ * Announces the current epoch before following any offset
+ */
+static void kv_epoch_enter(shared_memory_kv_store_t *store,
+                           kv_registry_entry_t *reader) {
+  unsigned long long epoch =
+      atomic_load_explicit(&store->epoch, memory_order_seq_cst);
+  if (atomic_load_explicit(&reader->pid, memory_order_relaxed) !=
+      KV_REGISTRY_SHARED) {
+    atomic_store_explicit(&reader->epoch, epoch, memory_order_seq_cst);
+    atomic_thread_fence(memory_order_seq_cst);
+    return;
+  }
+
+  // Shared reader entry: count this reader in; the first one announces
+  // the epoch, later ones keep the older epoch already announced
+  unsigned long long state =
+      atomic_load_explicit(&reader->epoch, memory_order_relaxed);
+  unsigned long long joined;
+  do {
+    joined = state + (1ULL << KV_SHARED_EPOCH_BITS);
+    if ((state & KV_SHARED_EPOCH_MASK) == 0) {
+      joined |= epoch & KV_SHARED_EPOCH_MASK;
+    }
+  } while (!atomic_compare_exchange_weak(&reader->epoch, &state, joined));
+  atomic_thread_fence(memory_order_seq_cst);
+}
+
+/**
+ * Ends a read: nothing it found is used any more
+ */
+static void kv_epoch_exit(kv_registry_entry_t *reader) {
+  if (atomic_load_explicit(&reader->pid, memory_order_relaxed) !=
+      KV_REGISTRY_SHARED) {
+    atomic_store_explicit(&reader->epoch, 0, memory_order_release);
+    return;
+  }
+
+  // Shared reader entry: the last reader out clears the epoch
+  unsigned long long state =
+      atomic_load_explicit(&reader->epoch, memory_order_relaxed);
+  unsigned long long left;
+  do {
+    left = state - (1ULL << KV_SHARED_EPOCH_BITS);
+    if ((left >> KV_SHARED_EPOCH_BITS) == 0) {
+      left = 0;
+    }
+  } while (!atomic_compare_exchange_weak_explicit(
+      &reader->epoch, &state, left, memory_order_release,
+      memory_order_relaxed));
+}
+
+// ============================================================================
+// WRITER EXCLUSION (semaphore, or none with KV_FLAG_SINGLE_WRITER)
+// ============================================================================
+
+/**
+ * Table read in progress (see kv_read_lock)
+ */
+typedef struct {
+  kv_registry_entry_t *reader; // Entry announcing the epoch (single writer)
+  unsigned int seq;            // Store sequence when the attempt started
+} kv_read_t;
+
+/**
+ * Checks whether the store was created with KV_FLAG_SINGLE_WRITER
+ */
+static int kv_single_writer(const shared_memory_kv_store_t *store) {
+  return (store->flags & KV_FLAG_SINGLE_WRITER) != 0;
+}
+
+/**
+ * Gets exclusive write access before a modification
+ *
+ * Takes the semaphore; with KV_FLAG_SINGLE_WRITER there is nobody to
+ * exclude, so only the caller is checked to be the writer: the thread that
+ * created the store. Any other thread, even of the same process, would
+ * write concurrently without a lock.
+ *
+ * @return 0 on success, -1 on error (errno set: EPERM if another process
+ *         or thread is the single writer)
+ */
+static int kv_write_lock(shared_memory_kv_store_t *store) {
+  if (kv_single_writer(store)) {
+    if ((int)getpid() != store->writer_pid ||
+        (uintptr_t)&kv_thread_marker != store->writer_thread) {
+      errno = EPERM;
+      return -1;
+    }
+    return 0;
+  }
+
+  if (sem_wait(&store->sem) == -1) {
+    perror("sem_wait failed");
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Starts a read that needs a stable table
+ *
+ * Takes the semaphore. With KV_FLAG_SINGLE_WRITER the writer never takes
+ * it, so the read instead runs inside an epoch (nothing it follows is
+ * freed) between two checks of the sequence lock, and is repeated when
+ * kv_read_unlock() reports that a write overlapped it. Used as:
+ *
+ *   do { kv_read_lock(); ...read, outputs reset first...; }
+ *   while (kv_read_unlock());
+ *
+ * @return 0 on success, -1 on error
+ */
+static int kv_read_lock(shared_memory_kv_store_t *store, kv_read_t *read) {
+  if (!kv_single_writer(store)) {
+    if (sem_wait(&store->sem) == -1) {
+      perror("sem_wait failed");
+      return -1;
+    }
+    return 0;
+  }
+
+  read->reader = kv_reader_entry(store);
+  while ((read->seq = kv_seq_read_begin(store)) & 1) {
+    sched_yield(); // A write is in progress: let the writer finish it
+  }
+  kv_epoch_enter(store, read->reader);
+  return 0;
+}
+
+/**
+ * Ends a read started with kv_read_lock()
+ *
+ * @return 1 if the read overlapped a write and must be repeated, else 0
+ */
+static int kv_read_unlock(shared_memory_kv_store_t *store, kv_read_t *read) {
+  if (!kv_single_writer(store)) {
+    if (sem_post(&store->sem) == -1) {
+      perror("sem_post failed");
+    }
+    return 0;
+  }
+
+  kv_epoch_exit(read->reader);
+  return !kv_seq_read_valid(store, read->seq);
+}
+
+// ============================================================================
+// HASH TABLE (internal helpers, caller must hold the semaphore)
+// ============================================================================
+
+/**
+ * FNV-1a hash of a key
+ *
+ * Small and good enough for short string keys; the full 32-bit value is
+ * kept in the slot so most mismatching probes skip the key comparison.
+ */
+static unsigned int kv_hash_key(const char *key) {
+  return kv_hash_bytes(key, strnlen(key, KEY_SIZE));
+}
+
+/**
+ * Home slot of a hash (where its probe sequence starts)
+ */
+static unsigned int kv_home_slot(unsigned int hash) {
+  return hash % MAX_ENTRIES;
+}
+
+/**
+ * Finds a key using linear probing
+ *
+ * Walks from the home slot until the key is found or an empty slot ends the
+ * probe sequence. Tombstones are skipped but remembered, so an insert can
+ * reuse the first one.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string
+ * @param hash kv_hash_key(key)
+ * @param free_slot_out Optional: first tombstone or empty slot on the probe
+ *        sequence, -1 if the whole table was probed without one
+ * @return Slot index of the key, or -1 if not found
+ */
+static int kv_find_slot(const shared_memory_kv_store_t *store, const char *key,
+                        unsigned int hash, int *free_slot_out) {
+  int free_slot = -1;
+  unsigned int slot = kv_home_slot(hash);
+
+  for (unsigned int probe = 0; probe < MAX_ENTRIES; probe++) {
+    const kv_pair_t *pair = &store->kv_table[slot];
+
+    if (pair->state == KV_SLOT_EMPTY) {
+      // End of the probe sequence: key is not in the table
+      if (free_slot == -1) {
+        free_slot = (int)slot;
+      }
+      break;
+    }
+
+    if (pair->state == KV_SLOT_TOMBSTONE) {
+      if (free_slot == -1) {
+        free_slot = (int)slot;
+      }
+    } else if (pair->hash == hash && kv_key_compare(store, pair, key) == 0) {
+      if (free_slot_out != NULL) {
+        *free_slot_out = free_slot;
+      }
+      return (int)slot;
+    }
+
+    slot = (slot + 1) % MAX_ENTRIES;
+  }
+
+  if (free_slot_out != NULL) {
+    *free_slot_out = free_slot;
+  }
+  return -1;
+}
+
+/**
+ * Probe length of an occupied slot (1 = entry sits at its home slot)
+ */
+static unsigned int kv_probe_length(unsigned int slot, unsigned int hash) {
+  unsigned int home = kv_home_slot(hash);
+  return (slot + MAX_ENTRIES - home) % MAX_ENTRIES + 1;
+}
+
+/**
+ * Finds the newest version of a key without the semaphore
+ *
+ * Same probe as kv_find_slot(), but the key is compared against the
+ * version record the slot's head points to, not against the slot fields
+ * a writer may be changing. The caller must be inside an epoch
+ * (kv_epoch_enter), which keeps every record reachable from a head alive.
+ * A miss can be spurious if a writer changed the table meanwhile.
+ *
+ * @return Version record offset, or 0 if not found
+ */
+static unsigned int kv_find_version(const shared_memory_kv_store_t *store,
+                                    const char *key, unsigned int hash) {
+  unsigned int slot = kv_home_slot(hash);
+
+  for (unsigned int probe = 0; probe < MAX_ENTRIES; probe++) {
+    const kv_pair_t *pair = &store->kv_table[slot];
+
+    if (pair->state == KV_SLOT_EMPTY) {
+      break;
+    }
+
+    if (pair->state == KV_SLOT_OCCUPIED && pair->hash == hash) {
+      unsigned int head =
+          atomic_load_explicit(&pair->head, memory_order_acquire);
+      if (head != 0) {
+        kv_pair_t view = kv_version_view(kv_version(store, head));
+        if (kv_key_compare(store, &view, key) == 0) {
+          return head;
+        }
+      }
+    }
+
+    slot = (slot + 1) % MAX_ENTRIES;
+  }
+
+  return 0;
+}
+
+// ============================================================================
+// SORTED KEY INDEX (internal helpers, caller must hold the semaphore)
+// ============================================================================
+
+/**
+ * Finds the first position in key_index whose key is >= key
+ *
+ * Standard binary search (lower bound) over the first entry_count elements.
+ */
+static unsigned int kv_index_lower_bound(const shared_memory_kv_store_t *store,
+                                         const char *key) {
+  unsigned int low = 0;
+  unsigned int high = store->entry_count;
+
+  while (low < high) {
+    unsigned int mid = low + (high - low) / 2;
+    const kv_pair_t *mid_pair = &store->kv_table[store->key_index[mid]];
+    if (kv_key_compare(store, mid_pair, key) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+/**
+ * Inserts a newly occupied slot into the sorted key index
+ *
+ * Must be called after the key is written to the slot and before
+ * entry_count is incremented.
+ */
+static void kv_index_insert(shared_memory_kv_store_t *store,
+                            unsigned int slot) {
+  char key[KEY_SIZE];
+  kv_key_copy(store, &store->kv_table[slot], key);
+  unsigned int pos = kv_index_lower_bound(store, key);
+
+  // Shift the tail right by one to make room
+  memmove(&store->key_index[pos + 1], &store->key_index[pos],
+          (store->entry_count - pos) * sizeof(store->key_index[0]));
+  store->key_index[pos] = slot;
+}
+
+/**
+ * Removes an occupied slot from the sorted key index
+ *
+ * Must be called while the key is still in the slot and before
+ * entry_count is decremented.
+ */
+static void kv_index_remove(shared_memory_kv_store_t *store,
+                            unsigned int slot) {
+  char key[KEY_SIZE];
+  kv_key_copy(store, &store->kv_table[slot], key);
+  unsigned int pos = kv_index_lower_bound(store, key);
+
+  // Keys are unique, so the slot is at the lower bound position
+  if (pos >= store->entry_count || store->key_index[pos] != slot) {
+    return;
+  }
+
+  // Shift the tail left by one to close the gap
+  memmove(&store->key_index[pos], &store->key_index[pos + 1],
+          (store->entry_count - pos - 1) * sizeof(store->key_index[0]));
+}
+
+/**
+ * Points the sorted key index entry of a key to a new slot
+ *
+ * Used when an entry is moved; the key (and so its index position) does
+ * not change. Call while the key is present in from_slot.
+ */
+static void kv_index_relocate(shared_memory_kv_store_t *store,
+                              unsigned int from_slot, unsigned int to_slot) {
+  char key[KEY_SIZE];
+  kv_key_copy(store, &store->kv_table[from_slot], key);
+  unsigned int pos = kv_index_lower_bound(store, key);
+
+  if (pos < store->entry_count && store->key_index[pos] == from_slot) {
+    store->key_index[pos] = to_slot;
+  }
+}
+
+// ============================================================================
+// KEY SUBSCRIPTIONS (claimed and freed lock-free, woken through a futex)
+// ============================================================================
+
+/**
+ * Futex system call on a word in the segment
+ *
+ * Shared (no FUTEX_PRIVATE_FLAG): waiters and wakers are different
+ * processes, each with its own mapping of the segment.
+ */
+static long kv_futex(_Atomic unsigned int *word, int op, unsigned int value,
+                     const struct timespec *timeout) {
+  return syscall(SYS_futex, (unsigned int *)word, op, value, timeout, NULL,
+                 0);
+}
+
+// Socket this thread sends notification datagrams from (inherited by
+// forked children, where it keeps working)
+static _Thread_local int kv_notify_sender = -1;
+
+// Subscriptions the current write of this thread signalled; they are
+// woken once the write lock is released (see kv_notify_flush)
+static _Thread_local struct {
+  shared_memory_kv_store_t *store;
+  unsigned char wake[KV_SUBSCRIPTIONS]; // 1 = wake after the write
+  unsigned int count;                   // Elements of wake set
+} kv_notify_pending;
+
+/**
+ * Fills in the abstract socket address of a subscription's notifications
+ *
+ * @return Length of the address
+ */
+static socklen_t kv_notify_address(struct sockaddr_un *address, int pid,
+                                   int subscription) {
+  memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  // sun_path[0] stays '\0': abstract namespace, no file to clean up
+  int length = snprintf(address->sun_path + 1, sizeof(address->sun_path) - 1,
+                        KV_NOTIFY_SOCKET_FORMAT, pid, subscription);
+  return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + length);
+}
+
+/**
+ * Sends a notification datagram to an armed subscription
+ *
+ * Non-blocking and best effort: the event counter, not the datagram,
+ * carries the information, so a full or closed socket is ignored.
+ */
+static void kv_subscription_send(shared_memory_kv_store_t *store,
+                                 kv_subscription_t *subscription) {
+  if (!atomic_load(&subscription->notify_socket) ||
+      !atomic_exchange(&subscription->notify_armed, 0)) {
+    return;
+  }
+  if (kv_notify_sender == -1) {
+    kv_notify_sender =
+        socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (kv_notify_sender == -1) {
+      return;
+    }
+  }
+
+  struct sockaddr_un address;
+  socklen_t length = kv_notify_address(
+      &address, atomic_load_explicit(&subscription->pid, memory_order_relaxed),
+      (int)(subscription - store->subscriptions));
+  int saved_errno = errno;
+  char byte = 1;
+  sendto(kv_notify_sender, &byte, 1, MSG_DONTWAIT,
+         (const struct sockaddr *)&address, length);
+  errno = saved_errno;
+}
+
+/**
+ * Wakes the waiters of a subscription, if any, and sends its datagram
+ */
+static void kv_subscription_wake(shared_memory_kv_store_t *store,
+                                 kv_subscription_t *subscription) {
+  if (atomic_load(&subscription->waiters) > 0) {
+    kv_futex(&subscription->events, FUTEX_WAKE, INT_MAX, NULL);
+  }
+  kv_subscription_send(store, subscription);
+}
+
+/**
+ * Counts an event of a subscription and wakes its waiters, if any
+ *
+ * The counter is incremented before the waiter count (and the armed flag
+ * of the notification socket) is read, and waiters register (or re-arm)
+ * before they compare the counter, so a waiter either sees the new counter
+ * or is woken.
+ */
+static void kv_subscription_signal(shared_memory_kv_store_t *store,
+                                   kv_subscription_t *subscription) {
+  atomic_fetch_add(&subscription->events, 1);
+  kv_subscription_wake(store, subscription);
+}
+
+/**
+ * Checks whether a key matches one of the patterns of a subscription
+ */
+static int kv_subscription_matches(const kv_subscription_t *subscription,
+                                   const char *key) {
+  unsigned int count = subscription->pattern_count;
+  if (count > KV_SUBSCRIPTION_KEYS) {
+    count = KV_SUBSCRIPTION_KEYS; // Entry being claimed by a subscriber
+  }
+  for (unsigned int i = 0; i < count; i++) {
+    const char *pattern = subscription->patterns[i];
+    if (subscription->flags & KV_SUBSCRIBE_PREFIX) {
+      if (strncmp(key, pattern, strnlen(pattern, KEY_SIZE)) == 0) {
+        return 1;
+      }
+    } else if (strncmp(key, pattern, KEY_SIZE) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Frees a subscription whose pid the caller switched to -1
+ *
+ * Waiters still sleeping on it are woken (and then find it gone).
+ */
+static void kv_subscription_free(shared_memory_kv_store_t *store,
+                                 kv_subscription_t *subscription) {
+  subscription->pattern_count = 0;
+  subscription->flags = 0;
+  kv_subscription_signal(store, subscription);
+  atomic_store(&subscription->notify_socket, 0);
+  atomic_fetch_sub_explicit(&store->subscription_count, 1,
+                            memory_order_relaxed);
+  atomic_store_explicit(&subscription->pid, 0, memory_order_release);
+}
+
+/**
+ * Frees the subscriptions of processes that are gone
+ *
+ * Same compare-and-swap protocol as kv_registry_reap().
+ *
+ * @return Number of subscriptions freed
+ */
+static unsigned int kv_subscription_reap(shared_memory_kv_store_t *store) {
+  int self = (int)getpid();
+  unsigned int reaped = 0;
+
+  for (unsigned int i = 0; i < KV_SUBSCRIPTIONS; i++) {
+    kv_subscription_t *subscription = &store->subscriptions[i];
+    int pid = atomic_load_explicit(&subscription->pid, memory_order_acquire);
+    if (pid <= 0 || pid == self ||
+        kv_process_alive(pid, subscription->start_time)) {
+      continue;
+    }
+    if (atomic_compare_exchange_strong(&subscription->pid, &pid, -1)) {
+      kv_subscription_free(store, subscription);
+      reaped++;
+    }
+  }
+  return reaped;
+}
+
+/**
+ * Wakes the subscriptions collected by kv_notify() since the last call
+ *
+ * Called once the write lock is released, so the wake-up system calls
+ * and datagrams do not lengthen the critical section.
+ */
+static void kv_notify_flush(void) {
+  if (kv_notify_pending.count == 0) {
+    return;
+  }
+  shared_memory_kv_store_t *store = kv_notify_pending.store;
+  int saved_errno = errno;
+  kv_notify_pending.count = 0;
+  for (unsigned int i = 0; i < KV_SUBSCRIPTIONS; i++) {
+    if (kv_notify_pending.wake[i]) {
+      kv_notify_pending.wake[i] = 0;
+      kv_subscription_wake(store, &store->subscriptions[i]);
+    }
+  }
+  errno = saved_errno;
+}
+
+/**
+ * Signals every subscription matching a changed key; called by the writer
+ * after a set or delete of that key
+ *
+ * Only counts the event here; waiters are woken by kv_notify_flush()
+ * after the write lock is released (a waiter that checks the counter
+ * before that sees the event anyway).
+ */
+static void kv_notify(shared_memory_kv_store_t *store, const char *key) {
+  if (atomic_load_explicit(&store->subscription_count,
+                           memory_order_acquire) == 0) {
+    return;
+  }
+  if (kv_notify_pending.store != store) {
+    kv_notify_flush(); // Wakes left over from another store, if any
+    kv_notify_pending.store = store;
+  }
+
+  for (unsigned int i = 0; i < KV_SUBSCRIPTIONS; i++) {
+    kv_subscription_t *subscription = &store->subscriptions[i];
+    if (atomic_load_explicit(&subscription->pid, memory_order_acquire) <= 0 ||
+        !kv_subscription_matches(subscription, key)) {
+      continue;
+    }
+    atomic_store_explicit(&subscription->last_version, store->version,
+                          memory_order_relaxed);
+    atomic_fetch_add(&subscription->events, 1);
+    if (!kv_notify_pending.wake[i]) {
+      kv_notify_pending.wake[i] = 1;
+      kv_notify_pending.count++;
+    }
+    atomic_fetch_add_explicit(&store->notifications, 1,
+                              memory_order_relaxed);
+  }
+}
+
+/**
+ * Ends a modification started with kv_write_lock(), then wakes the
+ * subscribers it notified
+ */
+static void kv_write_unlock(shared_memory_kv_store_t *store) {
+  if (!kv_single_writer(store) && sem_post(&store->sem) == -1) {
+    perror("sem_post failed");
+  }
+  kv_notify_flush();
+}
+
+// ============================================================================
+// ROLLUPS
+// ============================================================================
+
+// Window lengths in milliseconds, by window index (KV_ROLLUP_* bit)
+static const long long kv_rollup_window_ms[KV_ROLLUP_WINDOWS] = {
+    1000, 10000, 60000};
+
+/**
+ * Current time in milliseconds since the Unix epoch
+ */
+static long long kv_now_ms(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * Marks the start of a change of a rollup entry (counter odd)
+ */
+static void kv_rollup_write_begin(kv_rollup_t *rollup) {
+  unsigned int seq = atomic_load_explicit(&rollup->seq, memory_order_relaxed);
+  atomic_store_explicit(&rollup->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+/**
+ * Marks the end of a change of a rollup entry (counter even again)
+ */
+static void kv_rollup_write_end(kv_rollup_t *rollup) {
+  unsigned int seq = atomic_load_explicit(&rollup->seq, memory_order_relaxed);
+  atomic_store_explicit(&rollup->seq, seq + 1, memory_order_release);
+}
+
+/**
+ * Copies a rollup entry without locking, retrying while a writer changes it
+ */
+static void kv_rollup_copy(const kv_rollup_t *rollup, kv_rollup_t *copy) {
+  for (;;) {
+    unsigned int seq =
+        atomic_load_explicit(&rollup->seq, memory_order_acquire);
+    if (seq & 1) {
+      sched_yield(); // A write of the key is updating the entry
+      continue;
+    }
+    memcpy(copy, rollup, sizeof(*copy));
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&rollup->seq, memory_order_relaxed) == seq) {
+      return;
+    }
+  }
+}
+
+/**
+ * Finds the rollup entry of a key; the caller holds the semaphore (or is
+ * the single writer)
+ *
+ * @return Entry, or NULL if the key has no rollups
+ */
+static kv_rollup_t *kv_rollup_find(shared_memory_kv_store_t *store,
+                                   const char *key, unsigned int hash) {
+  for (unsigned int i = 0; i < KV_ROLLUP_MAX; i++) {
+    kv_rollup_t *rollup = &store->rollups[i];
+    if (rollup->key[0] != '\0' && rollup->hash == hash &&
+        strncmp(rollup->key, key, KEY_SIZE) == 0) {
+      return rollup;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Moves a window to the bucket starting at start
+ *
+ * The current bucket becomes the previous one if it is the bucket right
+ * before start; if it is older, the previous window saw no writes. Buckets
+ * that already start at (or after) start are left alone.
+ */
+static void kv_rollup_advance(kv_rollup_bucket_t *current,
+                              kv_rollup_bucket_t *previous, long long start,
+                              long long window) {
+  if (current->start >= start) {
+    return;
+  }
+  if (current->start == start - window) {
+    *previous = *current;
+  } else {
+    memset(previous, 0, sizeof(*previous));
+    previous->start = start - window;
+  }
+  memset(current, 0, sizeof(*current));
+  current->start = start;
+}
+
+/**
+ * Moves every window of a rollup entry to the buckets containing now
+ */
+static void kv_rollup_advance_all(kv_rollup_t *rollup, long long now) {
+  for (unsigned int i = 0; i < KV_ROLLUP_WINDOWS; i++) {
+    if (rollup->windows & (1u << i)) {
+      long long window = kv_rollup_window_ms[i];
+      kv_rollup_advance(&rollup->current[i], &rollup->previous[i],
+                        now - now % window, window);
+    }
+  }
+}
+
+/**
+ * Adds a written value to the rollups of its key, if it has any and the
+ * value is a number (a native one, or text that is nothing but a number);
+ * the caller holds the semaphore
+ */
+static void kv_rollup_update(shared_memory_kv_store_t *store, const char *key,
+                             unsigned int hash, const void *value,
+                             size_t value_len, unsigned int type) {
+  // Step 1: Most stores have no rollups: skip the lookup
+  if (atomic_load_explicit(&store->rollup_count, memory_order_relaxed) == 0) {
+    return;
+  }
+  kv_rollup_t *rollup = kv_rollup_find(store, key, hash);
+  if (rollup == NULL) {
+    return;
+  }
+
+  // Step 2: Only numbers count ("12.5", not "12.5 kB")
+  double number;
+  if (type == KV_TYPE_INT64 && value_len == sizeof(long long)) {
+    long long integer;
+    memcpy(&integer, value, sizeof(integer));
+    number = (double)integer;
+  } else if (type == KV_TYPE_DOUBLE && value_len == sizeof(double)) {
+    memcpy(&number, value, sizeof(number));
+  } else if (type == KV_TYPE_STRING) {
+    char *end;
+    number = strtod(value, &end);
+    if (end == (const char *)value || *end != '\0') {
+      return;
+    }
+  } else {
+    return;
+  }
+
+  // Step 3: Add the value to the current bucket of each window
+  long long now = kv_now_ms();
+  kv_rollup_write_begin(rollup);
+  kv_rollup_advance_all(rollup, now);
+  for (unsigned int i = 0; i < KV_ROLLUP_WINDOWS; i++) {
+    kv_rollup_bucket_t *bucket = &rollup->current[i];
+    if (!(rollup->windows & (1u << i))) {
+      continue;
+    }
+    if (bucket->count == 0 || number < bucket->min) {
+      bucket->min = number;
+    }
+    if (bucket->count == 0 || number > bucket->max) {
+      bucket->max = number;
+    }
+    bucket->sum += number;
+    bucket->last = number;
+    bucket->count++;
+  }
+  kv_rollup_write_end(rollup);
+}
+
+/**
+ * Fills a rollup summary from a copied entry, as of now
+ */
+static void kv_rollup_info(kv_rollup_t *copy, kv_rollup_info_t *info,
+                           long long now) {
+  kv_rollup_advance_all(copy, now);
+  memcpy(info->key, copy->key, KEY_SIZE);
+  info->key[KEY_SIZE - 1] = '\0';
+  info->windows = copy->windows;
+  memcpy(info->current, copy->current, sizeof(info->current));
+  memcpy(info->previous, copy->previous, sizeof(info->previous));
+}
+
+// ============================================================================
+// CHANGE LOG (appended by the writer, read lock-free)
+// ============================================================================
+
+/**
+ * Logs a set or delete of a table key and wakes waiting log readers
+ *
+ * The record is invalidated (position 0) before it is rewritten and
+ * published with its position last, so a reader that copied it while it
+ * changed sees a different position afterwards.
+ */
+static void kv_changelog_append(shared_memory_kv_store_t *store,
+                                unsigned int op, const char *key) {
+  unsigned long long position =
+      atomic_load_explicit(&store->changelog_head, memory_order_relaxed);
+  kv_changelog_record_t *record =
+      &store->changelog[position % KV_CHANGELOG_SIZE];
+
+  atomic_store_explicit(&record->position, 0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  record->op = op;
+  record->version = store->version;
+  record->timestamp = kv_now_ms();
+  size_t key_len = strnlen(key, KEY_SIZE - 1);
+  memcpy(record->key, key, key_len);
+  record->key[key_len] = '\0';
+  atomic_store_explicit(&record->position, position + 1,
+                        memory_order_release);
+  atomic_store_explicit(&store->changelog_head, position + 1,
+                        memory_order_release);
+
+  // Same handshake as queue pushes: the counter moves before waiters is
+  // read, so a reader about to sleep either is seen or sees the change
+  atomic_fetch_add(&store->changelog_events, 1);
+  if (atomic_load(&store->changelog_waiters) > 0) {
+    kv_futex(&store->changelog_events, FUTEX_WAKE, INT_MAX, NULL);
+  }
+}
+
+// ============================================================================
+// WRITES (internal helpers, caller must hold the semaphore)
+// ============================================================================
+
+/**
+ * A write whose arena memory is already allocated
+ *
+ * Staging does everything that can fail (capacity check, blob allocation);
+ * applying a staged write only links the blobs into the table and cannot
+ * fail. Transactions stage all their writes before applying any of them.
+ */
+typedef struct {
+  const char *key;             // Key (must stay valid until applied)
+  const void *value;           // Value (must stay valid until applied)
+  size_t value_len;            // Value length in bytes
+  unsigned int type;           // KV_TYPE_* of the value
+  unsigned int hash;           // kv_hash_key(key)
+  unsigned int value_ref;      // Value blob
+  unsigned int key_prefix_ref; // Key blobs, only for new entries
+  unsigned int key_suffix_ref;
+  unsigned int version_ref; // Version record to publish
+  int is_new; // 1 if the key was absent when staged
+} kv_staged_write_t;
+
+/**
+ * Frees the blobs and version record of a staged write that will not be applied
+ */
+static void kv_release_staged(shared_memory_kv_store_t *store,
+                              kv_staged_write_t *staged) {
+  kv_blob_release(store, staged->value_ref);
+  kv_blob_release(store, staged->key_prefix_ref);
+  kv_blob_release(store, staged->key_suffix_ref);
+  kv_arena_free(store, staged->version_ref);
+  memset(staged, 0, sizeof(*staged));
+}
+
+/**
+ * Allocates the value (and key, for a new entry) and version record of a set
+ *
+ * @param new_entries Number of new entries already staged but not applied;
+ *        incremented when this write adds an entry
+ * @return 0 on success, -1 on error (errno set: ENOSPC if the table or the
+ *         arena is full, EAGAIN if the retire list is full because a reader
+ *         is still on old versions; nothing is left allocated)
+ */
+static int kv_stage_write(shared_memory_kv_store_t *store, const char *key,
+                          size_t key_len, const void *value, size_t value_len,
+                          unsigned int type, unsigned int *new_entries,
+                          kv_staged_write_t *staged) {
+  memset(staged, 0, sizeof(*staged));
+  staged->key = key;
+  staged->value = value;
+  staged->value_len = value_len;
+  staged->type = type;
+  staged->hash = kv_hash_key(key);
+  int slot = kv_find_slot(store, key, staged->hash, NULL);
+  staged->is_new = slot == -1;
+
+  // A new entry needs a non-occupied slot. Linear probing wraps around the
+  // table, so one exists as long as the table is not full
+  if (staged->is_new && store->entry_count + *new_entries >= MAX_ENTRIES) {
+    errno = ENOSPC;
+    return -1;
+  }
+
+  // The write pushes the oldest kept version out of the chain. Without room
+  // to retire it the chain just grows for now (see kv_version_trim); fail,
+  // before anything is allocated, once it holds KV_MVCC_VERSIONS_MAX
+  if (!staged->is_new && kv_retire_room(store, 1) == -1 &&
+      kv_version_count(store, atomic_load_explicit(
+                                  &store->kv_table[slot].head,
+                                  memory_order_relaxed)) >=
+          KV_MVCC_VERSIONS_MAX) {
+    return -1;
+  }
+
+  // With KV_FLAG_DEDUP_VALUES an identical value already in the arena is
+  // shared instead of copied; with KV_FLAG_COMPRESS_VALUES large values are
+  // compressed first
+  staged->value_ref = kv_value_store(store, value, value_len, type);
+  if (staged->value_ref == 0) {
+    errno = ENOSPC;
+    return -1;
+  }
+
+  if (staged->is_new) {
+    kv_pair_t key_refs = {0};
+    if (kv_key_store(store, &key_refs, key, key_len) == -1) {
+      kv_blob_release(store, staged->value_ref);
+      staged->value_ref = 0;
+      errno = ENOSPC;
+      return -1;
+    }
+    staged->key_prefix_ref = key_refs.key_prefix_ref;
+    staged->key_suffix_ref = key_refs.key_suffix_ref;
+  }
+
+  staged->version_ref = kv_arena_alloc(store, sizeof(kv_version_t));
+  if (staged->version_ref == 0) {
+    kv_release_staged(store, staged);
+    errno = ENOSPC;
+    return -1;
+  }
+
+  if (staged->is_new) {
+    (*new_entries)++;
+  }
+  return 0;
+}
+
+/**
+ * Installs a staged write in the table
+ *
+ * Updates keep their slot; new entries take the first reusable slot of
+ * their probe sequence (an empty slot or a tombstone). The new version
+ * record is filled in completely before it is published as the slot's
+ * head, and the old value stays with the previous record until the chain
+ * is trimmed and readers moved on. Bumps the store version.
+ */
+static void kv_apply_write(shared_memory_kv_store_t *store,
+                           const kv_staged_write_t *staged) {
+  int free_slot = -1;
+  int slot = kv_find_slot(store, staged->key, staged->hash, &free_slot);
+  kv_pair_t *pair;
+
+  if (staged->is_new) {
+    // kv_stage_write() made sure a free slot exists
+    pair = &store->kv_table[free_slot];
+    if (pair->state == KV_SLOT_TOMBSTONE) {
+      store->tombstone_count--;
+    }
+    pair->key_prefix_ref = staged->key_prefix_ref;
+    pair->key_suffix_ref = staged->key_suffix_ref;
+    slot = free_slot;
+  } else {
+    // The old value belongs to the current head record and stays there
+    pair = &store->kv_table[slot];
+  }
+  kv_slot_write_begin(pair);
+
+  pair->value_ref = staged->value_ref;
+  pair->timestamp = time(NULL);
+  pair->hash = staged->hash;
+  pair->state = KV_SLOT_OCCUPIED;
+
+  // The slot remembers the version of its last change so that readers can
+  // request only the slots changed since a version they already have
+  store->version++;
+  pair->slot_version = store->version;
+
+  // Fill in the new version, then publish it: lock-free readers see either
+  // the previous head or the complete new record
+  kv_version_t *version = kv_version(store, staged->version_ref);
+  version->key_prefix_ref = pair->key_prefix_ref;
+  version->key_suffix_ref = pair->key_suffix_ref;
+  version->value_ref = staged->value_ref;
+  version->store_version = store->version;
+  version->timestamp = pair->timestamp;
+  atomic_store_explicit(
+      &version->prev,
+      atomic_load_explicit(&pair->head, memory_order_relaxed),
+      memory_order_relaxed);
+  atomic_store_explicit(&pair->head, staged->version_ref,
+                        memory_order_release);
+  store->version_records++;
+  kv_slot_write_end(pair);
+  kv_version_trim(store, staged->version_ref);
+
+  if (staged->is_new) {
+    kv_index_insert(store, (unsigned int)slot);
+    kv_bloom_add(store, staged->hash);
+    store->entry_count++;
+  }
+  kv_rollup_update(store, staged->key, staged->hash, staged->value,
+                   staged->value_len, staged->type);
+  kv_changelog_append(store, KV_CHANGE_SET, staged->key);
+  kv_notify(store, staged->key);
+}
+
+/**
+ * Deletes a key from the table
+ *
+ * @return 0 on success, -1 on error (errno set: ENOENT if the key is not in
+ *         the table, EAGAIN if the retire list has no room for its versions
+ *         and key; the key is left as it was)
+ */
+static int kv_apply_delete(shared_memory_kv_store_t *store, const char *key) {
+  unsigned int hash = kv_hash_key(key);
+  int slot = kv_find_slot(store, key, hash, NULL);
+  if (slot == -1) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  kv_pair_t *pair = &store->kv_table[slot];
+
+  // The whole chain and both key blobs are retired: check before changing
+  // anything
+  unsigned int head = atomic_load_explicit(&pair->head, memory_order_relaxed);
+  if (kv_retire_room(store, kv_version_count(store, head) + 2) == -1) {
+    return -1;
+  }
+
+  // Remove from the sorted index first (it needs the key to locate the slot)
+  kv_index_remove(store, (unsigned int)slot);
+  kv_bloom_remove(store, hash);
+  kv_slot_write_begin(pair);
+
+  // Unlink the version chain, then retire it with the key blobs: readers
+  // that already found them keep reading valid memory until they finish
+  atomic_store_explicit(&pair->head, 0, memory_order_release);
+  kv_version_retire_chain(store, head);
+  kv_retire(store, KV_RETIRED_BLOB, pair->key_prefix_ref);
+  kv_retire(store, KV_RETIRED_BLOB, pair->key_suffix_ref);
+  pair->key_prefix_ref = 0;
+  pair->key_suffix_ref = 0;
+  pair->value_ref = 0; // Owned by the retired head record
+  pair->timestamp = 0;
+
+  // Leave a tombstone: later keys of the same probe sequence may sit past
+  // this slot, so it must not end lookups like an empty slot would
+  pair->state = KV_SLOT_TOMBSTONE;
+  store->tombstone_count++;
+
+  // The cleared slot keeps its slot_version so delta readers see the delete
+  store->version++;
+  pair->slot_version = store->version;
+  kv_slot_write_end(pair);
+  store->entry_count--;
+  kv_changelog_append(store, KV_CHANGE_DELETE, key);
+  kv_notify(store, key);
+
+  return 0;
+}
+
+// ============================================================================
+// HASH ENTRIES (field maps in one value, caller must hold the semaphore)
+// ============================================================================
+
+/**
+ * Finds a field in an encoded field map ("field\0value\0" per field)
+ *
+ * @param record_len_out Bytes of the field's record (field, value and both
+ *        '\0'), if not NULL
+ * @return Offset of the field's record, or -1 if the map has no such field
+ */
+static long kv_hash_find(const char *map, size_t length, const char *field,
+                         size_t *record_len_out) {
+  size_t offset = 0;
+  while (offset < length) {
+    size_t field_len = strnlen(map + offset, length - offset);
+    size_t value_at = offset + field_len + 1;
+    if (value_at >= length) {
+      break; // Truncated map
+    }
+    size_t record_len =
+        field_len + 1 + strnlen(map + value_at, length - value_at) + 1;
+    if (strcmp(map + offset, field) == 0) {
+      if (record_len_out != NULL) {
+        *record_len_out = record_len;
+      }
+      return (long)offset;
+    }
+    offset += record_len;
+  }
+  return -1;
+}
+
+/**
+ * Sets or deletes a field of a hash entry: reads the current map, writes
+ * the changed copy as a new version
+ *
+ * @param request "field\0field value" (KV_COMBINE_HSET) or "field"
+ *        (KV_COMBINE_HDEL), request_len bytes
+ * @return 0 on success, -1 on error (errno set: EINVAL if the key holds a
+ *         value that is not a hash, ENOENT if a deleted key or field does
+ *         not exist, ENAMETOOLONG if the map would not fit in
+ *         VALUE_SIZE-1 bytes, ENOSPC or EAGAIN as by kv_stage_write)
+ */
+static int kv_hash_write(shared_memory_kv_store_t *store, unsigned int op,
+                         const char *key, const char *request,
+                         size_t request_len) {
+  // Per thread, like the compressor scratch: 8 KB of maps plus the frames
+  // of kv_value_decode() and kv_stage_write() below would strain small
+  // thread stacks
+  static _Thread_local char current[VALUE_SIZE];
+  static _Thread_local char updated[VALUE_SIZE];
+  size_t current_len = 0;
+  current[0] = '\0';
+
+  // Step 1: Read the current map (a missing key is an empty map)
+  int slot = kv_find_slot(store, key, kv_hash_key(key), NULL);
+  if (slot != -1) {
+    unsigned int type;
+    current_len =
+        kv_value_decode(store, &store->kv_table[slot], current, &type);
+    if (type != KV_TYPE_HASH) {
+      errno = EINVAL;
+      return -1;
+    }
+  } else if (op == KV_COMBINE_HDEL) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  // Step 2: Copy the map without the field
+  size_t record_len = 0;
+  long found = kv_hash_find(current, current_len, request, &record_len);
+  if (found == -1 && op == KV_COMBINE_HDEL) {
+    errno = ENOENT;
+    return -1;
+  }
+  size_t updated_len = current_len;
+  memcpy(updated, current, current_len);
+  if (found != -1) {
+    memmove(updated + found, updated + found + record_len,
+            current_len - (size_t)found - record_len);
+    updated_len -= record_len;
+  }
+
+  // Step 3: Append the field with its new value
+  if (op == KV_COMBINE_HSET) {
+    if (updated_len + request_len + 1 >= VALUE_SIZE) {
+      errno = ENAMETOOLONG;
+      return -1;
+    }
+    memcpy(updated + updated_len, request, request_len);
+    updated[updated_len + request_len] = '\0';
+    updated_len += request_len + 1;
+  }
+
+  // Step 4: Write the new map; a hash without fields is deleted
+  if (updated_len == 0) {
+    return kv_apply_delete(store, key);
+  }
+  unsigned int new_entries = 0;
+  kv_staged_write_t staged;
+  if (kv_stage_write(store, key, strlen(key), updated, updated_len,
+                     KV_TYPE_HASH, &new_entries, &staged) == -1) {
+    return -1;
+  }
+  kv_apply_write(store, &staged);
+  return 0;
+}
+
+// ============================================================================
+// FLAT COMBINING (sets and deletes of concurrent writers share one lock hold)
+// ============================================================================
+
+/**
+ * Applies one set, delete or hash field change; the caller holds the
+ * semaphore
+ *
+ * @return 0 on success, -1 on error (errno set: ENOSPC if the table or the
+ *         arena is full, ENOENT if a deleted key does not exist, EAGAIN if
+ *         the retire list is full, as by kv_hash_write for hash fields)
+ */
+static int kv_write_op(shared_memory_kv_store_t *store, unsigned int op,
+                       const char *key, const void *value, size_t value_len,
+                       unsigned int type) {
+  if (op == KV_COMBINE_HSET || op == KV_COMBINE_HDEL) {
+    return kv_hash_write(store, op, key, value, value_len);
+  }
+  if (op == KV_COMBINE_DELETE) {
+    return kv_apply_delete(store, key);
+  }
+
+  unsigned int new_entries = 0;
+  kv_staged_write_t staged;
+  if (kv_stage_write(store, key, strlen(key), value, value_len, type,
+                     &new_entries, &staged) == -1) {
+    return -1;
+  }
+  kv_apply_write(store, &staged);
+  return 0;
+}
+
+/**
+ * Applies every published request; the caller holds the semaphore
+ *
+ * Each request's outcome is stored in its record before the record is
+ * marked DONE, which releases the waiting owner.
+ */
+static void kv_combine_pass(shared_memory_kv_store_t *store) {
+  if (atomic_load_explicit(&store->combine_pending, memory_order_acquire) ==
+      0) {
+    return;
+  }
+
+  unsigned int applied = 0;
+  for (unsigned int i = 0; i < KV_COMBINE_SLOTS; i++) {
+    kv_combine_record_t *record = &store->combine[i];
+    unsigned int state =
+        atomic_load_explicit(&record->state, memory_order_acquire);
+    if ((state & KV_COMBINE_STATE_MASK) != KV_COMBINE_PENDING) {
+      continue;
+    }
+    record->result = kv_write_op(store, record->op, record->key,
+                                 record->value, record->length, record->type);
+    record->error = record->result == -1 ? errno : 0;
+    atomic_store_explicit(&record->state,
+                          (state & ~KV_COMBINE_STATE_MASK) | KV_COMBINE_DONE,
+                          memory_order_release);
+    kv_futex(&record->state, FUTEX_WAKE, INT_MAX, NULL);
+    atomic_fetch_sub_explicit(&store->combine_pending, 1,
+                              memory_order_relaxed);
+    applied++;
+  }
+
+  if (applied > 0) {
+    store->combined_writes += applied;
+    store->combine_batches++;
+  }
+}
+
+/**
+ * Applies a write (op 0: none) and all published requests, then releases
+ * the semaphore the caller took
+ *
+ * @return Result of the caller's own write (errno set on -1)
+ */
+static int kv_combine_locked(shared_memory_kv_store_t *store, unsigned int op,
+                             const char *key, const void *value,
+                             size_t value_len, unsigned int type) {
+  kv_seq_write_begin(store);
+  int result =
+      op != 0 ? kv_write_op(store, op, key, value, value_len, type) : 0;
+  int saved_errno = errno;
+  kv_combine_pass(store);
+  kv_reclaim(store);
+  kv_seq_write_end(store);
+
+  if (sem_post(&store->sem) == -1) {
+    perror("sem_post failed");
+  }
+  kv_notify_flush();
+  errno = saved_errno;
+  return result;
+}
+
+/**
+ * Waits until a published request is no longer pending
+ *
+ * The waiter sleeps on the record's state, which the combiner wakes after
+ * storing DONE. On every wake-up or timeout it tries the semaphore and, if
+ * it is free, becomes the combiner itself, so a request never depends on
+ * another writer coming along.
+ *
+ * @param pending The slot's state while the request is pending
+ */
+static void kv_combine_wait(shared_memory_kv_store_t *store,
+                            kv_combine_record_t *record,
+                            unsigned int pending) {
+  const struct timespec timeout = {0, KV_COMBINE_WAIT_US * 1000L};
+  while (atomic_load_explicit(&record->state, memory_order_acquire) ==
+         pending) {
+    if (sem_trywait(&store->sem) == 0) {
+      kv_combine_locked(store, 0, NULL, NULL, 0, 0);
+      continue;
+    }
+    // Returns at once if the state is no longer PENDING
+    kv_futex(&record->state, FUTEX_WAIT, pending, &timeout);
+  }
+}
+
+/**
+ * Claims an idle request slot for the calling process
+ *
+ * With every slot taken, slots that a dead process left claimed or done
+ * are freed and the search is repeated once. A pending slot of a dead
+ * process is left to the combiner, which marks it done.
+ *
+ * @param owner The caller's pid shifted by KV_COMBINE_STATE_BITS
+ * @return The claimed slot, or NULL if all are in use
+ */
+static kv_combine_record_t *kv_combine_claim(shared_memory_kv_store_t *store,
+                                             unsigned int owner) {
+  for (int pass = 0; pass < 2; pass++) {
+    for (unsigned int i = 0; i < KV_COMBINE_SLOTS; i++) {
+      unsigned int idle = KV_COMBINE_IDLE;
+      if (atomic_compare_exchange_strong_explicit(
+              &store->combine[i].state, &idle, owner | KV_COMBINE_CLAIMED,
+              memory_order_acquire, memory_order_relaxed)) {
+        return &store->combine[i];
+      }
+    }
+    if (pass > 0) {
+      break;
+    }
+
+    unsigned int freed = 0;
+    for (unsigned int i = 0; i < KV_COMBINE_SLOTS; i++) {
+      unsigned int state =
+          atomic_load_explicit(&store->combine[i].state, memory_order_relaxed);
+      unsigned int phase = state & KV_COMBINE_STATE_MASK;
+      if ((phase == KV_COMBINE_CLAIMED || phase == KV_COMBINE_DONE) &&
+          !kv_process_alive((int)(state >> KV_COMBINE_STATE_BITS), 0) &&
+          atomic_compare_exchange_strong_explicit(
+              &store->combine[i].state, &state, KV_COMBINE_IDLE,
+              memory_order_relaxed, memory_order_relaxed)) {
+        freed++;
+      }
+    }
+    if (freed == 0) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Performs a set (of any value type) or delete for shared_memory_kv_set*
+ * and shared_memory_kv_delete
+ *
+ * A writer that gets the semaphore right away applies its own write plus
+ * every request published meanwhile. One that finds it taken publishes
+ * its request in a free combining slot and waits for the holder (or
+ * itself, once the semaphore is free) to apply it, instead of queueing on
+ * the semaphore: N contending writers cost one lock hand-off per batch
+ * rather than one per write. Writers that find every slot taken block on
+ * the semaphore as before.
+ *
+ * @return 0 on success, -1 on error (errno set as by kv_write_op, or EPERM
+ *         if another process is the single writer)
+ */
+static int kv_submit_write(shared_memory_kv_store_t *store, unsigned int op,
+                           const char *key, const void *value,
+                           size_t value_len, unsigned int type) {
+  // Step 1: With KV_FLAG_SINGLE_WRITER there is nobody to combine with
+  if (kv_single_writer(store)) {
+    if (kv_write_lock(store) == -1) {
+      return -1;
+    }
+    kv_seq_write_begin(store);
+    int result = kv_write_op(store, op, key, value, value_len, type);
+    int saved_errno = errno;
+    kv_reclaim(store);
+    kv_seq_write_end(store);
+    kv_write_unlock(store);
+    errno = saved_errno;
+    return result;
+  }
+
+  // Step 2: Uncontended, or no slot to publish in: hold the semaphore
+  unsigned int owner = (unsigned int)getpid() << KV_COMBINE_STATE_BITS;
+  kv_combine_record_t *record = NULL;
+  if (sem_trywait(&store->sem) == -1) {
+    record = kv_combine_claim(store, owner);
+    if (record == NULL && sem_wait(&store->sem) == -1) {
+      perror("sem_wait failed");
+      return -1;
+    }
+  }
+  if (record == NULL) {
+    return kv_combine_locked(store, op, key, value, value_len, type);
+  }
+
+  // Step 3: Publish the request
+  // The pending count goes up before the state, so a combiner that sees
+  // the request also sees the count
+  record->op = op;
+  strncpy(record->key, key, KEY_SIZE - 1);
+  record->key[KEY_SIZE - 1] = '\0';
+  if (op != KV_COMBINE_DELETE) {
+    memcpy(record->value, value, value_len); // Callers checked the length
+    record->value[value_len] = '\0';
+    record->length = (unsigned int)value_len;
+    record->type = type;
+  }
+  atomic_fetch_add_explicit(&store->combine_pending, 1, memory_order_relaxed);
+  atomic_store_explicit(&record->state, owner | KV_COMBINE_PENDING,
+                        memory_order_release);
+
+  // Step 4: Wait for a combiner, then take the outcome and free the slot
+  kv_combine_wait(store, record, owner | KV_COMBINE_PENDING);
+  int result = record->result;
+  int error = record->error;
+  atomic_store_explicit(&record->state, KV_COMBINE_IDLE, memory_order_relaxed);
+  if (result == -1) {
+    errno = error;
+  }
+  return result;
+}
+
+/**
+ * Creates a new shared memory object for the KV store
+ *
+ * This function creates a new shared memory object, allocates memory,
+ * initializes the semaphore, and initializes the data structures.
+ *
+ * @param shared_memory_file_descriptor_out Pointer to return the shared memory
+ * file descriptor (output parameter) (required for later closing/deletion)
+ * @return Pointer to shared_memory_kv_store_t structure in shared memory, or
+ * NULL on error
+ *
+ * @note shared_memory_kv_destroy() must be called after use for cleanup
+ * @note If the object already exists, the function returns NULL (use
+ * shared_memory_kv_open())
+ */
+shared_memory_kv_store_t *
+shared_memory_kv_create(int *shared_memory_file_descriptor_out) {
+  return shared_memory_kv_create_ex(shared_memory_file_descriptor_out, 0);
+}
+
+/**
+ * Creates a new shared memory object for the KV store with options
+ *
+ * @param shared_memory_file_descriptor_out Pointer to return the shared memory
+ * file descriptor
+ * @param flags Bitwise OR of KV_FLAG_* (0 = no sharing)
+ * @return Pointer to shared_memory_kv_store_t structure in shared memory, or
+ * NULL on error
+ */
+shared_memory_kv_store_t *
+shared_memory_kv_create_ex(int *shared_memory_file_descriptor_out,
+                           unsigned int flags) {
+  return shared_memory_kv_create_named(
+      SHM_NAME, shared_memory_file_descriptor_out, flags);
+}
+
+/**
+ * Checks the name of a shared memory object
+ *
+ * @return 0 if valid, -1 if not (errno set: EINVAL, ENAMETOOLONG)
+ */
+static int kv_check_shm_name(const char *name) {
+  if (name == NULL || name[0] != '/' || name[1] == '\0') {
+    errno = EINVAL;
+    return -1;
+  }
+  if (strnlen(name, KV_SHM_NAME_SIZE) >= KV_SHM_NAME_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  if (strchr(name + 1, '/') != NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Creates a new shared memory object for the KV store under a given name
+ *
+ * @param name Object name ("/" and at most KV_SHM_NAME_SIZE-2 characters)
+ * @param shared_memory_file_descriptor_out Pointer to return the shared memory
+ * file descriptor
+ * @param flags Bitwise OR of KV_FLAG_* (0 = no sharing)
+ * @return Pointer to shared_memory_kv_store_t structure in shared memory, or
+ * NULL on error
+ */
+shared_memory_kv_store_t *
+shared_memory_kv_create_named(const char *name,
+                              int *shared_memory_file_descriptor_out,
+                              unsigned int flags) {
+  if (kv_check_shm_name(name) == -1) {
+    return NULL;
+  }
+
+  // Step 1: Create the shared memory object
+  // O_CREAT - create if it doesn't exist
+  // O_EXCL - return error if already exists (overwrite protection)
+  // O_RDWR - read and write mode
+  // S_IRUSR | S_IWUSR - permissions: read and write for the owner
+  int shared_memory_file_descriptor =
+      shm_open(name, O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+
+  if (shared_memory_file_descriptor == -1) {
+    int saved_errno = errno; // perror may change it (EEXIST, ENOENT matter)
+    perror("shm_open failed");
+    errno = saved_errno;
+    return NULL;
+  }
+
+  // Save the descriptor to return it
+  if (shared_memory_file_descriptor_out != NULL) {
+    *shared_memory_file_descriptor_out = shared_memory_file_descriptor;
+  }
+
+  // Step 2: Set the shared memory object size
+  // ftruncate sets the size of the file/object
+  // Important: shm_open creates an object with size 0, so size must be
+  // explicitly set. Size should be equal to sizeof(shared_memory_kv_store_t)
+  if (ftruncate(shared_memory_file_descriptor,
+                sizeof(shared_memory_kv_store_t)) == -1) {
+    perror("ftruncate failed");
+    // If ftruncate fails, close the descriptor and return an error
+    close(shared_memory_file_descriptor);
+    // Also need to unlink the object as it was created but is incomplete
+    shm_unlink(name);
+    return NULL;
+  }
+
+  // Step 3: Map shared memory into the process address space
+  // mmap creates a virtual mapping of the shared memory object into process
+  // memory. After mmap, we can work with shared memory via a pointer like a
+  // regular structure.
+  //
+  // Parameters:
+  // - NULL: the kernel will choose the mapping address
+  // - sizeof(shared_memory_kv_store_t): mapping size (must match ftruncate
+  //   size)
+  // - PROT_READ | PROT_WRITE: allow read and write
+  // - MAP_SHARED: changes are visible to other processes (important for IPC!)
+  // - shared_memory_file_descriptor: descriptor from shm_open
+  // - 0: offset from the start of the object (map from the beginning)
+  shared_memory_kv_store_t *store =
+      mmap(NULL, // address (NULL = kernel will choose)
+           sizeof(shared_memory_kv_store_t), // size
+           PROT_READ | PROT_WRITE,           // access rights
+           MAP_SHARED,                       // flags (shared between processes)
+           shared_memory_file_descriptor,    // file descriptor
+           0                                 // offset
+      );
+
+  // Error check: mmap returns MAP_FAILED (usually (void*)-1) on error
+  if (store == MAP_FAILED) {
+    perror("mmap failed");
+
+    close(shared_memory_file_descriptor);
+    shm_unlink(name);
+    return NULL;
+  }
+
+  // Step 4: Initialize structure fields
+  // After mmap, memory may contain garbage, so all fields must be explicitly
+  // initialized.
+  //
+  // memset clears memory: sets all bytes to 0.
+  // This ensures that:
+  // - All strings in kv_table will start with '\0' (empty)
+  // - All timestamps will be 0
+  // - version and entry_count will be 0
+  memset(store, 0, sizeof(shared_memory_kv_store_t));
+
+  // Explicit field initialization for clarity (though memset already cleared
+  // them). This makes the code more readable and explicitly shows initial
+  // values.
+  store->version = 0;     // Initial data version
+  store->entry_count = 0; // Initial entry count (table is empty)
+  struct timespec created;
+  clock_gettime(CLOCK_REALTIME, &created);
+  store->generation = (unsigned long long)created.tv_sec * 1000000ULL +
+                      (unsigned long long)created.tv_nsec / 1000ULL;
+  store->flags = flags;   // Storage options, fixed for the store's lifetime
+  store->writer_pid = (int)getpid(); // Only writer with KV_FLAG_SINGLE_WRITER
+  store->writer_thread = (uintptr_t)&kv_thread_marker; // (this thread)
+  memcpy(store->shm_name, name, strlen(name) + 1); // For unlink_safe
+  atomic_store(&store->epoch, 1); // Reclamation epoch (0 = "not reading")
+  for (int i = 0; i < KV_SHARED_READERS; i++) {
+    atomic_store(&store->shared_readers[i].pid, KV_REGISTRY_SHARED);
+  }
+
+  // Step 5: Initialize the semaphore for synchronization
+  // sem_init initializes the semaphore for inter-process synchronization.
+  // Important: do this AFTER memset so the semaphore is initialized in clean
+  // memory.
+  //
+  // Parameters:
+  // - &store->sem: pointer to the semaphore in the structure (in shared memory)
+  // - 1 (pshared): "shared" flag - semaphore will be accessible between
+  // processes
+  //   (0 = current process only, 1 = between processes via shared memory)
+  // - 1 (value): initial semaphore value (1 = semaphore is free, can be taken)
+  //   Used as a mutex: 1 = unlocked, 0 = locked
+  if (sem_init(&store->sem, 1, 1) == -1) {
+    perror("sem_init failed");
+    munmap(store, sizeof(shared_memory_kv_store_t));
+    close(shared_memory_file_descriptor);
+    shm_unlink(name);
+    return NULL;
+  }
+
+  // Step 6: Register this process as attached
+  kv_registry_attach(store);
+
+  return store; // Return pointer to the structure in shared memory
+}
+
+/**
+ * Opens an existing shared memory object for the KV store
+ *
+ * @param shared_memory_file_descriptor_out Pointer to return the shared memory
+ * file descriptor
+ * @return Pointer to shared_memory_kv_store_t structure in shared memory, or
+ * NULL on error
+ */
+shared_memory_kv_store_t *
+shared_memory_kv_open(int *shared_memory_file_descriptor_out) {
+  return shared_memory_kv_open_named(SHM_NAME,
+                                     shared_memory_file_descriptor_out);
+}
+
+/**
+ * Opens an existing shared memory object for the KV store by name
+ *
+ * @param name Object name (see shared_memory_kv_create_named)
+ * @param shared_memory_file_descriptor_out Pointer to return the shared memory
+ * file descriptor
+ * @return Pointer to shared_memory_kv_store_t structure in shared memory, or
+ * NULL on error
+ */
+shared_memory_kv_store_t *
+shared_memory_kv_open_named(const char *name,
+                            int *shared_memory_file_descriptor_out) {
+  if (kv_check_shm_name(name) == -1) {
+    return NULL;
+  }
+
+  // Step 1: Open existing shared memory object
+  // O_RDWR - read and write mode
+  int shared_memory_file_descriptor = shm_open(name, O_RDWR, 0);
+
+  if (shared_memory_file_descriptor == -1) {
+    int saved_errno = errno; // perror may change it (EEXIST, ENOENT matter)
+    perror("shm_open failed");
+    errno = saved_errno;
+    return NULL;
+  }
+
+  // Save descriptor if requested
+  if (shared_memory_file_descriptor_out != NULL) {
+    *shared_memory_file_descriptor_out = shared_memory_file_descriptor;
+  }
+
+  // Step 2: Map shared memory into process address space
+  shared_memory_kv_store_t *store =
+      mmap(NULL, sizeof(shared_memory_kv_store_t), PROT_READ | PROT_WRITE,
+           MAP_SHARED, shared_memory_file_descriptor, 0);
+  if (store == MAP_FAILED) {
+    perror("mmap failed");
+    close(shared_memory_file_descriptor);
+    return NULL;
+  }
+
+  // Step 3: Register this process as attached
+  if (kv_registry_attach(store) == -1) {
+    munmap(store, sizeof(shared_memory_kv_store_t));
+    close(shared_memory_file_descriptor);
+    errno = EAGAIN;
+    return NULL;
+  }
+
+  return store;
+}
+
+/**
+ * Destroys the shared memory object and frees resources
+ *
+ * @param shared_memory_file_descriptor File descriptor of shared memory
+ * @param store Pointer to mapped shared memory region
+ */
+void shared_memory_kv_destroy(int shared_memory_file_descriptor,
+                              shared_memory_kv_store_t *store) {
+  // Step 1: Detach: free the registry entries and subscriptions of this
+  // process
+  // Done before unmapping; a read still running in another thread of the
+  // process keeps its entry (and epoch) until reaping frees it
+  if (store != NULL) {
+    int pid = (int)getpid();
+    kv_registry_detach(store);
+    for (int i = 0; i < KV_REGISTRY_SIZE; i++) {
+      kv_registry_entry_t *entry = &store->registry[i];
+      if (atomic_load_explicit(&entry->pid, memory_order_relaxed) == pid &&
+          atomic_load_explicit(&entry->epoch, memory_order_relaxed) == 0) {
+        kv_registry_free(entry);
+      }
+    }
+    for (int i = 0; i < KV_SUBSCRIPTIONS; i++) {
+      kv_subscription_t *subscription = &store->subscriptions[i];
+      int owner = pid;
+      if (atomic_compare_exchange_strong(&subscription->pid, &owner, -1)) {
+        kv_subscription_free(store, subscription);
+      }
+    }
+  }
+
+  // Step 2: Unmap shared memory from process address space
+  // Check for NULL pointer before using it
+  if (store != NULL) {
+    if (munmap(store, sizeof(shared_memory_kv_store_t)) == -1) {
+      perror("munmap failed");
+      // Continue cleanup even if munmap fails
+    }
+  }
+
+  // Step 3: Close file descriptor
+  // Check for invalid descriptor before using it
+  if (shared_memory_file_descriptor != -1) {
+    if (close(shared_memory_file_descriptor) == -1) {
+      perror("close failed");
+    }
+  }
+
+  // Note: We do NOT call sem_destroy() here because:
+  // - Semaphore is in shared memory and will be destroyed when object is
+  // unlinked
+  // - Multiple processes should not destroy the same semaphore
+  //
+  // Note: We do NOT call shm_unlink() here because:
+  // - Only the creator (producer) should unlink the object
+  // - shm_unlink() should be called separately by producer when shutting down
+}
+
+/**
+ * Unlinks (removes) the shared memory object from the system
+ *
+ * This should be called ONLY by the creator process (producer)
+ * when shutting down. After unlinking, the object will be removed
+ * when all processes close their references to it.
+ *
+ * @return 0 on success, -1 on error
+ * @note This function should be called after all processes have
+ * called shared_memory_kv_destroy()
+ */
+int shared_memory_kv_unlink(void) {
+  return shared_memory_kv_unlink_named(SHM_NAME);
+}
+
+/**
+ * Unlinks the shared memory object of a given name
+ *
+ * @param name Object name (see shared_memory_kv_create_named)
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_unlink_named(const char *name) {
+  if (kv_check_shm_name(name) == -1) {
+    return -1;
+  }
+  if (shm_unlink(name) == -1) {
+    if (errno == ENOENT) {
+      return 0;
+    }
+    perror("shm_unlink failed");
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Unlinks the shared memory object unless other processes are attached
+ *
+ * @param store Pointer to shared memory KV store
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_unlink_safe(shared_memory_kv_store_t *store) {
+  // Step 1: Validate input parameters
+  if (store == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Lock semaphore (one unlink decision at a time)
+  if (sem_wait(&store->sem) == -1) {
+    perror("sem_wait failed");
+    return -1;
+  }
+
+  // Step 3: Forget crashed processes, then look for live ones: attached
+  // through create/open, or reading through a registry entry (a forked
+  // child that never opened the store)
+  kv_registry_reap(store);
+  int self = (int)getpid();
+  int busy = 0;
+  for (unsigned int i = 0; i < KV_PROCESS_MAX && !busy; i++) {
+    int pid = atomic_load_explicit(&store->processes[i].pid,
+                                   memory_order_acquire);
+    busy = pid > 0 && pid != self;
+  }
+  for (unsigned int i = 0; i < KV_REGISTRY_SIZE && !busy; i++) {
+    int pid = atomic_load_explicit(&store->registry[i].pid,
+                                   memory_order_acquire);
+    busy = pid > 0 && pid != self;
+  }
+
+  // Step 4: Unlink only if this process is the last one attached
+  int result = busy ? -1 : shared_memory_kv_unlink_named(store->shm_name);
+
+  // Step 5: Unlock semaphore
+  if (sem_post(&store->sem) == -1) {
+    perror("sem_post failed");
+  }
+
+  if (busy) {
+    errno = EBUSY;
+  }
+  return result;
+}
+
+/**
+ * Records that the calling thread is alive
+ *
+ * @param store Pointer to shared memory KV store
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_heartbeat(shared_memory_kv_store_t *store) {
+  if (store == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  kv_registry_entry_t *entry = kv_registry_entry(store);
+  if (entry == NULL) {
+    errno = EAGAIN;
+    return -1;
+  }
+
+  atomic_store_explicit(&entry->heartbeat, (long long)time(NULL),
+                        memory_order_relaxed);
+  return 0;
+}
+
+/**
+ * Frees the registry entries of processes that no longer exist
+ *
+ * @param store Pointer to shared memory KV store
+ * @return Number of entries freed, or -1 on error
+ */
+int shared_memory_kv_reap(shared_memory_kv_store_t *store) {
+  // Step 1: Validate input parameters
+  if (store == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Reap (lock-free); subscriptions of dead processes go too
+  unsigned int reaped = kv_registry_reap(store);
+  kv_subscription_reap(store);
+
+  // Step 3: Retry reclamation that dead readers were blocking; the retire
+  // list belongs to the writer (a single writer reclaims on its next write)
+  if (reaped > 0 && kv_write_lock(store) == 0) {
+    kv_reclaim(store);
+    kv_write_unlock(store);
+  }
+
+  return (int)reaped;
+}
+
+/**
+ * Lists the processes attached to the store
+ *
+ * @param store Pointer to shared memory KV store
+ * @param processes_out Array of at least max_processes elements
+ * @param max_processes Maximum number of processes to return
+ * @return Number of processes written, or -1 on error
+ */
+int shared_memory_kv_processes(shared_memory_kv_store_t *store,
+                               kv_process_info_t *processes_out,
+                               size_t max_processes) {
+  // Step 1: Validate input parameters
+  if (store == NULL || (processes_out == NULL && max_processes > 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: List the attached processes, then group registry entries by
+  // pid (entries are only read, so no lock is needed; the listing is a
+  // best-effort view)
+  size_t count = 0;
+  for (unsigned int i = 0; i < KV_PROCESS_MAX && count < max_processes;
+       i++) {
+    const kv_process_entry_t *attached = &store->processes[i];
+    int pid = atomic_load_explicit(&attached->pid, memory_order_acquire);
+    size_t index = 0;
+    while (index < count && processes_out[index].pid != pid) {
+      index++;
+    }
+    if (pid <= 0 || index < count) {
+      continue;
+    }
+    kv_process_info_t *process = &processes_out[count++];
+    memset(process, 0, sizeof(*process));
+    process->pid = pid;
+    process->start_time =
+        atomic_load_explicit(&attached->start_time, memory_order_relaxed);
+  }
+  for (unsigned int i = 0; i < KV_REGISTRY_SIZE; i++) {
+    const kv_registry_entry_t *entry = &store->registry[i];
+    int pid = atomic_load_explicit(&entry->pid, memory_order_acquire);
+    if (pid <= 0) {
+      continue;
+    }
+
+    size_t index = 0;
+    while (index < count && processes_out[index].pid != pid) {
+      index++;
+    }
+    if (index == count) {
+      if (count == max_processes) {
+        continue;
+      }
+      kv_process_info_t *process = &processes_out[count++];
+      memset(process, 0, sizeof(*process));
+      process->pid = pid;
+      process->start_time =
+          atomic_load_explicit(&entry->start_time, memory_order_relaxed);
+    }
+
+    kv_process_info_t *process = &processes_out[index];
+    time_t heartbeat = (time_t)atomic_load_explicit(&entry->heartbeat,
+                                                    memory_order_relaxed);
+    unsigned long long epoch =
+        atomic_load_explicit(&entry->epoch, memory_order_relaxed);
+    process->threads++;
+    if (heartbeat > process->heartbeat) {
+      process->heartbeat = heartbeat;
+    }
+    if (epoch != 0 && (process->epoch == 0 || epoch < process->epoch)) {
+      process->epoch = epoch;
+    }
+  }
+
+  // Step 3: Check which of them still run
+  for (size_t i = 0; i < count; i++) {
+    processes_out[i].alive =
+        kv_process_alive(processes_out[i].pid, processes_out[i].start_time);
+  }
+
+  return (int)count;
+}
+
+/**
+ * Subscribes to changes of specific keys
+ *
+ * @param store Pointer to shared memory KV store
+ * @param patterns Keys (or key prefixes with KV_SUBSCRIBE_PREFIX)
+ * @param pattern_count Number of patterns (1..KV_SUBSCRIPTION_KEYS)
+ * @param flags KV_SUBSCRIBE_*
+ * @return Subscription id, or -1 on error
+ */
+int shared_memory_kv_subscribe(shared_memory_kv_store_t *store,
+                               const char *const *patterns,
+                               size_t pattern_count, unsigned int flags) {
+  // Step 1: Validate input parameters
+  if (store == NULL || patterns == NULL || pattern_count == 0 ||
+      pattern_count > KV_SUBSCRIPTION_KEYS ||
+      (flags & ~(unsigned int)KV_SUBSCRIBE_PREFIX) != 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  for (size_t i = 0; i < pattern_count; i++) {
+    if (patterns[i] == NULL) {
+      errno = EINVAL;
+      return -1;
+    }
+    if (strnlen(patterns[i], KEY_SIZE) >= KEY_SIZE) {
+      errno = ENAMETOOLONG;
+      return -1;
+    }
+  }
+
+  // Step 2: Claim a free entry (compare-and-swap from 0 to -1, so writers
+  // skip it until it is filled in); a full table is reaped once
+  int pid = (int)getpid();
+  for (int attempt = 0; attempt < 2; attempt++) {
+    for (int i = 0; i < KV_SUBSCRIPTIONS; i++) {
+      kv_subscription_t *subscription = &store->subscriptions[i];
+      int expected = 0;
+      if (!atomic_compare_exchange_strong(&subscription->pid, &expected,
+                                          -1)) {
+        continue;
+      }
+
+      // Step 3: Fill it in, then publish it to writers
+      subscription->start_time = kv_self_start_time();
+      subscription->flags = flags;
+      memset(subscription->patterns, 0, sizeof(subscription->patterns));
+      for (size_t j = 0; j < pattern_count; j++) {
+        strncpy(subscription->patterns[j], patterns[j], KEY_SIZE - 1);
+      }
+      subscription->pattern_count = (unsigned int)pattern_count;
+      atomic_store(&subscription->events, 0);
+      atomic_store(&subscription->waiters, 0);
+      atomic_store(&subscription->notify_socket, 0);
+      atomic_store(&subscription->notify_armed, 0);
+      atomic_store_explicit(&subscription->last_version, store->version,
+                            memory_order_relaxed);
+      atomic_fetch_add_explicit(&store->subscription_count, 1,
+                                memory_order_relaxed);
+      atomic_store_explicit(&subscription->pid, pid, memory_order_release);
+      return i;
+    }
+    if (attempt == 0 && kv_subscription_reap(store) == 0) {
+      break;
+    }
+  }
+
+  errno = ENOSPC;
+  return -1;
+}
+
+/**
+ * Waits for events of a subscription
+ *
+ * @param store Pointer to shared memory KV store
+ * @param subscription Subscription id of the calling process
+ * @param events_inout Event counter last seen / current counter
+ * @param timeout_ms Maximum wait in milliseconds (-1 = no limit)
+ * @return 0 if events arrived, -1 on error
+ */
+int shared_memory_kv_wait(shared_memory_kv_store_t *store, int subscription,
+                          unsigned int *events_inout, int timeout_ms) {
+  // Step 1: Validate input parameters
+  if (store == NULL || events_inout == NULL || subscription < 0 ||
+      subscription >= KV_SUBSCRIPTIONS || timeout_ms < -1) {
+    errno = EINVAL;
+    return -1;
+  }
+  kv_subscription_t *entry = &store->subscriptions[subscription];
+  if (atomic_load_explicit(&entry->pid, memory_order_acquire) !=
+      (int)getpid()) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Compute the deadline (the futex timeout is relative, and each
+  // wake-up without a change of the counter waits again for the rest)
+  struct timespec deadline = {0, 0};
+  if (timeout_ms > 0) {
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+  }
+
+  for (;;) {
+    // Step 3: Return as soon as the counter moved
+    unsigned int events = atomic_load(&entry->events);
+    if (events != *events_inout) {
+      *events_inout = events;
+      return 0;
+    }
+
+    struct timespec remaining;
+    if (timeout_ms == 0) {
+      errno = ETIMEDOUT;
+      return -1;
+    }
+    if (timeout_ms > 0) {
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      remaining.tv_sec = deadline.tv_sec - now.tv_sec;
+      remaining.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+      if (remaining.tv_nsec < 0) {
+        remaining.tv_sec--;
+        remaining.tv_nsec += 1000000000L;
+      }
+      if (remaining.tv_sec < 0) {
+        errno = ETIMEDOUT;
+        return -1;
+      }
+    }
+
+    // Step 4: Sleep until a writer signals the counter
+    // The kernel only sleeps if the counter still holds the value seen, so
+    // an event between the check above and the call is not lost
+    atomic_fetch_add(&entry->waiters, 1);
+    long result = kv_futex(&entry->events, FUTEX_WAIT, *events_inout,
+                           timeout_ms > 0 ? &remaining : NULL);
+    int saved_errno = errno;
+    atomic_fetch_sub(&entry->waiters, 1);
+    if (result == -1 && saved_errno == EINTR) {
+      errno = EINTR;
+      return -1;
+    }
+  }
+}
+
+/**
+ * Cancels a subscription of the calling process
+ *
+ * @param store Pointer to shared memory KV store
+ * @param subscription Subscription id
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_unsubscribe(shared_memory_kv_store_t *store,
+                                 int subscription) {
+  // Step 1: Validate input parameters
+  if (store == NULL || subscription < 0 || subscription >= KV_SUBSCRIPTIONS) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Take the entry from its owner (lock-free), then free it
+  int pid = (int)getpid();
+  kv_subscription_t *entry = &store->subscriptions[subscription];
+  if (!atomic_compare_exchange_strong(&entry->pid, &pid, -1)) {
+    errno = EINVAL;
+    return -1;
+  }
+  kv_subscription_free(store, entry);
+  return 0;
+}
+
+/**
+ * Returns a pollable file descriptor signalling events of a subscription
+ *
+ * @param store Pointer to shared memory KV store
+ * @param subscription Subscription id of the calling process
+ * @return File descriptor, or -1 on error
+ */
+int shared_memory_kv_notify_fd(shared_memory_kv_store_t *store,
+                               int subscription) {
+  // Step 1: Validate input parameters
+  if (store == NULL || subscription < 0 || subscription >= KV_SUBSCRIPTIONS) {
+    errno = EINVAL;
+    return -1;
+  }
+  int pid = (int)getpid();
+  kv_subscription_t *entry = &store->subscriptions[subscription];
+  if (atomic_load_explicit(&entry->pid, memory_order_acquire) != pid) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (atomic_load(&entry->notify_socket)) {
+    errno = EEXIST;
+    return -1;
+  }
+
+  // Step 2: Create the socket under the subscription's name
+  // Non-blocking, so draining it in an event loop never blocks
+  int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd == -1) {
+    return -1;
+  }
+  struct sockaddr_un address;
+  socklen_t length = kv_notify_address(&address, pid, subscription);
+  if (bind(fd, (const struct sockaddr *)&address, length) == -1) {
+    int saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return -1;
+  }
+
+  // Step 3: Announce it to writers, armed for the first event
+  atomic_store(&entry->notify_armed, 1);
+  atomic_store(&entry->notify_socket, 1);
+  return fd;
+}
+
+/**
+ * Consumes the notifications of a subscription's notification socket
+ *
+ * @param store Pointer to shared memory KV store
+ * @param subscription Subscription id of the calling process
+ * @param fd Descriptor returned by shared_memory_kv_notify_fd()
+ * @param events_inout Event counter last seen / current counter
+ * @return 0 if events arrived, -1 on error
+ */
+int shared_memory_kv_notify_read(shared_memory_kv_store_t *store,
+                                 int subscription, int fd,
+                                 unsigned int *events_inout) {
+  // Step 1: Validate input parameters
+  if (store == NULL || fd < 0 || events_inout == NULL || subscription < 0 ||
+      subscription >= KV_SUBSCRIPTIONS) {
+    errno = EINVAL;
+    return -1;
+  }
+  kv_subscription_t *entry = &store->subscriptions[subscription];
+  if (atomic_load_explicit(&entry->pid, memory_order_acquire) !=
+      (int)getpid()) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Drain pending datagrams (their content does not matter)
+  char buffer[16];
+  while (recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+  }
+
+  // Step 3: Re-arm, then look at the counter
+  // Armed before the counter is read: an event after the read sends a new
+  // datagram, one before it is reported now
+  atomic_store(&entry->notify_armed, 1);
+  unsigned int events = atomic_load(&entry->events);
+  if (events == *events_inout) {
+    errno = EAGAIN;
+    return -1;
+  }
+  *events_inout = events;
+  return 0;
+}
+
+/**
+ * Sets (adds or updates) a key-value pair in the store
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value Value string (max VALUE_SIZE-1 characters)
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_set(shared_memory_kv_store_t *store, const char *key,
+                         const char *value) {
+  // Step 1: Validate input parameters
+  if (store == NULL || key == NULL || value == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Check key and value lengths
+  // strnlen returns the length of the string, but not more than the limit
+  // If length >= KEY_SIZE, it means the string is too long (no space for '\0')
+  size_t key_len = strnlen(key, KEY_SIZE);
+  size_t value_len = strnlen(value, VALUE_SIZE);
+
+  if (key_len >= KEY_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  if (value_len >= VALUE_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  // Step 3: Write under the semaphore for exclusive access
+  // sem_wait decrements the semaphore value (blocks if value is 0)
+  // This ensures only one process can modify the store at a time
+  // Critical for IPC: without this, we could have race conditions
+  // A writer that finds the semaphore taken hands its write to the holder
+  // (flat combining, see kv_submit_write). With KV_FLAG_SINGLE_WRITER no
+  // other process writes, so the lock is skipped entirely. The sequence
+  // lock additionally tells lock-free snapshot readers that a modification
+  // is in progress
+  //
+  // The key is looked up along its probe sequence (starting at its home
+  // slot) to decide between update and insert. The value (and key for a
+  // new entry) is allocated in the arena before anything in the table
+  // changes, so a full table or arena leaves the store untouched.
+  return kv_submit_write(store, KV_COMBINE_SET, key, value, value_len,
+                         KV_TYPE_STRING);
+}
+
+/**
+ * Set of a typed value for the shared_memory_kv_set_* variants
+ *
+ * @return 0 on success, -1 on error
+ */
+static int kv_set_typed(shared_memory_kv_store_t *store, const char *key,
+                        const void *value, size_t value_len,
+                        unsigned int type) {
+  // Step 1: Validate input parameters
+  if (store == NULL || key == NULL || (value == NULL && value_len > 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Check key and value lengths
+  if (strnlen(key, KEY_SIZE) >= KEY_SIZE || value_len >= VALUE_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  // Step 3: Write like shared_memory_kv_set; the value bytes are stored
+  // as they are, with the type in the blob
+  return kv_submit_write(store, KV_COMBINE_SET, key, value, value_len, type);
+}
+
+/**
+ * Sets a key to a native 64-bit integer
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value Value
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_set_int64(shared_memory_kv_store_t *store,
+                               const char *key, long long value) {
+  return kv_set_typed(store, key, &value, sizeof(value), KV_TYPE_INT64);
+}
+
+/**
+ * Sets a key to a native double
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value Value
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_set_double(shared_memory_kv_store_t *store,
+                                const char *key, double value) {
+  return kv_set_typed(store, key, &value, sizeof(value), KV_TYPE_DOUBLE);
+}
+
+/**
+ * Sets a key to opaque bytes
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param data Value bytes
+ * @param length Number of bytes (max VALUE_SIZE-1)
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_set_bytes(shared_memory_kv_store_t *store,
+                               const char *key, const void *data,
+                               size_t length) {
+  return kv_set_typed(store, key, data, length, KV_TYPE_BYTES);
+}
+
+/**
+ * Sets a key to a value of any type
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value Value as filled by shared_memory_kv_get_value()
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_set_value(shared_memory_kv_store_t *store,
+                               const char *key, const kv_value_t *value) {
+  if (value == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  switch (value->type) {
+  case KV_TYPE_STRING:
+    return kv_set_typed(store, key, value->data,
+                        strnlen(value->data, VALUE_SIZE), KV_TYPE_STRING);
+  case KV_TYPE_INT64:
+    return shared_memory_kv_set_int64(store, key, value->int64);
+  case KV_TYPE_DOUBLE:
+    return shared_memory_kv_set_double(store, key, value->number);
+  case KV_TYPE_BYTES:
+  case KV_TYPE_HASH:
+    return kv_set_typed(store, key, value->data, value->length, value->type);
+  default:
+    errno = EINVAL;
+    return -1;
+  }
+}
+
+/**
+ * Lookup for the shared_memory_kv_get* functions
+ *
+ * Copies the value as text into value_out, or with its type into
+ * typed_out when that is not NULL.
+ *
+ * @return 0 on success, -1 on error
+ */
+static int kv_get(shared_memory_kv_store_t *store, const char *key,
+                  char *value_out, kv_value_t *typed_out) {
+  // Step 1: Validate input parameters
+  if (store == NULL || key == NULL ||
+      (value_out == NULL && typed_out == NULL)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Check key length
+  size_t key_len = strnlen(key, KEY_SIZE);
+  if (key_len >= KEY_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  // Step 3: Consult the bloom filter without locking
+  // Most misses end here, touching KV_BLOOM_HASHES bytes and no semaphore
+  unsigned int hash = kv_hash_key(key);
+  if (!kv_bloom_may_contain(store, hash)) {
+    atomic_fetch_add_explicit(&store->bloom_rejects, 1, memory_order_relaxed);
+    errno = ENOENT;
+    return -1;
+  }
+
+  // Step 4: Claim (once per thread) a registry entry, or use a shared
+  // reader entry while the registry is full
+  kv_registry_entry_t *reader = kv_reader_entry(store);
+
+  // Step 5: Find the key's newest version inside an epoch
+  // Between kv_epoch_enter() and kv_epoch_exit() no version record or blob
+  // this reader can reach is freed, whatever writers do meanwhile. A hit is
+  // a complete published version and needs no check; a miss only counts if
+  // no write ran meanwhile. Retries leave the epoch first, so a writer
+  // waiting for reclamation is never held up by them
+  unsigned int head = 0;
+  for (;;) {
+    kv_epoch_enter(store, reader);
+    unsigned int seq = kv_seq_read_begin(store);
+    head = kv_find_version(store, key, hash);
+    if (head != 0) {
+      // Step 6: Copy the value out of the version record
+      kv_pair_t view = kv_version_view(kv_version(store, head));
+      if (typed_out != NULL) {
+        kv_value_read(store, &view, typed_out);
+      } else {
+        kv_value_copy(store, &view, value_out);
+      }
+      kv_epoch_exit(reader);
+      break;
+    }
+    kv_epoch_exit(reader);
+
+    if ((seq & 1) == 0 && kv_seq_read_valid(store, seq)) {
+      break;
+    }
+    if (seq & 1) {
+      sched_yield(); // The writer holding the semaphore was preempted
+    }
+  }
+
+  if (head == 0) {
+    // Key not found although the filter let it through
+    atomic_fetch_add_explicit(&store->bloom_false_positives, 1,
+                              memory_order_relaxed);
+    errno = ENOENT;
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * Gets a value from the store by key
+ * 
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value_out Pointer to return the value (max VALUE_SIZE-1 characters)
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params, 
+ *         ENOSPC if table is full, ENAMETOOLONG if key/value too long)
+ */
+int shared_memory_kv_get(shared_memory_kv_store_t *store, const char *key,
+                         char *value_out) {
+  if (value_out == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  return kv_get(store, key, value_out, NULL);
+}
+
+/**
+ * Gets a value from the store by key, with its type
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value_out Pointer to return the value
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_get_value(shared_memory_kv_store_t *store,
+                               const char *key, kv_value_t *value_out) {
+  if (value_out == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  return kv_get(store, key, NULL, value_out);
+}
+
+/**
+ * Gets a value from the store as a 64-bit integer
+ *
+ * Native integers are returned as they are; doubles only if they hold an
+ * integer; text values are parsed (values written by shared_memory_kv_set).
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value_out Pointer to return the value
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_get_int64(shared_memory_kv_store_t *store,
+                               const char *key, long long *value_out) {
+  kv_value_t value;
+  if (value_out == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (kv_get(store, key, NULL, &value) == -1) {
+    return -1;
+  }
+
+  char *end;
+  switch (value.type) {
+  case KV_TYPE_INT64:
+    *value_out = value.int64;
+    return 0;
+  case KV_TYPE_DOUBLE:
+    // In range and without a fractional part
+    if (value.number >= -9223372036854775808.0 &&
+        value.number < 9223372036854775808.0 &&
+        (double)(long long)value.number == value.number) {
+      *value_out = (long long)value.number;
+      return 0;
+    }
+    break;
+  case KV_TYPE_STRING:
+    errno = 0;
+    *value_out = strtoll(value.data, &end, 10);
+    if (end != value.data && *end == '\0' && errno == 0) {
+      return 0;
+    }
+    break;
+  }
+
+  errno = EINVAL;
+  return -1;
+}
+
+/**
+ * Gets a value from the store as a double
+ *
+ * Native numbers are returned as they are (integers converted); text
+ * values are parsed (values written by shared_memory_kv_set).
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value_out Pointer to return the value
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_get_double(shared_memory_kv_store_t *store,
+                                const char *key, double *value_out) {
+  kv_value_t value;
+  if (value_out == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (kv_get(store, key, NULL, &value) == -1) {
+    return -1;
+  }
+
+  char *end;
+  switch (value.type) {
+  case KV_TYPE_INT64:
+  case KV_TYPE_DOUBLE:
+    *value_out = value.number;
+    return 0;
+  case KV_TYPE_STRING:
+    *value_out = strtod(value.data, &end);
+    if (end != value.data && *end == '\0') {
+      return 0;
+    }
+    break;
+  }
+
+  errno = EINVAL;
+  return -1;
+}
+
+/**
+ * Gets opaque bytes from the store by key
+ *
+ * Text values are returned as their bytes (no '\0'); numbers are EINVAL.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param data_out Buffer for the bytes
+ * @param capacity Size of data_out
+ * @return Number of bytes, or -1 on error
+ */
+int shared_memory_kv_get_bytes(shared_memory_kv_store_t *store,
+                               const char *key, void *data_out,
+                               size_t capacity) {
+  kv_value_t value;
+  if (data_out == NULL && capacity > 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (kv_get(store, key, NULL, &value) == -1) {
+    return -1;
+  }
+  if (value.type != KV_TYPE_BYTES && value.type != KV_TYPE_STRING) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (value.length > capacity) {
+    errno = ERANGE;
+    return -1;
+  }
+
+  if (value.length > 0) {
+    memcpy(data_out, value.data, value.length);
+  }
+  return (int)value.length;
+}
+
+/**
+ * Deletes a key-value pair from the store
+ * 
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_delete(shared_memory_kv_store_t *store, const char *key) {
+
+  // Step 1: Validate input parameters
+  if (store == NULL || key == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Check key length
+  size_t key_len = strnlen(key, KEY_SIZE);
+  if (key_len >= KEY_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  // Step 3: Find and delete the key (probe from its home slot) under the
+  // semaphore, combined with concurrent writers (single writer: no lock)
+  return kv_submit_write(store, KV_COMBINE_DELETE, key, NULL, 0, 0);
+}
+
+/**
+ * Sets a field of a hash entry
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param field Field name (max KV_HASH_FIELD_SIZE-1 characters)
+ * @param value Field value string
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_hset(shared_memory_kv_store_t *store, const char *key,
+                          const char *field, const char *value) {
+  // Step 1: Validate input parameters
+  if (store == NULL || key == NULL || field == NULL || value == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Check lengths; the field's record alone must fit in a value
+  size_t field_len = strnlen(field, KV_HASH_FIELD_SIZE);
+  size_t value_len = strnlen(value, VALUE_SIZE);
+  if (strnlen(key, KEY_SIZE) >= KEY_SIZE ||
+      field_len >= KV_HASH_FIELD_SIZE ||
+      field_len + 1 + value_len + 1 >= VALUE_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  // Step 3: Send "field\0value" as one request; the map is read and
+  // rewritten under the semaphore (see kv_hash_write)
+  char request[VALUE_SIZE];
+  memcpy(request, field, field_len + 1);
+  memcpy(request + field_len + 1, value, value_len);
+  return kv_submit_write(store, KV_COMBINE_HSET, key, request,
+                         field_len + 1 + value_len, KV_TYPE_HASH);
+}
+
+/**
+ * Reads a hash entry for shared_memory_kv_hget and shared_memory_kv_hgetall
+ *
+ * @return 0 on success, -1 on error (EINVAL if the value is not a hash)
+ */
+static int kv_hash_read(shared_memory_kv_store_t *store, const char *key,
+                        kv_value_t *value_out) {
+  if (kv_get(store, key, NULL, value_out) == -1) {
+    return -1;
+  }
+  if (value_out->type != KV_TYPE_HASH) {
+    errno = EINVAL;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Gets a field of a hash entry
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param field Field name
+ * @param value_out Buffer of VALUE_SIZE bytes for the field value
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_hget(shared_memory_kv_store_t *store, const char *key,
+                          const char *field, char *value_out) {
+  kv_value_t hash;
+  if (field == NULL || value_out == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (kv_hash_read(store, key, &hash) == -1) {
+    return -1;
+  }
+
+  size_t record_len;
+  long offset = kv_hash_find(hash.data, hash.length, field, &record_len);
+  if (offset == -1) {
+    errno = ENOENT;
+    return -1;
+  }
+  size_t field_len = strlen(field);
+  memcpy(value_out, hash.data + offset + field_len + 1,
+         record_len - field_len - 1); // Value with its '\0'
+  return 0;
+}
+
+/**
+ * Deletes a field of a hash entry
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param field Field name
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_hdel(shared_memory_kv_store_t *store, const char *key,
+                          const char *field) {
+  // Step 1: Validate input parameters
+  if (store == NULL || key == NULL || field == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Check lengths
+  size_t field_len = strnlen(field, KV_HASH_FIELD_SIZE);
+  if (strnlen(key, KEY_SIZE) >= KEY_SIZE ||
+      field_len >= KV_HASH_FIELD_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  // Step 3: Remove the field under the semaphore (see kv_hash_write)
+  return kv_submit_write(store, KV_COMBINE_HDEL, key, field, field_len,
+                         KV_TYPE_HASH);
+}
+
+/**
+ * Gets all fields of a hash entry
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value_out Pointer to return the hash
+ * @return Number of fields, or -1 on error
+ */
+int shared_memory_kv_hgetall(shared_memory_kv_store_t *store,
+                             const char *key, kv_value_t *value_out) {
+  if (value_out == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (kv_hash_read(store, key, value_out) == -1) {
+    return -1;
+  }
+
+  int count = 0;
+  size_t offset = 0;
+  const char *field;
+  const char *value;
+  while (shared_memory_kv_hash_next(value_out, &offset, &field, &value)) {
+    count++;
+  }
+  return count;
+}
+
+/**
+ * Steps through the fields of a hash
+ *
+ * @param hash Value of type KV_TYPE_HASH
+ * @param offset_inout Position in the map; 0 for the first field
+ * @param field_out Pointer to return the field name
+ * @param value_out Pointer to return the field value
+ * @return 1 if a field was returned, 0 at the end of the map
+ */
+int shared_memory_kv_hash_next(const kv_value_t *hash, size_t *offset_inout,
+                               const char **field_out,
+                               const char **value_out) {
+  if (hash == NULL || offset_inout == NULL || hash->type != KV_TYPE_HASH) {
+    return 0;
+  }
+
+  // A record is "field\0value\0"; a truncated one ends the map
+  size_t offset = *offset_inout;
+  size_t length = hash->length < VALUE_SIZE ? hash->length : VALUE_SIZE;
+  if (offset >= length) {
+    return 0;
+  }
+  size_t field_len = strnlen(hash->data + offset, length - offset);
+  size_t value_at = offset + field_len + 1;
+  if (value_at >= length) {
+    return 0;
+  }
+  size_t value_len = strnlen(hash->data + value_at, length - value_at);
+  if (value_at + value_len >= length) {
+    return 0;
+  }
+
+  if (field_out != NULL) {
+    *field_out = hash->data + offset;
+  }
+  if (value_out != NULL) {
+    *value_out = hash->data + value_at;
+  }
+  *offset_inout = value_at + value_len + 1;
+  return 1;
+}
+
+/**
+ * Runs one bounded step of tombstone compaction
+ *
+ * @param store Pointer to shared memory KV store
+ * @param max_slots Maximum number of slots to examine in this step
+ * @return Number of slots changed, or -1 on error
+ */
+int shared_memory_kv_compact_step(shared_memory_kv_store_t *store,
+                                  unsigned int max_slots) {
+  // Step 1: Validate input parameters
+  if (store == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Nothing to do without tombstones, retired objects or a due
+  // registry check (cheap unlocked check; anything created right now is
+  // picked up by the next step)
+  int reap_due = (long long)time(NULL) -
+                     atomic_load_explicit(&store->last_reap,
+                                          memory_order_relaxed) >=
+                 KV_REAP_INTERVAL;
+  if ((store->tombstone_count == 0 && store->retired_count == 0 &&
+       !reap_due) ||
+      max_slots == 0) {
+    return 0;
+  }
+
+  // Step 3: Lock semaphore for exclusive access (single writer: no lock)
+  if (kv_write_lock(store) == -1) {
+    return -1;
+  }
+  kv_seq_write_begin(store);
+
+  int changed = 0;
+  unsigned int work = 0; // Slots examined in this step (cursor and scans)
+
+  while (work < max_slots && store->tombstone_count > 0) {
+    unsigned int slot = store->compact_cursor % MAX_ENTRIES;
+    kv_pair_t *pair = &store->kv_table[slot];
+    work++;
+
+    // Step 4: Move an entry back into the first tombstone of its probe path
+    if (pair->state == KV_SLOT_OCCUPIED) {
+      unsigned int target = kv_home_slot(pair->hash);
+      while (target != slot &&
+             store->kv_table[target].state != KV_SLOT_TOMBSTONE) {
+        target = (target + 1) % MAX_ENTRIES;
+      }
+
+      if (target != slot) {
+        kv_pair_t *moved = &store->kv_table[target];
+        kv_slot_write_begin(moved);
+        kv_slot_write_begin(pair);
+        kv_index_relocate(store, slot, target);
+        moved->key_prefix_ref = pair->key_prefix_ref;
+        moved->key_suffix_ref = pair->key_suffix_ref;
+        moved->value_ref = pair->value_ref;
+        moved->timestamp = pair->timestamp;
+        moved->hash = pair->hash;
+        moved->state = KV_SLOT_OCCUPIED;
+
+        // Publish the chain at the new slot before unlinking the old one;
+        // a reader that misses the entry in between retries (the sequence
+        // lock is odd)
+        atomic_store_explicit(
+            &moved->head,
+            atomic_load_explicit(&pair->head, memory_order_relaxed),
+            memory_order_release);
+        atomic_store_explicit(&pair->head, 0, memory_order_release);
+
+        // The old slot stays part of other probe sequences: tombstone it
+        pair->key_prefix_ref = 0;
+        pair->key_suffix_ref = 0;
+        pair->value_ref = 0;
+        pair->timestamp = 0;
+        pair->hash = 0;
+        pair->state = KV_SLOT_TOMBSTONE;
+
+        store->version++;
+        moved->slot_version = store->version;
+        pair->slot_version = store->version;
+        kv_slot_write_end(pair);
+        kv_slot_write_end(moved);
+        store->compact_moved++;
+        changed++;
+      }
+    }
+
+    // Step 5: Purge a tombstone that no probe path crosses
+    // Only entries between this slot and the next empty slot can have a
+    // probe path through it; if none of them does, lookups never need it.
+    // Runs longer than the remaining budget are left for a later step.
+    if (pair->state == KV_SLOT_TOMBSTONE) {
+      int needed = 0;
+      unsigned int scan = (slot + 1) % MAX_ENTRIES;
+
+      while (scan != slot && store->kv_table[scan].state != KV_SLOT_EMPTY) {
+        if (work >= max_slots) {
+          needed = 1;
+          break;
+        }
+        work++;
+
+        const kv_pair_t *other = &store->kv_table[scan];
+        if (other->state == KV_SLOT_OCCUPIED) {
+          unsigned int home = kv_home_slot(other->hash);
+          unsigned int to_slot = (slot + MAX_ENTRIES - home) % MAX_ENTRIES;
+          unsigned int to_other = (scan + MAX_ENTRIES - home) % MAX_ENTRIES;
+          if (to_slot < to_other) {
+            needed = 1; // other's probe path passes through slot
+            break;
+          }
+        }
+        scan = (scan + 1) % MAX_ENTRIES;
+      }
+
+      if (!needed) {
+        kv_slot_write_begin(pair);
+        pair->state = KV_SLOT_EMPTY;
+        kv_slot_write_end(pair);
+        store->tombstone_count--;
+        store->compact_purged++;
+        changed++;
+      }
+    }
+
+    // Step 6: Advance the cursor
+    store->compact_cursor = (slot + 1) % MAX_ENTRIES;
+    if (store->compact_cursor == 0) {
+      store->compact_passes++;
+    }
+  }
+
+  // Step 7: Reap processes that died attached (at most every
+  // KV_REAP_INTERVAL seconds) and their subscriptions, then free retired
+  // versions readers finished with meanwhile
+  if (reap_due) {
+    kv_registry_reap(store);
+    kv_subscription_reap(store);
+  }
+  kv_reclaim(store);
+
+  // Step 8: Unlock semaphore
+  kv_seq_write_end(store);
+  kv_write_unlock(store);
+
+  return changed;
+}
+
+/**
+ * Body of shared_memory_kv_occupancy_stats (under the semaphore or inside
+ * an optimistic read)
+ *
+ * @return Sum of the probe lengths of all entries
+ */
+static unsigned long long
+kv_occupancy_locked(const shared_memory_kv_store_t *store,
+                    kv_occupancy_stats_t *stats_out) {
+  memset(stats_out, 0, sizeof(*stats_out));
+  stats_out->capacity = MAX_ENTRIES;
+
+  // Step 1: Split the table into at most KV_OCCUPANCY_REGIONS regions
+  stats_out->region_size =
+      (MAX_ENTRIES + KV_OCCUPANCY_REGIONS - 1) / KV_OCCUPANCY_REGIONS;
+  stats_out->region_count =
+      (MAX_ENTRIES + stats_out->region_size - 1) / stats_out->region_size;
+
+  // Step 2: One pass over all slots
+  unsigned long long probe_total = 0;
+  for (unsigned int i = 0; i < MAX_ENTRIES; i++) {
+    const kv_pair_t *pair = &store->kv_table[i];
+    unsigned int region = i / stats_out->region_size;
+
+    if (pair->state == KV_SLOT_TOMBSTONE) {
+      stats_out->tombstone_count++;
+      stats_out->region_tombstones[region]++;
+      continue;
+    }
+    if (pair->state != KV_SLOT_OCCUPIED) {
+      continue;
+    }
+
+    unsigned int probe_length = kv_probe_length(i, pair->hash);
+    unsigned int bucket = probe_length - 1;
+    if (bucket >= KV_PROBE_HISTOGRAM_BUCKETS) {
+      bucket = KV_PROBE_HISTOGRAM_BUCKETS - 1;
+    }
+
+    stats_out->entry_count++;
+    stats_out->region_occupied[region]++;
+    stats_out->probe_histogram[bucket]++;
+    probe_total += probe_length;
+    if (probe_length > stats_out->max_probe_length) {
+      stats_out->max_probe_length = probe_length;
+    }
+  }
+
+  // Compaction progress is read in the same (locked or validated) pass
+  stats_out->compact_cursor = store->compact_cursor;
+  stats_out->compact_passes = store->compact_passes;
+  stats_out->compact_moved = store->compact_moved;
+  stats_out->compact_purged = store->compact_purged;
+
+  // Bloom filter effectiveness and fill
+  stats_out->bloom_rejects =
+      atomic_load_explicit(&store->bloom_rejects, memory_order_relaxed);
+  stats_out->bloom_false_positives = atomic_load_explicit(
+      &store->bloom_false_positives, memory_order_relaxed);
+  for (unsigned int i = 0; i < KV_BLOOM_COUNTERS; i++) {
+    if (atomic_load_explicit(&store->bloom[i], memory_order_relaxed) != 0) {
+      stats_out->bloom_counters_set++;
+    }
+  }
+
+  return probe_total;
+}
+
+/**
+ * Computes occupancy and probe-length statistics of the hash table
+ *
+ * @param store Pointer to shared memory KV store
+ * @param stats_out Pointer to return the statistics
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_occupancy_stats(shared_memory_kv_store_t *store,
+                                     kv_occupancy_stats_t *stats_out) {
+  // Step 1: Validate input parameters
+  if (store == NULL || stats_out == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Lock semaphore for a consistent view of the table (single
+  // writer: an optimistic pass, repeated if a write overlapped it)
+  kv_read_t read;
+  unsigned long long probe_total;
+  do {
+    if (kv_read_lock(store, &read) == -1) {
+      return -1;
+    }
+    probe_total = kv_occupancy_locked(store, stats_out);
+  } while (kv_read_unlock(store, &read));
+
+  // Step 3: Derived values
+  stats_out->load_factor = (double)stats_out->entry_count / MAX_ENTRIES;
+  if (stats_out->entry_count > 0) {
+    stats_out->avg_probe_length =
+        (double)probe_total / stats_out->entry_count;
+  }
+
+  return 0;
+}
+
+/**
+ * Reads the key and value stored in a table slot
+ *
+ * @param store Pointer to shared memory KV store
+ * @param slot Slot index (0..MAX_ENTRIES-1)
+ * @param key_out Buffer of at least KEY_SIZE bytes
+ * @param value_out Buffer of at least VALUE_SIZE bytes
+ * @param timestamp_out Optional pointer to return the update timestamp
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_read_slot(shared_memory_kv_store_t *store,
+                               unsigned int slot, char *key_out,
+                               char *value_out, time_t *timestamp_out) {
+  // Step 1: Validate input parameters
+  if (store == NULL || key_out == NULL || value_out == NULL ||
+      slot >= MAX_ENTRIES) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Copy key and value out of the arena without locking
+  // Inside an epoch no blob the slot refers to is freed; the slot's own
+  // sequence counter tells whether the slot changed during the copy, so
+  // writes to other slots never force a retry
+  const kv_pair_t *pair = &store->kv_table[slot];
+  kv_registry_entry_t *reader = kv_reader_entry(store);
+  int occupied;
+  for (;;) {
+    unsigned int seq = atomic_load_explicit(&pair->seq, memory_order_acquire);
+    if (seq & 1) {
+      sched_yield(); // The writer is changing this slot
+      continue;
+    }
+    kv_epoch_enter(store, reader);
+
+    occupied = pair->state == KV_SLOT_OCCUPIED;
+    if (occupied) {
+      kv_key_copy(store, pair, key_out);
+      kv_value_copy(store, pair, value_out);
+      if (timestamp_out != NULL) {
+        *timestamp_out = pair->timestamp;
+      }
+    }
+
+    kv_epoch_exit(reader);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&pair->seq, memory_order_relaxed) == seq) {
+      break;
+    }
+  }
+
+  if (!occupied) {
+    errno = ENOENT;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Sets the preset dictionary used for value compression
+ *
+ * @param store Pointer to shared memory KV store
+ * @param dictionary Dictionary bytes (NULL with length 0 clears it)
+ * @param length Dictionary size (max KV_COMPRESS_DICT_SIZE bytes)
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_set_dictionary(shared_memory_kv_store_t *store,
+                                    const void *dictionary, size_t length) {
+  // Step 1: Validate input parameters
+  if (store == NULL || (dictionary == NULL && length > 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (length > KV_COMPRESS_DICT_SIZE) {
+    errno = E2BIG;
+    return -1;
+  }
+
+  // Step 2: Lock semaphore for exclusive access (single writer: no lock)
+  if (kv_write_lock(store) == -1) {
+    return -1;
+  }
+  kv_seq_write_begin(store);
+
+  // Step 3: Replace the dictionary unless stored values depend on it
+  // (retired versions count until reclaimed: readers may still decode them)
+  kv_reclaim(store);
+  int result = 0;
+  if (store->compressed_values > 0) {
+    errno = EBUSY;
+    result = -1;
+  } else {
+    if (length > 0) {
+      memcpy(store->compress_dict, dictionary, length);
+    }
+    store->compress_dict_length = (unsigned int)length;
+  }
+
+  // Step 4: Unlock semaphore
+  kv_seq_write_end(store);
+  kv_write_unlock(store);
+
+  return result;
+}
+
+/**
+ * Body of shared_memory_kv_memory_stats (under the semaphore or inside an
+ * optimistic read)
+ */
+static void kv_memory_stats_locked(const shared_memory_kv_store_t *store,
+                                   kv_memory_stats_t *stats_out) {
+  // Step 1: Copy counters maintained by the allocator
+  memset(stats_out, 0, sizeof(*stats_out));
+  stats_out->flags = store->flags;
+  stats_out->arena_size = ARENA_SIZE;
+  stats_out->arena_top = store->arena_top;
+  stats_out->allocated_bytes = store->arena_allocated_bytes;
+  stats_out->free_bytes = store->arena_free_bytes;
+  stats_out->blob_count = store->blob_count;
+  stats_out->dedup_hits = store->dedup_hits;
+  stats_out->bytes_saved = store->bytes_saved;
+  stats_out->compress_dict_length = store->compress_dict_length;
+  stats_out->compressed_values = store->compressed_values;
+  stats_out->compressed_bytes = store->compressed_bytes;
+  stats_out->uncompressed_bytes = store->uncompressed_bytes;
+  stats_out->epoch = atomic_load_explicit(&store->epoch, memory_order_relaxed);
+  stats_out->version_records = store->version_records;
+  stats_out->retired_pending = store->retired_count;
+  stats_out->reclaimed = store->reclaimed;
+  stats_out->retire_overflows = store->retire_overflows;
+  stats_out->writer_pid = kv_single_writer(store) ? store->writer_pid : 0;
+  stats_out->combined_writes = store->combined_writes;
+  stats_out->combine_batches = store->combine_batches;
+  stats_out->subscriptions = atomic_load_explicit(&store->subscription_count,
+                                                  memory_order_relaxed);
+  stats_out->notifications =
+      atomic_load_explicit(&store->notifications, memory_order_relaxed);
+  stats_out->reaped_entries =
+      atomic_load_explicit(&store->reaped, memory_order_relaxed);
+  for (unsigned int i = 0; i < KV_SHARED_READERS; i++) {
+    stats_out->active_readers += (unsigned int)(
+        atomic_load_explicit(&store->shared_readers[i].epoch,
+                             memory_order_relaxed) >>
+        KV_SHARED_EPOCH_BITS);
+  }
+  for (unsigned int i = 0; i < KV_REGISTRY_SIZE; i++) {
+    const kv_registry_entry_t *entry = &store->registry[i];
+    int pid = atomic_load_explicit(&entry->pid, memory_order_relaxed);
+    if (pid <= 0) {
+      continue;
+    }
+    stats_out->registry_entries++;
+    if (atomic_load_explicit(&entry->epoch, memory_order_relaxed) != 0) {
+      stats_out->active_readers++;
+    }
+
+    // Count each pid once (at its first entry; entries change while this
+    // runs, so the search stops at i in any case), unless it is counted
+    // as attached below
+    unsigned int first = 0;
+    while (first < i && atomic_load_explicit(&store->registry[first].pid,
+                                             memory_order_relaxed) != pid) {
+      first++;
+    }
+    unsigned int attached = 0;
+    while (attached < KV_PROCESS_MAX &&
+           atomic_load_explicit(&store->processes[attached].pid,
+                                memory_order_relaxed) != pid) {
+      attached++;
+    }
+    if (first == i && attached == KV_PROCESS_MAX) {
+      stats_out->attached_processes++;
+    }
+  }
+  for (unsigned int i = 0; i < KV_PROCESS_MAX; i++) {
+    if (atomic_load_explicit(&store->processes[i].pid,
+                             memory_order_relaxed) > 0) {
+      stats_out->attached_processes++;
+    }
+  }
+
+  // Step 2: Count shared blobs (only interned blobs can be shared)
+  // An optimistic read may follow a chain through reused blocks: offsets
+  // are bounds-checked and the walk is capped, the result is discarded
+  unsigned int visited = 0;
+  for (unsigned int bucket = 0; bucket < KV_BLOB_BUCKETS; bucket++) {
+    for (unsigned int offset = store->blob_buckets[bucket];
+         offset != 0 && offset <= ARENA_SIZE - sizeof(kv_blob_t) &&
+         visited < ARENA_SIZE / sizeof(kv_blob_t);
+         visited++) {
+      const kv_blob_t *blob = kv_blob(store, offset);
+      if (blob->refcount > 1) {
+        stats_out->shared_blob_count++;
+      }
+      offset = blob->next;
+    }
+  }
+}
+
+/**
+ * Computes arena usage and deduplication statistics
+ *
+ * @param store Pointer to shared memory KV store
+ * @param stats_out Pointer to return the statistics
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_memory_stats(shared_memory_kv_store_t *store,
+                                  kv_memory_stats_t *stats_out) {
+  // Step 1: Validate input parameters
+  if (store == NULL || stats_out == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Lock semaphore for a consistent view (single writer: an
+  // optimistic read, repeated if a write overlapped it)
+  kv_read_t read;
+  do {
+    if (kv_read_lock(store, &read) == -1) {
+      return -1;
+    }
+    kv_memory_stats_locked(store, stats_out);
+  } while (kv_read_unlock(store, &read)); // Step 3: Unlock semaphore
+
+  return 0;
+}
+
+/**
+ * Case-insensitive substring check
+ */
+static int kv_contains_nocase(const char *haystack, const char *needle) {
+  size_t needle_len = strlen(needle);
+
+  for (const char *start = haystack; *start != '\0'; start++) {
+    size_t i = 0;
+    while (i < needle_len && start[i] != '\0' &&
+           tolower((unsigned char)start[i]) ==
+               tolower((unsigned char)needle[i])) {
+      i++;
+    }
+    if (i == needle_len) {
+      return 1;
+    }
+  }
+  return needle_len == 0;
+}
+
+/**
+ * Case-insensitive subsequence check (all query characters in order)
+ */
+static int kv_is_subsequence_nocase(const char *key, const char *query) {
+  while (*query != '\0') {
+    while (*key != '\0' &&
+           tolower((unsigned char)*key) != tolower((unsigned char)*query)) {
+      key++;
+    }
+    if (*key == '\0') {
+      return 0;
+    }
+    key++;
+    query++;
+  }
+  return 1;
+}
+
+/**
+ * Copies a slot into a search result
+ */
+static void kv_fill_search_result(const shared_memory_kv_store_t *store,
+                                  unsigned int slot, int match,
+                                  kv_search_result_t *result) {
+  kv_key_copy(store, &store->kv_table[slot], result->key);
+  kv_value_copy(store, &store->kv_table[slot], result->value);
+  result->slot = slot;
+  result->match = match;
+}
+
+/**
+ * Body of shared_memory_kv_search (under the semaphore or inside an
+ * optimistic read)
+ *
+ * @return Number of results written
+ */
+static size_t kv_search_locked(const shared_memory_kv_store_t *store,
+                               const char *query, size_t query_len,
+                               int flags, kv_search_result_t *results_out,
+                               size_t max_results) {
+  size_t count = 0;
+  unsigned int prefix_start = 0;
+  unsigned int prefix_end = 0; // Range [start, end) of prefix matches
+
+  // Step 1: Prefix matches from the sorted index
+  // All keys with the prefix form a contiguous run starting at the lower
+  // bound of the query, so we walk forward until the prefix stops matching
+  char key[KEY_SIZE];
+  if (flags & KV_SEARCH_PREFIX) {
+    prefix_start = kv_index_lower_bound(store, query);
+    prefix_end = prefix_start;
+    while (prefix_end < store->entry_count) {
+      kv_key_copy(store, &store->kv_table[store->key_index[prefix_end]], key);
+      if (strncmp(key, query, query_len) != 0) {
+        break;
+      }
+      if (count < max_results) {
+        kv_fill_search_result(store, store->key_index[prefix_end],
+                              KV_MATCH_PREFIX, &results_out[count]);
+        count++;
+      } else {
+        break;
+      }
+      prefix_end++;
+    }
+  }
+
+  // Step 2: Fuzzy fallback (linear scan in key order)
+  // Pass 1 collects substring matches, pass 2 subsequence matches, skipping
+  // keys that were already returned as prefix matches
+  if ((flags & KV_SEARCH_FUZZY) && count < max_results && query_len > 0) {
+    for (int pass = 0; pass < 2 && count < max_results; pass++) {
+      for (unsigned int i = 0; i < store->entry_count && count < max_results;
+           i++) {
+        if (i >= prefix_start && i < prefix_end) {
+          continue;
+        }
+        kv_key_copy(store, &store->kv_table[store->key_index[i]], key);
+        int is_substring = kv_contains_nocase(key, query);
+
+        if (pass == 0 && is_substring) {
+          kv_fill_search_result(store, store->key_index[i],
+                                KV_MATCH_SUBSTRING, &results_out[count]);
+          count++;
+        } else if (pass == 1 && !is_substring &&
+                   kv_is_subsequence_nocase(key, query)) {
+          kv_fill_search_result(store, store->key_index[i], KV_MATCH_FUZZY,
+                                &results_out[count]);
+          count++;
+        }
+      }
+    }
+  }
+
+  return count;
+}
+
+/**
+ * Searches keys by prefix, substring or subsequence
+ *
+ * @param store Pointer to shared memory KV store
+ * @param query Query string (max KEY_SIZE-1 characters)
+ * @param flags KV_SEARCH_PREFIX and/or KV_SEARCH_FUZZY
+ * @param results_out Array of at least max_results elements
+ * @param max_results Maximum number of results to return
+ * @return Number of results written, or -1 on error
+ */
+int shared_memory_kv_search(shared_memory_kv_store_t *store, const char *query,
+                            int flags, kv_search_result_t *results_out,
+                            size_t max_results) {
+  // Step 1: Validate input parameters
+  if (store == NULL || query == NULL ||
+      (results_out == NULL && max_results > 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Check query length
+  size_t query_len = strnlen(query, KEY_SIZE);
+  if (query_len >= KEY_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  // Step 3: Lock semaphore for exclusive access (single writer: the search
+  // runs optimistically and is repeated if a write overlapped it)
+  kv_read_t read;
+  size_t count;
+  do {
+    if (kv_read_lock(store, &read) == -1) {
+      return -1;
+    }
+    count = kv_search_locked(store, query, query_len, flags, results_out,
+                             max_results);
+  } while (kv_read_unlock(store, &read)); // Step 4: Unlock semaphore
+
+  return (int)count;
+}
+
+// ============================================================================
+// SNAPSHOT READS
+// ============================================================================
+
+/**
+ * Copies the requested keys (under the semaphore or inside a seqlock read)
+ */
+static void kv_snapshot_copy_items(const shared_memory_kv_store_t *store,
+                                   kv_snapshot_item_t *items, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    int slot = kv_find_slot(store, items[i].key, kv_hash_key(items[i].key),
+                            NULL);
+    items[i].found = slot != -1;
+    if (slot != -1) {
+      kv_value_copy(store, &store->kv_table[slot], items[i].value);
+    } else {
+      items[i].value[0] = '\0';
+    }
+  }
+}
+
+/**
+ * Copies all occupied slots (under the semaphore or inside a seqlock read)
+ *
+ * @return Number of entries copied
+ */
+static int kv_snapshot_copy_table(const shared_memory_kv_store_t *store,
+                                  kv_entry_t *entries_out) {
+  int count = 0;
+  for (unsigned int slot = 0; slot < MAX_ENTRIES; slot++) {
+    const kv_pair_t *pair = &store->kv_table[slot];
+    if (pair->state != KV_SLOT_OCCUPIED) {
+      continue;
+    }
+    kv_entry_t *entry = &entries_out[count++];
+    kv_key_copy(store, pair, entry->key);
+    size_t length = kv_value_decode(store, pair, entry->value, &entry->type);
+    kv_value_number(entry->value, length, entry->type, &entry->int64,
+                    &entry->number);
+    kv_value_format(entry->value, length, entry->type);
+    entry->slot = slot;
+    entry->slot_version = pair->slot_version;
+    entry->timestamp = pair->timestamp;
+  }
+  return count;
+}
+
+/**
+ * Reads several keys as of one store version
+ *
+ * @param store Pointer to shared memory KV store
+ * @param items Keys to read
+ * @param count Number of items
+ * @param version_out Optional pointer to return the snapshot's store version
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_snapshot_get(shared_memory_kv_store_t *store,
+                                  kv_snapshot_item_t *items, size_t count,
+                                  unsigned int *version_out) {
+  // Step 1: Validate input parameters
+  if (store == NULL || (items == NULL && count > 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Check key lengths
+  for (size_t i = 0; i < count; i++) {
+    if (strnlen(items[i].key, KEY_SIZE) >= KEY_SIZE) {
+      errno = ENAMETOOLONG;
+      return -1;
+    }
+  }
+
+  // Step 3: Optimistic copies, validated by the sequence lock
+  // Values copied while a writer was active may be torn; they are simply
+  // discarded. Inside an epoch no block read here is reused meanwhile
+  // (arena accesses are bounds-checked anyway)
+  kv_registry_entry_t *reader = kv_reader_entry(store);
+  for (int attempt = 0; attempt < KV_SNAPSHOT_RETRIES; attempt++) {
+    unsigned int seq = kv_seq_read_begin(store);
+    if (seq & 1) {
+      continue;
+    }
+    kv_epoch_enter(store, reader);
+    unsigned int version = store->version;
+    kv_snapshot_copy_items(store, items, count);
+    kv_epoch_exit(reader);
+    if (kv_seq_read_valid(store, seq)) {
+      if (version_out != NULL) {
+        *version_out = version;
+      }
+      return 0;
+    }
+  }
+
+  // Step 4: Writers kept interfering, take the semaphore instead (a single
+  // writer never waits for it: keep retrying)
+  kv_read_t read;
+  unsigned int version;
+  do {
+    if (kv_read_lock(store, &read) == -1) {
+      return -1;
+    }
+    version = store->version;
+    kv_snapshot_copy_items(store, items, count);
+  } while (kv_read_unlock(store, &read));
+
+  if (version_out != NULL) {
+    *version_out = version;
+  }
+  return 0;
+}
+
+/**
+ * Copies every entry of the table as of one store version
+ *
+ * @param store Pointer to shared memory KV store
+ * @param entries_out Array of at least MAX_ENTRIES elements
+ * @param version_out Optional pointer to return the snapshot's store version
+ * @return Number of entries written, or -1 on error
+ */
+int shared_memory_kv_snapshot_table(shared_memory_kv_store_t *store,
+                                    kv_entry_t *entries_out,
+                                    unsigned int *version_out) {
+  // Step 1: Validate input parameters
+  if (store == NULL || entries_out == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Optimistic copies inside an epoch, validated by the sequence
+  // lock
+  kv_registry_entry_t *reader = kv_reader_entry(store);
+  for (int attempt = 0; attempt < KV_SNAPSHOT_RETRIES; attempt++) {
+    unsigned int seq = kv_seq_read_begin(store);
+    if (seq & 1) {
+      continue;
+    }
+    kv_epoch_enter(store, reader);
+    unsigned int version = store->version;
+    int count = kv_snapshot_copy_table(store, entries_out);
+    kv_epoch_exit(reader);
+    if (kv_seq_read_valid(store, seq)) {
+      if (version_out != NULL) {
+        *version_out = version;
+      }
+      return count;
+    }
+  }
+
+  // Step 3: Writers kept interfering, take the semaphore instead (a single
+  // writer never waits for it: keep retrying)
+  kv_read_t read;
+  unsigned int version;
+  int count;
+  do {
+    if (kv_read_lock(store, &read) == -1) {
+      return -1;
+    }
+    version = store->version;
+    count = kv_snapshot_copy_table(store, entries_out);
+  } while (kv_read_unlock(store, &read));
+
+  if (version_out != NULL) {
+    *version_out = version;
+  }
+  return count;
+}
+
+/**
+ * Reads the retained versions of a key
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param versions_out Array of at least max_versions elements
+ * @param max_versions Maximum number of versions to return
+ * @return Number of versions written, or -1 on error
+ */
+int shared_memory_kv_history(shared_memory_kv_store_t *store, const char *key,
+                             kv_version_info_t *versions_out,
+                             size_t max_versions) {
+  // Step 1: Validate input parameters
+  if (store == NULL || key == NULL ||
+      (versions_out == NULL && max_versions > 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Check key length
+  if (strnlen(key, KEY_SIZE) >= KEY_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  unsigned int hash = kv_hash_key(key);
+  if (!kv_bloom_may_contain(store, hash)) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  // Step 3: Claim a registry entry or use a shared reader entry (no
+  // semaphore, as in shared_memory_kv_get)
+  kv_registry_entry_t *reader = kv_reader_entry(store);
+
+  // Step 4: Inside an epoch, find the newest version and walk the chain
+  // from newest to oldest; misses during writes are retried outside it
+  unsigned int head = 0;
+  size_t count = 0;
+  for (;;) {
+    kv_epoch_enter(store, reader);
+    unsigned int seq = kv_seq_read_begin(store);
+    head = kv_find_version(store, key, hash);
+    for (unsigned int offset = head; offset != 0 && count < max_versions;) {
+      const kv_version_t *version = kv_version(store, offset);
+      kv_pair_t view = kv_version_view(version);
+      kv_version_info_t *info = &versions_out[count++];
+      kv_value_copy(store, &view, info->value);
+      info->version = version->store_version;
+      info->timestamp = version->timestamp;
+      offset = atomic_load_explicit(&version->prev, memory_order_acquire);
+    }
+    kv_epoch_exit(reader);
+
+    if (head != 0 || ((seq & 1) == 0 && kv_seq_read_valid(store, seq))) {
+      break;
+    }
+    if (seq & 1) {
+      sched_yield();
+    }
+  }
+
+  if (head == 0) {
+    errno = ENOENT;
+    return -1;
+  }
+  return (int)count;
+}
+
+// ============================================================================
+// TRANSACTIONS
+// ============================================================================
+
+/**
+ * Finds the buffered write of a key, or -1
+ */
+static int kv_txn_find_write(const shared_memory_kv_txn_t *txn,
+                             const char *key) {
+  for (unsigned int i = 0; i < txn->write_count; i++) {
+    if (strcmp(txn->writes[i].key, key) == 0) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Finds the recorded read of a key, or -1
+ */
+static int kv_txn_find_read(const shared_memory_kv_txn_t *txn,
+                            const char *key) {
+  for (unsigned int i = 0; i < txn->read_count; i++) {
+    if (strcmp(txn->reads[i].key, key) == 0) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Buffers a write (replacing an earlier write of the same key)
+ *
+ * @param value Value bytes (value_len of them) in the given KV_TYPE_*
+ * @return 0 on success, -1 on error
+ */
+static int kv_txn_buffer_write(shared_memory_kv_txn_t *txn, const char *key,
+                               const void *value, size_t value_len,
+                               unsigned int type, int is_delete) {
+  // Step 1: Validate input parameters
+  if (txn == NULL || !txn->active || key == NULL ||
+      (!is_delete && value == NULL)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Check key and value lengths
+  size_t key_len = strnlen(key, KEY_SIZE);
+  if (key_len >= KEY_SIZE || (!is_delete && value_len >= VALUE_SIZE)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  // Step 3: Reuse the key's buffered write, or take a new one
+  // One write per key keeps commit simple: staging all writes up front
+  // sees the same key state that applying them will
+  int index = kv_txn_find_write(txn, key);
+  if (index == -1) {
+    if (txn->write_count == KV_TXN_MAX_OPS) {
+      errno = E2BIG;
+      return -1;
+    }
+    index = (int)txn->write_count++;
+    memcpy(txn->writes[index].key, key, key_len + 1);
+  }
+
+  kv_txn_write_t *write = &txn->writes[index];
+  write->is_delete = is_delete;
+  write->type = is_delete ? KV_TYPE_STRING : type;
+  write->length = is_delete ? 0 : (unsigned int)value_len;
+  if (!is_delete) {
+    memcpy(write->value, value, value_len);
+  }
+  write->value[write->length] = '\0';
+  return 0;
+}
+
+/**
+ * Starts a transaction
+ *
+ * @param store Pointer to shared memory KV store
+ * @param txn Caller-allocated transaction
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_txn_begin(shared_memory_kv_store_t *store,
+                               shared_memory_kv_txn_t *txn) {
+  if (store == NULL || txn == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  txn->store = store;
+  txn->active = 1;
+  txn->read_count = 0;
+  txn->write_count = 0;
+  return 0;
+}
+
+/**
+ * Reads a key inside a transaction
+ *
+ * @param txn Active transaction
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value_out Pointer to return the value (max VALUE_SIZE-1 characters)
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_txn_get(shared_memory_kv_txn_t *txn, const char *key,
+                             char *value_out) {
+  // Step 1: Validate input parameters
+  if (txn == NULL || !txn->active || key == NULL || value_out == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Check key length
+  size_t key_len = strnlen(key, KEY_SIZE);
+  if (key_len >= KEY_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  // Step 3: Read-your-writes from the buffer
+  int write_index = kv_txn_find_write(txn, key);
+  if (write_index != -1) {
+    const kv_txn_write_t *write = &txn->writes[write_index];
+    if (write->is_delete) {
+      errno = ENOENT;
+      return -1;
+    }
+    memcpy(value_out, write->value, write->length + 1);
+    kv_value_format(value_out, write->length, write->type);
+    return 0;
+  }
+
+  // Step 4: Reserve a read record (a repeated read refreshes its record)
+  int read_index = kv_txn_find_read(txn, key);
+  if (read_index == -1) {
+    if (txn->read_count == KV_TXN_MAX_OPS) {
+      errno = E2BIG;
+      return -1;
+    }
+    read_index = (int)txn->read_count++;
+    memcpy(txn->reads[read_index].key, key, key_len + 1);
+  }
+  kv_txn_read_t *read = &txn->reads[read_index];
+
+  // Step 5: Lock semaphore just for this read (single writer: optimistic
+  // read, repeated if a write overlapped it)
+  shared_memory_kv_store_t *store = txn->store;
+  kv_read_t table_read;
+  int slot;
+  do {
+    if (kv_read_lock(store, &table_read) == -1) {
+      return -1;
+    }
+
+    // Step 6: Copy the value and remember the version it was read at
+    slot = kv_find_slot(store, key, kv_hash_key(key), NULL);
+    read->found = slot != -1;
+    read->slot = slot != -1 ? (unsigned int)slot : 0;
+    read->slot_version =
+        slot != -1 ? store->kv_table[slot].slot_version : 0;
+    if (slot != -1) {
+      kv_value_copy(store, &store->kv_table[slot], value_out);
+    }
+  } while (kv_read_unlock(store, &table_read)); // Step 7: Unlock semaphore
+
+  if (slot == -1) {
+    errno = ENOENT;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Buffers a set inside a transaction
+ *
+ * @param txn Active transaction
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value Value string (max VALUE_SIZE-1 characters)
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_txn_set(shared_memory_kv_txn_t *txn, const char *key,
+                             const char *value) {
+  size_t value_len = value != NULL ? strnlen(value, VALUE_SIZE) : 0;
+  return kv_txn_buffer_write(txn, key, value, value_len, KV_TYPE_STRING, 0);
+}
+
+/**
+ * Buffers a set of a native integer inside a transaction
+ *
+ * @param txn Active transaction
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value Value
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_txn_set_int64(shared_memory_kv_txn_t *txn,
+                                   const char *key, long long value) {
+  return kv_txn_buffer_write(txn, key, &value, sizeof(value), KV_TYPE_INT64,
+                             0);
+}
+
+/**
+ * Buffers a set of a native double inside a transaction
+ *
+ * @param txn Active transaction
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value Value
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_txn_set_double(shared_memory_kv_txn_t *txn,
+                                    const char *key, double value) {
+  return kv_txn_buffer_write(txn, key, &value, sizeof(value), KV_TYPE_DOUBLE,
+                             0);
+}
+
+/**
+ * Buffers a delete inside a transaction
+ *
+ * @param txn Active transaction
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_txn_delete(shared_memory_kv_txn_t *txn, const char *key) {
+  return kv_txn_buffer_write(txn, key, NULL, 0, KV_TYPE_STRING, 1);
+}
+
+/**
+ * Validates and applies a transaction atomically
+ *
+ * @param txn Active transaction
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_txn_commit(shared_memory_kv_txn_t *txn) {
+  // Step 1: Validate input parameters
+  if (txn == NULL || !txn->active) {
+    errno = EINVAL;
+    return -1;
+  }
+  txn->active = 0; // The transaction ends whatever the outcome
+
+  shared_memory_kv_store_t *store = txn->store;
+
+  // Step 2: Lock semaphore for the whole validate + apply (single writer:
+  // no lock)
+  if (kv_write_lock(store) == -1) {
+    return -1;
+  }
+  kv_seq_write_begin(store);
+
+  // Step 3: Validate the read set
+  // A key changed if it appeared, disappeared, or its slot was written
+  // since it was read (compaction moves count as changes too)
+  for (unsigned int i = 0; i < txn->read_count; i++) {
+    const kv_txn_read_t *read = &txn->reads[i];
+    int slot = kv_find_slot(store, read->key, kv_hash_key(read->key), NULL);
+    int unchanged =
+        read->found ? slot == (int)read->slot &&
+                          store->kv_table[slot].slot_version ==
+                              read->slot_version
+                    : slot == -1;
+    if (!unchanged) {
+      kv_seq_write_end(store);
+      kv_write_unlock(store);
+      errno = EAGAIN;
+      return -1;
+    }
+  }
+
+  // Step 4: Stage all sets (everything that can fail happens here)
+  kv_staged_write_t staged[KV_TXN_MAX_OPS];
+  unsigned int staged_count = 0;
+  unsigned int new_entries = 0;
+  unsigned int delete_retires = 0;
+
+  for (unsigned int i = 0; i < txn->write_count; i++) {
+    const kv_txn_write_t *write = &txn->writes[i];
+    if (write->is_delete) {
+      // A delete retires the key's chain and key blobs (see below)
+      int slot = kv_find_slot(store, write->key, kv_hash_key(write->key),
+                              NULL);
+      if (slot != -1) {
+        delete_retires += kv_version_count(
+            store, atomic_load_explicit(&store->kv_table[slot].head,
+                                        memory_order_relaxed)) + 2;
+      }
+      continue;
+    }
+    if (kv_stage_write(store, write->key, strlen(write->key), write->value,
+                       write->length, write->type, &new_entries,
+                       &staged[staged_count]) == -1) {
+      // Roll back: nothing was applied yet, just free what was staged
+      int saved_errno = errno;
+      while (staged_count > 0) {
+        kv_release_staged(store, &staged[--staged_count]);
+      }
+      kv_seq_write_end(store);
+      kv_write_unlock(store);
+      errno = saved_errno;
+      return -1;
+    }
+    staged_count++;
+  }
+  if (kv_retire_room(store, delete_retires) == -1) {
+    while (staged_count > 0) {
+      kv_release_staged(store, &staged[--staged_count]);
+    }
+    kv_seq_write_end(store);
+    kv_write_unlock(store);
+    errno = EAGAIN;
+    return -1;
+  }
+
+  // Step 5: Apply deletes, then sets
+  // Deletes first: they only free slots, so the capacity checked while
+  // staging still holds
+  for (unsigned int i = 0; i < txn->write_count; i++) {
+    if (txn->writes[i].is_delete) {
+      kv_apply_delete(store, txn->writes[i].key); // Missing key is fine
+    }
+  }
+  for (unsigned int i = 0; i < staged_count; i++) {
+    kv_apply_write(store, &staged[i]);
+  }
+  kv_reclaim(store);
+
+  // Step 6: Unlock semaphore
+  kv_seq_write_end(store);
+  kv_write_unlock(store);
+
+  return 0;
+}
+
+/**
+ * Discards a transaction without applying its writes
+ *
+ * @param txn Transaction
+ */
+void shared_memory_kv_txn_abort(shared_memory_kv_txn_t *txn) {
+  if (txn != NULL) {
+    txn->active = 0;
+    txn->read_count = 0;
+    txn->write_count = 0;
+  }
+}
+
+// ============================================================================
+// TIME SERIES
+// ============================================================================
+
+/**
+ * Marks the start of a change of a series (counter odd)
+ */
+static void kv_series_write_begin(kv_series_t *series) {
+  unsigned int seq = atomic_load_explicit(&series->seq, memory_order_relaxed);
+  atomic_store_explicit(&series->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+/**
+ * Marks the end of a change of a series (counter even again)
+ */
+static void kv_series_write_end(kv_series_t *series) {
+  unsigned int seq = atomic_load_explicit(&series->seq, memory_order_relaxed);
+  atomic_store_explicit(&series->seq, seq + 1, memory_order_release);
+}
+
+/**
+ * Waits until a series is not being changed and returns its counter
+ */
+static unsigned int kv_series_read_begin(const kv_series_t *series) {
+  unsigned int seq;
+  while ((seq = atomic_load_explicit(&series->seq, memory_order_acquire)) &
+         1) {
+    sched_yield(); // The writer is appending to this series
+  }
+  return seq;
+}
+
+/**
+ * Checks that a series did not change since kv_series_read_begin()
+ */
+static int kv_series_read_valid(const kv_series_t *series, unsigned int seq) {
+  atomic_thread_fence(memory_order_acquire);
+  return atomic_load_explicit(&series->seq, memory_order_relaxed) == seq;
+}
+
+/**
+ * Finds a series by name; the caller holds the semaphore (or is the single
+ * writer)
+ *
+ * @return Series, or NULL if there is none with that name
+ */
+static kv_series_t *kv_series_find(shared_memory_kv_store_t *store,
+                                   const char *key, unsigned int hash) {
+  for (unsigned int i = 0; i < KV_SERIES_MAX; i++) {
+    kv_series_t *series = &store->series[i];
+    if (series->key[0] != '\0' && series->hash == hash &&
+        strncmp(series->key, key, KEY_SIZE) == 0) {
+      return series;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Copies the samples of a series that fall into [from, to], newest
+ * max_samples at most, oldest first
+ *
+ * @return Number of samples copied
+ */
+static size_t kv_series_collect(const kv_series_t *series, long long from,
+                                long long to, kv_sample_t *samples_out,
+                                size_t max_samples) {
+  unsigned long long appended = series->appended;
+  size_t held = appended < KV_SERIES_SAMPLES ? (size_t)appended
+                                             : KV_SERIES_SAMPLES;
+
+  // Walk back from the newest sample; timestamps never decrease, so the
+  // walk ends at the first sample older than the range
+  size_t count = 0;
+  for (size_t i = 0; i < held && count < max_samples; i++) {
+    const kv_sample_t *sample =
+        &series->samples[(appended - 1 - i) % KV_SERIES_SAMPLES];
+    if (from != 0 && sample->timestamp < from) {
+      break;
+    }
+    if (to == 0 || sample->timestamp <= to) {
+      samples_out[count++] = *sample;
+    }
+  }
+
+  // Oldest first
+  for (size_t i = 0; i < count / 2; i++) {
+    kv_sample_t swap = samples_out[i];
+    samples_out[i] = samples_out[count - 1 - i];
+    samples_out[count - 1 - i] = swap;
+  }
+  return count;
+}
+
+/**
+ * Appends a sample to a time series, creating the series if needed
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Series name (max KEY_SIZE-1 characters)
+ * @param timestamp Milliseconds since the Unix epoch (0 = now)
+ * @param value Sample value
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_ts_append(shared_memory_kv_store_t *store,
+                               const char *key, long long timestamp,
+                               double value) {
+  // Step 1: Validate input parameters
+  if (store == NULL || key == NULL || key[0] == '\0' || timestamp < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  size_t key_len = strnlen(key, KEY_SIZE);
+  if (key_len >= KEY_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  if (timestamp == 0) {
+    timestamp = kv_now_ms();
+  }
+
+  // Step 2: Lock semaphore for exclusive access (single writer: no lock)
+  if (kv_write_lock(store) == -1) {
+    return -1;
+  }
+
+  // Step 3: Find the series, or take a free entry for it
+  unsigned int hash = kv_hash_key(key);
+  kv_series_t *series = kv_series_find(store, key, hash);
+  if (series == NULL) {
+    for (unsigned int i = 0; i < KV_SERIES_MAX && series == NULL; i++) {
+      if (store->series[i].key[0] == '\0') {
+        series = &store->series[i];
+      }
+    }
+    if (series == NULL) {
+      kv_write_unlock(store);
+      errno = ENOSPC;
+      return -1;
+    }
+    kv_series_write_begin(series);
+    memcpy(series->key, key, key_len + 1);
+    series->hash = hash;
+    series->appended = 0;
+    kv_series_write_end(series);
+  }
+
+  // Step 4: Append only: the newest sample must not be newer
+  if (series->appended > 0 &&
+      timestamp <
+          series->samples[(series->appended - 1) % KV_SERIES_SAMPLES]
+              .timestamp) {
+    kv_write_unlock(store);
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 5: Write the sample over the oldest one, then notify subscribers
+  kv_series_write_begin(series);
+  kv_sample_t *sample = &series->samples[series->appended % KV_SERIES_SAMPLES];
+  sample->timestamp = timestamp;
+  sample->value = value;
+  series->appended++;
+  kv_series_write_end(series);
+  kv_notify(store, key);
+
+  // Step 6: Unlock semaphore
+  kv_write_unlock(store);
+  return 0;
+}
+
+/**
+ * Reads the samples of a time series within a time range
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Series name
+ * @param from First timestamp (inclusive, 0 = no limit)
+ * @param to Last timestamp (inclusive, 0 = no limit)
+ * @param samples_out Array of at least max_samples elements
+ * @param max_samples Maximum number of samples to return
+ * @return Number of samples written, or -1 on error
+ */
+int shared_memory_kv_ts_range(shared_memory_kv_store_t *store,
+                              const char *key, long long from, long long to,
+                              kv_sample_t *samples_out, size_t max_samples) {
+  // Step 1: Validate input parameters
+  if (store == NULL || key == NULL ||
+      (samples_out == NULL && max_samples > 0) || from < 0 || to < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (strnlen(key, KEY_SIZE) >= KEY_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  // Step 2: Look for the series and copy its samples without locking
+  // Each entry is read between two checks of its sequence counter and read
+  // again if an append (or a delete and reuse) overlapped
+  unsigned int hash = kv_hash_key(key);
+  for (unsigned int i = 0; i < KV_SERIES_MAX; i++) {
+    const kv_series_t *series = &store->series[i];
+    for (;;) {
+      unsigned int seq = kv_series_read_begin(series);
+      int match = series->hash == hash &&
+                  strncmp(series->key, key, KEY_SIZE) == 0 && key[0] != '\0';
+      size_t count = 0;
+      if (match) {
+        count = kv_series_collect(series, from, to, samples_out, max_samples);
+      }
+      if (kv_series_read_valid(series, seq)) {
+        if (match) {
+          return (int)count;
+        }
+        break;
+      }
+    }
+  }
+
+  errno = ENOENT;
+  return -1;
+}
+
+/**
+ * Lists the time series
+ *
+ * @param store Pointer to shared memory KV store
+ * @param series_out Array of at least max_series elements
+ * @param max_series Maximum number of series to return
+ * @return Number of series written, or -1 on error
+ */
+int shared_memory_kv_ts_list(shared_memory_kv_store_t *store,
+                             kv_series_info_t *series_out, size_t max_series) {
+  // Step 1: Validate input parameters
+  if (store == NULL || (series_out == NULL && max_series > 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Summarize each entry in use (lock-free, like ts_range)
+  size_t count = 0;
+  for (unsigned int i = 0; i < KV_SERIES_MAX && count < max_series; i++) {
+    const kv_series_t *series = &store->series[i];
+    kv_series_info_t *info = &series_out[count];
+    int used;
+    for (;;) {
+      unsigned int seq = kv_series_read_begin(series);
+      used = series->key[0] != '\0' && series->appended > 0;
+      if (used) {
+        unsigned long long appended = series->appended;
+        memcpy(info->key, series->key, KEY_SIZE);
+        info->key[KEY_SIZE - 1] = '\0';
+        info->appended = appended;
+        info->count = appended < KV_SERIES_SAMPLES ? (unsigned int)appended
+                                                   : KV_SERIES_SAMPLES;
+        info->last = series->samples[(appended - 1) % KV_SERIES_SAMPLES];
+        info->first =
+            series->samples[(appended - info->count) % KV_SERIES_SAMPLES];
+      }
+      if (kv_series_read_valid(series, seq)) {
+        break;
+      }
+    }
+    if (used) {
+      count++;
+    }
+  }
+
+  return (int)count;
+}
+
+/**
+ * Deletes a time series with all its samples
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Series name
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_ts_delete(shared_memory_kv_store_t *store,
+                               const char *key) {
+  // Step 1: Validate input parameters
+  if (store == NULL || key == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (strnlen(key, KEY_SIZE) >= KEY_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  // Step 2: Lock semaphore for exclusive access (single writer: no lock)
+  if (kv_write_lock(store) == -1) {
+    return -1;
+  }
+
+  // Step 3: Free the entry; readers in the middle of it retry and find the
+  // name gone
+  kv_series_t *series = kv_series_find(store, key, kv_hash_key(key));
+  if (series == NULL) {
+    kv_write_unlock(store);
+    errno = ENOENT;
+    return -1;
+  }
+  kv_series_write_begin(series);
+  memset(series->key, 0, sizeof(series->key));
+  series->hash = 0;
+  series->appended = 0;
+  kv_series_write_end(series);
+  kv_notify(store, key);
+
+  // Step 4: Unlock semaphore
+  kv_write_unlock(store);
+  return 0;
+}
+
+// ============================================================================
+// ROLLUP CONFIGURATION AND READS
+// ============================================================================
+
+/**
+ * Enables, changes or disables the rollups of a key
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key name (max KEY_SIZE-1 characters)
+ * @param windows KV_ROLLUP_* flags (0 = disable)
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_rollup_enable(shared_memory_kv_store_t *store,
+                                   const char *key, unsigned int windows) {
+  // Step 1: Validate input parameters
+  if (store == NULL || key == NULL || key[0] == '\0' ||
+      (windows & ~(unsigned int)KV_ROLLUP_ALL) != 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  size_t key_len = strnlen(key, KEY_SIZE);
+  if (key_len >= KEY_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  // Step 2: Lock semaphore for exclusive access (single writer: no lock)
+  if (kv_write_lock(store) == -1) {
+    return -1;
+  }
+
+  // Step 3: Find the entry of the key, or take a free one
+  unsigned int hash = kv_hash_key(key);
+  kv_rollup_t *rollup = kv_rollup_find(store, key, hash);
+  if (rollup == NULL && windows == 0) {
+    kv_write_unlock(store);
+    errno = ENOENT;
+    return -1;
+  }
+  if (rollup == NULL) {
+    for (unsigned int i = 0; i < KV_ROLLUP_MAX && rollup == NULL; i++) {
+      if (store->rollups[i].key[0] == '\0') {
+        rollup = &store->rollups[i];
+      }
+    }
+    if (rollup == NULL) {
+      kv_write_unlock(store);
+      errno = ENOSPC;
+      return -1;
+    }
+    kv_rollup_write_begin(rollup);
+    memcpy(rollup->key, key, key_len + 1);
+    rollup->hash = hash;
+    rollup->windows = 0;
+    memset(rollup->current, 0, sizeof(rollup->current));
+    memset(rollup->previous, 0, sizeof(rollup->previous));
+    kv_rollup_write_end(rollup);
+    atomic_fetch_add_explicit(&store->rollup_count, 1, memory_order_relaxed);
+  }
+
+  // Step 4: Reset the windows that are switched off, or free the entry
+  kv_rollup_write_begin(rollup);
+  for (unsigned int i = 0; i < KV_ROLLUP_WINDOWS; i++) {
+    if (!(windows & (1u << i))) {
+      memset(&rollup->current[i], 0, sizeof(rollup->current[i]));
+      memset(&rollup->previous[i], 0, sizeof(rollup->previous[i]));
+    }
+  }
+  rollup->windows = windows;
+  if (windows == 0) {
+    memset(rollup->key, 0, sizeof(rollup->key));
+    rollup->hash = 0;
+  }
+  kv_rollup_write_end(rollup);
+  if (windows == 0) {
+    atomic_fetch_sub_explicit(&store->rollup_count, 1, memory_order_relaxed);
+  }
+
+  // Step 5: Unlock semaphore
+  kv_write_unlock(store);
+  return 0;
+}
+
+/**
+ * Reads the rollups of a key
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key name
+ * @param rollup_out Receives the rollups
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_rollup_get(shared_memory_kv_store_t *store,
+                                const char *key,
+                                kv_rollup_info_t *rollup_out) {
+  // Step 1: Validate input parameters
+  if (store == NULL || key == NULL || key[0] == '\0' || rollup_out == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (strnlen(key, KEY_SIZE) >= KEY_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  // Step 2: Copy the entry of the key without locking, then move buckets
+  // whose window ended since the last write
+  unsigned int hash = kv_hash_key(key);
+  long long now = kv_now_ms();
+  for (unsigned int i = 0; i < KV_ROLLUP_MAX; i++) {
+    kv_rollup_t copy;
+    kv_rollup_copy(&store->rollups[i], &copy);
+    if (copy.key[0] != '\0' && copy.hash == hash &&
+        strncmp(copy.key, key, KEY_SIZE) == 0) {
+      kv_rollup_info(&copy, rollup_out, now);
+      return 0;
+    }
+  }
+
+  errno = ENOENT;
+  return -1;
+}
+
+/**
+ * Lists the rollups of all keys that have them
+ *
+ * @param store Pointer to shared memory KV store
+ * @param rollups_out Array of at least max_rollups elements
+ * @param max_rollups Maximum number of entries to return
+ * @return Number of entries written, or -1 on error
+ */
+int shared_memory_kv_rollup_list(shared_memory_kv_store_t *store,
+                                 kv_rollup_info_t *rollups_out,
+                                 size_t max_rollups) {
+  // Step 1: Validate input parameters
+  if (store == NULL || (rollups_out == NULL && max_rollups > 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Copy each entry in use (lock-free, like rollup_get)
+  long long now = kv_now_ms();
+  size_t count = 0;
+  for (unsigned int i = 0; i < KV_ROLLUP_MAX && count < max_rollups; i++) {
+    kv_rollup_t copy;
+    kv_rollup_copy(&store->rollups[i], &copy);
+    if (copy.key[0] != '\0') {
+      kv_rollup_info(&copy, &rollups_out[count++], now);
+    }
+  }
+
+  return (int)count;
+}
+
+// ============================================================================
+// QUEUES (bounded MPMC rings, pushed and popped without the semaphore)
+// ============================================================================
+
+/**
+ * Returns the first position of a queue generation
+ */
+static unsigned long long kv_queue_base(unsigned int generation) {
+  return (unsigned long long)generation << KV_QUEUE_GENERATION_SHIFT;
+}
+
+/**
+ * Finds an initialized queue by name (lock-free)
+ *
+ * The generation is read before and after the name, like a sequence
+ * counter: a create bumps it before it rewrites the name.
+ *
+ * @param generation_out Generation the name was found in (may be NULL)
+ * @return Queue, or NULL if there is none with that name
+ */
+static kv_queue_t *kv_queue_find(shared_memory_kv_store_t *store,
+                                 const char *name, unsigned int hash,
+                                 unsigned int *generation_out) {
+  for (unsigned int i = 0; i < KV_QUEUE_MAX; i++) {
+    kv_queue_t *queue = &store->queues[i];
+    unsigned int generation =
+        atomic_load_explicit(&queue->generation, memory_order_acquire);
+    if (!atomic_load_explicit(&queue->active, memory_order_acquire) ||
+        queue->hash != hash || strncmp(queue->name, name, KEY_SIZE) != 0) {
+      continue;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&queue->generation, memory_order_relaxed) !=
+        generation) {
+      continue; // Deleted and created again while comparing
+    }
+    if (generation_out != NULL) {
+      *generation_out = generation;
+    }
+    return queue;
+  }
+  return NULL;
+}
+
+/**
+ * Looks up the queue of a push or pop, checking the name
+ *
+ * @return Queue, or NULL on error (errno set: ENAMETOOLONG, ENOENT)
+ */
+static kv_queue_t *kv_queue_lookup(shared_memory_kv_store_t *store,
+                                   const char *name,
+                                   unsigned int *generation_out) {
+  if (strnlen(name, KEY_SIZE) >= KEY_SIZE) {
+    errno = ENAMETOOLONG;
+    return NULL;
+  }
+  kv_queue_t *queue =
+      kv_queue_find(store, name, kv_hash_key(name), generation_out);
+  if (queue == NULL) {
+    errno = ENOENT;
+  }
+  return queue;
+}
+
+/**
+ * Takes the item at the head of a queue if there is one
+ *
+ * @param generation Generation the queue was looked up in
+ * @return Item length, or -1 (errno set: EAGAIN if the queue is empty,
+ *         ERANGE if the item is larger than capacity, ENOENT if the queue
+ *         was deleted)
+ */
+static int kv_queue_try_pop(kv_queue_t *queue, unsigned int generation,
+                            void *data_out, size_t capacity) {
+  unsigned long long base = kv_queue_base(generation);
+  unsigned long long pos =
+      atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+  kv_queue_cell_t *cell;
+  unsigned int length;
+
+  // Step 1: Claim the head position
+  // A cell is ready when its sequence is pos + 1; a smaller one means the
+  // producer of pos has not finished (or nobody pushed yet), a larger one
+  // that another consumer took pos first. A position of another generation
+  // means the entry now holds a different queue
+  for (;;) {
+    if ((pos & ~KV_QUEUE_POSITION_MASK) != base) {
+      errno = ENOENT;
+      return -1;
+    }
+    cell = &queue->cells[pos & (KV_QUEUE_CAPACITY - 1)];
+    unsigned long long sequence =
+        atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    long long diff = (long long)(sequence - (pos + 1));
+    if (diff == 0) {
+      // The item is complete and stays put until its cell is released,
+      // so its length can be checked before claiming it
+      length = cell->length;
+      if (length > capacity) {
+        errno = ERANGE;
+        return -1;
+      }
+      if (atomic_compare_exchange_weak_explicit(
+              &queue->dequeue_pos, &pos, pos + 1, memory_order_relaxed,
+              memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      errno = EAGAIN;
+      return -1;
+    } else {
+      pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+    }
+  }
+
+  // Step 2: Copy the item out, then hand the cell to the producer that
+  // wraps around to it (unless the queue was deleted and created again)
+  memcpy(data_out, cell->data, length);
+  unsigned long long ready = pos + 1;
+  if (!atomic_compare_exchange_strong_explicit(
+          &cell->sequence, &ready, pos + KV_QUEUE_CAPACITY,
+          memory_order_release, memory_order_relaxed)) {
+    errno = ENOENT;
+    return -1;
+  }
+  return (int)length;
+}
+
+/**
+ * Summarizes a queue (lock-free, positions read one after the other)
+ */
+static void kv_queue_info(kv_queue_t *queue, kv_queue_info_t *info) {
+  memset(info, 0, sizeof(*info));
+  memcpy(info->name, queue->name, KEY_SIZE);
+  info->name[KEY_SIZE - 1] = '\0';
+  info->popped = atomic_load(&queue->dequeue_pos) & KV_QUEUE_POSITION_MASK;
+  info->pushed = atomic_load(&queue->enqueue_pos) & KV_QUEUE_POSITION_MASK;
+  info->length = info->pushed > info->popped
+                     ? (unsigned int)(info->pushed - info->popped)
+                     : 0;
+  info->waiters = atomic_load(&queue->waiters);
+  info->rejected = atomic_load(&queue->rejected);
+}
+
+/**
+ * Creates a queue
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Queue name (max KEY_SIZE-1 characters)
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_queue_create(shared_memory_kv_store_t *store,
+                                  const char *name) {
+  // Step 1: Validate input parameters
+  if (store == NULL || name == NULL || name[0] == '\0') {
+    errno = EINVAL;
+    return -1;
+  }
+  size_t name_len = strnlen(name, KEY_SIZE);
+  if (name_len >= KEY_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  // Step 2: Lock semaphore for exclusive access (single writer: no lock)
+  if (kv_write_lock(store) == -1) {
+    return -1;
+  }
+
+  // Step 3: An existing queue is kept as it is
+  unsigned int hash = kv_hash_key(name);
+  if (kv_queue_find(store, name, hash, NULL) != NULL) {
+    kv_write_unlock(store);
+    return 0;
+  }
+
+  // Step 4: Initialize a free entry in a new generation, then publish it
+  // Cell i starts with sequence base + i: free for the producer of
+  // position base + i
+  kv_queue_t *queue = NULL;
+  for (unsigned int i = 0; i < KV_QUEUE_MAX && queue == NULL; i++) {
+    if (!atomic_load_explicit(&store->queues[i].active,
+                              memory_order_relaxed)) {
+      queue = &store->queues[i];
+    }
+  }
+  if (queue == NULL) {
+    kv_write_unlock(store);
+    errno = ENOSPC;
+    return -1;
+  }
+  unsigned int generation =
+      atomic_fetch_add_explicit(&queue->generation, 1, memory_order_relaxed) +
+      1;
+  atomic_thread_fence(memory_order_release);
+  memset(queue->name, 0, sizeof(queue->name));
+  memcpy(queue->name, name, name_len);
+  queue->hash = hash;
+  unsigned long long base = kv_queue_base(generation);
+  atomic_store(&queue->rejected, 0);
+  atomic_store(&queue->enqueue_pos, base);
+  atomic_store(&queue->dequeue_pos, base);
+  for (unsigned int i = 0; i < KV_QUEUE_CAPACITY; i++) {
+    atomic_store_explicit(&queue->cells[i].sequence, base + i,
+                          memory_order_relaxed);
+  }
+  atomic_store_explicit(&queue->active, 1, memory_order_release);
+
+  // Step 5: Unlock semaphore
+  kv_write_unlock(store);
+  return 0;
+}
+
+/**
+ * Pushes an item to the tail of a queue
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Queue name
+ * @param data Item bytes
+ * @param length Number of bytes (max KV_QUEUE_ITEM_SIZE)
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_queue_push(shared_memory_kv_store_t *store,
+                                const char *name, const void *data,
+                                size_t length) {
+  // Step 1: Validate input parameters
+  if (store == NULL || name == NULL || (data == NULL && length > 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (length > KV_QUEUE_ITEM_SIZE) {
+    errno = EMSGSIZE;
+    return -1;
+  }
+  unsigned int generation;
+  kv_queue_t *queue = kv_queue_lookup(store, name, &generation);
+  if (queue == NULL) {
+    return -1;
+  }
+
+  // Step 2: Claim the tail position
+  // The cell of pos is free when its sequence is pos; a smaller one means
+  // its item of the previous round was not popped yet (the ring is full),
+  // a larger one that another producer took pos first. A position of
+  // another generation means the entry now holds a different queue
+  unsigned long long base = kv_queue_base(generation);
+  unsigned long long pos =
+      atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+  kv_queue_cell_t *cell;
+  for (;;) {
+    if ((pos & ~KV_QUEUE_POSITION_MASK) != base) {
+      errno = ENOENT;
+      return -1;
+    }
+    cell = &queue->cells[pos & (KV_QUEUE_CAPACITY - 1)];
+    unsigned long long sequence =
+        atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    long long diff = (long long)(sequence - pos);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(
+              &queue->enqueue_pos, &pos, pos + 1, memory_order_relaxed,
+              memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      atomic_fetch_add_explicit(&queue->rejected, 1, memory_order_relaxed);
+      errno = EAGAIN;
+      return -1;
+    } else {
+      pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    }
+  }
+
+  // Step 3: Write the item, then publish it to consumers (unless the queue
+  // was deleted and created again meanwhile)
+  if (length > 0) {
+    memcpy(cell->data, data, length);
+  }
+  cell->length = (unsigned int)length;
+  unsigned long long claimed = pos;
+  if (!atomic_compare_exchange_strong_explicit(
+          &cell->sequence, &claimed, pos + 1, memory_order_release,
+          memory_order_relaxed)) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  // Step 4: Wake one blocked consumer
+  // items moves before waiters is read, and a consumer registers as waiter
+  // before the kernel compares items: either this push sees the waiter or
+  // the consumer's futex call sees items changed and returns at once
+  atomic_fetch_add(&queue->items, 1);
+  if (atomic_load(&queue->waiters) > 0) {
+    kv_futex(&queue->items, FUTEX_WAKE, 1, NULL);
+  }
+  return 0;
+}
+
+/**
+ * Pops the item at the head of a queue, waiting for one if it is empty
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Queue name
+ * @param data_out Buffer for the item
+ * @param capacity Size of data_out
+ * @param timeout_ms Maximum wait in milliseconds (0 = don't wait,
+ *        -1 = no limit)
+ * @return Item length, or -1 on error
+ */
+int shared_memory_kv_queue_pop(shared_memory_kv_store_t *store,
+                               const char *name, void *data_out,
+                               size_t capacity, int timeout_ms) {
+  // Step 1: Validate input parameters
+  if (store == NULL || name == NULL || (data_out == NULL && capacity > 0) ||
+      timeout_ms < -1) {
+    errno = EINVAL;
+    return -1;
+  }
+  unsigned int generation;
+  kv_queue_t *queue = kv_queue_lookup(store, name, &generation);
+  if (queue == NULL) {
+    return -1;
+  }
+
+  // Step 2: Compute the deadline (the futex timeout is relative, and each
+  // wake-up that finds no item waits again for the rest)
+  struct timespec deadline = {0, 0};
+  if (timeout_ms > 0) {
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+  }
+
+  for (;;) {
+    // Step 3: Try to take an item
+    // items is read first: a push completing after the attempt changes it,
+    // so the wait below cannot miss that push
+    unsigned int items = atomic_load(&queue->items);
+    if (!atomic_load_explicit(&queue->active, memory_order_acquire)) {
+      errno = ENOENT; // Deleted while waiting
+      return -1;
+    }
+    int length = kv_queue_try_pop(queue, generation, data_out, capacity);
+    if (length != -1 || errno != EAGAIN) {
+      return length;
+    }
+
+    struct timespec remaining;
+    if (timeout_ms == 0) {
+      errno = EAGAIN;
+      return -1;
+    }
+    if (timeout_ms > 0) {
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      remaining.tv_sec = deadline.tv_sec - now.tv_sec;
+      remaining.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+      if (remaining.tv_nsec < 0) {
+        remaining.tv_sec--;
+        remaining.tv_nsec += 1000000000L;
+      }
+      if (remaining.tv_sec < 0) {
+        errno = ETIMEDOUT;
+        return -1;
+      }
+    }
+
+    // Step 4: Sleep until a producer signals items
+    atomic_fetch_add(&queue->waiters, 1);
+    long result = kv_futex(&queue->items, FUTEX_WAIT, items,
+                           timeout_ms > 0 ? &remaining : NULL);
+    int saved_errno = errno;
+    atomic_fetch_sub(&queue->waiters, 1);
+    if (result == -1 && saved_errno == EINTR) {
+      errno = EINTR;
+      return -1;
+    }
+  }
+}
+
+/**
+ * Lists the queues
+ *
+ * @param store Pointer to shared memory KV store
+ * @param queues_out Array of at least max_queues elements
+ * @param max_queues Maximum number of queues to return
+ * @return Number of queues written, or -1 on error
+ */
+int shared_memory_kv_queue_list(shared_memory_kv_store_t *store,
+                                kv_queue_info_t *queues_out,
+                                size_t max_queues) {
+  // Step 1: Validate input parameters
+  if (store == NULL || (queues_out == NULL && max_queues > 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Summarize each queue in use (lock-free)
+  size_t count = 0;
+  for (unsigned int i = 0; i < KV_QUEUE_MAX && count < max_queues; i++) {
+    kv_queue_t *queue = &store->queues[i];
+    if (atomic_load_explicit(&queue->active, memory_order_acquire)) {
+      kv_queue_info(queue, &queues_out[count++]);
+    }
+  }
+
+  return (int)count;
+}
+
+/**
+ * Deletes a queue with the items it holds
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Queue name
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_queue_delete(shared_memory_kv_store_t *store,
+                                  const char *name) {
+  // Step 1: Validate input parameters
+  if (store == NULL || name == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (strnlen(name, KEY_SIZE) >= KEY_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  // Step 2: Lock semaphore for exclusive access (single writer: no lock)
+  if (kv_write_lock(store) == -1) {
+    return -1;
+  }
+
+  // Step 3: Unpublish the entry, then wake every blocked consumer so it
+  // sees the queue gone
+  kv_queue_t *queue = kv_queue_find(store, name, kv_hash_key(name), NULL);
+  if (queue == NULL) {
+    kv_write_unlock(store);
+    errno = ENOENT;
+    return -1;
+  }
+  atomic_store_explicit(&queue->active, 0, memory_order_release);
+  atomic_fetch_add(&queue->items, 1);
+  kv_futex(&queue->items, FUTEX_WAKE, INT_MAX, NULL);
+  memset(queue->name, 0, sizeof(queue->name));
+  queue->hash = 0;
+
+  // Step 4: Unlock semaphore
+  kv_write_unlock(store);
+  return 0;
+}
+
+// ============================================================================
+// SORTED SETS (skiplists changed by the writer, read lock-free)
+// ============================================================================
+
+// Lock-free queries (kv_zset_query_t.op)
+#define KV_ZSET_QUERY_SCORE 1       // Score of member
+#define KV_ZSET_QUERY_RANK 2        // Rank of member
+#define KV_ZSET_QUERY_RANGE 3       // Members from rank start
+#define KV_ZSET_QUERY_SCORE_RANGE 4 // Members with min <= score <= max
+
+/**
+ * Parameters and result of a lock-free sorted set query
+ */
+typedef struct {
+  int op;                   // KV_ZSET_QUERY_*
+  const char *member;       // SCORE, RANK
+  unsigned int member_hash; // kv_hash_key(member)
+  int reverse;              // RANK, RANGE: count from the highest score
+  unsigned int start;       // RANGE: first rank
+  double min;               // SCORE_RANGE: lowest score
+  double max;               // SCORE_RANGE: highest score
+  kv_zset_item_t *items;    // RANGE, SCORE_RANGE: result array
+  size_t max_items;         // Size of items
+  double score;             // SCORE: result
+} kv_zset_query_t;
+
+/**
+ * Marks the start of a change of a sorted set (counter odd)
+ */
+static void kv_zset_write_begin(kv_zset_t *zset) {
+  unsigned int seq = atomic_load_explicit(&zset->seq, memory_order_relaxed);
+  atomic_store_explicit(&zset->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+/**
+ * Marks the end of a change of a sorted set (counter even again)
+ */
+static void kv_zset_write_end(kv_zset_t *zset) {
+  unsigned int seq = atomic_load_explicit(&zset->seq, memory_order_relaxed);
+  atomic_store_explicit(&zset->seq, seq + 1, memory_order_release);
+}
+
+/**
+ * Waits until a sorted set is not being changed and returns its counter
+ */
+static unsigned int kv_zset_read_begin(const kv_zset_t *zset) {
+  unsigned int seq;
+  while ((seq = atomic_load_explicit(&zset->seq, memory_order_acquire)) & 1) {
+    sched_yield(); // The writer is changing this set
+  }
+  return seq;
+}
+
+/**
+ * Checks that a sorted set did not change since kv_zset_read_begin()
+ */
+static int kv_zset_read_valid(const kv_zset_t *zset, unsigned int seq) {
+  atomic_thread_fence(memory_order_acquire);
+  return atomic_load_explicit(&zset->seq, memory_order_relaxed) == seq;
+}
+
+/**
+ * Finds a sorted set by name; the caller holds the semaphore (or is the
+ * single writer)
+ *
+ * @return Set, or NULL if there is none with that name
+ */
+static kv_zset_t *kv_zset_find(shared_memory_kv_store_t *store,
+                               const char *name, unsigned int hash) {
+  for (unsigned int i = 0; i < KV_ZSET_MAX; i++) {
+    kv_zset_t *zset = &store->zsets[i];
+    if (zset->name[0] != '\0' && zset->hash == hash &&
+        strncmp(zset->name, name, KEY_SIZE) == 0) {
+      return zset;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Checks whether node sorts before (score, member)
+ *
+ * Members are ordered by score, equal scores by member name, so every
+ * member has exactly one place in the list.
+ */
+static int kv_zset_before(const kv_zset_node_t *node, double score,
+                          const char *member) {
+  return node->score < score ||
+         (node->score == score &&
+          strncmp(node->member, member, KV_ZSET_MEMBER_SIZE) < 0);
+}
+
+/**
+ * Finds the node of a member in the member index
+ *
+ * Also used by lock-free readers: node numbers out of range (a torn read)
+ * end the search, and the caller's sequence check discards the result.
+ *
+ * @param slot_out Pointer to return the index slot (may be NULL)
+ * @return Node, or 0 if the member is not in the set
+ */
+static unsigned int kv_zset_index_find(const kv_zset_t *zset,
+                                       const char *member, unsigned int hash,
+                                       unsigned int *slot_out) {
+  for (unsigned int probe = 0; probe < KV_ZSET_INDEX_SIZE; probe++) {
+    unsigned int slot = (hash + probe) & (KV_ZSET_INDEX_SIZE - 1);
+    unsigned int node = zset->index[slot];
+    if (node == 0 || node > KV_ZSET_CAPACITY) {
+      return 0;
+    }
+    if (zset->nodes[node].hash == hash &&
+        strncmp(zset->nodes[node].member, member, KV_ZSET_MEMBER_SIZE) == 0) {
+      if (slot_out != NULL) {
+        *slot_out = slot;
+      }
+      return node;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Adds a node to the member index (there is always a free slot: the index
+ * has twice as many slots as the set has nodes)
+ */
+static void kv_zset_index_insert(kv_zset_t *zset, unsigned int node) {
+  unsigned int slot = zset->nodes[node].hash & (KV_ZSET_INDEX_SIZE - 1);
+  while (zset->index[slot] != 0) {
+    slot = (slot + 1) & (KV_ZSET_INDEX_SIZE - 1);
+  }
+  zset->index[slot] = node;
+}
+
+/**
+ * Removes the node in an index slot
+ *
+ * Later nodes of the same probe run move back into the hole, so the index
+ * needs no tombstones and never degrades.
+ */
+static void kv_zset_index_remove(kv_zset_t *zset, unsigned int slot) {
+  const unsigned int mask = KV_ZSET_INDEX_SIZE - 1;
+  unsigned int next = slot;
+  zset->index[slot] = 0;
+  for (;;) {
+    next = (next + 1) & mask;
+    unsigned int node = zset->index[next];
+    if (node == 0) {
+      return;
+    }
+    // The node may fill the hole unless its home slot lies cyclically in
+    // (slot, next]: moving it before its home would hide it from lookups
+    unsigned int home = zset->nodes[node].hash & mask;
+    if (((next - home) & mask) >= ((next - slot) & mask)) {
+      zset->index[slot] = node;
+      zset->index[next] = 0;
+      slot = next;
+    }
+  }
+}
+
+/**
+ * Picks the level of a new node: level n with probability 2^-n
+ */
+static unsigned int kv_zset_random_level(kv_zset_t *zset) {
+  // xorshift32, state kept in the set so every process continues the same
+  // sequence
+  unsigned int x = zset->random;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  zset->random = x;
+
+  unsigned int level = 1;
+  while (level < KV_ZSET_LEVELS && (x & 1)) {
+    level++;
+    x >>= 1;
+  }
+  return level;
+}
+
+/**
+ * Links a node (member and score set) into the skiplist in O(log n)
+ *
+ * Walks down from the top level remembering, per level, the last node
+ * before the new one and its rank; the spans around the new node follow
+ * from those ranks.
+ */
+static void kv_zset_link(kv_zset_t *zset, unsigned int node) {
+  kv_zset_node_t *nodes = zset->nodes;
+  kv_zset_node_t *new_node = &nodes[node];
+  unsigned int update[KV_ZSET_LEVELS];
+  unsigned int rank[KV_ZSET_LEVELS];
+
+  // Step 1: Find the predecessor on each level
+  unsigned int x = 0;
+  for (int i = (int)zset->level - 1; i >= 0; i--) {
+    rank[i] = i == (int)zset->level - 1 ? 0 : rank[i + 1];
+    unsigned int next;
+    while ((next = nodes[x].next[i]) != 0 &&
+           kv_zset_before(&nodes[next], new_node->score, new_node->member)) {
+      rank[i] += nodes[x].span[i];
+      x = next;
+    }
+    update[i] = x;
+  }
+
+  // Step 2: New top levels start at the head, spanning the whole list
+  unsigned int level = kv_zset_random_level(zset);
+  if (level > zset->level) {
+    for (unsigned int i = zset->level; i < level; i++) {
+      rank[i] = 0;
+      update[i] = 0;
+      nodes[0].span[i] = zset->count;
+    }
+    zset->level = level;
+  }
+
+  // Step 3: Link the node on its levels, split the spans it lands in
+  new_node->level = level;
+  for (unsigned int i = 0; i < level; i++) {
+    kv_zset_node_t *before = &nodes[update[i]];
+    new_node->next[i] = before->next[i];
+    before->next[i] = node;
+    new_node->span[i] = before->span[i] - (rank[0] - rank[i]);
+    before->span[i] = rank[0] - rank[i] + 1;
+  }
+
+  // Step 4: Higher levels now jump over one more node
+  for (unsigned int i = level; i < zset->level; i++) {
+    nodes[update[i]].span[i]++;
+  }
+
+  // Step 5: Level 0 is doubly linked (reverse ranges walk it backwards)
+  new_node->prev = update[0];
+  if (new_node->next[0] != 0) {
+    nodes[new_node->next[0]].prev = node;
+  } else {
+    zset->tail = node;
+  }
+  zset->count++;
+}
+
+/**
+ * Unlinks a node from the skiplist in O(log n)
+ */
+static void kv_zset_unlink(kv_zset_t *zset, unsigned int node) {
+  kv_zset_node_t *nodes = zset->nodes;
+  kv_zset_node_t *old_node = &nodes[node];
+  unsigned int update[KV_ZSET_LEVELS];
+
+  // Step 1: Find the predecessor on each level
+  unsigned int x = 0;
+  for (int i = (int)zset->level - 1; i >= 0; i--) {
+    unsigned int next;
+    while ((next = nodes[x].next[i]) != 0 && next != node &&
+           kv_zset_before(&nodes[next], old_node->score, old_node->member)) {
+      x = next;
+    }
+    update[i] = x;
+  }
+
+  // Step 2: Bypass the node; levels above it just get shorter spans
+  for (unsigned int i = 0; i < zset->level; i++) {
+    kv_zset_node_t *before = &nodes[update[i]];
+    if (before->next[i] == node) {
+      before->span[i] += old_node->span[i] - 1;
+      before->next[i] = old_node->next[i];
+    } else {
+      before->span[i]--;
+    }
+  }
+  if (old_node->next[0] != 0) {
+    nodes[old_node->next[0]].prev = old_node->prev;
+  } else {
+    zset->tail = old_node->prev;
+  }
+
+  // Step 3: Drop levels left empty
+  while (zset->level > 1 && nodes[0].next[zset->level - 1] == 0) {
+    zset->level--;
+  }
+  zset->count--;
+}
+
+/**
+ * Copies a node's member and score into a result item
+ */
+static void kv_zset_copy_item(const kv_zset_node_t *node,
+                              kv_zset_item_t *item) {
+  memcpy(item->member, node->member, KV_ZSET_MEMBER_SIZE);
+  item->member[KV_ZSET_MEMBER_SIZE - 1] = '\0';
+  item->score = node->score;
+}
+
+/**
+ * Finds the node at a 1-based rank (ascending) by following spans
+ *
+ * @return Node, or 0 if there is none (or the read was torn)
+ */
+static unsigned int kv_zset_node_at(const kv_zset_t *zset,
+                                    unsigned int rank) {
+  const kv_zset_node_t *nodes = zset->nodes;
+  unsigned int level = zset->level;
+  unsigned int traversed = 0;
+  unsigned int x = 0;
+  unsigned int steps = 0;
+
+  if (level > KV_ZSET_LEVELS) {
+    return 0;
+  }
+  for (int i = (int)level - 1; i >= 0; i--) {
+    unsigned int next;
+    while ((next = nodes[x].next[i]) != 0 && next <= KV_ZSET_CAPACITY &&
+           traversed + nodes[x].span[i] <= rank &&
+           steps++ < KV_ZSET_CAPACITY) {
+      traversed += nodes[x].span[i];
+      x = next;
+    }
+    if (traversed == rank) {
+      return x;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Runs a query against a sorted set as it is; called between
+ * kv_zset_read_begin() and kv_zset_read_valid()
+ *
+ * A concurrent change can leave any link torn, so every node number is
+ * range-checked and every walk bounded by the set capacity; results of a
+ * torn read are discarded by the caller's sequence check.
+ *
+ * @return Result (0, rank or number of items), or -1 if the member is not
+ *         in the set
+ */
+static int kv_zset_run(const kv_zset_t *zset, kv_zset_query_t *query) {
+  const kv_zset_node_t *nodes = zset->nodes;
+  unsigned int count = zset->count;
+  unsigned int node;
+  size_t written = 0;
+
+  switch (query->op) {
+  case KV_ZSET_QUERY_SCORE:
+  case KV_ZSET_QUERY_RANK: {
+    node = kv_zset_index_find(zset, query->member, query->member_hash, NULL);
+    if (node == 0) {
+      return -1;
+    }
+    query->score = nodes[node].score;
+    if (query->op == KV_ZSET_QUERY_SCORE) {
+      return 0;
+    }
+
+    // Sum the spans on the way down to the member
+    unsigned int rank = 0;
+    unsigned int x = 0;
+    unsigned int steps = 0;
+    unsigned int level = zset->level;
+    for (int i = (level <= KV_ZSET_LEVELS ? (int)level : 0) - 1; i >= 0;
+         i--) {
+      unsigned int next;
+      while ((next = nodes[x].next[i]) != 0 && next <= KV_ZSET_CAPACITY &&
+             (next == node || kv_zset_before(&nodes[next], query->score,
+                                             query->member)) &&
+             steps++ < KV_ZSET_CAPACITY) {
+        rank += nodes[x].span[i];
+        x = next;
+      }
+      if (x == node) {
+        break;
+      }
+    }
+    if (rank == 0 || rank > count) {
+      return -1; // Torn read
+    }
+    return query->reverse ? (int)(count - rank) : (int)(rank - 1);
+  }
+
+  case KV_ZSET_QUERY_RANGE:
+    if (query->start >= count) {
+      return 0;
+    }
+    node = kv_zset_node_at(zset, query->reverse ? count - query->start
+                                                : query->start + 1);
+    while (node != 0 && node <= KV_ZSET_CAPACITY &&
+           written < query->max_items && written < count) {
+      kv_zset_copy_item(&nodes[node], &query->items[written++]);
+      node = query->reverse ? nodes[node].prev : nodes[node].next[0];
+    }
+    return (int)written;
+
+  case KV_ZSET_QUERY_SCORE_RANGE: {
+    // Descend to the last node below min, then walk level 0 up to max
+    unsigned int x = 0;
+    unsigned int steps = 0;
+    unsigned int level = zset->level;
+    for (int i = (level <= KV_ZSET_LEVELS ? (int)level : 0) - 1; i >= 0;
+         i--) {
+      unsigned int next;
+      while ((next = nodes[x].next[i]) != 0 && next <= KV_ZSET_CAPACITY &&
+             nodes[next].score < query->min && steps++ < KV_ZSET_CAPACITY) {
+        x = next;
+      }
+    }
+    node = nodes[x].next[0];
+    while (node != 0 && node <= KV_ZSET_CAPACITY &&
+           nodes[node].score <= query->max && written < query->max_items &&
+           written < count) {
+      kv_zset_copy_item(&nodes[node], &query->items[written++]);
+      node = nodes[node].next[0];
+    }
+    return (int)written;
+  }
+  }
+  return -1;
+}
+
+/**
+ * Runs a query against the sorted set of a name without locking
+ *
+ * Each entry is read between two checks of its sequence counter and read
+ * again if a change (or a delete and reuse) overlapped, as in ts_range.
+ *
+ * @return Query result, or -1 on error (errno set: ENAMETOOLONG, ENOENT)
+ */
+static int kv_zset_query(shared_memory_kv_store_t *store, const char *name,
+                         kv_zset_query_t *query) {
+  if (strnlen(name, KEY_SIZE) >= KEY_SIZE ||
+      (query->member != NULL &&
+       strnlen(query->member, KV_ZSET_MEMBER_SIZE) >= KV_ZSET_MEMBER_SIZE)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  if (query->member != NULL) {
+    query->member_hash = kv_hash_key(query->member);
+  }
+
+  unsigned int hash = kv_hash_key(name);
+  for (unsigned int i = 0; i < KV_ZSET_MAX; i++) {
+    const kv_zset_t *zset = &store->zsets[i];
+    for (;;) {
+      unsigned int seq = kv_zset_read_begin(zset);
+      int match = zset->hash == hash &&
+                  strncmp(zset->name, name, KEY_SIZE) == 0 && name[0] != '\0';
+      int result = match ? kv_zset_run(zset, query) : 0;
+      if (kv_zset_read_valid(zset, seq)) {
+        if (!match) {
+          break;
+        }
+        if (result == -1) {
+          errno = ENOENT; // No such member
+        }
+        return result;
+      }
+    }
+  }
+
+  errno = ENOENT;
+  return -1;
+}
+
+/**
+ * Adds a member to a sorted set or changes its score, creating the set if
+ * needed
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Set name (max KEY_SIZE-1 characters)
+ * @param member Member (max KV_ZSET_MEMBER_SIZE-1 characters)
+ * @param score Score (not NaN)
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_zadd(shared_memory_kv_store_t *store, const char *name,
+                          const char *member, double score) {
+  // Step 1: Validate input parameters
+  if (store == NULL || name == NULL || name[0] == '\0' || member == NULL ||
+      member[0] == '\0' || score != score) {
+    errno = EINVAL;
+    return -1;
+  }
+  size_t name_len = strnlen(name, KEY_SIZE);
+  size_t member_len = strnlen(member, KV_ZSET_MEMBER_SIZE);
+  if (name_len >= KEY_SIZE || member_len >= KV_ZSET_MEMBER_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  // Step 2: Lock semaphore for exclusive access (single writer: no lock)
+  if (kv_write_lock(store) == -1) {
+    return -1;
+  }
+
+  // Step 3: Find the set, or take a free entry for it
+  // A new set has an empty index and every node on the free list
+  unsigned int hash = kv_hash_key(name);
+  kv_zset_t *zset = kv_zset_find(store, name, hash);
+  if (zset == NULL) {
+    for (unsigned int i = 0; i < KV_ZSET_MAX && zset == NULL; i++) {
+      if (store->zsets[i].name[0] == '\0') {
+        zset = &store->zsets[i];
+      }
+    }
+    if (zset == NULL) {
+      kv_write_unlock(store);
+      errno = ENOSPC;
+      return -1;
+    }
+    kv_zset_write_begin(zset);
+    memset(zset->name, 0, sizeof(zset->name));
+    memcpy(zset->name, name, name_len);
+    zset->hash = hash;
+    zset->count = 0;
+    zset->level = 1;
+    zset->tail = 0;
+    zset->random = hash | 1; // xorshift state must not be 0
+    memset(zset->index, 0, sizeof(zset->index));
+    memset(&zset->nodes[0], 0, sizeof(zset->nodes[0]));
+    zset->nodes[0].level = KV_ZSET_LEVELS;
+    for (unsigned int i = 1; i <= KV_ZSET_CAPACITY; i++) {
+      zset->nodes[i].next[0] = i < KV_ZSET_CAPACITY ? i + 1 : 0;
+    }
+    zset->free_head = 1;
+    kv_zset_write_end(zset);
+  }
+
+  // Step 4: Move an existing member, or take a free node for a new one
+  unsigned int member_hash = kv_hash_key(member);
+  unsigned int node = kv_zset_index_find(zset, member, member_hash, NULL);
+  if (node != 0) {
+    if (zset->nodes[node].score != score) {
+      kv_zset_write_begin(zset);
+      kv_zset_unlink(zset, node);
+      zset->nodes[node].score = score;
+      kv_zset_link(zset, node);
+      kv_zset_write_end(zset);
+    }
+  } else {
+    if (zset->free_head == 0) {
+      kv_write_unlock(store);
+      errno = ENOSPC;
+      return -1;
+    }
+    kv_zset_write_begin(zset);
+    node = zset->free_head;
+    kv_zset_node_t *new_node = &zset->nodes[node];
+    zset->free_head = new_node->next[0];
+    memset(new_node, 0, sizeof(*new_node));
+    memcpy(new_node->member, member, member_len);
+    new_node->score = score;
+    new_node->hash = member_hash;
+    kv_zset_index_insert(zset, node);
+    kv_zset_link(zset, node);
+    kv_zset_write_end(zset);
+  }
+
+  // Step 5: Notify subscribers of the set name
+  kv_notify(store, name);
+
+  // Step 6: Unlock semaphore
+  kv_write_unlock(store);
+  return 0;
+}
+
+/**
+ * Removes a member from a sorted set
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Set name
+ * @param member Member
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_zrem(shared_memory_kv_store_t *store, const char *name,
+                          const char *member) {
+  // Step 1: Validate input parameters
+  if (store == NULL || name == NULL || member == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (strnlen(name, KEY_SIZE) >= KEY_SIZE ||
+      strnlen(member, KV_ZSET_MEMBER_SIZE) >= KV_ZSET_MEMBER_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  // Step 2: Lock semaphore for exclusive access (single writer: no lock)
+  if (kv_write_lock(store) == -1) {
+    return -1;
+  }
+
+  // Step 3: Find the set and the member
+  kv_zset_t *zset = kv_zset_find(store, name, kv_hash_key(name));
+  unsigned int slot = 0;
+  unsigned int node =
+      zset == NULL
+          ? 0
+          : kv_zset_index_find(zset, member, kv_hash_key(member), &slot);
+  if (node == 0) {
+    kv_write_unlock(store);
+    errno = ENOENT;
+    return -1;
+  }
+
+  // Step 4: Unlink the node and return it to the free list
+  kv_zset_write_begin(zset);
+  kv_zset_unlink(zset, node);
+  kv_zset_index_remove(zset, slot);
+  memset(&zset->nodes[node], 0, sizeof(zset->nodes[node]));
+  zset->nodes[node].next[0] = zset->free_head;
+  zset->free_head = node;
+  kv_zset_write_end(zset);
+  kv_notify(store, name);
+
+  // Step 5: Unlock semaphore
+  kv_write_unlock(store);
+  return 0;
+}
+
+/**
+ * Gets the score of a member (lock-free)
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Set name
+ * @param member Member
+ * @param score_out Pointer to return the score
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_zscore(shared_memory_kv_store_t *store, const char *name,
+                            const char *member, double *score_out) {
+  // Step 1: Validate input parameters
+  if (store == NULL || name == NULL || member == NULL || score_out == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Look the member up in the index
+  kv_zset_query_t query = {.op = KV_ZSET_QUERY_SCORE, .member = member};
+  if (kv_zset_query(store, name, &query) == -1) {
+    return -1;
+  }
+  *score_out = query.score;
+  return 0;
+}
+
+/**
+ * Gets the rank of a member (lock-free, O(log n))
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Set name
+ * @param member Member
+ * @param reverse 0: rank 0 is the lowest score; 1: the highest
+ * @return Rank, or -1 on error
+ */
+int shared_memory_kv_zrank(shared_memory_kv_store_t *store, const char *name,
+                           const char *member, int reverse) {
+  // Step 1: Validate input parameters
+  if (store == NULL || name == NULL || member == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Sum the spans down to the member
+  kv_zset_query_t query = {
+      .op = KV_ZSET_QUERY_RANK, .member = member, .reverse = reverse != 0};
+  return kv_zset_query(store, name, &query);
+}
+
+/**
+ * Reads the members from a rank on (lock-free, O(log n + k))
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Set name
+ * @param start First rank
+ * @param reverse 0: ascending scores; 1: descending
+ * @param items_out Array of at least max_items elements
+ * @param max_items Maximum number of members to return
+ * @return Number of members written, or -1 on error
+ */
+int shared_memory_kv_zrange(shared_memory_kv_store_t *store, const char *name,
+                            unsigned int start, int reverse,
+                            kv_zset_item_t *items_out, size_t max_items) {
+  // Step 1: Validate input parameters
+  if (store == NULL || name == NULL || (items_out == NULL && max_items > 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Find the start rank by its spans, then walk level 0
+  kv_zset_query_t query = {.op = KV_ZSET_QUERY_RANGE,
+                           .reverse = reverse != 0,
+                           .start = start,
+                           .items = items_out,
+                           .max_items = max_items};
+  return kv_zset_query(store, name, &query);
+}
+
+/**
+ * Reads the members within a score range, lowest first (lock-free,
+ * O(log n + k))
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Set name
+ * @param min Lowest score
+ * @param max Highest score
+ * @param items_out Array of at least max_items elements
+ * @param max_items Maximum number of members to return
+ * @return Number of members written, or -1 on error
+ */
+int shared_memory_kv_zrange_by_score(shared_memory_kv_store_t *store,
+                                     const char *name, double min, double max,
+                                     kv_zset_item_t *items_out,
+                                     size_t max_items) {
+  // Step 1: Validate input parameters
+  if (store == NULL || name == NULL || (items_out == NULL && max_items > 0) ||
+      min != min || max != max) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Descend to min, then walk level 0 up to max
+  kv_zset_query_t query = {.op = KV_ZSET_QUERY_SCORE_RANGE,
+                           .min = min,
+                           .max = max,
+                           .items = items_out,
+                           .max_items = max_items};
+  return kv_zset_query(store, name, &query);
+}
+
+/**
+ * Lists the sorted sets
+ *
+ * @param store Pointer to shared memory KV store
+ * @param zsets_out Array of at least max_zsets elements
+ * @param max_zsets Maximum number of sets to return
+ * @return Number of sets written, or -1 on error
+ */
+int shared_memory_kv_zset_list(shared_memory_kv_store_t *store,
+                               kv_zset_info_t *zsets_out, size_t max_zsets) {
+  // Step 1: Validate input parameters
+  if (store == NULL || (zsets_out == NULL && max_zsets > 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: Summarize each entry in use (lock-free, like ts_list)
+  // The lowest member follows the head, the highest is the tail
+  size_t count = 0;
+  for (unsigned int i = 0; i < KV_ZSET_MAX && count < max_zsets; i++) {
+    const kv_zset_t *zset = &store->zsets[i];
+    kv_zset_info_t *info = &zsets_out[count];
+    int used;
+    for (;;) {
+      unsigned int seq = kv_zset_read_begin(zset);
+      used = zset->name[0] != '\0';
+      if (used) {
+        unsigned int first = zset->nodes[0].next[0];
+        unsigned int last = zset->tail;
+        memcpy(info->name, zset->name, KEY_SIZE);
+        info->name[KEY_SIZE - 1] = '\0';
+        info->count = zset->count;
+        memset(&info->min, 0, sizeof(info->min));
+        memset(&info->max, 0, sizeof(info->max));
+        if (first != 0 && first <= KV_ZSET_CAPACITY && last != 0 &&
+            last <= KV_ZSET_CAPACITY) {
+          kv_zset_copy_item(&zset->nodes[first], &info->min);
+          kv_zset_copy_item(&zset->nodes[last], &info->max);
+        }
+      }
+      if (kv_zset_read_valid(zset, seq)) {
+        break;
+      }
+    }
+    if (used) {
+      count++;
+    }
+  }
+
+  return (int)count;
+}
+
+/**
+ * Deletes a sorted set with all its members
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Set name
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_zset_delete(shared_memory_kv_store_t *store,
+                                 const char *name) {
+  // Step 1: Validate input parameters
+  if (store == NULL || name == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (strnlen(name, KEY_SIZE) >= KEY_SIZE) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  // Step 2: Lock semaphore for exclusive access (single writer: no lock)
+  if (kv_write_lock(store) == -1) {
+    return -1;
+  }
+
+  // Step 3: Free the entry; readers in the middle of it retry and find the
+  // name gone (the nodes are reset when the entry is reused)
+  kv_zset_t *zset = kv_zset_find(store, name, kv_hash_key(name));
+  if (zset == NULL) {
+    kv_write_unlock(store);
+    errno = ENOENT;
+    return -1;
+  }
+  kv_zset_write_begin(zset);
+  memset(zset->name, 0, sizeof(zset->name));
+  zset->hash = 0;
+  zset->count = 0;
+  kv_zset_write_end(zset);
+  kv_notify(store, name);
+
+  // Step 4: Unlock semaphore
+  kv_write_unlock(store);
+  return 0;
+}
+
+// ============================================================================
+// CHANGE LOG READS AND REPLICATION STATE
+// ============================================================================
+
+/**
+ * Returns the position the next change will be logged at
+ *
+ * @param store Pointer to shared memory KV store
+ * @return Change log head
+ */
+unsigned long long
+shared_memory_kv_changelog_position(shared_memory_kv_store_t *store) {
+  if (store == NULL) {
+    return 0;
+  }
+  return atomic_load_explicit(&store->changelog_head, memory_order_acquire);
+}
+
+/**
+ * Reads logged changes from a position on (lock-free)
+ *
+ * @param store Pointer to shared memory KV store
+ * @param position_inout Position of the first change; advanced past the
+ *        changes returned
+ * @param changes_out Array of at least max_changes elements
+ * @param max_changes Maximum number of changes to return
+ * @return Number of changes written, or -1 on error
+ */
+int shared_memory_kv_changelog_read(shared_memory_kv_store_t *store,
+                                    unsigned long long *position_inout,
+                                    kv_change_t *changes_out,
+                                    size_t max_changes) {
+  // Step 1: Validate input parameters
+  if (store == NULL || position_inout == NULL ||
+      (changes_out == NULL && max_changes > 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+  unsigned long long position = *position_inout;
+  unsigned long long head =
+      atomic_load_explicit(&store->changelog_head, memory_order_acquire);
+  if (position > head) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Step 2: The ring keeps the last KV_CHANGELOG_SIZE changes only
+  if (head - position > KV_CHANGELOG_SIZE) {
+    errno = ERANGE;
+    return -1;
+  }
+
+  // Step 3: Copy records, checking each one's position before and after:
+  // a record the writer reused meanwhile means the reader fell behind
+  size_t count = 0;
+  for (; count < max_changes && position + count < head; count++) {
+    unsigned long long at = position + count;
+    const kv_changelog_record_t *record =
+        &store->changelog[at % KV_CHANGELOG_SIZE];
+    kv_change_t *change = &changes_out[count];
+    if (atomic_load_explicit(&record->position, memory_order_acquire) !=
+        at + 1) {
+      errno = ERANGE;
+      return -1;
+    }
+    change->position = at;
+    change->op = record->op;
+    change->version = record->version;
+    change->timestamp = record->timestamp;
+    memcpy(change->key, record->key, KEY_SIZE);
+    change->key[KEY_SIZE - 1] = '\0';
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&record->position, memory_order_relaxed) !=
+        at + 1) {
+      errno = ERANGE;
+      return -1;
+    }
   }
 
-  return store;
+  *position_inout = position + count;
+  return (int)count;
 }
 
 /**
- * Destroys the shared memory object and frees resources
+ * Waits until a change is logged at a position
  *
- * @param shared_memory_file_descriptor File descriptor of shared memory
- * @param store Pointer to mapped shared memory region
+ * @param store Pointer to shared memory KV store
+ * @param position Position to wait for
+ * @param timeout_ms Maximum wait in milliseconds (0 = don't wait,
+ *        -1 = no limit)
+ * @return 0 if a change is there, -1 on error
  */
-void shared_memory_kv_destroy(int shared_memory_file_descriptor,
-                              shared_memory_kv_store_t *store) {
-  // Step 1: Unmap shared memory from process address space
-  // Check for NULL pointer before using it
-  if (store != NULL) {
-    if (munmap(store, sizeof(shared_memory_kv_store_t)) == -1) {
-      perror("munmap failed");
-      // Continue cleanup even if munmap fails
-    }
+int shared_memory_kv_changelog_wait(shared_memory_kv_store_t *store,
+                                    unsigned long long position,
+                                    int timeout_ms) {
+  // Step 1: Validate input parameters
+  if (store == NULL || timeout_ms < -1) {
+    errno = EINVAL;
+    return -1;
   }
 
-  // Step 2: Close file descriptor
-  // Check for invalid descriptor before using it
-  if (shared_memory_file_descriptor != -1) {
-    if (close(shared_memory_file_descriptor) == -1) {
-      perror("close failed");
+  // Step 2: Compute the deadline (as in shared_memory_kv_queue_pop)
+  struct timespec deadline = {0, 0};
+  if (timeout_ms > 0) {
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
     }
   }
 
-  // Note: We do NOT call sem_destroy() here because:
-  // - Semaphore is in shared memory and will be destroyed when object is
-  // unlinked
-  // - Multiple processes should not destroy the same semaphore
-  //
-  // Note: We do NOT call shm_unlink() here because:
-  // - Only the creator (producer) should unlink the object
-  // - shm_unlink() should be called separately by producer when shutting down
+  for (;;) {
+    // Step 3: Done once the head moved past position
+    // events is read first: an append after the check changes it, so the
+    // wait below cannot miss that append
+    unsigned int events = atomic_load(&store->changelog_events);
+    if (atomic_load_explicit(&store->changelog_head, memory_order_acquire) >
+        position) {
+      return 0;
+    }
+
+    struct timespec remaining;
+    if (timeout_ms == 0) {
+      errno = EAGAIN;
+      return -1;
+    }
+    if (timeout_ms > 0) {
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      remaining.tv_sec = deadline.tv_sec - now.tv_sec;
+      remaining.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+      if (remaining.tv_nsec < 0) {
+        remaining.tv_sec--;
+        remaining.tv_nsec += 1000000000L;
+      }
+      if (remaining.tv_sec < 0) {
+        errno = ETIMEDOUT;
+        return -1;
+      }
+    }
+
+    // Step 4: Sleep until a writer appends
+    atomic_fetch_add(&store->changelog_waiters, 1);
+    long result = kv_futex(&store->changelog_events, FUTEX_WAIT, events,
+                           timeout_ms > 0 ? &remaining : NULL);
+    int saved_errno = errno;
+    atomic_fetch_sub(&store->changelog_waiters, 1);
+    if (result == -1 && saved_errno == EINTR) {
+      errno = EINTR;
+      return -1;
+    }
+  }
 }
 
 /**
- * Unlinks (removes) the shared memory object from the system
- *
- * This should be called ONLY by the creator process (producer)
- * when shutting down. After unlinking, the object will be removed
- * when all processes close their references to it.
+ * Publishes the replication state of a store
  *
+ * @param store Pointer to shared memory KV store
+ * @param status State to publish
  * @return 0 on success, -1 on error
- * @note This function should be called after all processes have
- * called shared_memory_kv_destroy()
  */
-int shared_memory_kv_unlink(void) {
-  if (shm_unlink(SHM_NAME) == -1) {
-    if (errno == ENOENT) {
-      return 0;
-    }
-    perror("shm_unlink failed");
+int shared_memory_kv_replication_report(
+    shared_memory_kv_store_t *store, const kv_replication_status_t *status) {
+  // Step 1: Validate input parameters
+  if (store == NULL || status == NULL) {
+    errno = EINVAL;
     return -1;
   }
+
+  // Step 2: Copy it between two increments of the sequence counter
+  unsigned int seq =
+      atomic_load_explicit(&store->replication_seq, memory_order_relaxed);
+  atomic_store_explicit(&store->replication_seq, seq + 1,
+                        memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  store->replication = *status;
+  store->replication.source[KV_REPLICATION_SOURCE_SIZE - 1] = '\0';
+  atomic_store_explicit(&store->replication_seq, seq + 2,
+                        memory_order_release);
   return 0;
 }
 
 /**
- * Sets (adds or updates) a key-value pair in the store
+ * Reads the replication state of a store (lock-free)
  *
  * @param store Pointer to shared memory KV store
- * @param key Key string (max KEY_SIZE-1 characters)
- * @param value Value string (max VALUE_SIZE-1 characters)
+ * @param status_out Pointer to return the state
  * @return 0 on success, -1 on error
  */
-int shared_memory_kv_set(shared_memory_kv_store_t *store, const char *key,
-                         const char *value) {
+int shared_memory_kv_replication_status(shared_memory_kv_store_t *store,
+                                        kv_replication_status_t *status_out) {
   // Step 1: Validate input parameters
-  if (store == NULL || key == NULL || value == NULL) {
+  if (store == NULL || status_out == NULL) {
     errno = EINVAL;
     return -1;
   }
 
-  // Step 2: Check key and value lengths
-  // strnlen returns the length of the string, but not more than the limit
-  // If length >= KEY_SIZE, it means the string is too long (no space for '\0')
-  size_t key_len = strnlen(key, KEY_SIZE);
-  size_t value_len = strnlen(value, VALUE_SIZE);
+  // Step 2: Copy the state, again if a report overlapped
+  for (;;) {
+    unsigned int seq =
+        atomic_load_explicit(&store->replication_seq, memory_order_acquire);
+    if (seq & 1) {
+      sched_yield(); // The replicator is reporting
+      continue;
+    }
+    *status_out = store->replication;
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&store->replication_seq, memory_order_relaxed) ==
+        seq) {
+      break;
+    }
+  }
 
-  if (key_len >= KEY_SIZE) {
-    errno = ENAMETOOLONG;
-    return -1;
+  // Step 3: A store nobody replicates into is its own primary
+  if (status_out->role == KV_ROLE_PRIMARY) {
+    status_out->primary_position =
+        shared_memory_kv_changelog_position(store);
+    status_out->applied_position = status_out->primary_position;
   }
+  return 0;
+}
 
-  if (value_len >= VALUE_SIZE) {
-    errno = ENAMETOOLONG;
+// ============================================================================
+// SHARDED STORES (client-side routing over several segments)
+// ============================================================================
+
+/**
+ * Name of a shard's shared memory object: "<name>.<shard>"
+ *
+ * @return 0 on success, -1 on error (errno set: EINVAL, ENAMETOOLONG)
+ */
+static int kv_shard_name(char *name_out, const char *name,
+                         unsigned int shard) {
+  if (kv_check_shm_name(name) == -1) {
     return -1;
   }
-
-  // Step 3: Lock semaphore for exclusive access
-  // sem_wait decrements the semaphore value (blocks if value is 0)
-  // This ensures only one process can modify the store at a time
-  // Critical for IPC: without this, we could have race conditions
-  if (sem_wait(&store->sem) == -1) {
-    perror("sem_wait failed");
+  if (snprintf(name_out, KV_SHM_NAME_SIZE, "%s.%u", name, shard) >=
+      KV_SHM_NAME_SIZE) {
+    errno = ENAMETOOLONG;
     return -1;
   }
+  return 0;
+}
 
-  // Step 4: Search for existing key in the table
-  // We need to find if the key already exists to update it,
-  // or find a free slot to add a new entry
-  int found_index_key = -1;  // Index of found key, -1 if not found
-  int found_index_free = -1;    // Index of first free slot, -1 if table is full
-
-  for (int i = 0; i < MAX_ENTRIES; i++) {
-    // Check if this slot has the key we're looking for
-    // strncmp compares strings, returns 0 if they match
-    if (store->kv_table[i].key[0] != '\0' &&
-        strncmp(store->kv_table[i].key, key, KEY_SIZE) == 0) {
-      found_index_key = i;
-      break; // Found existing key, no need to continue searching
-    }
-
-    // Track first free slot (empty key means slot is free)
-    if (found_index_free == -1 && store->kv_table[i].key[0] == '\0') {
-      found_index_free = i;
+/**
+ * Detaches from the first count shards of a router (and removes them)
+ */
+static void kv_shard_release(shared_memory_kv_sharded_t *router,
+                             unsigned int count, int unlink_shards) {
+  int saved_errno = errno;
+  for (unsigned int i = 0; i < count; i++) {
+    char name[KV_SHM_NAME_SIZE];
+    if (unlink_shards && kv_shard_name(name, router->name, i) == 0) {
+      shared_memory_kv_unlink_named(name);
     }
+    shared_memory_kv_destroy(router->fds[i], router->shards[i]);
+    router->shards[i] = NULL;
+    router->fds[i] = -1;
   }
+  errno = saved_errno;
+}
 
-  // Step 5: Determine which slot to use
-  int target_index;
-  int is_new_entry = 0; // Flag: 1 if adding new entry, 0 if updating existing
-
-  if (found_index_key != -1) {
-    // Key exists, update existing entry
-    target_index = found_index_key;
-    is_new_entry = 0;
-  } else if (found_index_free != -1) {
-    // Key doesn't exist, but we have a free slot
-    target_index = found_index_free;
-    is_new_entry = 1;
-  } else {
-    // Key doesn't exist AND table is full
-    // Unlock semaphore before returning error
-    sem_post(&store->sem);
-    errno = ENOSPC;
+/**
+ * Creates a sharded store of count independent shards
+ *
+ * @param router Caller-allocated router to initialize
+ * @param name Base name of the shards' objects
+ * @param count Number of shards (1 to KV_SHARD_MAX)
+ * @param flags Storage options of every shard
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_sharded_create(shared_memory_kv_sharded_t *router,
+                                    const char *name, unsigned int count,
+                                    unsigned int flags) {
+  // Step 1: Validate input parameters
+  // Batch workers and the callers' threads all write to the shards, so a
+  // shard cannot have a single writing thread
+  char shard_name[KV_SHM_NAME_SIZE];
+  if (router == NULL || count == 0 || count > KV_SHARD_MAX ||
+      (flags & KV_FLAG_SINGLE_WRITER)) {
+    errno = EINVAL;
     return -1;
   }
-
-  strncpy(store->kv_table[target_index].key, key, KEY_SIZE - 1);
-  store->kv_table[target_index].key[KEY_SIZE - 1] = '\0';
-
-  strncpy(store->kv_table[target_index].value, value, VALUE_SIZE - 1) ;
-  store->kv_table[target_index].value[VALUE_SIZE - 1] = '\0';
-
-  store->kv_table[target_index].timestamp = time(NULL);
-
-  // Step 6: Update entry count and version
-  store->version++;
-
-  if (is_new_entry) {
-    store->entry_count++;
+  if (kv_shard_name(shard_name, name, count - 1) == -1) {
+    return -1;
   }
+  memset(router, 0, sizeof(*router));
+  memcpy(router->name, name, strlen(name) + 1);
 
-  // Step 7: Unlock semaphore
-  if (sem_post(&store->sem) == -1) {
-    perror("sem_post failed");
+  // Step 2: Create every shard and record its place in the sharded store
+  for (unsigned int i = 0; i < count; i++) {
+    kv_shard_name(shard_name, name, i);
+    router->shards[i] =
+        shared_memory_kv_create_named(shard_name, &router->fds[i], flags);
+    if (router->shards[i] == NULL) {
+      kv_shard_release(router, i, 1);
+      return -1;
+    }
+    router->shards[i]->shard_index = i;
+    router->shards[i]->shard_count = count;
   }
-  
+
+  router->count = count;
+  pthread_mutex_init(&router->batch_lock, NULL);
   return 0;
 }
 
 /**
- * Gets a value from the store by key
- * 
- * @param store Pointer to shared memory KV store
- * @param key Key string (max KEY_SIZE-1 characters)
- * @param value_out Pointer to return the value (max VALUE_SIZE-1 characters)
- * @return 0 on success, -1 on error (errno set: EINVAL for invalid params, 
- *         ENOSPC if table is full, ENAMETOOLONG if key/value too long)
+ * Opens an existing sharded store
+ *
+ * @param router Caller-allocated router to initialize
+ * @param name Base name the store was created with
+ * @return 0 on success, -1 on error
  */
-
-int shared_memory_kv_get(shared_memory_kv_store_t *store,
-  const char *key,
-  char *value_out) {
-
+int shared_memory_kv_sharded_open(shared_memory_kv_sharded_t *router,
+                                  const char *name) {
   // Step 1: Validate input parameters
-  if (store == NULL || key == NULL || value_out == NULL) {
+  char shard_name[KV_SHM_NAME_SIZE];
+  if (router == NULL) {
     errno = EINVAL;
     return -1;
   }
-
-  // Step 2: Check key length
-  size_t key_len = strnlen(key, KEY_SIZE);
-  if (key_len >= KEY_SIZE) {
-    errno = ENAMETOOLONG;
+  if (kv_shard_name(shard_name, name, KV_SHARD_MAX - 1) == -1) {
     return -1;
   }
+  memset(router, 0, sizeof(*router));
+  memcpy(router->name, name, strlen(name) + 1);
 
-  // Step 3: Lock semaphore for exclusive access
-  if (sem_wait(&store->sem) == -1) {
-    perror("sem_wait failed");
-    return -1;
+  // Step 2: Shard 0 tells how many shards there are; every shard must
+  // agree and sit at its own position
+  unsigned int count = 1;
+  for (unsigned int i = 0; i < count; i++) {
+    kv_shard_name(shard_name, name, i);
+    router->shards[i] = shared_memory_kv_open_named(shard_name,
+                                                    &router->fds[i]);
+    if (router->shards[i] == NULL) {
+      kv_shard_release(router, i, 0);
+      return -1;
+    }
+    if (i == 0) {
+      count = router->shards[0]->shard_count;
+    }
+    if (count == 0 || count > KV_SHARD_MAX ||
+        router->shards[i]->shard_index != i ||
+        router->shards[i]->shard_count != count) {
+      kv_shard_release(router, i + 1, 0);
+      errno = EINVAL;
+      return -1;
+    }
   }
 
-  // Step 4: Search for the key in the table
-  int found_index = -1;
-  for (int i = 0; i < MAX_ENTRIES; i++) {
-    if (store->kv_table[i].key[0] != '\0' &&
-        strncmp(store->kv_table[i].key, key, KEY_SIZE) == 0) {
-      found_index = i;
-      break;
+  router->count = count;
+  pthread_mutex_init(&router->batch_lock, NULL);
+  return 0;
+}
+
+/**
+ * Stops the batch workers and detaches from all shards
+ *
+ * @param router Open router
+ */
+void shared_memory_kv_sharded_destroy(shared_memory_kv_sharded_t *router) {
+  if (router == NULL || router->count == 0) {
+    return;
+  }
+
+  // Step 1: Let the batch workers exit
+  if (router->worker_count > 0) {
+    atomic_store_explicit(&router->stopping, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&router->batch_seq, 1, memory_order_release);
+    kv_futex(&router->batch_seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL);
+    for (unsigned int i = 1; i <= router->worker_count; i++) {
+      pthread_join(router->workers[i].thread, NULL);
     }
+    router->worker_count = 0;
   }
 
-  // Step 5: Handle result - copy value or return error
-  if (found_index == -1) {
-    // Key not found
-    sem_post(&store->sem); // Unlock before returning error
-    errno = ENOENT;
+  // Step 2: Detach from the shards
+  kv_shard_release(router, router->count, 0);
+  pthread_mutex_destroy(&router->batch_lock);
+  router->count = 0;
+}
+
+/**
+ * Removes the shared memory objects of a sharded store
+ *
+ * @param name Base name the store was created with
+ * @return 0 if any shard was removed, -1 on error
+ */
+int shared_memory_kv_sharded_unlink(const char *name) {
+  char shard_name[KV_SHM_NAME_SIZE];
+  if (kv_shard_name(shard_name, name, KV_SHARD_MAX - 1) == -1) {
     return -1;
   }
 
-  // Key found - copy value to output buffer
-  // Use strncpy with explicit null termination for safety
-  strncpy(value_out, store->kv_table[found_index].value, VALUE_SIZE - 1);
-  value_out[VALUE_SIZE - 1] = '\0';
+  unsigned int removed = 0;
+  for (unsigned int i = 0; i < KV_SHARD_MAX; i++) {
+    kv_shard_name(shard_name, name, i);
+    if (shm_unlink(shard_name) == 0) {
+      removed++;
+    }
+  }
+  if (removed == 0) {
+    errno = ENOENT;
+    return -1;
+  }
+  return 0;
+}
 
-  // Step 6: Unlock semaphore
-  if (sem_post(&store->sem) == -1) {
-    perror("sem_post failed");
-    // Data was already copied, so we return success
+/**
+ * Shard a key belongs to
+ *
+ * @param router Open router
+ * @param key Key string
+ * @return Shard index
+ */
+unsigned int
+shared_memory_kv_shard_of(const shared_memory_kv_sharded_t *router,
+                          const char *key) {
+  if (router == NULL || router->count == 0 || key == NULL) {
     return 0;
   }
 
-  return 0;
+  // The slot of a key in its shard's table also comes from kv_hash_key():
+  // mix it (MurmurHash3 finalizer) so that shard and slot are independent
+  unsigned int hash = kv_hash_key(key);
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bu;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35u;
+  hash ^= hash >> 16;
+  return (unsigned int)(((unsigned long long)hash * router->count) >> 32);
 }
 
 /**
- * Deletes a key-value pair from the store
- * 
- * @param store Pointer to shared memory KV store
- * @param key Key string (max KEY_SIZE-1 characters)
- * @return 0 on success, -1 on error
+ * Store of the shard a key belongs to
+ *
+ * @param router Open router
+ * @param key Key string
+ * @return Store of the key's shard, or NULL on error
  */
-int shared_memory_kv_delete(shared_memory_kv_store_t *store, const char *key) {
-
-  // Step 1: Validate input parameters
-  if (store == NULL || key == NULL) {
+shared_memory_kv_store_t *
+shared_memory_kv_sharded_store(const shared_memory_kv_sharded_t *router,
+                               const char *key) {
+  if (router == NULL || router->count == 0 || key == NULL) {
     errno = EINVAL;
-    return -1;
+    return NULL;
   }
+  return router->shards[shared_memory_kv_shard_of(router, key)];
+}
 
-  // Step 2: Check key length
-  size_t key_len = strnlen(key, KEY_SIZE);
-  if (key_len >= KEY_SIZE) {
-    errno = ENAMETOOLONG;
-    return -1;
+/**
+ * Sets a key in its shard
+ *
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_sharded_set(shared_memory_kv_sharded_t *router,
+                                 const char *key, const char *value) {
+  return shared_memory_kv_set(shared_memory_kv_sharded_store(router, key),
+                              key, value);
+}
+
+/**
+ * Reads a key from its shard
+ *
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_sharded_get(shared_memory_kv_sharded_t *router,
+                                 const char *key, char *value_out) {
+  return shared_memory_kv_get(shared_memory_kv_sharded_store(router, key),
+                              key, value_out);
+}
+
+/**
+ * Deletes a key from its shard
+ *
+ * @return 0 on success, -1 on error
+ */
+int shared_memory_kv_sharded_delete(shared_memory_kv_sharded_t *router,
+                                    const char *key) {
+  return shared_memory_kv_delete(shared_memory_kv_sharded_store(router, key),
+                                 key);
+}
+
+/**
+ * Runs the operations of one shard in a batch, in batch order
+ */
+static void kv_shard_run(shared_memory_kv_sharded_t *router,
+                         unsigned int shard, kv_shard_op_t *ops,
+                         size_t count, int write) {
+  shared_memory_kv_store_t *store = router->shards[shard];
+  for (size_t i = 0; i < count; i++) {
+    kv_shard_op_t *op = &ops[i];
+    if (op->shard != shard) {
+      continue;
+    }
+    int result;
+    if (!write) {
+      result = shared_memory_kv_get(store, op->key, op->value);
+    } else if (op->is_delete) {
+      result = shared_memory_kv_delete(store, op->key);
+    } else {
+      result = shared_memory_kv_set(store, op->key, op->value);
+    }
+    op->error = result == 0 ? 0 : errno;
+    if (result == -1 && !write) {
+      op->value[0] = '\0';
+    }
   }
-  // Step 3: Lock semaphore for exclusive access
-  if (sem_wait(&store->sem) == -1) {
-    perror("sem_wait failed");
-    return -1;
+}
+
+/**
+ * Batch worker: runs its shard's part of every posted batch
+ */
+static void *kv_shard_worker(void *arg) {
+  kv_shard_worker_t *worker = arg;
+  shared_memory_kv_sharded_t *router = worker->router;
+
+  for (;;) {
+    // Step 1: Sleep until the next batch (or the router is destroyed)
+    unsigned int seq;
+    while ((seq = atomic_load_explicit(&router->batch_seq,
+                                       memory_order_acquire)) ==
+           worker->seen) {
+      kv_futex(&router->batch_seq, FUTEX_WAIT_PRIVATE, seq, NULL);
+    }
+    worker->seen = seq;
+    if (atomic_load_explicit(&router->stopping, memory_order_relaxed)) {
+      return NULL;
+    }
+
+    // Step 2: Run this shard's part; the last worker done wakes the caller
+    kv_shard_run(router, worker->shard, router->batch_ops,
+                 router->batch_count, router->batch_write);
+    if (atomic_fetch_sub_explicit(&router->batch_pending, 1,
+                                  memory_order_acq_rel) == 1) {
+      kv_futex(&router->batch_pending, FUTEX_WAKE_PRIVATE, 1, NULL);
+    }
   }
+}
 
-  // Step 4: Search for the key in the table
-  int found_index = -1;
-  for (int i = 0; i < MAX_ENTRIES; i++) {
-    if (store->kv_table[i].key[0] != '\0' &&
-        strncmp(store->kv_table[i].key, key, KEY_SIZE) == 0) {
-      found_index = i;
+/**
+ * Starts a worker for every shard but shard 0
+ *
+ * Workers block all signals, so signals keep going to the application's
+ * threads. If a thread cannot be started, the calling thread runs the
+ * parts of the shards left without a worker.
+ */
+static void kv_shard_start_workers(shared_memory_kv_sharded_t *router) {
+  sigset_t all;
+  sigset_t previous;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &previous);
+  for (unsigned int i = 1; i < router->count; i++) {
+    kv_shard_worker_t *worker = &router->workers[i];
+    worker->router = router;
+    worker->shard = i;
+    worker->seen =
+        atomic_load_explicit(&router->batch_seq, memory_order_relaxed);
+    if (pthread_create(&worker->thread, NULL, kv_shard_worker, worker) !=
+        0) {
       break;
     }
+    router->worker_count = i;
   }
-  
-  // Step 5: Handle result - delete key or return error
-  if (found_index == -1) {
-    sem_post(&store->sem);
-    errno = ENOENT;
+  pthread_sigmask(SIG_SETMASK, &previous, NULL);
+}
+
+/**
+ * Routes a batch and runs each shard's part, concurrently if it is large
+ *
+ * @return Number of operations that succeeded, or -1 on error
+ */
+static int kv_sharded_batch(shared_memory_kv_sharded_t *router,
+                            kv_shard_op_t *ops, size_t count, int write) {
+  // Step 1: Validate input parameters
+  if (router == NULL || router->count == 0 || (ops == NULL && count > 0)) {
+    errno = EINVAL;
     return -1;
   }
 
-  // Step 6: Delete key
-  store->kv_table[found_index].key[0] = '\0';
-  store->kv_table[found_index].value[0] = '\0';
-  store->kv_table[found_index].timestamp = 0;
-  
-  store->version++;
-  store->entry_count--;
+  // Step 2: Route every operation
+  int used[KV_SHARD_MAX] = {0};
+  unsigned int used_count = 0;
+  for (size_t i = 0; i < count; i++) {
+    ops[i].shard = shared_memory_kv_shard_of(router, ops[i].key);
+    ops[i].error = 0;
+    if (!used[ops[i].shard]) {
+      used[ops[i].shard] = 1;
+      used_count++;
+    }
+  }
 
-  if (sem_post(&store->sem) == -1) {
-    perror("sem_post failed");
-    return 0;
+  if (count < KV_SHARD_PARALLEL_MIN || used_count < 2) {
+    // Step 3: Small batches (waking workers would cost more than they
+    // save) and batches for a single shard run on this thread
+    for (unsigned int shard = 0; shard < router->count; shard++) {
+      if (used[shard]) {
+        kv_shard_run(router, shard, ops, count, write);
+      }
+    }
+  } else {
+    // Step 4: Post the batch to the workers, run shard 0 (and the shards
+    // without a worker) here, then wait for the workers
+    pthread_mutex_lock(&router->batch_lock);
+    if (router->worker_count == 0) {
+      kv_shard_start_workers(router);
+    }
+    router->batch_ops = ops;
+    router->batch_count = count;
+    router->batch_write = write;
+    atomic_store_explicit(&router->batch_pending, router->worker_count,
+                          memory_order_relaxed);
+    atomic_fetch_add_explicit(&router->batch_seq, 1, memory_order_release);
+    kv_futex(&router->batch_seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL);
+
+    for (unsigned int shard = 0; shard < router->count; shard++) {
+      if (used[shard] && (shard == 0 || shard > router->worker_count)) {
+        kv_shard_run(router, shard, ops, count, write);
+      }
+    }
+    unsigned int pending;
+    while ((pending = atomic_load_explicit(&router->batch_pending,
+                                           memory_order_acquire)) != 0) {
+      kv_futex(&router->batch_pending, FUTEX_WAIT_PRIVATE, pending, NULL);
+    }
+    pthread_mutex_unlock(&router->batch_lock);
   }
 
-  return 0;
+  // Step 5: Count the operations that succeeded
+  int succeeded = 0;
+  for (size_t i = 0; i < count; i++) {
+    succeeded += ops[i].error == 0;
+  }
+  return succeeded;
+}
+
+/**
+ * Applies a batch of sets and deletes, split by shard
+ *
+ * @param router Open router
+ * @param ops Operations
+ * @param count Number of operations
+ * @return Number of operations that succeeded, or -1 on error
+ */
+int shared_memory_kv_sharded_mset(shared_memory_kv_sharded_t *router,
+                                  kv_shard_op_t *ops, size_t count) {
+  return kv_sharded_batch(router, ops, count, 1);
+}
+
+/**
+ * Reads a batch of keys, split by shard
+ *
+ * @param router Open router
+ * @param ops Operations
+ * @param count Number of operations
+ * @return Number of keys read, or -1 on error
+ */
+int shared_memory_kv_sharded_mget(shared_memory_kv_sharded_t *router,
+                                  kv_shard_op_t *ops, size_t count) {
+  return kv_sharded_batch(router, ops, count, 0);
 }
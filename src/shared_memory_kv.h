@@ -6,17 +6,32 @@
 #ifndef _POSIX_C_SOURCE
 #define _POSIX_C_SOURCE 200809L
 #endif
+// syscall() (futex wake-ups of key subscriptions)
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
 
 // Required header files for shared memory and synchronization
+#include <ctype.h>     // tolower
 #include <errno.h>     // errno
 #include <fcntl.h>     // O_CREAT, O_RDWR, O_RDONLY
+#include <limits.h>    // UINT_MAX
+#include <linux/futex.h> // FUTEX_WAIT, FUTEX_WAKE
+#include <pthread.h>   // pthread_create, pthread_mutex_t (sharded batches)
+#include <sched.h>     // sched_yield
 #include <semaphore.h> // sem_t, sem_init, sem_wait, sem_post, sem_destroy
-#include <signal.h>    // signal, SIGINT
+#include <signal.h>    // signal, SIGINT, kill
+#include <stdatomic.h> // atomic_load_explicit, atomic_store_explicit
+#include <stddef.h>    // offsetof
+#include <stdint.h>    // uintptr_t
 #include <stdio.h>     // printf, perror
 #include <stdlib.h>    // exit, EXIT_SUCCESS, EXIT_FAILURE
 #include <string.h>    // memset, strncpy, strnlen
 #include <sys/mman.h>  // mmap, munmap, shm_open, shm_unlink
+#include <sys/socket.h> // socket, sendto, recv
 #include <sys/stat.h>  // Access modes (S_IRUSR, S_IWUSR, etc.)
+#include <sys/syscall.h> // SYS_futex
+#include <sys/un.h>     // sockaddr_un
 #include <time.h>      // time_t, time()
 #include <unistd.h>    // ftruncate, close
 
@@ -35,8 +50,225 @@
 
 // Field sizes (fixed for simplicity)
 // Why fixed: shared memory requires a known size at compile time
+// Keys and values live in the arena below; these are the API limits
+// Values are large enough for small JSON documents (see value compression)
 #define KEY_SIZE 64
-#define VALUE_SIZE 256
+#define VALUE_SIZE 4096
+
+// Version chains (see shared_memory_kv_get): every entry keeps its newest
+// KV_MVCC_VERSIONS versions in the arena, so readers never block on writers
+// and a version a reader is copying is never overwritten under it
+#define KV_MVCC_VERSIONS 4
+// Versions a chain may grow to while the retire list is full (see
+// KV_RETIRED_MAX); beyond that, writes to the key fail with EAGAIN
+#define KV_MVCC_VERSIONS_MAX (4 * KV_MVCC_VERSIONS)
+
+// Registry of attached processes: one entry per attached thread (pid,
+// thread id, start time, heartbeat, announced epoch), KV_REGISTRY_SIZE
+// entries. A thread's entry is freed when the thread exits; entries of
+// threads and processes that ended without freeing them are reaped (see
+// shared_memory_kv_reap), at most every KV_REAP_INTERVAL seconds from the
+// compaction step and whenever they block reclamation.
+#define KV_REGISTRY_SIZE 128
+#define KV_REAP_INTERVAL 1
+// Attachments (shared_memory_kv_create/open not yet destroyed) are counted
+// per process in a table of their own, KV_PROCESS_MAX processes, so that
+// shared_memory_kv_unlink_safe() sees every attached process even when the
+// thread registry is full. KV_MAPPED_MAX stores mapped by one process are
+// tracked for freeing the entries of exiting threads
+#define KV_PROCESS_MAX 128
+#define KV_MAPPED_MAX 64
+// Readers that find the registry full announce their epoch in one of
+// KV_SHARED_READERS shared entries instead. Such an entry counts its
+// readers in the bits above the low KV_SHARED_EPOCH_BITS of its epoch and
+// keeps the oldest epoch announced until the last of them is done
+#define KV_SHARED_READERS 8
+#define KV_SHARED_EPOCH_BITS 48
+#define KV_SHARED_EPOCH_MASK ((1ULL << KV_SHARED_EPOCH_BITS) - 1)
+#define KV_REGISTRY_SHARED -2 // pid of the shared reader entries
+
+// Epoch-based reclamation: readers announce the epoch they started in
+// in their registry entry; replaced versions and deleted keys wait in a
+// retire list of KV_RETIRED_MAX items until no announced epoch is old
+// enough to still see them. A writer never waits for readers: while the
+// list is full, a set leaves the replaced version in its chain for a later
+// write to trim (up to KV_MVCC_VERSIONS_MAX), and a delete fails with EAGAIN
+// before it changes anything.
+#define KV_RETIRED_MAX 1024
+
+// Flat combining of sets and deletes (see shared_memory_kv_set): a writer
+// that finds the semaphore taken publishes its request in one of
+// KV_COMBINE_SLOTS shared request slots, and whoever holds the semaphore
+// applies all published requests in one pass (with every slot taken, a
+// writer waits on the semaphore instead). Waiters sleep on the slot's state
+// futex, woken when it is applied; every KV_COMBINE_WAIT_US they try to
+// take the semaphore themselves, in case its holder is not combining
+#define KV_COMBINE_SLOTS 16
+#define KV_COMBINE_WAIT_US 200
+
+// Key subscriptions (see shared_memory_kv_subscribe): up to
+// KV_SUBSCRIPTIONS at a time, each watching up to KV_SUBSCRIPTION_KEYS keys
+// or key prefixes. Writers wake only the subscriptions a change matches
+#define KV_SUBSCRIPTIONS 64
+#define KV_SUBSCRIPTION_KEYS 8
+
+// Subscription flags
+#define KV_SUBSCRIBE_PREFIX 0x1 // Patterns are key prefixes, not whole keys
+
+// Name of the notification socket of a subscription (see
+// shared_memory_kv_notify_fd) in the abstract unix socket namespace:
+// owner pid, subscription id
+#define KV_NOTIFY_SOCKET_FORMAT "shared_memory_kv.%d.%d"
+
+// Arena for key and value bytes (offsets, not pointers: every process maps
+// the segment at a different address). Sized for the worst case (a full
+// version chain plus one retired version per entry, each value in a block
+// of twice VALUE_SIZE); tmpfs only backs pages that are actually touched,
+// so unused arena costs no RAM.
+#ifndef ARENA_SIZE
+#define ARENA_SIZE                                                             \
+  (MAX_ENTRIES * ((KV_MVCC_VERSIONS + 1) * (2 * VALUE_SIZE + 64) +             \
+                  2 * KEY_SIZE) +                                              \
+   64 * 1024)
+#endif
+
+// Arena allocator: power-of-two size classes from KV_ARENA_MIN_BLOCK bytes
+#define KV_ARENA_MIN_BLOCK 32
+#define KV_ARENA_CLASSES 16 // Largest block: KV_ARENA_MIN_BLOCK << 15 = 1 MiB
+
+// Buckets of the content-addressed blob index (deduplicated values and
+// interned key prefixes)
+#define KV_BLOB_BUCKETS (MAX_ENTRIES * 2)
+
+// Key prefixes are split at the last of these delimiters (delimiter kept in
+// the prefix) and interned when at least KV_MIN_PREFIX_LENGTH bytes long
+#define KV_KEY_DELIMITERS "._:/-"
+#define KV_MIN_PREFIX_LENGTH 4
+
+// Store creation flags (see shared_memory_kv_create_ex)
+#define KV_FLAG_DEDUP_VALUES 0x1 // Identical values share one arena blob
+#define KV_FLAG_PREFIX_KEYS 0x2  // Keys store an interned prefix + suffix
+#define KV_FLAG_COMPRESS_VALUES 0x4 // LZ-compress values above a threshold
+#define KV_FLAG_SINGLE_WRITER 0x8   // Only the creating process writes; its
+                                    // writes skip the semaphore
+
+// Value compression: values of at least KV_COMPRESS_THRESHOLD bytes are
+// LZ77-compressed (optionally against a preset dictionary of up to
+// KV_COMPRESS_DICT_SIZE bytes) and kept compressed only if that saves space
+#define KV_COMPRESS_THRESHOLD 128
+#define KV_COMPRESS_DICT_SIZE 1024
+
+// Slot states for open addressing (see kv_pair_t.state)
+// A tombstone marks a deleted slot that lookups must probe past; it can be
+// reused by inserts but never terminates a probe sequence
+#define KV_SLOT_EMPTY 0
+#define KV_SLOT_OCCUPIED 1
+#define KV_SLOT_TOMBSTONE 2
+
+// Counting bloom filter in front of lookups (see shared_memory_kv_get)
+// Each key sets KV_BLOOM_HASHES of KV_BLOOM_COUNTERS 8-bit counters; a get
+// that finds any of them at zero is a guaranteed miss and returns without
+// taking the semaphore. Deletes decrement the counters, so the filter
+// never needs a rebuild. Counters that reach 255 stay saturated.
+#define KV_BLOOM_COUNTERS 1024 // Power of two, >> MAX_ENTRIES * HASHES
+#define KV_BLOOM_HASHES 3
+
+// Transactions (see shared_memory_kv_txn_*): maximum number of distinct keys
+// a transaction can read and write. Reads and writes are buffered in the
+// caller's shared_memory_kv_txn_t, not in shared memory
+#define KV_TXN_MAX_OPS 16
+
+// Snapshot reads (see shared_memory_kv_snapshot_get): optimistic attempts
+// against the sequence lock before falling back to the semaphore, and spins
+// waiting for an in-progress write to finish within one attempt
+#define KV_SNAPSHOT_RETRIES 8
+#define KV_SNAPSHOT_SPINS 1024
+
+// Occupancy statistics layout (see shared_memory_kv_occupancy_stats)
+#define KV_PROBE_HISTOGRAM_BUCKETS 16 // Last bucket counts longer probes too
+#define KV_OCCUPANCY_REGIONS 64       // Max number of regions in the heatmap
+
+// Key search match kinds (see shared_memory_kv_search)
+#define KV_MATCH_PREFIX 1    // Key starts with the query
+#define KV_MATCH_SUBSTRING 2 // Key contains the query (case-insensitive)
+#define KV_MATCH_FUZZY 3     // Query characters appear in order in the key
+
+// Key search flags
+#define KV_SEARCH_PREFIX 0x1 // Prefix matches via the sorted key index
+#define KV_SEARCH_FUZZY 0x2  // Substring/subsequence fallback (linear scan)
+
+// Time series (see shared_memory_kv_ts_append): up to KV_SERIES_MAX series,
+// each keeping its last KV_SERIES_SAMPLES samples in a ring. Series names
+// are a namespace of their own, separate from the keys of the table
+#define KV_SERIES_MAX 16
+#define KV_SERIES_SAMPLES 256
+
+// Rollups (see shared_memory_kv_rollup_enable): up to KV_ROLLUP_MAX keys
+// whose numeric values are aggregated on write over fixed windows
+#define KV_ROLLUP_MAX 16
+#define KV_ROLLUP_WINDOWS 3 // Window i is selected by flag (1 << i)
+#define KV_ROLLUP_1S 0x1    // 1-second buckets
+#define KV_ROLLUP_10S 0x2   // 10-second buckets
+#define KV_ROLLUP_1M 0x4    // 1-minute buckets
+#define KV_ROLLUP_ALL (KV_ROLLUP_1S | KV_ROLLUP_10S | KV_ROLLUP_1M)
+
+// Queues (see shared_memory_kv_queue_push): up to KV_QUEUE_MAX bounded
+// multi-producer/multi-consumer rings of KV_QUEUE_CAPACITY items of at most
+// KV_QUEUE_ITEM_SIZE bytes. Queue names are a namespace of their own
+#define KV_QUEUE_MAX 8
+#define KV_QUEUE_CAPACITY 256 // Power of two (positions are masked)
+#define KV_QUEUE_ITEM_SIZE 256
+// Positions and cell sequences carry the generation of their queue entry
+// above bit KV_QUEUE_GENERATION_SHIFT, so a push or pop that started before
+// its queue was deleted cannot act on a queue created in the same entry
+#define KV_QUEUE_GENERATION_SHIFT 40
+#define KV_QUEUE_POSITION_MASK ((1ULL << KV_QUEUE_GENERATION_SHIFT) - 1)
+
+// Sorted sets (see shared_memory_kv_zadd): up to KV_ZSET_MAX skiplists of
+// at most KV_ZSET_CAPACITY members ordered by score. Set names are a
+// namespace of their own
+#define KV_ZSET_MAX 8
+#define KV_ZSET_CAPACITY 256
+#define KV_ZSET_LEVELS 8         // Skiplist levels (log2 of the capacity)
+#define KV_ZSET_MEMBER_SIZE 64   // Max member length + 1
+#define KV_ZSET_INDEX_SIZE 512   // Member hash index slots (power of two)
+
+// Names of shared memory objects (see shared_memory_kv_create_named): "/"
+// and at most KV_SHM_NAME_SIZE-2 more characters, like SHM_NAME
+#define KV_SHM_NAME_SIZE 64
+
+// Change log (see shared_memory_kv_changelog_read): the last
+// KV_CHANGELOG_SIZE sets and deletes of table keys, in order. A reader that
+// falls further behind has to start over from a copy of the table
+#define KV_CHANGELOG_SIZE 1024
+
+// Change log operations (kv_change_t.op)
+#define KV_CHANGE_SET 1    // Key set (its value is read from the table)
+#define KV_CHANGE_DELETE 2 // Key deleted
+
+// Replication roles (see shared_memory_kv_replication_status)
+#define KV_ROLE_PRIMARY 0 // No replicator reported (the default)
+#define KV_ROLE_REPLICA 1 // Store kept up to date by a replicator
+#define KV_REPLICATION_SOURCE_SIZE 108 // Primary address (sun_path size)
+
+// Sharded stores (see shared_memory_kv_sharded_create): up to KV_SHARD_MAX
+// independent segments named "<name>.<index>", keys routed by hash. Batches
+// of at least KV_SHARD_PARALLEL_MIN operations run each shard's part on its
+// own thread; smaller ones run on the calling thread
+#define KV_SHARD_MAX 16
+#define KV_SHARD_PARALLEL_MIN 128
+
+// Value types (see shared_memory_kv_get_value). Numbers are stored natively
+// and formatted only when read as text (shared_memory_kv_get)
+#define KV_TYPE_STRING 0 // Text (shared_memory_kv_set)
+#define KV_TYPE_INT64 1  // Signed 64-bit integer
+#define KV_TYPE_DOUBLE 2 // Double-precision floating point
+#define KV_TYPE_BYTES 3  // Opaque bytes (may contain '\0')
+#define KV_TYPE_HASH 4   // Field map (see shared_memory_kv_hset)
+
+// Hash entries: fields are text of at most KV_HASH_FIELD_SIZE-1 characters;
+// the encoded map ("field\0value\0" per field) must fit in VALUE_SIZE-1
+#define KV_HASH_FIELD_SIZE 64
 
 // ============================================================================
 // DATA STRUCTURES
@@ -45,23 +277,400 @@
 /**
  * Structure for a single KV pair
  *
- * Contains key, value, and last update timestamp.
+ * Contains arena references to the key and value, last update timestamp,
+ * the store version at which the slot last changed, and the hash/state used
+ * by open addressing. Key and value bytes live in refcounted arena blobs:
+ * a key is an optional interned prefix blob followed by a suffix blob.
+ * head points to the entry's newest version record; lock-free readers only
+ * follow head, the other fields are for code holding the semaphore (or for
+ * readers validating seq, which is odd while the writer changes the slot).
  * All fields have fixed sizes for shared memory operation.
  */
 typedef struct {
-  char key[KEY_SIZE];     // Key (string, max KEY_SIZE-1 characters + '\0')
-  char value[VALUE_SIZE]; // Value (string, max VALUE_SIZE-1 characters + '\0')
-  time_t timestamp;       // Last update time (Unix timestamp)
+  unsigned int key_prefix_ref; // Arena offset of the interned key prefix
+                               // blob (0 = key has no shared prefix)
+  unsigned int key_suffix_ref; // Arena offset of the rest of the key
+  unsigned int value_ref;      // Arena offset of the value blob
+  time_t timestamp;            // Last update time (Unix timestamp)
+  unsigned int slot_version; // Store version at the last change of this slot
+                             // (set on both writes and deletes, so readers
+                             // can fetch only slots changed since a version)
+  unsigned int hash;  // Hash of the key (compared before the key bytes)
+  unsigned int state; // KV_SLOT_EMPTY, KV_SLOT_OCCUPIED or KV_SLOT_TOMBSTONE
+  _Atomic unsigned int head; // Arena offset of the newest version record
+                             // (0 = none), see shared_memory_kv_get
+  _Atomic unsigned int seq;  // Slot sequence counter (odd during a change)
 } kv_pair_t;
 
+/**
+ * Entry of the registry of attached processes
+ *
+ * Claimed by one thread of one process when it creates or opens the store
+ * (other threads claim theirs on their first lock-free read) and freed when
+ * the thread exits, by shared_memory_kv_destroy(), or by reaping once the
+ * thread or process is gone. The start time tells a live process from a
+ * later one that reused its pid.
+ */
+typedef struct {
+  _Atomic int pid;                       // Owning process (0 = free entry,
+                                         // -1 = being reaped, -2 = shared
+                                         // reader entry)
+  _Atomic uintptr_t thread;              // Owning thread within that process
+  _Atomic int tid;                       // Its kernel thread id (0 = unknown)
+  _Atomic unsigned long long start_time; // Process start (clock ticks after
+                                         // boot, 0 = unknown)
+  _Atomic long long heartbeat;           // time() of the last heartbeat
+  _Atomic unsigned long long epoch; // Epoch announced by the current read
+                                    // (0 = not reading)
+} kv_registry_entry_t;
+
+/**
+ * Attachment count of one process (see shared_memory_kv_unlink_safe)
+ *
+ * Claimed by the first create or open of a process, counted up by further
+ * ones and down by shared_memory_kv_destroy(); freed at zero, or by
+ * reaping once the process is gone.
+ */
+typedef struct {
+  _Atomic int pid;                       // Attached process (0 = free entry,
+                                         // -1 = being reaped)
+  _Atomic unsigned long long start_time; // Process start (clock ticks after
+                                         // boot, 0 = unknown)
+  _Atomic unsigned int attachments;      // Mappings not yet destroyed
+} kv_process_entry_t;
+
+/**
+ * Arena object waiting for readers to move past its retirement epoch
+ */
+typedef struct {
+  unsigned int offset;      // Version record or blob offset
+  unsigned int kind;        // What to free (see kv_reclaim_item)
+  unsigned long long epoch; // Global epoch when it was unlinked
+} kv_retired_t;
+
+// Combining record states (see kv_combine_record_t.state): the low
+// KV_COMBINE_STATE_BITS bits, above them the owner's pid
+#define KV_COMBINE_IDLE 0
+#define KV_COMBINE_CLAIMED 1 // Taken, the owner fills in the request
+#define KV_COMBINE_PENDING 2 // Published, waiting for a combiner
+#define KV_COMBINE_DONE 3    // Applied, result and error are valid
+#define KV_COMBINE_STATE_BITS 2
+#define KV_COMBINE_STATE_MASK 3u
+
+// Combined operations (see kv_combine_record_t.op)
+#define KV_COMBINE_SET 1
+#define KV_COMBINE_DELETE 2
+#define KV_COMBINE_HSET 3 // value = "field\0field value"
+#define KV_COMBINE_HDEL 4 // value = "field"
+
+/**
+ * Write request slot for flat combining
+ *
+ * A writer claims an idle slot with a compare-and-swap, fills in the
+ * request and sets PENDING; the combiner (holding the semaphore) applies
+ * it, stores the outcome and sets DONE; the owner takes the outcome and
+ * sets the slot idle again. The owner's pid is part of the state word, so
+ * a slot left claimed or done by a dead process is freed again with a
+ * compare-and-swap that fails if someone else took it meanwhile.
+ */
+typedef struct {
+  _Atomic unsigned int state; // pid << KV_COMBINE_STATE_BITS | KV_COMBINE_*
+  unsigned int op;            // KV_COMBINE_* operation
+  int result;                 // 0 or -1, valid once DONE
+  int error;                  // errno when result is -1
+  unsigned int type;          // KV_TYPE_* of value (KV_COMBINE_SET only)
+  unsigned int length;        // Bytes in value (not for KV_COMBINE_DELETE)
+  char key[KEY_SIZE];
+  char value[VALUE_SIZE]; // Not for KV_COMBINE_DELETE
+} kv_combine_record_t;
+
+/**
+ * Time series sample
+ */
+typedef struct {
+  long long timestamp; // Milliseconds since the Unix epoch
+  double value;
+} kv_sample_t;
+
+/**
+ * Time series: ring of the newest samples of one metric
+ *
+ * Appended under the semaphore (or by the single writer); readers copy
+ * without locking and retry when seq changed meanwhile.
+ */
+typedef struct {
+  char key[KEY_SIZE];          // Series name ("" = free entry)
+  unsigned int hash;           // Hash of the name
+  _Atomic unsigned int seq;    // Sequence counter (odd during a change)
+  unsigned long long appended; // Samples appended so far; the newest is at
+                               // (appended - 1) % KV_SERIES_SAMPLES
+  kv_sample_t samples[KV_SERIES_SAMPLES];
+} kv_series_t;
+
+/**
+ * Summary of a time series (see shared_memory_kv_ts_list)
+ */
+typedef struct {
+  char key[KEY_SIZE];
+  unsigned int count;          // Samples held (at most KV_SERIES_SAMPLES)
+  unsigned long long appended; // Samples appended since creation
+  kv_sample_t first;           // Oldest sample held
+  kv_sample_t last;            // Newest sample
+} kv_series_info_t;
+
+/**
+ * Aggregate of the numeric writes of a key within one window bucket
+ */
+typedef struct {
+  long long start;    // Bucket start (ms since the epoch, window-aligned)
+  unsigned int count; // Numeric writes in the bucket (0 = empty)
+  double min;
+  double max;
+  double sum;  // Average = sum / count
+  double last; // Newest value written in the bucket
+} kv_rollup_bucket_t;
+
+/**
+ * Rollups of one key: the bucket being filled and the last completed one
+ * for each window
+ *
+ * Updated by writes of the key (under the semaphore or by the single
+ * writer); readers copy without locking and retry when seq changed
+ * meanwhile.
+ */
+typedef struct {
+  char key[KEY_SIZE];       // Key name ("" = free entry)
+  unsigned int hash;        // kv_hash_key(key)
+  unsigned int windows;     // KV_ROLLUP_* flags being maintained
+  _Atomic unsigned int seq; // Sequence counter (odd during a change)
+  kv_rollup_bucket_t current[KV_ROLLUP_WINDOWS];
+  kv_rollup_bucket_t previous[KV_ROLLUP_WINDOWS];
+} kv_rollup_t;
+
+/**
+ * Rollups of a key as seen at the time of the read (see
+ * shared_memory_kv_rollup_get)
+ *
+ * A bucket whose window has ended is reported as previous (or as empty
+ * when it is older than that), so idle keys don't show stale aggregates.
+ */
+typedef struct {
+  char key[KEY_SIZE];
+  unsigned int windows; // KV_ROLLUP_* flags maintained
+  kv_rollup_bucket_t current[KV_ROLLUP_WINDOWS];  // Window in progress
+  kv_rollup_bucket_t previous[KV_ROLLUP_WINDOWS]; // Last completed window
+} kv_rollup_info_t;
+
+/**
+ * Cell of a queue ring
+ *
+ * sequence tells producers and consumers whose turn the cell is: equal to
+ * a producer's position when the cell is free for it, position + 1 once
+ * the item is written, position + KV_QUEUE_CAPACITY once it was taken. It
+ * is advanced with a compare-and-swap, which fails if the queue was
+ * deleted and its entry reused meanwhile.
+ */
+typedef struct {
+  _Atomic unsigned long long sequence;
+  unsigned int length; // Bytes in data
+  char data[KV_QUEUE_ITEM_SIZE];
+} kv_queue_cell_t;
+
+/**
+ * Bounded MPMC queue (Vyukov's array queue)
+ *
+ * Created and deleted under the semaphore; pushes and pops are lock-free
+ * from any process: each claims a position with one compare-and-swap and
+ * then owns the cell until it advances the cell's sequence. Every push
+ * increments items, the futex word blocked consumers sleep on; producers
+ * make the wake-up system call only while a consumer is waiting.
+ */
+typedef struct {
+  char name[KEY_SIZE];         // Queue name ("" = free entry)
+  unsigned int hash;           // kv_hash_key(name)
+  _Atomic unsigned int active; // Set once the ring is initialized
+  _Atomic unsigned int generation; // Bumped by every create of the entry
+  _Atomic unsigned int items;   // Pushes so far (futex word)
+  _Atomic unsigned int waiters; // Consumers sleeping on items
+  _Atomic unsigned long long rejected; // Pushes that found the ring full
+  // Positions on cache lines of their own, so producers and consumers
+  // don't invalidate each other's line on every operation
+  _Alignas(64) _Atomic unsigned long long enqueue_pos; // Next push
+  _Alignas(64) _Atomic unsigned long long dequeue_pos; // Next pop
+  _Alignas(64) kv_queue_cell_t cells[KV_QUEUE_CAPACITY];
+} kv_queue_t;
+
+/**
+ * Summary of a queue (see shared_memory_kv_queue_list)
+ */
+typedef struct {
+  char name[KEY_SIZE];
+  unsigned int length;         // Items waiting (at most KV_QUEUE_CAPACITY)
+  unsigned int waiters;        // Consumers blocked in a pop
+  unsigned long long pushed;   // Items pushed since creation
+  unsigned long long popped;   // Items popped since creation
+  unsigned long long rejected; // Pushes that found the queue full
+} kv_queue_info_t;
+
+/**
+ * Skiplist node of a sorted set
+ *
+ * Nodes are linked by their index in the set's node pool (0 is the head
+ * node, so 0 also ends a list). span[i] counts the nodes next[i] skips,
+ * which turns rank lookups into a descent of the list.
+ */
+typedef struct {
+  char member[KV_ZSET_MEMBER_SIZE];
+  double score;
+  unsigned int hash;                 // kv_hash_key(member)
+  unsigned int level;                // Levels the node is linked on
+  unsigned int prev;                 // Predecessor on level 0
+  unsigned int next[KV_ZSET_LEVELS]; // Successor per level (0 = none)
+  unsigned int span[KV_ZSET_LEVELS]; // Nodes skipped by next[i]
+} kv_zset_node_t;
+
+/**
+ * Sorted set: skiplist ordered by (score, member) with a member index
+ *
+ * Changed under the semaphore (or by the single writer); readers walk it
+ * without locking and retry when seq changed meanwhile.
+ */
+typedef struct {
+  char name[KEY_SIZE];      // Set name ("" = free entry)
+  unsigned int hash;        // kv_hash_key(name)
+  _Atomic unsigned int seq; // Sequence counter (odd during a change)
+  unsigned int count;       // Members
+  unsigned int level;       // Levels in use (at least 1)
+  unsigned int tail;        // Last node (0 = empty set)
+  unsigned int free_head;   // Unused nodes, chained through next[0]
+  unsigned int random;      // Level generator state
+  unsigned int index[KV_ZSET_INDEX_SIZE]; // Node of each member, by member
+                                          // hash (linear probing, 0 = empty)
+  kv_zset_node_t nodes[KV_ZSET_CAPACITY + 1]; // nodes[0] is the head
+} kv_zset_t;
+
+/**
+ * Member of a sorted set with its score (see shared_memory_kv_zrange)
+ */
+typedef struct {
+  char member[KV_ZSET_MEMBER_SIZE];
+  double score;
+} kv_zset_item_t;
+
+/**
+ * Summary of a sorted set (see shared_memory_kv_zset_list)
+ */
+typedef struct {
+  char name[KEY_SIZE];
+  unsigned int count; // Members
+  kv_zset_item_t min; // Lowest member (empty if count is 0)
+  kv_zset_item_t max; // Highest member
+} kv_zset_info_t;
+
+/**
+ * Change log record in the segment
+ *
+ * Written by the writer (holding the semaphore, or the single writer);
+ * position is 0 while the record is rewritten, so lock-free readers can
+ * tell a record they copied was overwritten meanwhile.
+ */
+typedef struct {
+  _Atomic unsigned long long position; // Log position + 1 (0 = rewriting)
+  unsigned int op;                     // KV_CHANGE_*
+  unsigned int version;                // Store version of the change
+  long long timestamp;                 // Milliseconds since the Unix epoch
+  char key[KEY_SIZE];                  // Key changed
+} kv_changelog_record_t;
+
+/**
+ * Change of a table key (see shared_memory_kv_changelog_read)
+ *
+ * Only the key is logged: the value is whatever the table holds when the
+ * change is read, so replaying changes always converges on the current
+ * table even if a key changed again meanwhile.
+ */
+typedef struct {
+  unsigned long long position; // Log position (consecutive)
+  unsigned int op;             // KV_CHANGE_*
+  unsigned int version;        // Store version of the change
+  long long timestamp;         // Milliseconds since the Unix epoch
+  char key[KEY_SIZE];          // Key changed
+} kv_change_t;
+
+/**
+ * Replication state of a store
+ *
+ * Reported by the replicator of a replica store into the replica's own
+ * segment (see shared_memory_kv_replication_report), so every process
+ * attached to the replica can see how far behind it is.
+ */
+typedef struct {
+  unsigned int role; // KV_ROLE_*
+  int connected;     // 1 while the stream from the primary is up
+  int pid;           // Replicator process (0 = none)
+  char source[KV_REPLICATION_SOURCE_SIZE]; // Primary socket path or
+                                           // host:port
+  unsigned long long applied_position; // Primary log position applied up to
+                                       // (exclusive)
+  unsigned long long primary_position; // Primary log head last reported
+  long long lag_ms;       // Primary change to replica apply of the newest
+                          // applied change (0 once caught up)
+  long long last_contact; // Milliseconds since the epoch of the last message
+  unsigned long long applied_changes; // Sets and deletes applied
+  unsigned long long full_syncs;      // Table copies received (on connect,
+                                      // and after falling behind the log)
+  unsigned long long bytes_received;  // Stream bytes received
+} kv_replication_status_t;
+
+/**
+ * Subscription to changes of a few keys
+ *
+ * Claimed lock-free by shared_memory_kv_subscribe() and freed by
+ * shared_memory_kv_unsubscribe(), shared_memory_kv_destroy() or reaping.
+ * Every set or delete of a matching key increments events, which is also
+ * the futex word subscribers sleep on; writers issue the wake-up system
+ * call only while a subscriber is actually waiting, after releasing the
+ * write lock. A subscriber with a notification socket is sent one
+ * datagram per batch of events instead (whenever it has re-armed the
+ * socket).
+ */
+typedef struct {
+  _Atomic int pid;                 // Owning process (0 = free entry,
+                                   // -1 = being claimed or freed)
+  unsigned long long start_time;   // Owner start time (see registry)
+  unsigned int flags;              // KV_SUBSCRIBE_*
+  unsigned int pattern_count;      // Valid elements of patterns
+  char patterns[KV_SUBSCRIPTION_KEYS][KEY_SIZE]; // Keys or key prefixes
+  _Atomic unsigned int events;     // Matching changes so far (futex word)
+  _Atomic unsigned int waiters;    // Threads sleeping on events
+  _Atomic unsigned int last_version; // Store version of the last match
+  _Atomic unsigned int notify_socket; // Owner bound a notification socket
+  _Atomic unsigned int notify_armed;  // Next event sends it a datagram
+} kv_subscription_t;
+
 /**
  * Main shared memory structure
  *
  * Contains:
- * - KV pair table (fixed array)
+ * - KV pair table (fixed array, open addressing with linear probing:
+ *   a key lives at hash % MAX_ENTRIES or the next non-occupied slot after it)
  * - Semaphore for inter-process synchronization
  * - Data version for tracking changes
  * - Entry counter for table traversal optimization
+ * - Sorted key index for prefix search
+ * - Tombstone counter (deleted slots still part of probe sequences)
+ * - Incremental compaction progress
+ * - Arena holding key/value blobs, its free lists and the blob index
+ * - Preset dictionary and counters for value compression
+ * - Counting bloom filter consulted by lookups before locking
+ * - Sequence counter for lock-free consistent snapshots
+ * - Registry of attached processes and retire list for epoch-based
+ *   reclamation
+ * - Combining records for concurrent writers
+ * - Key subscriptions woken by matching writes
+ * - Time series rings
+ * - Rollups, work queues and sorted sets
+ * - Change log of table keys and replication state
  *
  * Important: the size of this structure must be known at compile time!
  */
@@ -70,8 +679,354 @@ typedef struct {
   sem_t sem; // Semaphore for synchronization (shared between processes)
   unsigned int version;     // Data version (incremented on every change)
   unsigned int entry_count; // Current number of non-empty entries in the table
+  unsigned long long generation; // Creation time in microseconds: tells a
+                                 // recreated store (whose version starts
+                                 // over) from the one it replaced
+  unsigned int key_index[MAX_ENTRIES]; // Slot indexes of occupied entries,
+                                       // sorted by key (first entry_count
+                                       // elements are valid)
+  unsigned int tombstone_count; // Number of slots in KV_SLOT_TOMBSTONE state
+
+  // Incremental compaction progress (see shared_memory_kv_compact_step)
+  unsigned int compact_cursor; // Next slot the compactor will examine
+  unsigned int compact_passes; // Completed full passes over the table
+  unsigned long long compact_moved;  // Entries moved into earlier tombstones
+  unsigned long long compact_purged; // Tombstones turned back into empty slots
+
+  unsigned int flags; // KV_FLAG_* chosen at create time
+  int writer_pid;     // The only writer with KV_FLAG_SINGLE_WRITER (creator)
+  uintptr_t writer_thread; // Its writing thread (see kv_thread_marker)
+  char shm_name[KV_SHM_NAME_SIZE]; // Name of the shared memory object
+  unsigned int shard_index; // Position in its sharded store
+  unsigned int shard_count; // Segments of its sharded store (0 = not a
+                            // shard)
+
+  // Arena allocator state
+  unsigned int arena_top; // Bump pointer: first never-allocated offset
+  unsigned int arena_free[KV_ARENA_CLASSES]; // Free list head per size class
+  unsigned int arena_allocated_bytes; // Bytes in live blocks
+  unsigned int arena_free_bytes;      // Bytes in free lists
+  unsigned int blob_count;            // Live blobs
+  unsigned int blob_buckets[KV_BLOB_BUCKETS]; // Interned blob hash chains
+  unsigned long long dedup_hits;  // Times an existing blob was reused
+  unsigned long long bytes_saved; // Payload bytes currently shared
+
+  // Value compression (see KV_FLAG_COMPRESS_VALUES)
+  unsigned int compress_dict_length; // Bytes of compress_dict in use
+  unsigned char compress_dict[KV_COMPRESS_DICT_SIZE]; // Preset dictionary
+  unsigned int compressed_values;     // Live compressed value blobs
+  unsigned long long compressed_bytes;   // Stored size of those blobs
+  unsigned long long uncompressed_bytes; // Their size before compression
+
+  // Counting bloom filter over the stored keys. Written only by the writer
+  // (holding the semaphore), read without it, hence atomic
+  _Atomic unsigned char bloom[KV_BLOOM_COUNTERS];
+  _Atomic unsigned long long bloom_rejects; // Misses answered lock-free
+  _Atomic unsigned long long bloom_false_positives; // Misses the filter let
+                                                    // through
+
+  // Sequence lock: odd while a writer (holding the semaphore, or the single
+  // writer) is modifying the table or arena. Snapshot readers copy without
+  // locking and retry if it was odd or changed meanwhile
+  _Atomic unsigned int seq;
+
+  // Epoch-based reclamation of version records and key blobs. Readers
+  // write only their own registry entry (reapers free dead ones with a
+  // compare-and-swap); everything else is written by the writer
+  _Atomic unsigned long long epoch;             // Global epoch (starts at 1)
+  kv_registry_entry_t registry[KV_REGISTRY_SIZE]; // Attached threads
+  kv_registry_entry_t shared_readers[KV_SHARED_READERS]; // Readers without
+                                                         // an entry
+  kv_process_entry_t processes[KV_PROCESS_MAX];   // Attached processes
+  _Atomic unsigned long long reaped; // Registry entries of dead processes
+                                     // freed
+  _Atomic long long last_reap;       // time() of the last registry check
+  kv_retired_t retired[KV_RETIRED_MAX];      // Retire list
+  unsigned int retired_count;                // Valid elements of retired
+  unsigned int version_records;              // Live version records
+  unsigned long long reclaimed;              // Objects freed from the list
+  unsigned long long retire_overflows; // Objects leaked because the list
+                                       // was full
+
+  // Flat combining of writes, request slots shared by all writers
+  kv_combine_record_t combine[KV_COMBINE_SLOTS];
+  _Atomic unsigned int combine_pending; // Requests published, not applied
+  unsigned long long combined_writes;   // Requests applied by a combiner
+  unsigned long long combine_batches;   // Passes that applied any
+
+  // Key subscriptions, claimed and freed lock-free, matched by writers
+  kv_subscription_t subscriptions[KV_SUBSCRIPTIONS];
+  _Atomic unsigned int subscription_count; // Claimed entries (writers skip
+                                           // matching while 0)
+  _Atomic unsigned long long notifications; // Events signalled to
+                                            // subscriptions
+
+  // Time series, written by the writer, read lock-free
+  kv_series_t series[KV_SERIES_MAX];
+
+  // Rollups, updated by writes of their keys, read lock-free
+  kv_rollup_t rollups[KV_ROLLUP_MAX];
+  _Atomic unsigned int rollup_count; // Entries in use (writers skip the
+                                     // lookup while 0)
+
+  // Queues, created and deleted by the writer, pushed and popped lock-free
+  kv_queue_t queues[KV_QUEUE_MAX];
+
+  // Sorted sets, changed by the writer, read lock-free
+  kv_zset_t zsets[KV_ZSET_MAX];
+
+  // Change log of table keys, appended by the writer, read lock-free
+  kv_changelog_record_t changelog[KV_CHANGELOG_SIZE];
+  _Atomic unsigned long long changelog_head; // Next log position
+  _Atomic unsigned int changelog_events;  // Futex word, bumped per append
+  _Atomic unsigned int changelog_waiters; // Readers sleeping on it
+
+  // Replication state, written by the replicator, read lock-free
+  _Atomic unsigned int replication_seq; // Sequence counter (odd while
+                                        // being written)
+  kv_replication_status_t replication;
+
+  _Alignas(8) unsigned char arena[ARENA_SIZE]; // Blob storage
 } shared_memory_kv_store_t;
 
+/**
+ * Arena and deduplication statistics
+ *
+ * Filled by shared_memory_kv_memory_stats().
+ */
+typedef struct {
+  unsigned int flags;             // KV_FLAG_* of the store
+  unsigned int arena_size;        // ARENA_SIZE
+  unsigned int arena_top;         // High-water mark of the bump allocator
+  unsigned int allocated_bytes;   // Bytes in live blocks (headers included)
+  unsigned int free_bytes;        // Bytes in free lists, reusable
+  unsigned int blob_count;        // Live blobs (values, key parts)
+  unsigned int shared_blob_count; // Interned blobs referenced more than once
+  unsigned long long dedup_hits;  // Times an existing blob was reused
+  unsigned long long bytes_saved; // Payload bytes not stored thanks to sharing
+  unsigned int compress_dict_length;     // Preset dictionary size (0 = none)
+  unsigned int compressed_values;        // Values stored compressed
+  unsigned long long compressed_bytes;   // Their stored size
+  unsigned long long uncompressed_bytes; // Their original size
+  unsigned long long epoch;          // Global reclamation epoch
+  unsigned int registry_entries;     // Claimed registry entries
+  unsigned int attached_processes;   // Distinct processes among them
+  unsigned int active_readers;       // Readers inside a read right now
+  unsigned long long reaped_entries; // Entries of dead processes freed
+  unsigned int version_records;      // Live version records
+  unsigned int retired_pending;      // Objects waiting in the retire list
+  unsigned long long reclaimed;      // Objects freed after their epoch
+  unsigned long long retire_overflows; // Objects leaked (list stayed full)
+  int writer_pid; // The single writer (KV_FLAG_SINGLE_WRITER), else 0
+  unsigned long long combined_writes; // Writes applied for another writer
+  unsigned long long combine_batches; // Combining passes that applied any
+  unsigned int subscriptions;         // Active key subscriptions
+  unsigned long long notifications;   // Events signalled to subscriptions
+} kv_memory_stats_t;
+
+/**
+ * Occupancy and probe-length statistics
+ *
+ * Filled by shared_memory_kv_occupancy_stats(). The probe length of an entry
+ * is the number of slots a lookup inspects to find it (1 = at its home
+ * slot). The table is split into region_count contiguous regions of
+ * region_size slots (the last one may be shorter) for a heatmap.
+ */
+typedef struct {
+  unsigned int capacity;        // MAX_ENTRIES
+  unsigned int entry_count;     // Occupied slots
+  unsigned int tombstone_count; // Tombstone slots
+  double load_factor;           // entry_count / capacity
+  double avg_probe_length;      // Mean probe length over occupied slots
+  unsigned int max_probe_length; // Longest probe length
+  // probe_histogram[i] = entries with probe length i + 1 (last bucket also
+  // counts everything longer)
+  unsigned int probe_histogram[KV_PROBE_HISTOGRAM_BUCKETS];
+  unsigned int region_count; // Number of valid elements in region arrays
+  unsigned int region_size;  // Slots per region
+  unsigned int region_occupied[KV_OCCUPANCY_REGIONS];   // Occupied per region
+  unsigned int region_tombstones[KV_OCCUPANCY_REGIONS]; // Tombstones per region
+  unsigned int compact_cursor;       // Compaction progress, see store fields
+  unsigned int compact_passes;
+  unsigned long long compact_moved;
+  unsigned long long compact_purged;
+  unsigned long long bloom_rejects;         // Gets answered by the filter
+  unsigned long long bloom_false_positives; // Gets that passed it and missed
+  unsigned int bloom_counters_set;          // Non-zero filter counters
+} kv_occupancy_stats_t;
+
+/**
+ * Single key search result
+ *
+ * Filled by shared_memory_kv_search(). Contains a copy of the key and value
+ * so the caller does not need a second lookup.
+ */
+typedef struct {
+  char key[KEY_SIZE];     // Matched key
+  char value[VALUE_SIZE]; // Value at the time of the search
+  unsigned int slot;      // Slot index in kv_table
+  int match;              // KV_MATCH_PREFIX, KV_MATCH_SUBSTRING or
+                          // KV_MATCH_FUZZY
+} kv_search_result_t;
+
+/**
+ * Key requested from a snapshot read
+ *
+ * Filled by shared_memory_kv_snapshot_get().
+ */
+typedef struct {
+  char key[KEY_SIZE];     // In: key to read
+  char value[VALUE_SIZE]; // Out: value ('\0' if not found)
+  int found;              // Out: 1 if the key existed in the snapshot
+} kv_snapshot_item_t;
+
+/**
+ * Value with its type
+ *
+ * Filled by shared_memory_kv_get_value(). Numbers are returned natively,
+ * without formatting or parsing.
+ */
+typedef struct {
+  unsigned int type;     // KV_TYPE_*
+  unsigned int length;   // Bytes in data (0 for numbers)
+  long long int64;       // KV_TYPE_INT64 value
+  double number;         // KV_TYPE_DOUBLE value (KV_TYPE_INT64 converted)
+  char data[VALUE_SIZE]; // KV_TYPE_STRING ('\0'-terminated), KV_TYPE_BYTES
+                         // or KV_TYPE_HASH (see shared_memory_kv_hash_next)
+} kv_value_t;
+
+/**
+ * Entry of a whole-table snapshot
+ *
+ * Filled by shared_memory_kv_snapshot_table().
+ */
+typedef struct {
+  char key[KEY_SIZE];        // Key
+  char value[VALUE_SIZE];    // Value (numbers formatted as text, hashes
+                             // as "field=value" lines)
+  unsigned int slot;         // Slot index in kv_table
+  unsigned int slot_version; // Store version of the slot's last change
+  time_t timestamp;          // Last update time
+  unsigned int type;         // KV_TYPE_* of the value
+  long long int64;           // Native value, as in kv_value_t
+  double number;
+} kv_entry_t;
+
+/**
+ * Attached process, aggregated over its registry entries
+ *
+ * Filled by shared_memory_kv_processes().
+ */
+typedef struct {
+  int pid;                       // Process ID
+  unsigned long long start_time; // Start time (clock ticks after boot)
+  time_t heartbeat;              // Latest heartbeat of its threads
+  unsigned long long epoch;      // Oldest epoch announced by its threads
+                                 // (0 = not reading)
+  unsigned int threads;          // Registry entries it holds
+  int alive;                     // 0 if it exited without detaching
+} kv_process_info_t;
+
+/**
+ * One version of an entry
+ *
+ * Filled by shared_memory_kv_history(), newest first.
+ */
+typedef struct {
+  char value[VALUE_SIZE]; // Value of this version
+  unsigned int version;   // Store version that wrote it
+  time_t timestamp;       // When it was written
+} kv_version_info_t;
+
+/**
+ * Key read by a transaction, with the slot version it was read at
+ */
+typedef struct {
+  char key[KEY_SIZE];        // Key that was read
+  int found;                 // 1 if the key existed when read
+  unsigned int slot;         // Slot it was found in (found only)
+  unsigned int slot_version; // slot_version at the time of the read
+} kv_txn_read_t;
+
+/**
+ * Write buffered by a transaction until commit
+ */
+typedef struct {
+  char key[KEY_SIZE];     // Key to write
+  char value[VALUE_SIZE]; // New value (unused for deletes)
+  int is_delete;          // 1 to delete the key instead
+  unsigned int type;      // KV_TYPE_* of value
+  unsigned int length;    // Bytes in value
+} kv_txn_write_t;
+
+/**
+ * Optimistic multi-key transaction
+ *
+ * Allocated by the caller (it is large: keep it static or on the heap) and
+ * private to one process. No lock is held between begin and commit: reads
+ * take the semaphore briefly and remember slot versions, writes are only
+ * buffered. Commit takes the semaphore once, checks that nothing read has
+ * changed, and applies all writes before releasing it, so other processes
+ * see either none or all of them.
+ */
+typedef struct {
+  shared_memory_kv_store_t *store; // Store the transaction runs against
+  int active;                      // 1 between begin and commit/abort
+  unsigned int read_count;         // Valid elements of reads
+  unsigned int write_count;        // Valid elements of writes
+  kv_txn_read_t reads[KV_TXN_MAX_OPS];
+  kv_txn_write_t writes[KV_TXN_MAX_OPS];
+} shared_memory_kv_txn_t;
+
+/**
+ * Operation of a sharded batch (see shared_memory_kv_sharded_mset)
+ */
+typedef struct {
+  char key[KEY_SIZE];     // Key to read or write
+  char value[VALUE_SIZE]; // Value to set, or the value read
+  int is_delete;          // Writes: 1 to delete the key instead
+  int error;              // Set by the call: 0 or errno of this operation
+  unsigned int shard;     // Set by the call: shard the key belongs to
+} kv_shard_op_t;
+
+typedef struct shared_memory_kv_sharded shared_memory_kv_sharded_t;
+
+/**
+ * Batch worker of a sharded store: runs the part of one shard
+ */
+typedef struct {
+  shared_memory_kv_sharded_t *router; // Router the worker belongs to
+  unsigned int shard;                 // Shard whose operations it runs
+  unsigned int seen;                  // Last batch it started
+  pthread_t thread;
+} kv_shard_worker_t;
+
+/**
+ * Client-side router of a sharded store
+ *
+ * Private to one process and allocated by the caller; it must stay where
+ * it is between open and destroy (its workers point to it). Single-key
+ * calls may come from any number of threads; batches run one at a time.
+ */
+struct shared_memory_kv_sharded {
+  char name[KV_SHM_NAME_SIZE]; // Base name of the shards' objects
+  unsigned int count;          // Shards
+  int fds[KV_SHARD_MAX];
+  shared_memory_kv_store_t *shards[KV_SHARD_MAX];
+
+  // Parallel batches: shard 0's part runs on the calling thread, every
+  // other shard's on its worker (started by the first parallel batch)
+  pthread_mutex_t batch_lock;          // Held while a batch runs
+  kv_shard_worker_t workers[KV_SHARD_MAX];
+  unsigned int worker_count;           // Started workers (index 1 up)
+  _Atomic unsigned int batch_seq;      // Futex word, bumped per batch
+  _Atomic unsigned int batch_pending;  // Futex word, workers still running
+  _Atomic int stopping;                // Set to let the workers exit
+  kv_shard_op_t *batch_ops;            // Batch being run
+  size_t batch_count;
+  int batch_write;                     // 1 for writes, 0 for reads
+};
+
 // ============================================================================
 // FUNCTIONS FOR SHARED MEMORY KV STORE
 // ============================================================================
@@ -87,6 +1042,34 @@ typedef struct {
 shared_memory_kv_store_t *
 shared_memory_kv_create(int *shared_memory_file_descriptor_out);
 
+/**
+ * Creates a new shared memory object for the KV store with options
+ *
+ * Same as shared_memory_kv_create(), with storage options:
+ * - KV_FLAG_DEDUP_VALUES: identical values are stored once in the arena and
+ *   reference counted (good for repeated status strings and flags)
+ * - KV_FLAG_PREFIX_KEYS: the part of a key up to its last delimiter
+ *   (KV_KEY_DELIMITERS) is interned and shared between keys
+ * - KV_FLAG_COMPRESS_VALUES: values of at least KV_COMPRESS_THRESHOLD bytes
+ *   are LZ-compressed in the arena; gets decompress transparently
+ * - KV_FLAG_SINGLE_WRITER: the calling thread is the only writer. Sets,
+ *   deletes, transaction commits, compaction and set_dictionary skip the
+ *   semaphore (they fail with EPERM in other processes and in the other
+ *   threads of this one); writes publish with release stores and bump the
+ *   store and slot sequence counters, and reads that need a stable table
+ *   validate those counters instead of locking, so no reader ever waits
+ *   for a lock
+ *
+ * @param shared_memory_file_descriptor_out Pointer to return the shared memory
+ * file descriptor
+ * @param flags Bitwise OR of KV_FLAG_* (0 = no sharing)
+ * @return Pointer to shared_memory_kv_store_t structure in shared memory, or
+ * NULL on error
+ */
+shared_memory_kv_store_t *
+shared_memory_kv_create_ex(int *shared_memory_file_descriptor_out,
+                           unsigned int flags);
+
 /**
  * Opens an existing shared memory object for the KV store
  *
@@ -101,6 +1084,9 @@ shared_memory_kv_open(int *shared_memory_file_descriptor_out);
 /**
  * Destroys the shared memory object and releases resources
  *
+ * Frees the registry entries and subscriptions of the calling process
+ * (detaches it), then unmaps the store.
+ *
  * @param shared_memory_file_descriptor Shared memory file descriptor
  * @param store Pointer to the structure in shared memory (for munmap)
  */
@@ -121,40 +1107,1254 @@ void shared_memory_kv_destroy(int shared_memory_file_descriptor,
 int shared_memory_kv_unlink(void);
 
 /**
- * Sets (adds or updates) a key-value pair in the store
- * 
+ * Unlinks the shared memory object unless other processes are attached
+ *
+ * Reaps registry entries of dead processes first, so a crashed consumer
+ * does not keep the object alive. A process counts as attached from its
+ * first shared_memory_kv_create/open until its last
+ * shared_memory_kv_destroy(), or while one of its threads holds a registry
+ * entry. Call before shared_memory_kv_destroy().
+ *
  * @param store Pointer to shared memory KV store
- * @param key Key string (max KEY_SIZE-1 characters)
- * @param value Value string (max VALUE_SIZE-1 characters)
- * @return 0 on success, -1 on error (errno set: EINVAL for invalid params, 
- *         ENOSPC if table is full, ENAMETOOLONG if key/value too long)
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params,
+ *         EBUSY if another live process is attached)
  */
-int shared_memory_kv_set(shared_memory_kv_store_t *store, const char *key,
-                         const char *value);
+int shared_memory_kv_unlink_safe(shared_memory_kv_store_t *store);
 
 /**
- * Gets a value from the store
- * 
- * @param store Pointer to shared memory KV store
- * @param key Key string (max KEY_SIZE-1 characters)
- * @param value_out Pointer to return the value (max VALUE_SIZE-1 characters)
- * @return 0 on success, -1 on error (errno set: EINVAL for invalid params, 
- *         ENOSPC if table is full, ENAMETOOLONG if key/value too long)
+ * Creates a new shared memory object for the KV store under a given name
+ *
+ * Same as shared_memory_kv_create_ex() for a store other than SHM_NAME
+ * (a replica, or a second store on the same host).
+ *
+ * @param name Object name: "/" and at most KV_SHM_NAME_SIZE-2 characters,
+ *        no further "/"
+ * @param shared_memory_file_descriptor_out Pointer to return the shared memory
+ * file descriptor
+ * @param flags Bitwise OR of KV_FLAG_* (0 = no sharing)
+ * @return Pointer to shared_memory_kv_store_t structure in shared memory, or
+ * NULL on error (errno set: EINVAL for an invalid name, ENAMETOOLONG if it
+ * is too long, EEXIST if the object exists)
  */
-int shared_memory_kv_get(shared_memory_kv_store_t *store, const char *key,
-                     char *value_out);
-                        
+shared_memory_kv_store_t *
+shared_memory_kv_create_named(const char *name,
+                              int *shared_memory_file_descriptor_out,
+                              unsigned int flags);
+
 /**
- * Deletes a key-value pair from the store
- * 
+ * Opens an existing shared memory object for the KV store by name
+ *
+ * @param name Object name (see shared_memory_kv_create_named)
+ * @param shared_memory_file_descriptor_out Pointer to return the shared memory
+ * file descriptor
+ * @return Pointer to shared_memory_kv_store_t structure in shared memory, or
+ * NULL on error (errno set: EAGAIN if KV_PROCESS_MAX live processes are
+ * attached already)
+ */
+shared_memory_kv_store_t *
+shared_memory_kv_open_named(const char *name,
+                            int *shared_memory_file_descriptor_out);
+
+/**
+ * Unlinks the shared memory object of a given name
+ *
+ * @param name Object name (see shared_memory_kv_create_named)
+ * @return 0 on success (or if there is no such object), -1 on error
+ */
+int shared_memory_kv_unlink_named(const char *name);
+
+/**
+ * Records that the calling thread is alive
+ *
+ * Updates the heartbeat of the thread's registry entry (claiming one if
+ * needed). Meant for the idle loops of long-running processes; liveness
+ * itself is decided from the pid and start time, the heartbeat shows when
+ * a process was last active.
+ *
+ * @param store Pointer to shared memory KV store
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params,
+ *         EAGAIN if the registry is full)
+ */
+int shared_memory_kv_heartbeat(shared_memory_kv_store_t *store);
+
+/**
+ * Frees the registry entries of processes that no longer exist
+ *
+ * A process that crashed in the middle of a read would otherwise pin its
+ * epoch forever and stop all reclamation. Their subscriptions are freed
+ * as well. Lock-free: an entry is claimed
+ * for freeing with a compare-and-swap, so concurrent reapers (and a thread
+ * claiming the freed entry) never clash.
+ *
+ * @param store Pointer to shared memory KV store
+ * @return Number of entries freed, or -1 on error (errno set: EINVAL for
+ *         invalid params)
+ */
+int shared_memory_kv_reap(shared_memory_kv_store_t *store);
+
+/**
+ * Lists the processes attached to the store
+ *
+ * @param store Pointer to shared memory KV store
+ * @param processes_out Array of at least max_processes elements
+ * @param max_processes Maximum number of processes to return
+ * @return Number of processes written, or -1 on error (errno set: EINVAL
+ *         for invalid params)
+ */
+int shared_memory_kv_processes(shared_memory_kv_store_t *store,
+                               kv_process_info_t *processes_out,
+                               size_t max_processes);
+
+/**
+ * Subscribes to changes of specific keys
+ *
+ * Every later set or delete of a matching key (also by transactions)
+ * counts as an event of the subscription and wakes threads sleeping in
+ * shared_memory_kv_wait() on it; changes of other keys wake nobody. The
+ * subscription belongs to the calling process.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param patterns Keys to watch, or key prefixes with KV_SUBSCRIBE_PREFIX
+ *        (an empty prefix matches every key)
+ * @param pattern_count Number of patterns (1..KV_SUBSCRIPTION_KEYS)
+ * @param flags KV_SUBSCRIBE_* (0 = whole keys)
+ * @return Subscription id (>= 0), or -1 on error (errno set: EINVAL for
+ *         invalid params, ENAMETOOLONG if a pattern is too long, ENOSPC if
+ *         all KV_SUBSCRIPTIONS entries are taken by live processes)
+ */
+int shared_memory_kv_subscribe(shared_memory_kv_store_t *store,
+                               const char *const *patterns,
+                               size_t pattern_count, unsigned int flags);
+
+/**
+ * Waits for events of a subscription
+ *
+ * Returns as soon as the subscription's event counter differs from
+ * *events_inout (0 right after subscribing) and stores the new counter
+ * there; changes between two calls are therefore never missed, and several
+ * changes may be reported by one return. Sleeps on a futex in the segment,
+ * so no CPU is used while waiting.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param subscription Id returned by shared_memory_kv_subscribe()
+ * @param events_inout Event counter last seen (in), current counter (out)
+ * @param timeout_ms Maximum wait in milliseconds (-1 = no limit, 0 = check
+ *        only)
+ * @return 0 if events arrived, -1 on error (errno set: EINVAL for invalid
+ *         params or a subscription of another process, ETIMEDOUT if none
+ *         arrived in time, EINTR if a signal interrupted the wait)
+ */
+int shared_memory_kv_wait(shared_memory_kv_store_t *store, int subscription,
+                          unsigned int *events_inout, int timeout_ms);
+
+/**
+ * Cancels a subscription of the calling process
+ *
+ * @param store Pointer to shared memory KV store
+ * @param subscription Id returned by shared_memory_kv_subscribe()
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params
+ *         or a subscription of another process)
+ */
+int shared_memory_kv_unsubscribe(shared_memory_kv_store_t *store,
+                                 int subscription);
+
+/**
+ * Returns a pollable file descriptor signalling events of a subscription
+ *
+ * For event loops that cannot block in shared_memory_kv_wait(): the
+ * descriptor (a non-blocking unix datagram socket bound to the name
+ * KV_NOTIFY_SOCKET_FORMAT) becomes readable when events arrive; then call
+ * shared_memory_kv_notify_read(). Writers send at most one datagram per
+ * read, so a burst of changes costs one wake-up. Subscribe with
+ * KV_SUBSCRIBE_PREFIX and the empty prefix to be notified of every change
+ * of the store version. The caller closes the descriptor, after
+ * unsubscribing.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param subscription Id returned by shared_memory_kv_subscribe()
+ * @return File descriptor, or -1 on error (errno set: EINVAL for invalid
+ *         params or a subscription of another process, EEXIST if the
+ *         subscription already has one, or a socket() / bind() error)
+ */
+int shared_memory_kv_notify_fd(shared_memory_kv_store_t *store,
+                               int subscription);
+
+/**
+ * Consumes the notifications of a subscription's notification socket
+ *
+ * Drains the descriptor, re-arms it for the next event and reports the
+ * event counter like shared_memory_kv_wait() with a zero timeout.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param subscription Id returned by shared_memory_kv_subscribe()
+ * @param fd Descriptor returned by shared_memory_kv_notify_fd()
+ * @param events_inout Event counter last seen (in), current counter (out)
+ * @return 0 if events arrived, -1 on error (errno set: EINVAL for invalid
+ *         params, EAGAIN if nothing changed since *events_inout)
+ */
+int shared_memory_kv_notify_read(shared_memory_kv_store_t *store,
+                                 int subscription, int fd,
+                                 unsigned int *events_inout);
+
+/**
+ * Sets (adds or updates) a key-value pair in the store
+ * 
+ * When another writer holds the semaphore, the write is published for it to
+ * apply (flat combining) and the call returns once it has been applied.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value Value string (max VALUE_SIZE-1 characters)
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params, 
+ *         ENOSPC if table or arena is full, ENAMETOOLONG if key/value too
+ *         long, EPERM if another process is the single writer, EAGAIN if
+ *         the retire list is full, see KV_RETIRED_MAX)
+ */
+int shared_memory_kv_set(shared_memory_kv_store_t *store, const char *key,
+                         const char *value);
+
+/**
+ * Sets a key to a native 64-bit integer (KV_TYPE_INT64)
+ *
+ * Stored as 8 bytes, read back by shared_memory_kv_get_int64() without
+ * parsing; shared_memory_kv_get() formats it as decimal text.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value Value
+ * @return 0 on success, -1 on error (errno set as by shared_memory_kv_set)
+ */
+int shared_memory_kv_set_int64(shared_memory_kv_store_t *store,
+                               const char *key, long long value);
+
+/**
+ * Sets a key to a native double (KV_TYPE_DOUBLE)
+ *
+ * Stored as 8 bytes; shared_memory_kv_get() formats it with the fewest
+ * digits that read back as the same double.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value Value
+ * @return 0 on success, -1 on error (errno set as by shared_memory_kv_set)
+ */
+int shared_memory_kv_set_double(shared_memory_kv_store_t *store,
+                                const char *key, double value);
+
+/**
+ * Sets a key to opaque bytes (KV_TYPE_BYTES)
+ *
+ * The bytes may contain '\0'; shared_memory_kv_get() returns them up to
+ * the first one, shared_memory_kv_get_bytes() returns all of them.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param data Value bytes
+ * @param length Number of bytes (max VALUE_SIZE-1)
+ * @return 0 on success, -1 on error (errno set as by shared_memory_kv_set)
+ */
+int shared_memory_kv_set_bytes(shared_memory_kv_store_t *store,
+                               const char *key, const void *data,
+                               size_t length);
+
+/**
+ * Sets a key to a value of any type
+ *
+ * Writes a value as returned by shared_memory_kv_get_value(), so a value
+ * copied between stores keeps its type (hashes included).
+ *
  * @param store Pointer to shared memory KV store
  * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value Value: type, and int64, number or data/length by type
+ * @return 0 on success, -1 on error (errno set as by shared_memory_kv_set;
+ *         EINVAL for an unknown type)
+ */
+int shared_memory_kv_set_value(shared_memory_kv_store_t *store,
+                               const char *key, const kv_value_t *value);
+
+/**
+ * Gets a value from the store
+ *
+ * Never takes the semaphore. Misses are usually answered by the bloom
+ * filter; other lookups announce an epoch in the registry, probe the
+ * table and copy the value from the entry's newest version record. Writers
+ * publish a new record instead of changing the old one and free replaced
+ * records only after every reader that could still see them has finished,
+ * so a hit needs no validation. A miss is checked against the sequence lock
+ * and retried if a write (e.g. a compaction move) ran meanwhile. Only if
+ * all KV_REGISTRY_SIZE registry entries are taken does the lookup announce
+ * its epoch in one of the KV_SHARED_READERS entries shared by such readers.
+ * 
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value_out Pointer to return the value (max VALUE_SIZE-1 characters)
  * @return 0 on success, -1 on error (errno set: EINVAL for invalid params, 
  *         ENOSPC if table is full, ENAMETOOLONG if key/value too long)
  */
+int shared_memory_kv_get(shared_memory_kv_store_t *store, const char *key,
+                     char *value_out);
+
+/**
+ * Gets a value from the store with its type
+ *
+ * Lock-free like shared_memory_kv_get(), but numbers are returned natively
+ * in value_out->int64 / value_out->number instead of as text.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value_out Pointer to return the value
+ * @return 0 on success, -1 on error (errno set as by shared_memory_kv_get)
+ */
+int shared_memory_kv_get_value(shared_memory_kv_store_t *store,
+                               const char *key, kv_value_t *value_out);
+
+/**
+ * Gets a value from the store as a 64-bit integer
+ *
+ * Native integers need no conversion; doubles holding an integer are
+ * converted; text values (written by shared_memory_kv_set) are parsed.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value_out Pointer to return the value
+ * @return 0 on success, -1 on error (errno set as by shared_memory_kv_get,
+ *         or EINVAL if the value is not an integer)
+ */
+int shared_memory_kv_get_int64(shared_memory_kv_store_t *store,
+                               const char *key, long long *value_out);
+
+/**
+ * Gets a value from the store as a double
+ *
+ * Native numbers need no parsing (integers are converted); text values
+ * (written by shared_memory_kv_set) are parsed.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value_out Pointer to return the value
+ * @return 0 on success, -1 on error (errno set as by shared_memory_kv_get,
+ *         or EINVAL if the value is not a number)
+ */
+int shared_memory_kv_get_double(shared_memory_kv_store_t *store,
+                                const char *key, double *value_out);
+
+/**
+ * Gets the bytes of a value (KV_TYPE_BYTES or KV_TYPE_STRING)
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param data_out Buffer for the bytes
+ * @param capacity Size of data_out in bytes
+ * @return Number of bytes, or -1 on error (errno set as by
+ *         shared_memory_kv_get, or EINVAL if the value is a number, ERANGE
+ *         if it does not fit into capacity bytes)
+ */
+int shared_memory_kv_get_bytes(shared_memory_kv_store_t *store,
+                               const char *key, void *data_out,
+                               size_t capacity);
+                        
+/**
+ * Deletes a key-value pair from the store
+ * 
+ * Combined with concurrent writers like shared_memory_kv_set().
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params, 
+ *         ENOSPC if table is full, ENAMETOOLONG if key/value too long,
+ *         EPERM if another process is the single writer, EAGAIN if the
+ *         retire list is full, see KV_RETIRED_MAX)
+ */
 int shared_memory_kv_delete(shared_memory_kv_store_t *store, const char *key);
 
+/**
+ * Sets a field of a hash entry (KV_TYPE_HASH)
+ *
+ * A hash keeps a whole object (e.g. the metrics of one host) in one entry:
+ * one slot, one key copy and one lookup instead of one key per field. The
+ * field map is read, modified and written back under the semaphore, so
+ * concurrent hset/hdel of one key never lose updates; the entry is created
+ * if the key does not exist. Combined with concurrent writers like
+ * shared_memory_kv_set().
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param field Field name (max KV_HASH_FIELD_SIZE-1 characters)
+ * @param value Field value string
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params
+ *         or if the key holds a value that is not a hash, ENAMETOOLONG if
+ *         the key or field is too long or the map would not fit in
+ *         VALUE_SIZE-1 bytes, ENOSPC if the table or arena is full, EPERM
+ *         if another process is the single writer)
+ */
+int shared_memory_kv_hset(shared_memory_kv_store_t *store, const char *key,
+                          const char *field, const char *value);
+
+/**
+ * Gets a field of a hash entry
+ *
+ * Lock-free like shared_memory_kv_get().
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param field Field name
+ * @param value_out Buffer of VALUE_SIZE bytes for the field value
+ * @return 0 on success, -1 on error (errno set as by shared_memory_kv_get,
+ *         ENOENT also if the field does not exist, EINVAL if the key holds
+ *         a value that is not a hash)
+ */
+int shared_memory_kv_hget(shared_memory_kv_store_t *store, const char *key,
+                          const char *field, char *value_out);
 
+/**
+ * Deletes a field of a hash entry
+ *
+ * Deleting the last field deletes the key.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param field Field name
+ * @return 0 on success, -1 on error (errno set as by shared_memory_kv_hset,
+ *         ENOENT if the key or field does not exist)
+ */
+int shared_memory_kv_hdel(shared_memory_kv_store_t *store, const char *key,
+                          const char *field);
 
+/**
+ * Gets all fields of a hash entry with one lookup
+ *
+ * Lock-free like shared_memory_kv_get(). value_out receives the encoded
+ * field map; walk it with shared_memory_kv_hash_next().
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value_out Pointer to return the hash
+ * @return Number of fields, or -1 on error (errno set as by
+ *         shared_memory_kv_hget)
+ */
+int shared_memory_kv_hgetall(shared_memory_kv_store_t *store,
+                             const char *key, kv_value_t *value_out);
+
+/**
+ * Steps through the fields of a hash read by shared_memory_kv_hgetall()
+ * or shared_memory_kv_get_value()
+ *
+ * @param hash Value of type KV_TYPE_HASH
+ * @param offset_inout Position in the map; 0 for the first field
+ * @param field_out Pointer to return the field name (points into hash)
+ * @param value_out Pointer to return the field value (points into hash)
+ * @return 1 if a field was returned, 0 at the end of the map
+ */
+int shared_memory_kv_hash_next(const kv_value_t *hash, size_t *offset_inout,
+                               const char **field_out,
+                               const char **value_out);
+
+/**
+ * Runs one bounded step of tombstone compaction
+ *
+ * Examines up to max_slots slots starting at the compaction cursor, under
+ * the semaphore, then releases it. Meant to be called periodically (e.g.
+ * from an idle loop) so tombstones are purged in small steps interleaved
+ * with normal operations instead of a stop-the-world rehash. For each slot:
+ * - an entry is moved back into the first tombstone on its own probe
+ *   sequence (shortening its probe length; its old slot becomes a tombstone)
+ * - a tombstone that no entry's probe sequence passes through is no longer
+ *   needed by lookups, so it becomes empty again (only the entries up to
+ *   the next empty slot need to be checked)
+ *
+ * Moves bump the store version and the slot_version of both slots.
+ * Returns immediately without locking when there are no tombstones.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param max_slots Maximum number of slots to examine in this step
+ *        (including slots scanned to check a tombstone)
+ * @return Number of slots changed (moved + purged), or -1 on error (errno
+ *         set: EINVAL for invalid params, EPERM if another process is the
+ *         single writer)
+ */
+int shared_memory_kv_compact_step(shared_memory_kv_store_t *store,
+                                  unsigned int max_slots);
+
+/**
+ * Computes occupancy and probe-length statistics of the hash table
+ *
+ * One pass over the table under the semaphore (an optimistic pass with
+ * KV_FLAG_SINGLE_WRITER, see shared_memory_kv_snapshot_get). Use it to
+ * decide when the table needs a larger MAX_ENTRIES or a rehash to purge
+ * tombstones.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param stats_out Pointer to return the statistics
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params)
+ */
+int shared_memory_kv_occupancy_stats(shared_memory_kv_store_t *store,
+                                     kv_occupancy_stats_t *stats_out);
+
+/**
+ * Reads the key and value stored in a table slot
+ *
+ * Used to walk the table (e.g. for status listings) now that keys and
+ * values live in the arena instead of inline in kv_pair_t. Lock-free: the
+ * copy is made inside an epoch and redone if the slot's sequence counter
+ * shows that the slot changed meanwhile.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param slot Slot index (0..MAX_ENTRIES-1)
+ * @param key_out Buffer of at least KEY_SIZE bytes
+ * @param value_out Buffer of at least VALUE_SIZE bytes
+ * @param timestamp_out Optional pointer to return the update timestamp
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params,
+ *         ENOENT if the slot is not occupied)
+ */
+int shared_memory_kv_read_slot(shared_memory_kv_store_t *store,
+                               unsigned int slot, char *key_out,
+                               char *value_out, time_t *timestamp_out);
+
+/**
+ * Sets the preset dictionary used for value compression
+ *
+ * Matches may reference the dictionary as if it preceded every value, so
+ * samples of typical values (e.g. a representative JSON document with the
+ * usual field names) make even small values compress well. The dictionary
+ * can only be changed while no compressed values are stored, because they
+ * are decoded against it.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param dictionary Dictionary bytes (NULL with length 0 clears it)
+ * @param length Dictionary size (max KV_COMPRESS_DICT_SIZE bytes)
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params,
+ *         E2BIG if the dictionary is too large, EPERM if another process
+ *         is the single writer, EBUSY if compressed values
+ *         exist)
+ */
+int shared_memory_kv_set_dictionary(shared_memory_kv_store_t *store,
+                                    const void *dictionary, size_t length);
+
+/**
+ * Computes arena usage and deduplication statistics
+ *
+ * @param store Pointer to shared memory KV store
+ * @param stats_out Pointer to return the statistics
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params)
+ */
+int shared_memory_kv_memory_stats(shared_memory_kv_store_t *store,
+                                  kv_memory_stats_t *stats_out);
+
+/**
+ * Searches keys by prefix, substring or subsequence
+ *
+ * Prefix matches come from the sorted key index (binary search, then a
+ * sequential walk), so they cost O(log n + k). If fewer than max_results
+ * prefix matches exist and KV_SEARCH_FUZZY is set, the remaining results are
+ * filled by a linear scan for case-insensitive substring matches, then for
+ * keys containing the query characters in order. An empty query returns
+ * the first keys in sorted order.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param query Query string (max KEY_SIZE-1 characters)
+ * @param flags KV_SEARCH_PREFIX and/or KV_SEARCH_FUZZY
+ * @param results_out Array of at least max_results elements
+ * @param max_results Maximum number of results to return
+ * @return Number of results written, or -1 on error (errno set: EINVAL for
+ *         invalid params, ENAMETOOLONG if query too long)
+ */
+int shared_memory_kv_search(shared_memory_kv_store_t *store, const char *query,
+                            int flags, kv_search_result_t *results_out,
+                            size_t max_results);
+
+/**
+ * Reads several keys as of one store version
+ *
+ * All values come from the same state of the store: no write is partially
+ * visible. Readers do not take the semaphore and never block writers; they
+ * copy optimistically and retry when the sequence lock shows a concurrent
+ * write, falling back to the semaphore after KV_SNAPSHOT_RETRIES attempts
+ * (with KV_FLAG_SINGLE_WRITER they keep retrying: the writer never holds
+ * the semaphore).
+ *
+ * @param store Pointer to shared memory KV store
+ * @param items Keys to read (key filled in by the caller)
+ * @param count Number of items
+ * @param version_out Optional pointer to return the snapshot's store version
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params,
+ *         ENAMETOOLONG if a key is too long). Missing keys are not an
+ *         error: their found field is 0
+ */
+int shared_memory_kv_snapshot_get(shared_memory_kv_store_t *store,
+                                  kv_snapshot_item_t *items, size_t count,
+                                  unsigned int *version_out);
+
+/**
+ * Copies every entry of the table as of one store version
+ *
+ * Same consistency and locking as shared_memory_kv_snapshot_get().
+ *
+ * @param store Pointer to shared memory KV store
+ * @param entries_out Array of at least MAX_ENTRIES elements
+ * @param version_out Optional pointer to return the snapshot's store version
+ * @return Number of entries written (in slot order), or -1 on error (errno
+ *         set: EINVAL for invalid params)
+ */
+int shared_memory_kv_snapshot_table(shared_memory_kv_store_t *store,
+                                    kv_entry_t *entries_out,
+                                    unsigned int *version_out);
+
+/**
+ * Reads the retained versions of a key
+ *
+ * Lock-free like shared_memory_kv_get(). Up to KV_MVCC_VERSIONS versions
+ * are kept per entry; deleting a key drops its history.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param versions_out Array of at least max_versions elements
+ * @param max_versions Maximum number of versions to return
+ * @return Number of versions written (newest first), or -1 on error (errno
+ *         set: EINVAL for invalid params, ENAMETOOLONG if key too long,
+ *         ENOENT if the key does not exist)
+ */
+int shared_memory_kv_history(shared_memory_kv_store_t *store, const char *key,
+                             kv_version_info_t *versions_out,
+                             size_t max_versions);
+
+/**
+ * Starts a transaction
+ *
+ * @param store Pointer to shared memory KV store
+ * @param txn Caller-allocated transaction (any previous content discarded)
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params)
+ */
+int shared_memory_kv_txn_begin(shared_memory_kv_store_t *store,
+                               shared_memory_kv_txn_t *txn);
+
+/**
+ * Reads a key inside a transaction
+ *
+ * Returns the transaction's own buffered write if there is one; otherwise
+ * reads the store and records the slot version for validation at commit
+ * (a missing key is recorded too, so a concurrent insert is a conflict).
+ *
+ * @param txn Active transaction
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value_out Pointer to return the value (max VALUE_SIZE-1 characters)
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params or
+ *         inactive transaction, ENAMETOOLONG if key too long, ENOENT if the
+ *         key does not exist, E2BIG if KV_TXN_MAX_OPS keys were read)
+ */
+int shared_memory_kv_txn_get(shared_memory_kv_txn_t *txn, const char *key,
+                             char *value_out);
+
+/**
+ * Buffers a set inside a transaction (applied at commit)
+ *
+ * @param txn Active transaction
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value Value string (max VALUE_SIZE-1 characters)
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params or
+ *         inactive transaction, ENAMETOOLONG if key/value too long, E2BIG if
+ *         KV_TXN_MAX_OPS keys were written)
+ */
+int shared_memory_kv_txn_set(shared_memory_kv_txn_t *txn, const char *key,
+                             const char *value);
+
+/**
+ * Buffers a delete inside a transaction (applied at commit; deleting a key
+ * that does not exist at commit time is not an error)
+ *
+ * @param txn Active transaction
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @return 0 on success, -1 on error (errno set as for
+ *         shared_memory_kv_txn_set)
+ */
+int shared_memory_kv_txn_delete(shared_memory_kv_txn_t *txn, const char *key);
+
+/**
+ * Buffers a set of a native integer (KV_TYPE_INT64) inside a transaction
+ *
+ * @param txn Active transaction
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value Value
+ * @return 0 on success, -1 on error (errno set as by
+ *         shared_memory_kv_txn_set)
+ */
+int shared_memory_kv_txn_set_int64(shared_memory_kv_txn_t *txn,
+                                   const char *key, long long value);
+
+/**
+ * Buffers a set of a native double (KV_TYPE_DOUBLE) inside a transaction
+ *
+ * @param txn Active transaction
+ * @param key Key string (max KEY_SIZE-1 characters)
+ * @param value Value
+ * @return 0 on success, -1 on error (errno set as by
+ *         shared_memory_kv_txn_set)
+ */
+int shared_memory_kv_txn_set_double(shared_memory_kv_txn_t *txn,
+                                    const char *key, double value);
+
+/**
+ * Validates and applies a transaction atomically
+ *
+ * Under the semaphore (with KV_FLAG_SINGLE_WRITER: only in the writing
+ * process, without it): every key read must still be in the same state
+ * (same slot and slot_version, or still missing); then all writes are
+ * staged (arena allocation, capacity check) and, only if all succeed,
+ * applied. The transaction ends in every case; on EAGAIN the caller
+ * retries from shared_memory_kv_txn_begin().
+ *
+ * @param txn Active transaction
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params or
+ *         inactive transaction, EAGAIN if a read key changed or the retire
+ *         list is full, ENOSPC if the table or arena cannot hold the
+ *         writes, EPERM if another process is the single writer; nothing
+ *         is applied on error)
+ */
+int shared_memory_kv_txn_commit(shared_memory_kv_txn_t *txn);
+
+/**
+ * Discards a transaction without applying its writes
+ *
+ * @param txn Transaction
+ */
+void shared_memory_kv_txn_abort(shared_memory_kv_txn_t *txn);
+
+/**
+ * Appends a sample to a time series, creating the series if needed
+ *
+ * Once KV_SERIES_SAMPLES samples are held, each append overwrites the
+ * oldest one. Samples are append-only: a timestamp older than the newest
+ * sample is rejected. Subscribers of the series name are notified.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Series name (max KEY_SIZE-1 characters)
+ * @param timestamp Milliseconds since the Unix epoch (0 = now)
+ * @param value Sample value
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params
+ *         or a timestamp older than the newest sample, ENAMETOOLONG if the
+ *         name is too long, ENOSPC if KV_SERIES_MAX series exist, EPERM if
+ *         another process is the single writer)
+ */
+int shared_memory_kv_ts_append(shared_memory_kv_store_t *store,
+                               const char *key, long long timestamp,
+                               double value);
+
+/**
+ * Reads the samples of a time series within a time range
+ *
+ * Lock-free. Samples are returned oldest first; when more than
+ * max_samples fall into the range, the newest max_samples are returned.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Series name
+ * @param from First timestamp of the range (inclusive, 0 = no limit)
+ * @param to Last timestamp of the range (inclusive, 0 = no limit)
+ * @param samples_out Array of at least max_samples elements
+ * @param max_samples Maximum number of samples to return
+ * @return Number of samples written, or -1 on error (errno set: EINVAL for
+ *         invalid params, ENOENT if there is no such series)
+ */
+int shared_memory_kv_ts_range(shared_memory_kv_store_t *store,
+                              const char *key, long long from, long long to,
+                              kv_sample_t *samples_out, size_t max_samples);
+
+/**
+ * Lists the time series
+ *
+ * @param store Pointer to shared memory KV store
+ * @param series_out Array of at least max_series elements
+ * @param max_series Maximum number of series to return
+ * @return Number of series written, or -1 on error (errno set: EINVAL for
+ *         invalid params)
+ */
+int shared_memory_kv_ts_list(shared_memory_kv_store_t *store,
+                             kv_series_info_t *series_out, size_t max_series);
+
+/**
+ * Deletes a time series with all its samples
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Series name
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params,
+ *         ENOENT if there is no such series, EPERM if another process is
+ *         the single writer)
+ */
+int shared_memory_kv_ts_delete(shared_memory_kv_store_t *store,
+                               const char *key);
+
+/**
+ * Enables, changes or disables the rollups of a key
+ *
+ * While enabled, every write of the key whose value is a number is added
+ * to the current bucket of each selected window: a KV_TYPE_INT64 or
+ * KV_TYPE_DOUBLE value, or a string that strtod parses whole ("12.5", not
+ * "12.5 kB"). Other values are ignored. The key need not exist yet.
+ * Windows that are deselected are reset; windows = 0 frees the entry.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key name (max KEY_SIZE-1 characters)
+ * @param windows KV_ROLLUP_* flags (0 = disable)
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params,
+ *         ENAMETOOLONG if the key is too long, ENOSPC if KV_ROLLUP_MAX keys
+ *         have rollups, ENOENT when disabling a key without rollups, EPERM
+ *         if another process is the single writer)
+ */
+int shared_memory_kv_rollup_enable(shared_memory_kv_store_t *store,
+                                   const char *key, unsigned int windows);
+
+/**
+ * Reads the rollups of a key
+ *
+ * Lock-free and O(1): the aggregates are maintained on write, the read
+ * only copies them and moves buckets whose window has ended.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param key Key name
+ * @param rollup_out Receives the rollups
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params,
+ *         ENOENT if the key has no rollups)
+ */
+int shared_memory_kv_rollup_get(shared_memory_kv_store_t *store,
+                                const char *key,
+                                kv_rollup_info_t *rollup_out);
+
+/**
+ * Lists the rollups of all keys that have them
+ *
+ * @param store Pointer to shared memory KV store
+ * @param rollups_out Array of at least max_rollups elements
+ * @param max_rollups Maximum number of entries to return
+ * @return Number of entries written, or -1 on error (errno set: EINVAL for
+ *         invalid params)
+ */
+int shared_memory_kv_rollup_list(shared_memory_kv_store_t *store,
+                                 kv_rollup_info_t *rollups_out,
+                                 size_t max_rollups);
+
+/**
+ * Creates a queue
+ *
+ * Queues hand work between processes through the segment: producers push
+ * items of up to KV_QUEUE_ITEM_SIZE bytes, consumers pop them in FIFO
+ * order, both without taking the semaphore. Only creating and deleting a
+ * queue lock.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Queue name (max KEY_SIZE-1 characters)
+ * @return 0 on success (also if the queue exists), -1 on error (errno set:
+ *         EINVAL for invalid params, ENAMETOOLONG if the name is too long,
+ *         ENOSPC if KV_QUEUE_MAX queues exist, EPERM if another process is
+ *         the single writer)
+ */
+int shared_memory_kv_queue_create(shared_memory_kv_store_t *store,
+                                  const char *name);
+
+/**
+ * Pushes an item to the tail of a queue
+ *
+ * Lock-free; never blocks. Any attached process may push, also with
+ * KV_FLAG_SINGLE_WRITER.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Queue name
+ * @param data Item bytes
+ * @param length Number of bytes (max KV_QUEUE_ITEM_SIZE)
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params,
+ *         ENOENT if there is no such queue or it was deleted meanwhile,
+ *         EAGAIN if the queue is full, EMSGSIZE if the item is too large)
+ */
+int shared_memory_kv_queue_push(shared_memory_kv_store_t *store,
+                                const char *name, const void *data,
+                                size_t length);
+
+/**
+ * Pops the item at the head of a queue, waiting for one if it is empty
+ *
+ * Lock-free while items are waiting; an empty queue puts the caller to
+ * sleep on a futex until a push (no polling).
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Queue name
+ * @param data_out Buffer for the item
+ * @param capacity Size of data_out (KV_QUEUE_ITEM_SIZE always suffices)
+ * @param timeout_ms Maximum wait in milliseconds (0 = don't wait,
+ *        -1 = no limit)
+ * @return Item length, or -1 on error (errno set: EINVAL for invalid
+ *         params, ENOENT if there is no such queue or it was deleted
+ *         meanwhile, EAGAIN if the queue is empty and timeout_ms is 0,
+ *         ETIMEDOUT if it stayed empty, EINTR if a signal interrupted the
+ *         wait, ERANGE if the item at the head is larger than capacity; it
+ *         then stays queued)
+ */
+int shared_memory_kv_queue_pop(shared_memory_kv_store_t *store,
+                               const char *name, void *data_out,
+                               size_t capacity, int timeout_ms);
+
+/**
+ * Lists the queues
+ *
+ * @param store Pointer to shared memory KV store
+ * @param queues_out Array of at least max_queues elements
+ * @param max_queues Maximum number of queues to return
+ * @return Number of queues written, or -1 on error (errno set: EINVAL for
+ *         invalid params)
+ */
+int shared_memory_kv_queue_list(shared_memory_kv_store_t *store,
+                                kv_queue_info_t *queues_out,
+                                size_t max_queues);
+
+/**
+ * Deletes a queue with the items it holds
+ *
+ * Consumers blocked in a pop return ENOENT. Producers and consumers must
+ * be done with the queue: one still holding a position may otherwise
+ * write into the ring of a queue created later in the same entry.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Queue name
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params,
+ *         ENOENT if there is no such queue, EPERM if another process is
+ *         the single writer)
+ */
+int shared_memory_kv_queue_delete(shared_memory_kv_store_t *store,
+                                  const char *name);
+
+/**
+ * Adds a member to a sorted set or changes its score, creating the set if
+ * needed
+ *
+ * Members are ordered by score, then by name. O(log n): the member index
+ * finds an existing member, the skiplist places it. Subscribers of the set
+ * name are notified.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Set name (max KEY_SIZE-1 characters)
+ * @param member Member (max KV_ZSET_MEMBER_SIZE-1 characters)
+ * @param score Score (not NaN)
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params,
+ *         ENAMETOOLONG if the name or member is too long, ENOSPC if the set
+ *         holds KV_ZSET_CAPACITY members or KV_ZSET_MAX sets exist, EPERM
+ *         if another process is the single writer)
+ */
+int shared_memory_kv_zadd(shared_memory_kv_store_t *store, const char *name,
+                          const char *member, double score);
+
+/**
+ * Removes a member from a sorted set
+ *
+ * The set stays (empty) when its last member is removed.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Set name
+ * @param member Member
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params,
+ *         ENOENT if there is no such set or member, EPERM if another
+ *         process is the single writer)
+ */
+int shared_memory_kv_zrem(shared_memory_kv_store_t *store, const char *name,
+                          const char *member);
+
+/**
+ * Gets the score of a member (lock-free)
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Set name
+ * @param member Member
+ * @param score_out Pointer to return the score
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params,
+ *         ENOENT if there is no such set or member)
+ */
+int shared_memory_kv_zscore(shared_memory_kv_store_t *store, const char *name,
+                            const char *member, double *score_out);
+
+/**
+ * Gets the rank of a member (lock-free, O(log n))
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Set name
+ * @param member Member
+ * @param reverse 0: rank 0 is the lowest score; 1: the highest
+ * @return Rank, or -1 on error (errno set as by shared_memory_kv_zscore)
+ */
+int shared_memory_kv_zrank(shared_memory_kv_store_t *store, const char *name,
+                           const char *member, int reverse);
+
+/**
+ * Reads the members at ranks start .. start + max_items - 1 (lock-free,
+ * O(log n + k))
+ *
+ * With reverse set the ranks count from the highest score, so top-K is
+ * zrange(store, name, 0, 1, items, K).
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Set name
+ * @param start First rank
+ * @param reverse 0: ascending scores; 1: descending
+ * @param items_out Array of at least max_items elements
+ * @param max_items Maximum number of members to return
+ * @return Number of members written (in rank order), or -1 on error (errno
+ *         set: EINVAL for invalid params, ENOENT if there is no such set)
+ */
+int shared_memory_kv_zrange(shared_memory_kv_store_t *store, const char *name,
+                            unsigned int start, int reverse,
+                            kv_zset_item_t *items_out, size_t max_items);
+
+/**
+ * Reads the members with min <= score <= max, lowest first (lock-free,
+ * O(log n + k))
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Set name
+ * @param min Lowest score
+ * @param max Highest score
+ * @param items_out Array of at least max_items elements
+ * @param max_items Maximum number of members to return
+ * @return Number of members written, or -1 on error (errno set as by
+ *         shared_memory_kv_zrange)
+ */
+int shared_memory_kv_zrange_by_score(shared_memory_kv_store_t *store,
+                                     const char *name, double min, double max,
+                                     kv_zset_item_t *items_out,
+                                     size_t max_items);
+
+/**
+ * Lists the sorted sets
+ *
+ * @param store Pointer to shared memory KV store
+ * @param zsets_out Array of at least max_zsets elements
+ * @param max_zsets Maximum number of sets to return
+ * @return Number of sets written, or -1 on error (errno set: EINVAL for
+ *         invalid params)
+ */
+int shared_memory_kv_zset_list(shared_memory_kv_store_t *store,
+                               kv_zset_info_t *zsets_out, size_t max_zsets);
+
+/**
+ * Deletes a sorted set with all its members
+ *
+ * @param store Pointer to shared memory KV store
+ * @param name Set name
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params,
+ *         ENOENT if there is no such set, EPERM if another process is the
+ *         single writer)
+ */
+int shared_memory_kv_zset_delete(shared_memory_kv_store_t *store,
+                                 const char *name);
+
+
+
+
+/**
+ * Returns the position the next change will be logged at
+ *
+ * Read it before copying the table: changes from this position on then
+ * cover everything the copy may have missed.
+ *
+ * @param store Pointer to shared memory KV store
+ * @return Change log head (0 if store is NULL)
+ */
+unsigned long long
+shared_memory_kv_changelog_position(shared_memory_kv_store_t *store);
+
+/**
+ * Reads logged changes from a position on (lock-free)
+ *
+ * @param store Pointer to shared memory KV store
+ * @param position_inout Position of the first change to read; advanced
+ *        past the changes returned
+ * @param changes_out Array of at least max_changes elements
+ * @param max_changes Maximum number of changes to return
+ * @return Number of changes written (0 if there are none yet), or -1 on
+ *         error (errno set: EINVAL for invalid params or a position past
+ *         the head, ERANGE if changes from *position_inout on were already
+ *         overwritten: copy the table again)
+ */
+int shared_memory_kv_changelog_read(shared_memory_kv_store_t *store,
+                                    unsigned long long *position_inout,
+                                    kv_change_t *changes_out,
+                                    size_t max_changes);
+
+/**
+ * Waits until a change is logged at a position
+ *
+ * Sleeps on a futex in the segment; writers make the wake-up system call
+ * only while someone is waiting.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param position Position to wait for (returns at once if the head is
+ *        already past it)
+ * @param timeout_ms Maximum wait in milliseconds (0 = don't wait,
+ *        -1 = no limit)
+ * @return 0 if a change is there, -1 on error (errno set: EINVAL for
+ *         invalid params, EAGAIN or ETIMEDOUT if none came, EINTR if
+ *         interrupted by a signal)
+ */
+int shared_memory_kv_changelog_wait(shared_memory_kv_store_t *store,
+                                    unsigned long long position,
+                                    int timeout_ms);
+
+/**
+ * Publishes the replication state of a store (called by its replicator)
+ *
+ * One process reports at a time; readers never wait for it.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param status State to publish
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params)
+ */
+int shared_memory_kv_replication_report(
+    shared_memory_kv_store_t *store, const kv_replication_status_t *status);
+
+/**
+ * Reads the replication state of a store (lock-free)
+ *
+ * A store no replicator reported to reads as KV_ROLE_PRIMARY with its own
+ * log head as primary_position.
+ *
+ * @param store Pointer to shared memory KV store
+ * @param status_out Pointer to return the state
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params)
+ */
+int shared_memory_kv_replication_status(shared_memory_kv_store_t *store,
+                                        kv_replication_status_t *status_out);
+
+// ============================================================================
+// SHARDED STORES (client-side routing over several segments)
+// ============================================================================
+
+/**
+ * Creates a sharded store: count independent stores named "<name>.0" to
+ * "<name>.<count-1>"
+ *
+ * Each shard is a complete store with its own lock, so writes of keys in
+ * different shards never wait for each other.
+ *
+ * @param router Caller-allocated router to initialize
+ * @param name Base name ("/" and a name, like SHM_NAME)
+ * @param count Number of shards (1 to KV_SHARD_MAX)
+ * @param flags Storage options of every shard (see
+ *        shared_memory_kv_create_ex; KV_FLAG_SINGLE_WRITER is not allowed:
+ *        batch workers write from threads of their own)
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params
+ *         or KV_FLAG_SINGLE_WRITER, ENAMETOOLONG if a shard name would be
+ *         too long, EEXIST if a shard exists (see
+ *         shared_memory_kv_sharded_unlink), or as by
+ *         shared_memory_kv_create_named; no shard is left behind on error)
+ */
+int shared_memory_kv_sharded_create(shared_memory_kv_sharded_t *router,
+                                    const char *name, unsigned int count,
+                                    unsigned int flags);
+
+/**
+ * Opens an existing sharded store (the shard count is read from shard 0)
+ *
+ * @param router Caller-allocated router to initialize
+ * @param name Base name the store was created with
+ * @return 0 on success, -1 on error (errno set: EINVAL for invalid params
+ *         or if the objects are not the shards of one sharded store,
+ *         ENAMETOOLONG if a shard name would be too long, ENOENT if a
+ *         shard does not exist)
+ */
+int shared_memory_kv_sharded_open(shared_memory_kv_sharded_t *router,
+                                  const char *name);
+
+/**
+ * Stops the batch workers and detaches from all shards
+ *
+ * @param router Router opened by shared_memory_kv_sharded_create/open
+ */
+void shared_memory_kv_sharded_destroy(shared_memory_kv_sharded_t *router);
+
+/**
+ * Removes the shared memory objects of a sharded store
+ *
+ * @param name Base name the store was created with
+ * @return 0 if any shard was removed, -1 on error (errno set: EINVAL for
+ *         invalid params, ENOENT if there was none)
+ */
+int shared_memory_kv_sharded_unlink(const char *name);
+
+/**
+ * Shard a key belongs to
+ *
+ * The key hash is mixed before it is reduced to a shard, so the keys of one
+ * shard still spread over all slots of its table.
+ *
+ * @param router Open router
+ * @param key Key string
+ * @return Shard index (0 for invalid params)
+ */
+unsigned int
+shared_memory_kv_shard_of(const shared_memory_kv_sharded_t *router,
+                          const char *key);
+
+/**
+ * Store of the shard a key belongs to
+ *
+ * Any single-key function (typed values, hashes, history, rollups) works on
+ * a sharded store through it.
+ *
+ * @param router Open router
+ * @param key Key string
+ * @return Store of the key's shard, or NULL for invalid params (errno set:
+ *         EINVAL)
+ */
+shared_memory_kv_store_t *
+shared_memory_kv_sharded_store(const shared_memory_kv_sharded_t *router,
+                               const char *key);
+
+/**
+ * Sets a key in its shard (see shared_memory_kv_set)
+ *
+ * @return 0 on success, -1 on error (errno set as by shared_memory_kv_set)
+ */
+int shared_memory_kv_sharded_set(shared_memory_kv_sharded_t *router,
+                                 const char *key, const char *value);
+
+/**
+ * Reads a key from its shard, lock-free (see shared_memory_kv_get)
+ *
+ * @return 0 on success, -1 on error (errno set as by shared_memory_kv_get)
+ */
+int shared_memory_kv_sharded_get(shared_memory_kv_sharded_t *router,
+                                 const char *key, char *value_out);
+
+/**
+ * Deletes a key from its shard (see shared_memory_kv_delete)
+ *
+ * @return 0 on success, -1 on error (errno set as by
+ *         shared_memory_kv_delete)
+ */
+int shared_memory_kv_sharded_delete(shared_memory_kv_sharded_t *router,
+                                    const char *key);
+
+/**
+ * Applies a batch of sets and deletes
+ *
+ * The batch is split by shard and the parts run concurrently (see
+ * KV_SHARD_PARALLEL_MIN). Operations on one key run in batch order; the
+ * batch as a whole is not atomic. Each operation's error reports its own
+ * outcome.
+ *
+ * @param router Open router
+ * @param ops Operations (key, value, is_delete)
+ * @param count Number of operations
+ * @return Number of operations that succeeded, or -1 on error (errno set:
+ *         EINVAL for invalid params)
+ */
+int shared_memory_kv_sharded_mset(shared_memory_kv_sharded_t *router,
+                                  kv_shard_op_t *ops, size_t count);
+
+/**
+ * Reads a batch of keys, split by shard like shared_memory_kv_sharded_mset
+ *
+ * @param router Open router
+ * @param ops Operations (key); value receives the value, or "" if the read
+ *        failed (error, e.g. ENOENT)
+ * @param count Number of operations
+ * @return Number of keys read, or -1 on error (errno set: EINVAL for
+ *         invalid params)
+ */
+int shared_memory_kv_sharded_mget(shared_memory_kv_sharded_t *router,
+                                  kv_shard_op_t *ops, size_t count);
 
 #endif // SHM_KV_H
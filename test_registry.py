@@ -0,0 +1,116 @@
+from kv_store_wrapper import KVStoreWrapper, KV_FLAG_SINGLE_WRITER
+import subprocess
+import sys
+import threading
+from pathlib import Path
+
+# Path to shared library (relative to this file)
+BUILD_DIR = Path(__file__).parent / "build"
+LIB_PATH = BUILD_DIR / "libshared_memory_kv.so"
+
+STORE_NAME = "/test_registry_kv"
+SINGLE_WRITER_NAME = "/test_registry_single_writer_kv"
+# More short-lived threads than the registry has entries (KV_REGISTRY_SIZE)
+THREAD_COUNT = 140
+
+# Second process: opens the store, reads a key, then waits for a line on
+# stdin before detaching
+CHILD_SCRIPT = f"""
+import sys
+sys.path.insert(0, {str(Path(__file__).parent)!r})
+from kv_store_wrapper import KVStoreWrapper
+wrapper = KVStoreWrapper({str(LIB_PATH)!r}, name={STORE_NAME!r})
+assert wrapper.open(), "open failed"
+value, error = wrapper.get("key")
+print(f"{{value}}|{{error}}", flush=True)
+sys.stdin.readline()
+wrapper.destroy()
+"""
+
+
+def read_from_threads(wrapper):
+    """Reads "key" from THREAD_COUNT threads that are all alive at once"""
+    barrier = threading.Barrier(THREAD_COUNT)
+    results = [None] * THREAD_COUNT
+
+    def read_and_exit(index):
+        results[index] = wrapper.get("key")
+        barrier.wait()
+
+    threads = [threading.Thread(target=read_and_exit, args=(index,))
+               for index in range(THREAD_COUNT)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    return results
+
+
+def verify_fix():
+    print("--- Starting Verification ---")
+
+    if not LIB_PATH.exists():
+        print(f"Error: Library not found at {LIB_PATH}. Please run 'make libso' first.")
+        return
+
+    print(f"Loading library from {LIB_PATH}...")
+    wrapper = KVStoreWrapper(str(LIB_PATH), name=STORE_NAME)
+    wrapper.unlink()
+    assert wrapper.create(), "create failed"
+    success, error = wrapper.set("key", "value")
+    assert success, error
+
+    # Every thread claims a registry entry on its first read and must free
+    # it when it exits. They all read before any exits, so the registry
+    # fills up
+    print(f"Reading from {THREAD_COUNT} short-lived threads...")
+    read_from_threads(wrapper)
+    stats = wrapper.get_memory_stats()
+    entries = stats["mvcc"]["registry_entries"]
+    print(f"Registry entries in use: {entries}")
+    assert entries <= 2, "exited threads kept their entries"
+
+    print("Reading from a second process...")
+    child = subprocess.Popen([sys.executable, "-c", CHILD_SCRIPT],
+                             stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                             text=True)
+    line = child.stdout.readline().strip()
+    print(f"Child get: {line}")
+    assert line == "value|None", "second process could not read"
+
+    print("Testing unlink_safe() while the second process is attached...")
+    success, error = wrapper.unlink_safe()
+    print(f"Unlink result: {success}, Error: {error}")
+    assert success is False
+    assert "attached" in error
+
+    child.stdin.write("\n")
+    child.stdin.flush()
+    child.wait()
+
+    print("Testing unlink_safe() after it detached...")
+    success, error = wrapper.unlink_safe()
+    print(f"Unlink result: {success}, Error: {error}")
+    assert success is True
+
+    wrapper.destroy()
+
+    # Single-writer readers never take the semaphore: the threads that find
+    # the registry full must still read, through the shared reader entries
+    print("Reading from a single-writer store with the registry full...")
+    writer = KVStoreWrapper(str(LIB_PATH), name=SINGLE_WRITER_NAME)
+    writer.unlink()
+    assert writer.create(KV_FLAG_SINGLE_WRITER), "create failed"
+    success, error = writer.set("key", "value")
+    assert success, error
+    results = read_from_threads(writer)
+    failed = [result for result in results if result != ("value", None)]
+    print(f"Failed reads: {len(failed)}")
+    assert not failed, failed[0]
+    writer.destroy()
+    writer.unlink()
+
+    print("--- Verification Completed Successfully ---")
+
+if __name__ == "__main__":
+    verify_fix()
@@ -0,0 +1,57 @@
+from kv_store_wrapper import KVStoreWrapper, KV_FLAG_SINGLE_WRITER
+import ctypes
+import errno
+from pathlib import Path
+
+# Path to shared library (relative to this file)
+BUILD_DIR = Path(__file__).parent / "build"
+LIB_PATH = BUILD_DIR / "libshared_memory_kv.so"
+
+SHARDED_NAME = b"/test_sharded_kv"
+# Larger than shared_memory_kv_sharded_t
+ROUTER_SIZE = 65536
+
+
+def verify_fix():
+    print("--- Starting Verification ---")
+
+    if not LIB_PATH.exists():
+        print(f"Error: Library not found at {LIB_PATH}. Please run 'make libso' first.")
+        return
+
+    print(f"Loading library from {LIB_PATH}...")
+    lib = KVStoreWrapper(str(LIB_PATH)).lib
+    lib.shared_memory_kv_sharded_create.argtypes = [
+        ctypes.c_void_p, ctypes.c_char_p, ctypes.c_uint, ctypes.c_uint
+    ]
+    lib.shared_memory_kv_sharded_create.restype = ctypes.c_int
+    lib.shared_memory_kv_sharded_unlink.argtypes = [ctypes.c_char_p]
+    lib.shared_memory_kv_sharded_unlink.restype = ctypes.c_int
+    lib.shared_memory_kv_sharded_destroy.argtypes = [ctypes.c_void_p]
+    lib.shared_memory_kv_sharded_destroy.restype = None
+
+    lib.shared_memory_kv_sharded_unlink(SHARDED_NAME)
+    router = ctypes.create_string_buffer(ROUTER_SIZE)
+
+    # Sharded stores write from batch worker threads: single-writer shards
+    # must be rejected
+    print("Testing sharded_create() with KV_FLAG_SINGLE_WRITER...")
+    result = lib.shared_memory_kv_sharded_create(
+        router, SHARDED_NAME, 2, KV_FLAG_SINGLE_WRITER
+    )
+    error = ctypes.get_errno()
+    print(f"Create result: {result}, errno: {error}")
+    assert result == -1
+    assert error == errno.EINVAL
+
+    print("Testing sharded_create() without flags...")
+    result = lib.shared_memory_kv_sharded_create(router, SHARDED_NAME, 2, 0)
+    print(f"Create result: {result}")
+    assert result == 0
+    lib.shared_memory_kv_sharded_destroy(router)
+    lib.shared_memory_kv_sharded_unlink(SHARDED_NAME)
+
+    print("--- Verification Completed Successfully ---")
+
+if __name__ == "__main__":
+    verify_fix()
@@ -0,0 +1,50 @@
+from kv_store_wrapper import KVStoreWrapper, KV_FLAG_SINGLE_WRITER
+import threading
+from pathlib import Path
+
+# Path to shared library (relative to this file)
+BUILD_DIR = Path(__file__).parent / "build"
+LIB_PATH = BUILD_DIR / "libshared_memory_kv.so"
+
+STORE_NAME = "/test_single_writer_kv"
+
+
+def verify_fix():
+    print("--- Starting Verification ---")
+
+    if not LIB_PATH.exists():
+        print(f"Error: Library not found at {LIB_PATH}. Please run 'make libso' first.")
+        return
+
+    # Single-writer store: only the creating thread may write
+    print(f"Loading library from {LIB_PATH}...")
+    wrapper = KVStoreWrapper(str(LIB_PATH), name=STORE_NAME)
+    wrapper.unlink()
+    assert wrapper.create(KV_FLAG_SINGLE_WRITER), "create failed"
+
+    print("Testing set() from the creating thread...")
+    success, error = wrapper.set("owner", "1")
+    print(f"Set result: {success}, Error: {error}")
+    assert success is True
+
+    print("Testing set() from another thread...")
+    results = {}
+
+    def write_from_thread():
+        results["set"] = wrapper.set("other", "2")
+
+    thread = threading.Thread(target=write_from_thread)
+    thread.start()
+    thread.join()
+    success, error = results["set"]
+    print(f"Set result: {success}, Error: {error}")
+    assert success is False
+    assert "EPERM" in error
+
+    wrapper.destroy()
+    wrapper.unlink()
+
+    print("--- Verification Completed Successfully ---")
+
+if __name__ == "__main__":
+    verify_fix()